@@ -59,6 +59,8 @@
 #include "apple.h"
 #include "mystrings.h"
 #include "scan.h"
+#include "crc32.h"
+#include "profile.h"
 #include "../include/refit_call_wrapper.h"
 #include "../mok/mok.h"
 
@@ -70,6 +72,7 @@
 #define ENCODING_ISO8859_1  (0)
 #define ENCODING_UTF8       (1)
 #define ENCODING_UTF16_LE   (2)
+#define ENCODING_TOKENS     (3) /* Compiled token lines from ReadConfigFile */
 
 #define MINLOGLEVEL         (0)
 #define MAXLOGLEVEL         (3)
@@ -89,6 +92,141 @@ BOOLEAN InnerScan = FALSE;
 // extern REFIT_MENU_ENTRY MenuEntryReturn;
 //static REFIT_MENU_ENTRY MenuEntryReturn   = { L"Return to Main Menu", TAG_RETURN, 0, 0, 0, NULL, NULL, NULL };
 
+//
+// decode a file into UTF-16
+//
+
+// Decodes one UTF-8 sequence at p.
+// Returns the number of bytes used, or 0 if the bytes at p are not a valid
+// shortest-form sequence.
+static
+UINTN DecodeUtf8Char (
+    IN  CHAR8  *p,
+    IN  CHAR8  *End,
+    OUT UINT32 *CodePoint
+) {
+    UINT8   Lead = (UINT8) *p;
+    UINT8   Trail;
+    UINTN   Length, i;
+    UINT32  Value;
+
+    if (Lead < 0x80) {
+        *CodePoint = Lead;
+        return 1;
+    }
+
+    if ((Lead & 0xE0) == 0xC0) {
+        Length = 2;
+        Value  = Lead & 0x1F;
+    }
+    else if ((Lead & 0xF0) == 0xE0) {
+        Length = 3;
+        Value  = Lead & 0x0F;
+    }
+    else if ((Lead & 0xF8) == 0xF0) {
+        Length = 4;
+        Value  = Lead & 0x07;
+    }
+    else {
+        return 0;
+    }
+
+    if ((UINTN) (End - p) < Length) {
+        return 0;
+    }
+
+    for (i = 1; i < Length; i++) {
+        Trail = (UINT8) p[i];
+        if ((Trail & 0xC0) != 0x80) {
+            return 0;
+        }
+        Value = (Value << 6) | (Trail & 0x3F);
+    } // for
+
+    // Reject overlong forms, surrogates and values beyond Unicode
+    if ((Length == 2 && Value < 0x80)
+        || (Length == 3 && Value < 0x800)
+        || (Length == 4 && Value < 0x10000)
+        || (Value >= 0xD800 && Value <= 0xDFFF)
+        || (Value > 0x10FFFF)
+    ) {
+        return 0;
+    }
+
+    *CodePoint = Value;
+
+    return Length;
+} // static UINTN DecodeUtf8Char()
+
+// Decodes the rest of an 8-bit file into a single UTF-16 buffer that
+// replaces File->Buffer, so that lines and tokens can be split in place.
+// Files without a BOM are read as UTF-8 if they are valid UTF-8, and as
+// ISO-8859-1 otherwise. Invalid sequences in UTF-8 files become U+FFFD.
+static
+BOOLEAN DecodeFileToUtf16 (
+    IN OUT REFIT_FILE *File
+) {
+    CHAR8   *p, *End;
+    CHAR16  *Arena, *q;
+    UINT32   CodePoint;
+    UINTN    Length;
+    BOOLEAN  UseUtf8;
+
+    p   = File->Current8Ptr;
+    End = File->End8Ptr;
+
+    UseUtf8 = (File->Encoding == ENCODING_UTF8);
+    if (!UseUtf8) {
+        UseUtf8 = TRUE;
+        while (p < End) {
+            Length = DecodeUtf8Char (p, End, &CodePoint);
+            if (Length == 0) {
+                UseUtf8 = FALSE;
+                break;
+            }
+            p += Length;
+        } // while
+        p = File->Current8Ptr;
+    }
+
+    // No sequence gives more UTF-16 code units than it has bytes
+    Arena = AllocatePool (((UINTN) (End - p) + 1) * sizeof (CHAR16));
+    if (Arena == NULL) {
+        return FALSE;
+    }
+
+    q = Arena;
+    while (p < End) {
+        Length = (UseUtf8) ? DecodeUtf8Char (p, End, &CodePoint) : 0;
+        if (Length == 0) {
+            CodePoint = (UseUtf8) ? 0xFFFD : (UINT8) *p;
+            Length    = 1;
+        }
+        p += Length;
+
+        if (CodePoint >= 0x10000) {
+            CodePoint -= 0x10000;
+            *q++ = (CHAR16) (0xD800 + (CodePoint >> 10));
+            *q++ = (CHAR16) (0xDC00 + (CodePoint & 0x3FF));
+        }
+        else {
+            *q++ = (CHAR16) CodePoint;
+        }
+    } // while
+    *q = L'\0';
+
+    MY_FREE_POOL(File->Buffer);
+    File->Buffer       = (UINT8 *) Arena;
+    File->BufferSize   = (UINTN) (q - Arena) * sizeof (CHAR16);
+    File->Encoding     = ENCODING_UTF16_LE;
+    File->Current8Ptr  = (CHAR8 *) Arena;
+    File->End8Ptr      = File->Current8Ptr + File->BufferSize;
+    File->Current16Ptr = Arena;
+    File->End16Ptr     = q;
+
+    return TRUE;
+} // static BOOLEAN DecodeFileToUtf16()
+
 //
 // read a file into a buffer
 //
@@ -132,7 +270,8 @@ EFI_STATUS RefitReadFile (
     MY_FREE_POOL(FileInfo);
 
     File->BufferSize = (UINTN) ReadSize;
-    File->Buffer = AllocatePool (File->BufferSize);
+    // Leave room for a terminating null after the last line of UTF-16 files
+    File->Buffer = AllocatePool (File->BufferSize + sizeof (CHAR16));
     if (File->Buffer == NULL) {
         size = 0;
         return EFI_OUT_OF_RESOURCES;
@@ -178,6 +317,12 @@ EFI_STATUS RefitReadFile (
         // TODO: detect other encodings as they are implemented
     }
 
+    if (File->Encoding != ENCODING_UTF16_LE && !DecodeFileToUtf16 (File)) {
+        MY_FREE_POOL(File->Buffer);
+
+        return EFI_OUT_OF_RESOURCES;
+    }
+
     return EFI_SUCCESS;
 }
 
@@ -185,156 +330,71 @@ EFI_STATUS RefitReadFile (
 // get a single line of text from a file
 //
 
+// Returns the next line, terminated in place in the file buffer.
+// The line stays valid until the buffer is freed.
+// Needs the slot at File->End16Ptr to be writable, as RefitReadFile and
+// the generated options files provide.
 static
 CHAR16 * ReadLine (
     REFIT_FILE *File
 ) {
-    CHAR16  *Line = NULL;
-    CHAR16  *q    = NULL;
-    UINTN   LineLength;
+    CHAR16  *p, *LineStart, *LineEnd;
 
     if (File->Buffer == NULL) {
         return NULL;
     }
 
-    if (File->Encoding == ENCODING_ISO8859_1 || File->Encoding == ENCODING_UTF8) {
-
-        CHAR8 *p, *LineStart, *LineEnd;
-
-        p = File->Current8Ptr;
-        if (p >= File->End8Ptr) {
-            return NULL;
-        }
-
-        LineStart = p;
-        for (; p < File->End8Ptr; p++) {
-            if (*p == 13 || *p == 10) {
-                break;
-            }
-        }
-        LineEnd = p;
-        for (; p < File->End8Ptr; p++) {
-            if (*p != 13 && *p != 10) {
-                break;
-            }
-        }
-        File->Current8Ptr = p;
-
-        LineLength = (UINTN)(LineEnd - LineStart) + 1;
-        Line = AllocatePool (LineLength * sizeof (CHAR16));
-        if (Line == NULL) {
-            return NULL;
-        }
-
-        q = Line;
-        if (File->Encoding == ENCODING_ISO8859_1) {
-            for (p = LineStart; p < LineEnd; ) {
-                *q++ = *p++;
-            }
-        }
-        else if (File->Encoding == ENCODING_UTF8) {
-            // TODO: actually handle UTF-8
-            for (p = LineStart; p < LineEnd; ) {
-                *q++ = *p++;
-            }
-        }
-        *q = 0;
-
+    if (File->Encoding != ENCODING_UTF16_LE && !DecodeFileToUtf16 (File)) {
+        return NULL;
     }
-    else if (File->Encoding == ENCODING_UTF16_LE) {
-
-        CHAR16 *p, *LineStart, *LineEnd;
-
-        p = File->Current16Ptr;
-        if (p >= File->End16Ptr) {
-            return NULL;
-        }
-
-        LineStart = p;
-        for (; p < File->End16Ptr; p++) {
-            if (*p == 13 || *p == 10) {
-                break;
-            }
-        }
-        LineEnd = p;
-        for (; p < File->End16Ptr; p++) {
-            if (*p != 13 && *p != 10) {
-                break;
-            }
-        }
-        File->Current16Ptr = p;
 
-        LineLength = (UINTN)(LineEnd - LineStart) + 1;
-        Line = AllocatePool (LineLength * sizeof (CHAR16));
-        if (Line == NULL) {
-            return NULL;
-        }
+    p = File->Current16Ptr;
+    if (p >= File->End16Ptr) {
+        return NULL;
+    }
 
-        for (p = LineStart, q = Line; p < LineEnd; ) {
-            *q++ = *p++;
+    LineStart = p;
+    for (; p < File->End16Ptr; p++) {
+        if (*p == 13 || *p == 10) {
+            break;
         }
-        *q = 0;
-
     }
-    else {
-        return NULL;   // unsupported encoding
+    LineEnd = p;
+    for (; p < File->End16Ptr; p++) {
+        if (*p != 13 && *p != 10) {
+            break;
+        }
     }
+    File->Current16Ptr = p;
 
-    return Line;
+    *LineEnd = 0;
+
+    return LineStart;
 }
 
-// Returns FALSE if *p points to the end of a token, TRUE otherwise.
-// Also modifies *p **IF** the first and second characters are both
-// quotes ('"'); it deletes one of them.
 static
-BOOLEAN KeepReading (
-    IN OUT CHAR16  *p,
-    IN OUT BOOLEAN *IsQuoted
-) {
-    BOOLEAN MoreToRead = FALSE;
-    CHAR16  *Temp = NULL;
-
-    if ((p == NULL) || (IsQuoted == NULL)) {
-        return FALSE;
-    }
-
-    if (*p == L'\0') {
-        return FALSE;
-    }
-
-    if ((*p != ' ' && *p != '\t' && *p != '=' && *p != '#' && *p != ',') || *IsQuoted) {
-        MoreToRead = TRUE;
-    }
-
-    if (*p == L'"') {
-        if (p[1] == L'"') {
-            Temp = StrDuplicate (&p[1]);
-            if (Temp != NULL) {
-                StrCpy (p, Temp);
-            MY_FREE_POOL(Temp);
-            }
-            MoreToRead = TRUE;
-        }
-        else {
-            *IsQuoted = !(*IsQuoted);
-            MoreToRead = FALSE;
-        } // if/else second character is a quote
-    } // if first character is a quote
-
-    return MoreToRead;
-} // BOOLEAN KeepReading()
+UINTN ReadCompiledTokenLine (
+    IN REFIT_FILE   *File,
+    OUT CHAR16    ***TokenList
+);
 
 //
 // get a line of tokens from a file
 //
+// Tokens are split in place in the file buffer, so they stay valid until
+// the buffer is freed. Callers that need to change a token should copy it.
 UINTN ReadTokenLine (
     IN REFIT_FILE   *File,
     OUT CHAR16    ***TokenList
 ) {
     BOOLEAN          LineFinished, IsQuoted = FALSE;
-    CHAR16          *Line, *Token, *p;
+    CHAR16          *Line, *Token, *p, *q;
     UINTN            TokenCount = 0;
 
+    if (File->Encoding == ENCODING_TOKENS) {
+        return ReadCompiledTokenLine (File, TokenList);
+    }
+
     *TokenList = NULL;
 
     while (TokenCount == 0) {
@@ -362,155 +422,589 @@ UINTN ReadTokenLine (
                 p++;
             }
 
-            Token = p;
-
-            // find end of token
-            while (KeepReading (p, &IsQuoted)) {
-                if ((*p == L'/') && !IsQuoted) {
+            // find end of token, copying down over any doubled quotes
+            Token = q = p;
+            while (*p != L'\0') {
+                if (*p == L'"') {
+                    if (p[1] != L'"') {
+                        IsQuoted = !IsQuoted;
+                        break;
+                    }
+                    // a doubled quote stands for one literal quote
+                    p++;
+                }
+                else if (!IsQuoted
+                    && (*p == ' ' || *p == '\t' || *p == '=' || *p == '#' || *p == ',')
+                ) {
+                    break;
+                }
+                else if ((*p == L'/') && !IsQuoted) {
                     // Switch Unix-style to DOS-style directory separators
                     *p = L'\\';
                 }
-                p++;
+                *q++ = *p++;
             } // while
             if (*p == L'\0' || *p == L'#') {
                 LineFinished = TRUE;
             }
-            *p++ = 0;
+            else {
+                p++;
+            }
+            *q = 0;
 
             if (LOGPOOL(*TokenList));
-            AddListElement ((VOID ***)TokenList, &TokenCount, (VOID *)StrDuplicate (Token));
+            AddListElement ((VOID ***)TokenList, &TokenCount, (VOID *)Token);
         } // while
-
-        MY_FREE_POOL(Line);
     }
 
     return TokenCount;
 } /* ReadTokenLine() */
 
+// Tokens point into the file buffer, so only the list itself is freed.
 VOID FreeTokenLine (
     IN OUT CHAR16 ***TokenList,
     IN OUT UINTN    *TokenCount
 ) {
-    // TODO: also free the items
-    FreeList ((VOID ***) TokenList, TokenCount);
+    MY_FREE_POOL(*TokenList);
+    *TokenCount = 0;
 }
 
-// Handle a parameter with a single integer argument (unsigned)
+//
+// compiled config files
+//
+
+// Config files are compiled to their token lines when first read. The compiled
+// lines are kept for the session, so the repeated reads of the config file and
+// its 'include' files by ReadConfig, ScanUserConfigured and rescans skip the
+// decoding and tokenising. With 'config_cache' set, they are also kept in a
+// 'config.cache' file in the RefindPlus directory for later boots. Each file is
+// keyed by its path, size and modification time, and is parsed again in full
+// if either of the latter two no longer matches.
+#define CONFIG_CACHE_FILE_NAME    L"config.cache"
+#define CONFIG_CACHE_SIGNATURE    SIGNATURE_32('R','P','C','C')
+#define CONFIG_CACHE_VERSION      1
+#define CONFIG_CACHE_ALIGN(x)     (((x) + 7) & ~((UINTN) 7))
+
+typedef struct {
+    UINT32    Signature;
+    UINT32    Version;
+    UINT32    RecordCount;
+    UINT32    DataSize;
+    UINT32    DataCrc;
+    UINT32    Reserved;
+} CONFIG_CACHE_HEADER;
+
+// Each record is followed by PathLength CHAR16s (NUL terminated) and then by
+// TextLength CHAR16s of compiled lines. Each compiled line is a token count
+// followed by that many NUL terminated tokens. Records are padded to 8 bytes.
+typedef struct {
+    UINT32    RecordSize;
+    UINT32    PathLength;
+    UINT32    TextLength;
+    UINT32    Reserved;
+    UINT64    FileSize;
+    EFI_TIME  ModificationTime;
+} CONFIG_CACHE_RECORD;
+
+typedef struct {
+    CHAR16    *Path;
+    UINT64     FileSize;
+    EFI_TIME   ModificationTime;
+    CHAR16    *Text;
+    UINTN      TextLength;
+    BOOLEAN    OwnsText;
+    BOOLEAN    Used;
+} CONFIG_CACHE_ITEM;
+
+static BOOLEAN             ConfigCacheLoaded   = FALSE;
+static BOOLEAN             ConfigCacheDirty    = FALSE;
+static BOOLEAN             ConfigCacheOnDisk   = FALSE;
+static UINT8              *ConfigCacheFileData = NULL;
+static CONFIG_CACHE_ITEM  *ConfigItems         = NULL;
+static UINTN               ConfigItemCount     = 0;
+
+// Reads the cache file in one I/O. Compiled lines are used in place.
 static
-VOID HandleInt (
-    IN  CHAR16 **TokenList,
-    IN  UINTN    TokenCount,
-    OUT UINTN   *Value
-) {
-    if (TokenCount == 2) {
-            *Value = Atoi (TokenList[1]);
+VOID ConfigCacheReadFile (VOID) {
+    EFI_STATUS            Status;
+    UINTN                 FileSize;
+    UINTN                 Offset;
+    UINTN                 PathBytes;
+    UINTN                 TextBytes;
+    UINTN                 i;
+    CONFIG_CACHE_HEADER  *Header;
+    CONFIG_CACHE_RECORD  *Record;
+    CONFIG_CACHE_ITEM     Item;
+    CHAR16               *RecordPath;
+
+    Status = egLoadFile (SelfDir, CONFIG_CACHE_FILE_NAME, &ConfigCacheFileData, &FileSize);
+    if (EFI_ERROR(Status)) {
+        return;
+    }
+    ConfigCacheOnDisk = TRUE;
+
+    Header = (CONFIG_CACHE_HEADER *) ConfigCacheFileData;
+    if (FileSize < sizeof (CONFIG_CACHE_HEADER)             ||
+        Header->Signature != CONFIG_CACHE_SIGNATURE         ||
+        Header->Version   != CONFIG_CACHE_VERSION           ||
+        Header->DataSize  != FileSize - sizeof (CONFIG_CACHE_HEADER) ||
+        Header->DataCrc   != crc32refit (0, ConfigCacheFileData + sizeof (CONFIG_CACHE_HEADER), Header->DataSize)
+    ) {
+        #if REFIT_DEBUG > 0
+        LOG(2, LOG_LINE_NORMAL, L"Discarding Invalid Config Cache File");
+        #endif
+
+        MY_FREE_POOL(ConfigCacheFileData);
+        ConfigCacheDirty = TRUE;
+
+        return;
+    }
+
+    Offset = sizeof (CONFIG_CACHE_HEADER);
+    for (i = 0; i < Header->RecordCount; i++) {
+        if (FileSize - Offset < sizeof (CONFIG_CACHE_RECORD)) {
+            break;
+        }
+
+        Record    = (CONFIG_CACHE_RECORD *) (ConfigCacheFileData + Offset);
+        PathBytes = Record->PathLength * sizeof (CHAR16);
+        TextBytes = Record->TextLength * sizeof (CHAR16);
+        if (Record->RecordSize > FileSize - Offset ||
+            Record->PathLength == 0 ||
+            sizeof (CONFIG_CACHE_RECORD) + PathBytes + TextBytes > Record->RecordSize
+        ) {
+            break;
+        }
+
+        RecordPath = (CHAR16 *) (Record + 1);
+        if (RecordPath[Record->PathLength - 1] == 0) {
+            Item.Path             = StrDuplicate (RecordPath);
+            Item.FileSize         = Record->FileSize;
+            Item.ModificationTime = Record->ModificationTime;
+            Item.Text             = (CHAR16 *) ((UINT8 *) RecordPath + PathBytes);
+            Item.TextLength       = Record->TextLength;
+            Item.OwnsText         = FALSE;
+            Item.Used             = FALSE;
+            AddListElementSized (
+                (VOID **) &ConfigItems, &ConfigItemCount,
+                &Item, sizeof (Item)
+            );
         }
+
+        Offset += Record->RecordSize;
+    } // for
+
+    if (i < Header->RecordCount) {
+        ConfigCacheDirty = TRUE;
     }
 
-// Handle a parameter with a single integer argument (signed)
-// DA-TAG: We currently only have such arguments of up to '-1'
-//         Superflous '-2' added as update reminder if required
+    #if REFIT_DEBUG > 0
+    LOG(2, LOG_LINE_NORMAL,
+        L"Loaded %d Compiled Config Files from '%s'",
+        ConfigItemCount, CONFIG_CACHE_FILE_NAME
+    );
+    #endif
+} // static VOID ConfigCacheReadFile()
+
 static
-VOID HandleSignedInt (
-    IN  CHAR16 **TokenList,
-    IN  UINTN    TokenCount,
-    OUT INTN    *Value
+CONFIG_CACHE_ITEM * ConfigCacheFind (
+    IN CHAR16 *Path
 ) {
-    if (TokenCount == 2) {
-       if (StrCmp (TokenList[1], L"-1") == 0) {
-           *Value = -1;
-       }
-        else if (StrCmp (TokenList[1], L"-2") == 0) {
-            *Value = -2;
+    UINTN i;
+
+    for (i = 0; i < ConfigItemCount; i++) {
+        if (MyStriCmp (ConfigItems[i].Path, Path)) {
+            return &ConfigItems[i];
         }
-       else {
-           *Value = Atoi (TokenList[1]);
-       }
     }
-}
 
-// handle a parameter with a single string argument
-static
-VOID HandleString (
-    IN  CHAR16  **TokenList,
-    IN  UINTN     TokenCount,
-    OUT CHAR16  **Target
-) {
-    if ((TokenCount == 2) && Target) {
-        MY_FREE_POOL(*Target);
-        *Target = StrDuplicate (TokenList[1]);
-    } // if
-} // static VOID HandleString()
+    return NULL;
+} // static CONFIG_CACHE_ITEM * ConfigCacheFind()
 
-// Handle a parameter with a series of string arguments, to replace or be added to a
-// comma-delimited list. Passes each token through the CleanUpPathNameSlashes() function
-// to ensure consistency in subsequent comparisons of filenames. If the first
-// non-keyword token is "+", the list is added to the existing target string; otherwise,
-// the tokens replace the current string.
+// Writes the compiled files read this session back to the RefindPlus directory
+// if any of them changed, or removes the cache file if 'config_cache' is off.
 static
-VOID HandleStrings (
-    IN  CHAR16 **TokenList,
-    IN  UINTN    TokenCount,
-    OUT CHAR16 **Target
-) {
-    if (!Target) {
+VOID ConfigCacheSave (VOID) {
+    EFI_STATUS            Status;
+    UINTN                 DataSize;
+    UINTN                 Offset;
+    UINTN                 PathBytes;
+    UINTN                 TextBytes;
+    UINTN                 RecordCount;
+    UINTN                 i;
+    UINT8                *Buffer;
+    CONFIG_CACHE_HEADER  *Header;
+    CONFIG_CACHE_RECORD  *Record;
+
+    if (SelfDir == NULL) {
         return;
     }
 
-    UINTN i;
-    BOOLEAN AddMode = FALSE;
+    if (!GlobalConfig.ConfigCache) {
+        if (ConfigCacheOnDisk) {
+            egSaveFile (SelfDir, CONFIG_CACHE_FILE_NAME, NULL, 0);
+            ConfigCacheOnDisk = FALSE;
+        }
 
-    if (!Target) {
         return;
     }
 
-    if ((TokenCount > 2) && (StrCmp (TokenList[1], L"+") == 0)) {
-        AddMode = TRUE;
+    if (!ConfigCacheDirty) {
+        return;
     }
 
-    if ((*Target != NULL) && !AddMode) {
-        MY_FREE_POOL(*Target);
+    DataSize = 0;
+    for (i = 0; i < ConfigItemCount; i++) {
+        if (ConfigItems[i].Used) {
+            PathBytes = (StrLen (ConfigItems[i].Path) + 1) * sizeof (CHAR16);
+            TextBytes = ConfigItems[i].TextLength * sizeof (CHAR16);
+            DataSize += CONFIG_CACHE_ALIGN(sizeof (CONFIG_CACHE_RECORD) + PathBytes + TextBytes);
+        }
     }
 
-    for (i = 1; i < TokenCount; i++) {
-        if ((i != 1) || !AddMode) {
-            CleanUpPathNameSlashes (TokenList[i]);
-            MergeStrings (Target, TokenList[i], L',');
+    Buffer = AllocateZeroPool (sizeof (CONFIG_CACHE_HEADER) + DataSize);
+    if (Buffer == NULL) {
+        return;
+    }
+
+    Offset      = sizeof (CONFIG_CACHE_HEADER);
+    RecordCount = 0;
+    for (i = 0; i < ConfigItemCount; i++) {
+        if (!ConfigItems[i].Used) {
+            continue;
         }
+
+        PathBytes = (StrLen (ConfigItems[i].Path) + 1) * sizeof (CHAR16);
+        TextBytes = ConfigItems[i].TextLength * sizeof (CHAR16);
+
+        Record                   = (CONFIG_CACHE_RECORD *) (Buffer + Offset);
+        Record->RecordSize       = (UINT32) CONFIG_CACHE_ALIGN(sizeof (CONFIG_CACHE_RECORD) + PathBytes + TextBytes);
+        Record->PathLength       = (UINT32) (PathBytes / sizeof (CHAR16));
+        Record->TextLength       = (UINT32) ConfigItems[i].TextLength;
+        Record->FileSize         = ConfigItems[i].FileSize;
+        Record->ModificationTime = ConfigItems[i].ModificationTime;
+        CopyMem (Record + 1, ConfigItems[i].Path, PathBytes);
+        CopyMem ((UINT8 *) (Record + 1) + PathBytes, ConfigItems[i].Text, TextBytes);
+
+        Offset += Record->RecordSize;
+        RecordCount++;
+    } // for
+
+    Header              = (CONFIG_CACHE_HEADER *) Buffer;
+    Header->Signature   = CONFIG_CACHE_SIGNATURE;
+    Header->Version     = CONFIG_CACHE_VERSION;
+    Header->RecordCount = (UINT32) RecordCount;
+    Header->DataSize    = (UINT32) DataSize;
+    Header->DataCrc     = crc32refit (0, Buffer + sizeof (CONFIG_CACHE_HEADER), DataSize);
+
+    // egSaveFile does not truncate ... Delete any previous file first
+    egSaveFile (SelfDir, CONFIG_CACHE_FILE_NAME, NULL, 0);
+    Status = egSaveFile (SelfDir, CONFIG_CACHE_FILE_NAME, Buffer, sizeof (CONFIG_CACHE_HEADER) + DataSize);
+    MY_FREE_POOL(Buffer);
+
+    if (!EFI_ERROR(Status)) {
+        ConfigCacheDirty  = FALSE;
+        ConfigCacheOnDisk = TRUE;
     }
-} // static VOID HandleStrings()
 
-#if REFIT_DEBUG > 0
-VOID
-LEAKABLECSRVALUES (
-    UINT32_LIST *CsrValues
-) {
-    LOGPROCENTRY();
-    LEAKABLEPATHINIT (kLeakableCsrValues);
-        LEAKABLEPATHINC (); // space for Csr Index
-            UINT32_LIST *CsrValue = CsrValues;
-            for (CsrValue = CsrValues; CsrValue; CsrValue = CsrValue->Next) {
-                LEAKABLEWITHPATH (CsrValue, "Csr Value");
-            }
-        LEAKABLEPATHDEC ();
-    LEAKABLEPATHDONE ();
-    LOGPROCEXIT();
-}
-#endif
+    #if REFIT_DEBUG > 0
+    LOG(2, LOG_LINE_NORMAL,
+        L"Save %d Compiled Config Files to '%s' ... %r",
+        RecordCount, CONFIG_CACHE_FILE_NAME, Status
+    );
+    #endif
+} // static VOID ConfigCacheSave()
 
-// Handle a parameter with a series of hexadecimal arguments, to replace or be added to a
-// linked list of UINT32 values. Any item with a non-hexadecimal value is discarded, as is
-// any value that exceeds MaxValue. If the first non-keyword token is "+", the new list is
-// added to the existing Target; otherwise, the interpreted tokens replace the current
-// Target.
+// Compiles the rest of a file read by RefitReadFile into token lines.
+// Returns FALSE if a line has more tokens than a count slot can hold.
 static
-VOID HandleHexes (
-    IN  CHAR16       **TokenList,
-    IN  UINTN          TokenCount,
-    IN  UINTN          MaxValue,
-    OUT UINT32_LIST  **Target
+BOOLEAN CompileConfigFile (
+    IN OUT REFIT_FILE  *File,
+    OUT    CHAR16     **Text,
+    OUT    UINTN       *TextLength
 ) {
-    UINTN        InputIndex = 1, i;
+    CHAR16  **TokenList;
+    CHAR16   *q;
+    UINTN     TokenCount, Length, i;
+
+    // A token never takes more than twice its source text, counting the
+    // separator or line end after it, so this also covers the line counts
+    *Text = AllocatePool (((UINTN) (File->End16Ptr - File->Current16Ptr) * 2 + 1) * sizeof (CHAR16));
+    if (*Text == NULL) {
+        return FALSE;
+    }
+
+    q = *Text;
+    while ((TokenCount = ReadTokenLine (File, &TokenList)) > 0) {
+        if (TokenCount > MAX_UINT16) {
+            FreeTokenLine (&TokenList, &TokenCount);
+            MY_FREE_POOL(*Text);
+
+            return FALSE;
+        }
+
+        *q++ = (CHAR16) TokenCount;
+        for (i = 0; i < TokenCount; i++) {
+            Length = StrLen (TokenList[i]) + 1;
+            CopyMem (q, TokenList[i], Length * sizeof (CHAR16));
+            q += Length;
+        }
+        FreeTokenLine (&TokenList, &TokenCount);
+    } // while
+
+    *TextLength = (UINTN) (q - *Text);
+
+    return TRUE;
+} // static BOOLEAN CompileConfigFile()
+
+// Returns the next compiled line of a file opened by ReadConfigFile.
+static
+UINTN ReadCompiledTokenLine (
+    IN REFIT_FILE   *File,
+    OUT CHAR16    ***TokenList
+) {
+    CHAR16  *p;
+    UINTN    Count;
+    UINTN    TokenCount = 0;
+
+    *TokenList = NULL;
+
+    p = File->Current16Ptr;
+    if (File->Buffer == NULL || p >= File->End16Ptr) {
+        return 0;
+    }
+
+    Count = *p++;
+    while (TokenCount < Count && p < File->End16Ptr) {
+        AddListElement ((VOID ***) TokenList, &TokenCount, (VOID *) p);
+        while (p < File->End16Ptr && *p != L'\0') {
+            p++;
+        }
+        p++;
+    } // while
+    File->Current16Ptr = p;
+
+    return TokenCount;
+} // static UINTN ReadCompiledTokenLine()
+
+// Opens a config file in the RefindPlus directory as compiled token lines,
+// compiling it first if it is not already held with the same size and
+// modification time. Files that cannot be compiled are read as text.
+static
+EFI_STATUS ReadConfigFile (
+    IN  CHAR16      *FileName,
+    OUT REFIT_FILE  *File
+) {
+    EFI_STATUS          Status;
+    EFI_FILE_HANDLE     FileHandle;
+    EFI_FILE_INFO      *FileInfo = NULL;
+    CONFIG_CACHE_ITEM  *Item;
+    CONFIG_CACHE_ITEM   NewItem;
+    CHAR16             *Text;
+    UINTN               TextLength;
+    UINTN               Size;
+
+    if (SelfDir == NULL) {
+        return EFI_NOT_FOUND;
+    }
+
+    if (!ConfigCacheLoaded) {
+        ConfigCacheLoaded = TRUE;
+        ConfigCacheReadFile();
+    }
+
+    Status = REFIT_CALL_5_WRAPPER(
+        SelfDir->Open, SelfDir,
+        &FileHandle, FileName,
+        EFI_FILE_MODE_READ, 0
+    );
+    if (!EFI_ERROR(Status)) {
+        FileInfo = LibFileInfo (FileHandle);
+        REFIT_CALL_1_WRAPPER(FileHandle->Close, FileHandle);
+    }
+
+    Item = (FileInfo != NULL) ? ConfigCacheFind (FileName) : NULL;
+    if (Item == NULL ||
+        Item->FileSize != FileInfo->FileSize ||
+        CompareMem (&Item->ModificationTime, &FileInfo->ModificationTime, sizeof (EFI_TIME)) != 0
+    ) {
+        Status = RefitReadFile (SelfDir, FileName, File, &Size);
+        if (EFI_ERROR(Status) || FileInfo == NULL) {
+            MY_FREE_POOL(FileInfo);
+
+            return Status;
+        }
+
+        if (!CompileConfigFile (File, &Text, &TextLength)) {
+            // Read it again as text
+            MY_FREE_POOL(File->Buffer);
+            MY_FREE_POOL(FileInfo);
+
+            return RefitReadFile (SelfDir, FileName, File, &Size);
+        }
+        MY_FREE_POOL(File->Buffer);
+
+        if (Item == NULL) {
+            ZeroMem (&NewItem, sizeof (NewItem));
+            NewItem.Path = StrDuplicate (FileName);
+            AddListElementSized (
+                (VOID **) &ConfigItems, &ConfigItemCount,
+                &NewItem, sizeof (NewItem)
+            );
+            Item = &ConfigItems[ConfigItemCount - 1];
+        }
+        else if (Item->OwnsText) {
+            MY_FREE_POOL(Item->Text);
+        }
+
+        Item->FileSize         = FileInfo->FileSize;
+        Item->ModificationTime = FileInfo->ModificationTime;
+        Item->Text             = Text;
+        Item->TextLength       = TextLength;
+        Item->OwnsText         = TRUE;
+        ConfigCacheDirty       = TRUE;
+    }
+    MY_FREE_POOL(FileInfo);
+    Item->Used = TRUE;
+
+    // Callers get their own copy, as tokens are handed out in place
+    File->BufferSize = Item->TextLength * sizeof (CHAR16);
+    File->Buffer     = AllocatePool (File->BufferSize + sizeof (CHAR16));
+    if (File->Buffer == NULL) {
+        return EFI_OUT_OF_RESOURCES;
+    }
+    CopyMem (File->Buffer, Item->Text, File->BufferSize);
+
+    File->Encoding     = ENCODING_TOKENS;
+    File->Current8Ptr  = (CHAR8 *) File->Buffer;
+    File->End8Ptr      = File->Current8Ptr + File->BufferSize;
+    File->Current16Ptr = (CHAR16 *) File->Buffer;
+    File->End16Ptr     = File->Current16Ptr + Item->TextLength;
+
+    return EFI_SUCCESS;
+} // static EFI_STATUS ReadConfigFile()
+
+// Handle a parameter with a single integer argument (unsigned)
+static
+VOID HandleInt (
+    IN  CHAR16 **TokenList,
+    IN  UINTN    TokenCount,
+    OUT UINTN   *Value
+) {
+    if (TokenCount == 2) {
+            *Value = Atoi (TokenList[1]);
+        }
+    }
+
+// Handle a parameter with a single integer argument (signed)
+// DA-TAG: We currently only have such arguments of up to '-1'
+//         Superflous '-2' added as update reminder if required
+static
+VOID HandleSignedInt (
+    IN  CHAR16 **TokenList,
+    IN  UINTN    TokenCount,
+    OUT INTN    *Value
+) {
+    if (TokenCount == 2) {
+       if (StrCmp (TokenList[1], L"-1") == 0) {
+           *Value = -1;
+       }
+        else if (StrCmp (TokenList[1], L"-2") == 0) {
+            *Value = -2;
+        }
+       else {
+           *Value = Atoi (TokenList[1]);
+       }
+    }
+}
+
+// handle a parameter with a single string argument
+static
+VOID HandleString (
+    IN  CHAR16  **TokenList,
+    IN  UINTN     TokenCount,
+    OUT CHAR16  **Target
+) {
+    if ((TokenCount == 2) && Target) {
+        MY_FREE_POOL(*Target);
+        *Target = StrDuplicate (TokenList[1]);
+    } // if
+} // static VOID HandleString()
+
+// Handle a parameter with a series of string arguments, to replace or be added to a
+// comma-delimited list. Passes each token through the CleanUpPathNameSlashes() function
+// to ensure consistency in subsequent comparisons of filenames. If the first
+// non-keyword token is "+", the list is added to the existing target string; otherwise,
+// the tokens replace the current string.
+static
+VOID HandleStrings (
+    IN  CHAR16 **TokenList,
+    IN  UINTN    TokenCount,
+    OUT CHAR16 **Target
+) {
+    if (!Target) {
+        return;
+    }
+
+    UINTN i;
+    BOOLEAN AddMode = FALSE;
+    STRING_BUILDER Builder;
+
+    if (!Target) {
+        return;
+    }
+
+    if ((TokenCount > 2) && (StrCmp (TokenList[1], L"+") == 0)) {
+        AddMode = TRUE;
+    }
+
+    StrBuilderInit (&Builder);
+    if ((*Target != NULL) && AddMode) {
+        StrBuilderAppend (&Builder, *Target);
+    }
+
+    for (i = 1; i < TokenCount; i++) {
+        if ((i != 1) || !AddMode) {
+            CleanUpPathNameSlashes (TokenList[i]);
+            StrBuilderMerge (&Builder, TokenList[i], L',');
+        }
+    }
+
+    MY_FREE_POOL(*Target);
+    *Target = StrBuilderDetach (&Builder);
+} // static VOID HandleStrings()
+
+#if REFIT_DEBUG > 0
+VOID
+LEAKABLECSRVALUES (
+    UINT32_LIST *CsrValues
+) {
+    LOGPROCENTRY();
+    LEAKABLEPATHINIT (kLeakableCsrValues);
+        LEAKABLEPATHINC (); // space for Csr Index
+            UINT32_LIST *CsrValue = CsrValues;
+            for (CsrValue = CsrValues; CsrValue; CsrValue = CsrValue->Next) {
+                LEAKABLEWITHPATH (CsrValue, "Csr Value");
+            }
+        LEAKABLEPATHDEC ();
+    LEAKABLEPATHDONE ();
+    LOGPROCEXIT();
+}
+#endif
+
+// Handle a parameter with a series of hexadecimal arguments, to replace or be added to a
+// linked list of UINT32 values. Any item with a non-hexadecimal value is discarded, as is
+// any value that exceeds MaxValue. If the first non-keyword token is "+", the new list is
+// added to the existing Target; otherwise, the interpreted tokens replace the current
+// Target.
+static
+VOID HandleHexes (
+    IN  CHAR16       **TokenList,
+    IN  UINTN          TokenCount,
+    IN  UINTN          MaxValue,
+    OUT UINT32_LIST  **Target
+) {
+    UINTN        InputIndex = 1, i;
     UINT32       Value;
     UINT32_LIST *EndOfList  = NULL;
     UINT32_LIST *NewEntry;
@@ -660,112 +1154,272 @@ LOADER_ENTRY * AddPreparedLoaderEntry (
     return Entry;
 } // LOADER_ENTRY * AddPreparedLoaderEntry()
 
-// read config file
-VOID ReadConfig (
-    CHAR16 *FileName
-) {
-    EFI_STATUS        Status;
-    REFIT_FILE        File;
-    CHAR16          **TokenList;
-    CHAR16           *Flag;
-    CHAR16           *TempStr = NULL;
-    CHAR16           *MsgStr;
-    UINTN             TokenCount, i;
+// Keywords accepted in the config file.
+//
+// Each row names the GlobalConfig field a keyword sets and how its tokens
+// are parsed. Rows with CONFIG_TYPE_CUSTOM have no generic target and are
+// handled by HandleCustomOption(). Alternate spellings, such as the
+// "dont_*" forms of the "don't_*" keywords, are separate rows sharing a
+// target. MinTokens and MaxTokens count the keyword itself, with zero
+// meaning "no limit"; lines outside those bounds are ignored.
+//
+// NB: Rows MUST stay sorted by keyword, compared as CompareConfigKeyword()
+//     does (characters folded with '& ~0x20'), as FindConfigOption() does
+//     a binary search. The apostrophe folds below the letters, so the
+//     "don't_*" rows sort ahead of the "dont_*" rows.
+typedef enum {
+    CONFIG_TYPE_BOOLEAN,
+    CONFIG_TYPE_DECLINE,
+    CONFIG_TYPE_INT,
+    CONFIG_TYPE_SIGNED_INT,
+    CONFIG_TYPE_STRING,
+    CONFIG_TYPE_STRINGS,
+    CONFIG_TYPE_VOLUMES,
+    CONFIG_TYPE_CUSTOM
+} CONFIG_OPTION_TYPE;
+
+typedef enum {
+    CONFIG_OPT_GENERIC,
+    CONFIG_OPT_BANNER_SCALE,
+    CONFIG_OPT_BIG_ICON_SIZE,
+    CONFIG_OPT_CSR_VALUES,
+    CONFIG_OPT_DEFAULT_SELECTION,
+    CONFIG_OPT_ENABLE_MOUSE,
+    CONFIG_OPT_ENABLE_TOUCH,
+    CONFIG_OPT_FONT,
+    CONFIG_OPT_HIDEUI,
+    CONFIG_OPT_INCLUDE,
+    CONFIG_OPT_LOG_LEVEL,
+    CONFIG_OPT_MOUSE_SIZE,
+    CONFIG_OPT_MOUSE_SPEED,
+    CONFIG_OPT_RESOLUTION,
+    CONFIG_OPT_SCANFOR,
+    CONFIG_OPT_SCREEN_RGB,
+    CONFIG_OPT_SHOWTOOLS,
+    CONFIG_OPT_SMALL_ICON_SIZE,
+    CONFIG_OPT_USE_GRAPHICS_FOR
+} CONFIG_OPTION_ID;
+
+typedef struct {
+    CHAR16              *Keyword;
+    CONFIG_OPTION_TYPE   Type;
+    VOID                *Target;
+    UINTN                MinTokens;
+    UINTN                MaxTokens;
+    CHAR8               *Leakable;
+    CONFIG_OPTION_ID     Id;
+} CONFIG_OPTION;
 
-    LOGPROCENTRY("%s", FileName);
+static
+CONFIG_OPTION ConfigOptions[] = {
+    { L"active_csr",                   CONFIG_TYPE_SIGNED_INT, &(GlobalConfig.ActiveCSR),                   0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"all_hidden_icons",             CONFIG_TYPE_BOOLEAN,    &(GlobalConfig.AllHiddenIcons),              0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"also_scan_dirs",               CONFIG_TYPE_STRINGS,    &(GlobalConfig.AlsoScan),                    0, 0, "AlsoScan",              CONFIG_OPT_GENERIC },
+    { L"banner",                       CONFIG_TYPE_STRING,     &(GlobalConfig.BannerFileName),              0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"banner_scale",                 CONFIG_TYPE_CUSTOM,     NULL,                                        2, 2, NULL,                    CONFIG_OPT_BANNER_SCALE },
+    { L"big_icon_size",                CONFIG_TYPE_CUSTOM,     NULL,                                        2, 2, NULL,                    CONFIG_OPT_BIG_ICON_SIZE },
+    { L"config_cache",                 CONFIG_TYPE_BOOLEAN,    &(GlobalConfig.ConfigCache),                 0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"continue_on_warning",          CONFIG_TYPE_BOOLEAN,    &(GlobalConfig.ContinueOnWarning),           0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"csr_values",                   CONFIG_TYPE_CUSTOM,     NULL,                                        0, 0, NULL,                    CONFIG_OPT_CSR_VALUES },
+    { L"decline_apfsload",             CONFIG_TYPE_DECLINE,    &(GlobalConfig.SupplyAPFS),                  0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"decline_apfsmute",             CONFIG_TYPE_DECLINE,    &(GlobalConfig.SilenceAPFS),                 0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"decline_apfssync",             CONFIG_TYPE_DECLINE,    &(GlobalConfig.SyncAPFS),                    0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"decline_espfilter",            CONFIG_TYPE_DECLINE,    &(GlobalConfig.ScanAllESP),                  0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"decline_nvmeload",             CONFIG_TYPE_DECLINE,    &(GlobalConfig.SupplyNVME),                  0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"decline_nvramprotect",         CONFIG_TYPE_DECLINE,    &(GlobalConfig.ProtectNVRAM),                0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"decline_reloadgop",            CONFIG_TYPE_DECLINE,    &(GlobalConfig.ReloadGOP),                   0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"decline_tagshelp",             CONFIG_TYPE_DECLINE,    &(GlobalConfig.TagsHelp),                    0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"default_selection",            CONFIG_TYPE_CUSTOM,     NULL,                                        0, 0, NULL,                    CONFIG_OPT_DEFAULT_SELECTION },
+    { L"direct_gop_renderer",          CONFIG_TYPE_BOOLEAN,    &(GlobalConfig.UseDirectGop),                0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"disable_amfi",                 CONFIG_TYPE_BOOLEAN,    &(GlobalConfig.DisableAMFI),                 0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"disable_compat_check",         CONFIG_TYPE_BOOLEAN,    &(GlobalConfig.DisableCompatCheck),          0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"don't_scan_dirs",              CONFIG_TYPE_STRINGS,    &(GlobalConfig.DontScanDirs),                0, 0, "DontScanDirs",          CONFIG_OPT_GENERIC },
+    { L"don't_scan_files",             CONFIG_TYPE_STRINGS,    &(GlobalConfig.DontScanFiles),               0, 0, "DontScanFiles",         CONFIG_OPT_GENERIC },
+    { L"don't_scan_firmware",          CONFIG_TYPE_STRINGS,    &(GlobalConfig.DontScanFirmware),            0, 0, "DontScanFirmware",      CONFIG_OPT_GENERIC },
+    { L"don't_scan_tools",             CONFIG_TYPE_STRINGS,    &(GlobalConfig.DontScanTools),               0, 0, "DontScanTools",         CONFIG_OPT_GENERIC },
+    { L"don't_scan_volumes",           CONFIG_TYPE_VOLUMES,    &(GlobalConfig.DontScanVolumes),             0, 0, "DontScanVolumes",       CONFIG_OPT_GENERIC },
+    { L"dont_scan_dirs",               CONFIG_TYPE_STRINGS,    &(GlobalConfig.DontScanDirs),                0, 0, "DontScanDirs",          CONFIG_OPT_GENERIC },
+    { L"dont_scan_files",              CONFIG_TYPE_STRINGS,    &(GlobalConfig.DontScanFiles),               0, 0, "DontScanFiles",         CONFIG_OPT_GENERIC },
+    { L"dont_scan_firmware",           CONFIG_TYPE_STRINGS,    &(GlobalConfig.DontScanFirmware),            0, 0, "DontScanFirmware",      CONFIG_OPT_GENERIC },
+    { L"dont_scan_tools",              CONFIG_TYPE_STRINGS,    &(GlobalConfig.DontScanTools),               0, 0, "DontScanTools",         CONFIG_OPT_GENERIC },
+    { L"dont_scan_volumes",            CONFIG_TYPE_VOLUMES,    &(GlobalConfig.DontScanVolumes),             0, 0, "DontScanVolumes",       CONFIG_OPT_GENERIC },
+    { L"enable_and_lock_vmx",          CONFIG_TYPE_BOOLEAN,    &(GlobalConfig.EnableAndLockVMX),            0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"enable_mouse",                 CONFIG_TYPE_CUSTOM,     NULL,                                        0, 0, NULL,                    CONFIG_OPT_ENABLE_MOUSE },
+    { L"enable_touch",                 CONFIG_TYPE_CUSTOM,     NULL,                                        0, 0, NULL,                    CONFIG_OPT_ENABLE_TOUCH },
+    { L"extra_kernel_version_strings", CONFIG_TYPE_STRINGS,    &(GlobalConfig.ExtraKernelVersionStrings),   0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"fold_linux_kernels",           CONFIG_TYPE_BOOLEAN,    &(GlobalConfig.FoldLinuxKernels),            0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"font",                         CONFIG_TYPE_CUSTOM,     NULL,                                        2, 2, NULL,                    CONFIG_OPT_FONT },
+    { L"force_trim",                   CONFIG_TYPE_BOOLEAN,    &(GlobalConfig.ForceTRIM),                   0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"hideui",                       CONFIG_TYPE_CUSTOM,     NULL,                                        0, 0, NULL,                    CONFIG_OPT_HIDEUI },
+    { L"icons_dir",                    CONFIG_TYPE_STRING,     &(GlobalConfig.IconsDir),                    0, 0, "IconsDir",              CONFIG_OPT_GENERIC },
+    { L"icon_cache",                   CONFIG_TYPE_BOOLEAN,    &(GlobalConfig.IconCache),                   0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"ignore_hidden_icons",          CONFIG_TYPE_BOOLEAN,    &(GlobalConfig.IgnoreHiddenIcons),           0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"ignore_previous_boot",         CONFIG_TYPE_BOOLEAN,    &(GlobalConfig.IgnorePreviousBoot),          0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"include",                      CONFIG_TYPE_CUSTOM,     NULL,                                        2, 2, NULL,                    CONFIG_OPT_INCLUDE },
+    { L"log_drop_when_full",           CONFIG_TYPE_BOOLEAN,    &(GlobalConfig.LogDropWhenFull),             0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"log_level",                    CONFIG_TYPE_CUSTOM,     NULL,                                        2, 2, NULL,                    CONFIG_OPT_LOG_LEVEL },
+    { L"max_tags",                     CONFIG_TYPE_INT,        &(GlobalConfig.MaxTags),                     0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"mouse_size",                   CONFIG_TYPE_CUSTOM,     NULL,                                        2, 2, NULL,                    CONFIG_OPT_MOUSE_SIZE },
+    { L"mouse_speed",                  CONFIG_TYPE_CUSTOM,     NULL,                                        2, 2, NULL,                    CONFIG_OPT_MOUSE_SPEED },
+    { L"normalise_csr",                CONFIG_TYPE_BOOLEAN,    &(GlobalConfig.NormaliseCSR),                0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"prefer_hidden_icons",          CONFIG_TYPE_BOOLEAN,    &(GlobalConfig.PreferHiddenIcons),           0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"profile",                      CONFIG_TYPE_BOOLEAN,    &(GlobalConfig.Profile),                     0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"provide_console_gop",          CONFIG_TYPE_BOOLEAN,    &(GlobalConfig.ProvideConsoleGOP),           0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"resolution",                   CONFIG_TYPE_CUSTOM,     NULL,                                        2, 3, NULL,                    CONFIG_OPT_RESOLUTION },
+    { L"scale_ui",                     CONFIG_TYPE_SIGNED_INT, &(GlobalConfig.ScaleUI),                     0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"scanfor",                      CONFIG_TYPE_CUSTOM,     NULL,                                        0, 0, NULL,                    CONFIG_OPT_SCANFOR },
+    { L"scan_all_linux_kernels",       CONFIG_TYPE_BOOLEAN,    &(GlobalConfig.ScanAllLinux),                0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"scan_cache",                   CONFIG_TYPE_BOOLEAN,    &(GlobalConfig.ScanCache),                   0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"scan_delay",                   CONFIG_TYPE_INT,        &(GlobalConfig.ScanDelay),                   2, 2, NULL,                    CONFIG_OPT_GENERIC },
+    { L"scan_driver_dirs",             CONFIG_TYPE_STRINGS,    &(GlobalConfig.DriverDirs),                  0, 0, "DriverDirs",            CONFIG_OPT_GENERIC },
+    { L"screensaver",                  CONFIG_TYPE_SIGNED_INT, &(GlobalConfig.ScreensaverTime),             0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"screen_rgb",                   CONFIG_TYPE_CUSTOM,     NULL,                                        4, 4, NULL,                    CONFIG_OPT_SCREEN_RGB },
+    { L"selection_big",                CONFIG_TYPE_STRING,     &(GlobalConfig.SelectionBigFileName),        0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"selection_small",              CONFIG_TYPE_STRING,     &(GlobalConfig.SelectionSmallFileName),      0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"set_boot_args",                CONFIG_TYPE_STRING,     &(GlobalConfig.SetBootArgs),                 0, 0, "SetBootArgs",           CONFIG_OPT_GENERIC },
+    { L"showtools",                    CONFIG_TYPE_CUSTOM,     NULL,                                        0, 0, NULL,                    CONFIG_OPT_SHOWTOOLS },
+    { L"shutdown_after_timeout",       CONFIG_TYPE_BOOLEAN,    &(GlobalConfig.ShutdownAfterTimeout),        0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"small_icon_size",              CONFIG_TYPE_CUSTOM,     NULL,                                        2, 2, NULL,                    CONFIG_OPT_SMALL_ICON_SIZE },
+    { L"spoof_osx_version",            CONFIG_TYPE_STRING,     &(GlobalConfig.SpoofOSXVersion),             0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"textmode",                     CONFIG_TYPE_INT,        &(GlobalConfig.RequestedTextMode),           0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"textonly",                     CONFIG_TYPE_BOOLEAN,    &(GlobalConfig.TextOnly),                    0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"text_renderer",                CONFIG_TYPE_BOOLEAN,    &(GlobalConfig.TextRenderer),                0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"timeout",                      CONFIG_TYPE_SIGNED_INT, &(GlobalConfig.Timeout),                     0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"uefi_deep_legacy_scan",        CONFIG_TYPE_BOOLEAN,    &(GlobalConfig.DeepLegacyScan),              0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"uga_pass_through",             CONFIG_TYPE_BOOLEAN,    &(GlobalConfig.UgaPassThrough),              0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"use_graphics_for",             CONFIG_TYPE_CUSTOM,     NULL,                                        0, 0, NULL,                    CONFIG_OPT_USE_GRAPHICS_FOR },
+    { L"use_nvram",                    CONFIG_TYPE_BOOLEAN,    &(GlobalConfig.UseNvram),                    0, 0, NULL,                    CONFIG_OPT_GENERIC },
+    { L"windows_recovery_files",       CONFIG_TYPE_STRINGS,    &(GlobalConfig.WindowsRecoveryFiles),        0, 0, "WindowsRecoveryFiles",  CONFIG_OPT_GENERIC },
+    { L"write_systemd_vars",           CONFIG_TYPE_BOOLEAN,    &(GlobalConfig.WriteSystemdVars),            0, 0, NULL,                    CONFIG_OPT_GENERIC }
+};
+
+#define CONFIG_OPTION_COUNT (sizeof (ConfigOptions) / sizeof (ConfigOptions[0]))
+
+// Orders a keyword against a config token the same way MyStriCmp() matches them.
+static
+INTN CompareConfigKeyword (
+    IN CHAR16 *Keyword,
+    IN CHAR16 *Token
+) {
+    while (*Keyword && ((*Keyword & ~0x20) == (*Token & ~0x20))) {
+        Keyword++;
+        Token++;
+    }
 
-    // Set a few defaults only if we are loading the default file.
-    if (MyStriCmp (FileName, GlobalConfig.ConfigFilename)) {
-        MY_FREE_POOL(GlobalConfig.DontScanTools);
+    return (INTN) (*Keyword & ~0x20) - (INTN) (*Token & ~0x20);
+} // static INTN CompareConfigKeyword()
 
-        MY_FREE_POOL(GlobalConfig.AlsoScan);
-        GlobalConfig.AlsoScan = StrDuplicate (ALSO_SCAN_DIRS);
+static
+CONFIG_OPTION * FindConfigOption (
+    IN CHAR16 *Token
+) {
+    INTN   Low  = 0;
+    INTN   High = (INTN) CONFIG_OPTION_COUNT - 1;
+    INTN   Mid, Order;
 
-        MY_FREE_POOL(GlobalConfig.DontScanDirs);
-        if (SelfVolume) {
-            TempStr = GuidAsString (&(SelfVolume->PartGuid));
+    while (Low <= High) {
+        Mid   = (Low + High) / 2;
+        Order = CompareConfigKeyword (ConfigOptions[Mid].Keyword, Token);
+        if (Order == 0) {
+            // Folding maps ' ' onto the terminator ... confirm the match
+            return MyStriCmp (ConfigOptions[Mid].Keyword, Token) ? &ConfigOptions[Mid] : NULL;
         }
-        MergeStrings (&TempStr, SelfDirPath, L':');
-        MergeStrings (&TempStr, MEMTEST_LOCATIONS, L',');
-        GlobalConfig.DontScanDirs = TempStr;
-
-        MY_FREE_POOL(GlobalConfig.DontScanFiles);
-        GlobalConfig.DontScanFiles = StrDuplicate (DONT_SCAN_FILES);
-
-        MY_FREE_POOL(GlobalConfig.DontScanFirmware);
-        MergeStrings (&(GlobalConfig.DontScanFiles), MOK_NAMES, L',');
-        MergeStrings (&(GlobalConfig.DontScanFiles), FWUPDATE_NAMES, L',');
-
-        MY_FREE_POOL(GlobalConfig.DontScanVolumes);
-        GlobalConfig.DontScanVolumes = StrDuplicate (DONT_SCAN_VOLUMES);
 
-        MY_FREE_POOL(GlobalConfig.WindowsRecoveryFiles);
-        GlobalConfig.WindowsRecoveryFiles = StrDuplicate (WINDOWS_RECOVERY_FILES);
-
-        MY_FREE_POOL(GlobalConfig.MacOSRecoveryFiles);
-        GlobalConfig.MacOSRecoveryFiles = StrDuplicate (MACOS_RECOVERY_FILES);
+        if (Order < 0) {
+            Low = Mid + 1;
+        }
+        else {
+            High = Mid - 1;
+        }
+    } // while
 
-        MY_FREE_POOL(GlobalConfig.DefaultSelection);
-        GlobalConfig.DefaultSelection = StrDuplicate (L"+");
+    return NULL;
+} // static CONFIG_OPTION * FindConfigOption()
 
-        LEAKABLE (GlobalConfig.AlsoScan, "AlsoScan");
-        LEAKABLE (GlobalConfig.DontScanDirs, "DontScanDirs");
-        LEAKABLE (GlobalConfig.DontScanFiles, "DontScanFiles");
-        LEAKABLE (GlobalConfig.DontScanVolumes, "DontScanVolumes");
-        LEAKABLE (GlobalConfig.WindowsRecoveryFiles, "WindowsRecoveryFiles");
-        LEAKABLE (GlobalConfig.MacOSRecoveryFiles, "MacOSRecoveryFiles");
-        LEAKABLE (GlobalConfig.DefaultSelection, "DefaultSelection");
-    } // if
+// Handles the keywords whose tokens need more than one of the generic parsers.
+static
+VOID HandleCustomOption (
+    IN CONFIG_OPTION  *Option,
+    IN CHAR16        **TokenList,
+    IN UINTN           TokenCount,
+    IN CHAR16         *FileName
+) {
+    CHAR16  *Flag;
+    CHAR16  *MsgStr;
+    UINTN    MaxLogLevel;
+    UINTN    i;
 
-    if (!FileExists (SelfDir, FileName)) {
-        SwitchToText (FALSE);
+    switch (Option->Id) {
+        case CONFIG_OPT_BANNER_SCALE:
+            if (MyStriCmp (TokenList[1], L"noscale")) {
+                GlobalConfig.BannerScale = BANNER_NOSCALE;
+            }
+            else if (MyStriCmp (TokenList[1], L"fillscreen")
+                || MyStriCmp (TokenList[1], L"fullscreen")
+            ) {
+                GlobalConfig.BannerScale = BANNER_FILLSCREEN;
+            }
+            else {
+                MsgStr = PoolPrint (
+                    L"  - WARN: Invalid 'banner_type' Flag:- '%s'",
+                    TokenList[1]
+                );
+                PrintUglyText (MsgStr, NEXTLINE);
 
-        MsgStr = L"  - WARN: Cannot Find Configuration File ... Loading Defaults!!";
-        PrintUglyText (MsgStr, NEXTLINE);
+                #if REFIT_DEBUG > 0
+                MsgLog ("%s\n", MsgStr);
+                #endif
 
-        #if REFIT_DEBUG > 0
-        MsgLog ("%s\n", MsgStr);
-        #endif
+                PauseForKey();
+                MY_FREE_POOL(MsgStr);
+            } // if/else MyStriCmp TokenList[0]
 
-        if (!FileExists (SelfDir, L"icons")) {
-            MsgStr = L"  - WARN: Cannot Find Icons Directory ... Switching to Text Mode!!";
-            PrintUglyText (MsgStr, NEXTLINE);
+            break;
+        case CONFIG_OPT_BIG_ICON_SIZE:
+            HandleInt (TokenList, TokenCount, &i);
+            if (i >= 32) {
+                GlobalConfig.IconSizes[ICON_SIZE_BIG] = i;
+                GlobalConfig.IconSizes[ICON_SIZE_BADGE] = i / 4;
+            }
 
+            break;
+        case CONFIG_OPT_CSR_VALUES:
+            HandleHexes (TokenList, TokenCount, CSR_MAX_LEGAL_VALUE, &(GlobalConfig.CsrValues));
             #if REFIT_DEBUG > 0
-            MsgLog ("%s\n", MsgStr);
+            LEAKABLECSRVALUES(GlobalConfig.CsrValues);
             #endif
 
-            GlobalConfig.TextOnly = TRUE;
-        }
-
-        PauseForKey();
-        SwitchToGraphics();
+            break;
+        case CONFIG_OPT_DEFAULT_SELECTION:
+            if (TokenCount == 4) {
+                SetDefaultByTime (TokenList, &(GlobalConfig.DefaultSelection));
+                LEAKABLE(GlobalConfig.DefaultSelection, "DefaultSelection");
+            }
+            else {
+                HandleString (TokenList, TokenCount, &(GlobalConfig.DefaultSelection));
+                LEAKABLE(GlobalConfig.DefaultSelection, "DefaultSelection");
+            }
 
-        LOGPROCEXIT("(file not found)");
-        return;
-    }
+            break;
+        case CONFIG_OPT_ENABLE_MOUSE:
+            GlobalConfig.EnableMouse = HandleBoolean (TokenList, TokenCount);
+            if (GlobalConfig.EnableMouse) {
+                GlobalConfig.EnableTouch = FALSE;
+            }
 
-    Status = RefitReadFile (SelfDir, FileName, &File, &i);
-    if (EFI_ERROR(Status)) {
-        LOGPROCEXIT("(read error)");
-        return;
-    }
+            break;
+        case CONFIG_OPT_ENABLE_TOUCH:
+            GlobalConfig.EnableTouch = HandleBoolean (TokenList, TokenCount);
+            if (GlobalConfig.EnableTouch) {
+                GlobalConfig.EnableMouse = FALSE;
+            }
 
-    BOOLEAN DeclineSetting = FALSE;
-    for (;;) {
-        TokenCount = ReadTokenLine (&File, &TokenList);
-        if (TokenCount == 0) {
             break;
-        }
+        case CONFIG_OPT_FONT:
+            egLoadFont (TokenList[1]);
 
-        if (MyStriCmp (TokenList[0], L"timeout")) {
-            // Signed integer as can have negative value
-            HandleSignedInt (TokenList, TokenCount, &(GlobalConfig.Timeout));
-        }
-        else if (MyStriCmp (TokenList[0], L"shutdown_after_timeout")) {
-            GlobalConfig.ShutdownAfterTimeout = HandleBoolean (TokenList, TokenCount);
-        }
-        else if (MyStriCmp (TokenList[0], L"hideui")) {
+            break;
+        case CONFIG_OPT_HIDEUI:
             for (i = 1; i < TokenCount; i++) {
                 Flag = TokenList[i];
                 #define if_flag(name,flag) if (MyStriCmp (Flag, L""name)) { GlobalConfig.HideUIFlags |= flag; }
@@ -798,179 +1452,46 @@ VOID ReadConfig (
                     MY_FREE_POOL(MsgStr);
                 }
             }
-        }
-        else if (MyStriCmp (TokenList[0], L"icons_dir")) {
-            HandleString (TokenList, TokenCount, &(GlobalConfig.IconsDir));
-            LEAKABLE(GlobalConfig.IconsDir, "IconsDir");
-        }
-        else if (MyStriCmp (TokenList[0], L"set_boot_args")) {
-            HandleString (TokenList, TokenCount, &(GlobalConfig.SetBootArgs));
-            LEAKABLE(GlobalConfig.SetBootArgs, "SetBootArgs");
-        }
-        else if (MyStriCmp (TokenList[0], L"scanfor")) {
-            for (i = 0; i < NUM_SCAN_OPTIONS; i++) {
-                if (i < TokenCount) {
-                    GlobalConfig.ScanFor[i] = TokenList[i][0];
-                }
-                else {
-                    GlobalConfig.ScanFor[i] = ' ';
-                }
-            } // for
-        }
-        else if (MyStriCmp (TokenList[0], L"use_nvram")) {
-            GlobalConfig.UseNvram = HandleBoolean (TokenList, TokenCount);
-        }
-        else if (MyStriCmp (TokenList[0], L"uefi_deep_legacy_scan")) {
-            GlobalConfig.DeepLegacyScan = HandleBoolean (TokenList, TokenCount);
-        }
-        else if (MyStriCmp (TokenList[0], L"scan_delay") && (TokenCount == 2)) {
-            HandleInt (TokenList, TokenCount, &(GlobalConfig.ScanDelay));
-        }
-        else if (MyStriCmp (TokenList[0], L"log_level") && (TokenCount == 2)) {
-            // Signed integer as *MAY* have negative value input
-            HandleSignedInt (TokenList, TokenCount, &(GlobalConfig.LogLevel));
-            // Sanitise levels
-            UINTN MaxLogLevel = (ForensicLogging) ? MAXLOGLEVEL + 1 : MAXLOGLEVEL;
-                 if (GlobalConfig.LogLevel < MINLOGLEVEL) GlobalConfig.LogLevel = MINLOGLEVEL;
-            else if (GlobalConfig.LogLevel > MaxLogLevel) GlobalConfig.LogLevel = MaxLogLevel;
-        }
-        else if (MyStriCmp (TokenList[0], L"also_scan_dirs")) {
-            HandleStrings (TokenList, TokenCount, &(GlobalConfig.AlsoScan));
-            LEAKABLE(GlobalConfig.AlsoScan, "AlsoScan");
-        }
-        else if (MyStriCmp (TokenList[0], L"don't_scan_dirs")
-            || MyStriCmp (TokenList[0], L"dont_scan_dirs")
-        ) {
-            HandleStrings (TokenList, TokenCount, &(GlobalConfig.DontScanDirs));
-            LEAKABLE(GlobalConfig.DontScanDirs, "DontScanDirs");
-        }
-        else if (MyStriCmp (TokenList[0], L"don't_scan_files")
-            || MyStriCmp (TokenList[0], L"dont_scan_files")
-        ) {
-            HandleStrings (TokenList, TokenCount, &(GlobalConfig.DontScanFiles));
-            LEAKABLE (GlobalConfig.DontScanFiles, "DontScanFiles");
-        }
-        else if (MyStriCmp (TokenList[0], L"don't_scan_tools")
-            || MyStriCmp (TokenList[0], L"dont_scan_tools")
-        ) {
-            HandleStrings (TokenList, TokenCount, &(GlobalConfig.DontScanTools));
-            LEAKABLE (GlobalConfig.DontScanTools, "DontScanTools");
-        }
-        else if (MyStriCmp (TokenList[0], L"don't_scan_firmware")
-            || MyStriCmp (TokenList[0], L"dont_scan_firmware")
-        ) {
-            HandleStrings (TokenList, TokenCount, &(GlobalConfig.DontScanFirmware));
-            LEAKABLE (GlobalConfig.DontScanFirmware, "DontScanFirmware");
-        }
-        else if (MyStriCmp (TokenList[0], L"don't_scan_volumes")
-            || MyStriCmp (TokenList[0], L"dont_scan_volumes")
-        ) {
-            // Note: Do not use HandleStrings() because it modifies slashes.
-            //       However, This might be present in the volume name.
-            MY_FREE_POOL(GlobalConfig.DontScanVolumes);
-            for (i = 1; i < TokenCount; i++) {
-                MergeStrings (&GlobalConfig.DontScanVolumes, TokenList[i], L',');
-            }
-            LEAKABLE (GlobalConfig.DontScanVolumes, "DontScanVolumes");
-        }
-        else if (MyStriCmp (TokenList[0], L"windows_recovery_files")) {
-            HandleStrings (TokenList, TokenCount, &(GlobalConfig.WindowsRecoveryFiles));
-            LEAKABLE(GlobalConfig.WindowsRecoveryFiles, "WindowsRecoveryFiles");
-        }
-        else if (MyStriCmp (TokenList[0], L"scan_driver_dirs")) {
-            HandleStrings (TokenList, TokenCount, &(GlobalConfig.DriverDirs));
-            LEAKABLE(GlobalConfig.DriverDirs, "DriverDirs");
-        }
-        else if (MyStriCmp (TokenList[0], L"showtools")) {
-            SetMem (GlobalConfig.ShowTools, NUM_TOOLS * sizeof (UINTN), TAG_NONE);
-            for (i = 1; (i < TokenCount) && (i < NUM_TOOLS); i++) {
-                Flag = TokenList[i];
-                CHAR16 *OneFlag = PoolPrint (L",%s,", Flag);
-                ToLower (OneFlag);
-                UINTN TheTag;
-                #define TAGS_FLAG_TO_TAG
-                #include "tags.include"
-                MY_FREE_POOL(OneFlag);
 
-                if (TheTag == TAG_NONE) {
-                    #if REFIT_DEBUG > 0
-                    LOG(3, LOG_THREE_STAR_MID, L"Unknown Showtools Flag:- '%s'!!", Flag);
-                    #endif
-                }
-                else {
-                    GlobalConfig.ShowTools[i - 1] = TheTag;
-                }
-            } // for
-        }
-        else if (MyStriCmp (TokenList[0], L"banner")) {
-            HandleString (TokenList, TokenCount, &(GlobalConfig.BannerFileName));
-        }
-        else if (MyStriCmp (TokenList[0], L"banner_scale") && (TokenCount == 2)) {
-            if (MyStriCmp (TokenList[1], L"noscale")) {
-                GlobalConfig.BannerScale = BANNER_NOSCALE;
-            }
-            else if (MyStriCmp (TokenList[1], L"fillscreen")
-                || MyStriCmp (TokenList[1], L"fullscreen")
-            ) {
-                GlobalConfig.BannerScale = BANNER_FILLSCREEN;
+            break;
+        case CONFIG_OPT_INCLUDE:
+            if (!MyStriCmp (FileName, GlobalConfig.ConfigFilename)) {
+                break;
             }
-            else {
-                MsgStr = PoolPrint (
-                    L"  - WARN: Invalid 'banner_type' Flag:- '%s'",
-                    TokenList[1]
-                );
-                PrintUglyText (MsgStr, NEXTLINE);
 
+            if (!MyStriCmp (TokenList[1], FileName)) {
                 #if REFIT_DEBUG > 0
-                MsgLog ("%s\n", MsgStr);
+                MsgLog ("Detected Overrides - ");
                 #endif
 
-                PauseForKey();
-                MY_FREE_POOL(MsgStr);
-            } // if/else MyStriCmp TokenList[0]
-        }
-        else if (MyStriCmp (TokenList[0], L"small_icon_size") && (TokenCount == 2)) {
-            HandleInt (TokenList, TokenCount, &i);
-            if (i >= 32) {
-                GlobalConfig.IconSizes[ICON_SIZE_SMALL] = i;
-            }
-        }
-        else if (MyStriCmp (TokenList[0], L"big_icon_size") && (TokenCount == 2)) {
-            HandleInt (TokenList, TokenCount, &i);
-            if (i >= 32) {
-                GlobalConfig.IconSizes[ICON_SIZE_BIG] = i;
-                GlobalConfig.IconSizes[ICON_SIZE_BADGE] = i / 4;
+                ReadConfig (TokenList[1]);
             }
-        }
-        else if (MyStriCmp (TokenList[0], L"mouse_size") && (TokenCount == 2)) {
+
+            break;
+        case CONFIG_OPT_LOG_LEVEL:
+            // Signed integer as *MAY* have negative value input
+            HandleSignedInt (TokenList, TokenCount, &(GlobalConfig.LogLevel));
+            // Sanitise levels
+            MaxLogLevel = (ForensicLogging) ? MAXLOGLEVEL + 1 : MAXLOGLEVEL;
+                 if (GlobalConfig.LogLevel < MINLOGLEVEL) GlobalConfig.LogLevel = MINLOGLEVEL;
+            else if (GlobalConfig.LogLevel > MaxLogLevel) GlobalConfig.LogLevel = MaxLogLevel;
+
+            break;
+        case CONFIG_OPT_MOUSE_SIZE:
             HandleInt (TokenList, TokenCount, &i);
             if (i >= DEFAULT_MOUSE_SIZE) {
                 GlobalConfig.IconSizes[ICON_SIZE_MOUSE] = i;
             }
-        }
-        else if (MyStriCmp (TokenList[0], L"selection_small")) {
-            HandleString (TokenList, TokenCount, &(GlobalConfig.SelectionSmallFileName));
-        }
-        else if (MyStriCmp (TokenList[0], L"selection_big")) {
-            HandleString (TokenList, TokenCount, &(GlobalConfig.SelectionBigFileName));
-        }
-        else if (MyStriCmp (TokenList[0], L"default_selection")) {
-            if (TokenCount == 4) {
-                SetDefaultByTime (TokenList, &(GlobalConfig.DefaultSelection));
-                LEAKABLE(GlobalConfig.DefaultSelection, "DefaultSelection");
-            }
-            else {
-                HandleString (TokenList, TokenCount, &(GlobalConfig.DefaultSelection));
-                LEAKABLE(GlobalConfig.DefaultSelection, "DefaultSelection");
-            }
-        }
-        else if (MyStriCmp (TokenList[0], L"textonly")) {
-            GlobalConfig.TextOnly = HandleBoolean (TokenList, TokenCount);
-        }
-        else if (MyStriCmp (TokenList[0], L"textmode")) {
-            HandleInt (TokenList, TokenCount, &(GlobalConfig.RequestedTextMode));
-        }
-        else if (MyStriCmp (TokenList[0], L"resolution") && ((TokenCount == 2) || (TokenCount == 3))) {
+
+            break;
+        case CONFIG_OPT_MOUSE_SPEED:
+            HandleInt (TokenList, TokenCount, &i);
+            if (i < 1)  i = 1;
+            if (i > 32) i = 32;
+            GlobalConfig.MouseSpeed = i;
+
+            break;
+        case CONFIG_OPT_RESOLUTION:
             if (MyStriCmp(TokenList[1], L"max")) {
                 // DA-TAG: has been set to 0 so as to ignore the 'max' setting
                 //GlobalConfig.RequestedScreenWidth  = MAX_RES_CODE;
@@ -984,15 +1505,65 @@ VOID ReadConfig (
                     GlobalConfig.RequestedScreenHeight = Atoi(TokenList[2]);
                 }
                 else {
-                    GlobalConfig.RequestedScreenHeight = 0;
+                    GlobalConfig.RequestedScreenHeight = 0;
+                }
+            }
+
+            break;
+        case CONFIG_OPT_SCANFOR:
+            for (i = 0; i < NUM_SCAN_OPTIONS; i++) {
+                if (i < TokenCount) {
+                    GlobalConfig.ScanFor[i] = TokenList[i][0];
+                }
+                else {
+                    GlobalConfig.ScanFor[i] = ' ';
+                }
+            } // for
+
+            break;
+        case CONFIG_OPT_SCREEN_RGB:
+            GlobalConfig.ScreenR = Atoi(TokenList[1]);
+            GlobalConfig.ScreenG = Atoi(TokenList[2]);
+            GlobalConfig.ScreenB = Atoi(TokenList[3]);
+
+            // Record whether a Custom Screen BG is required
+            GlobalConfig.CustomScreenBG = (
+                GlobalConfig.ScreenR >= 0 && GlobalConfig.ScreenR <= 255 &&
+                GlobalConfig.ScreenG >= 0 && GlobalConfig.ScreenG <= 255 &&
+                GlobalConfig.ScreenB >= 0 && GlobalConfig.ScreenB <= 255
+            );
+
+            break;
+        case CONFIG_OPT_SHOWTOOLS:
+            SetMem (GlobalConfig.ShowTools, NUM_TOOLS * sizeof (UINTN), TAG_NONE);
+            for (i = 1; (i < TokenCount) && (i < NUM_TOOLS); i++) {
+                Flag = TokenList[i];
+                CHAR16 *OneFlag = PoolPrint (L",%s,", Flag);
+                ToLower (OneFlag);
+                UINTN TheTag;
+                #define TAGS_FLAG_TO_TAG
+                #include "tags.include"
+                MY_FREE_POOL(OneFlag);
+
+                if (TheTag == TAG_NONE) {
+                    #if REFIT_DEBUG > 0
+                    LOG(3, LOG_THREE_STAR_MID, L"Unknown Showtools Flag:- '%s'!!", Flag);
+                    #endif
+                }
+                else {
+                    GlobalConfig.ShowTools[i - 1] = TheTag;
                 }
+            } // for
+
+            break;
+        case CONFIG_OPT_SMALL_ICON_SIZE:
+            HandleInt (TokenList, TokenCount, &i);
+            if (i >= 32) {
+                GlobalConfig.IconSizes[ICON_SIZE_SMALL] = i;
             }
-        }
-        else if (MyStriCmp (TokenList[0], L"screensaver")) {
-            // Signed integer as can have negative value
-            HandleSignedInt (TokenList, TokenCount, &(GlobalConfig.ScreensaverTime));
-        }
-        else if (MyStriCmp (TokenList[0], L"use_graphics_for")) {
+
+            break;
+        case CONFIG_OPT_USE_GRAPHICS_FOR:
             if ((TokenCount == 2) || ((TokenCount > 2) && (!MyStriCmp (TokenList[1], L"+")))) {
                 GlobalConfig.GraphicsFor = 0;
             }
@@ -1006,160 +1577,247 @@ VOID ReadConfig (
                 else if (MyStriCmp (TokenList[i], L"windows") ) GlobalConfig.GraphicsFor |= GRAPHICS_FOR_WINDOWS;
                 else if (MyStriCmp (TokenList[i], L"opencore")) GlobalConfig.GraphicsFor |= GRAPHICS_FOR_OPENCORE;
             } // for
-        }
-        else if (MyStriCmp (TokenList[0], L"font") && (TokenCount == 2)) {
-            egLoadFont (TokenList[1]);
-        }
-        else if (MyStriCmp (TokenList[0], L"scan_all_linux_kernels")) {
-            GlobalConfig.ScanAllLinux = HandleBoolean (TokenList, TokenCount);
-        }
-        else if (MyStriCmp (TokenList[0], L"fold_linux_kernels")) {
-            GlobalConfig.FoldLinuxKernels = HandleBoolean (TokenList, TokenCount);
-        }
-        else if (MyStriCmp (TokenList[0], L"extra_kernel_version_strings")) {
-            HandleStrings (TokenList, TokenCount, &(GlobalConfig.ExtraKernelVersionStrings));
-        }
-        else if (MyStriCmp (TokenList[0], L"max_tags")) {
-            HandleInt (TokenList, TokenCount, &(GlobalConfig.MaxTags));
-        }
-        else if (MyStriCmp (TokenList[0], L"enable_and_lock_vmx")) {
-            GlobalConfig.EnableAndLockVMX = HandleBoolean (TokenList, TokenCount);
-        }
-        else if (MyStriCmp (TokenList[0], L"spoof_osx_version")) {
-            HandleString (TokenList, TokenCount, &(GlobalConfig.SpoofOSXVersion));
-        }
-        else if (MyStriCmp (TokenList[0], L"csr_values")) {
-            HandleHexes (TokenList, TokenCount, CSR_MAX_LEGAL_VALUE, &(GlobalConfig.CsrValues));
-            #if REFIT_DEBUG > 0
-            LEAKABLECSRVALUES(GlobalConfig.CsrValues);
-            #endif
-        }
-        else if (MyStriCmp (TokenList[0], L"screen_rgb") && TokenCount == 4) {
-            GlobalConfig.ScreenR = Atoi(TokenList[1]);
-            GlobalConfig.ScreenG = Atoi(TokenList[2]);
-            GlobalConfig.ScreenB = Atoi(TokenList[3]);
 
-            // Record whether a Custom Screen BG is required
-            GlobalConfig.CustomScreenBG = (
-                GlobalConfig.ScreenR >= 0 && GlobalConfig.ScreenR <= 255 &&
-                GlobalConfig.ScreenG >= 0 && GlobalConfig.ScreenG <= 255 &&
-                GlobalConfig.ScreenB >= 0 && GlobalConfig.ScreenB <= 255
-            );
-        }
-        else if (MyStriCmp (TokenList[0], L"include") &&
-            (TokenCount == 2) &&
-            MyStriCmp (FileName, GlobalConfig.ConfigFilename)
-        ) {
-            if (!MyStriCmp (TokenList[1], FileName)) {
-                #if REFIT_DEBUG > 0
-                MsgLog ("Detected Overrides - ");
-                #endif
+            break;
+        default:
+            break;
+    } // switch
+} // static VOID HandleCustomOption()
 
-                ReadConfig (TokenList[1]);
-            }
-        }
-        else if (MyStriCmp (TokenList[0], L"write_systemd_vars")) {
-            GlobalConfig.WriteSystemdVars = HandleBoolean (TokenList, TokenCount);
-        }
-        else if (MyStriCmp (TokenList[0], L"enable_mouse")) {
-            GlobalConfig.EnableMouse = HandleBoolean (TokenList, TokenCount);
-            if (GlobalConfig.EnableMouse) {
-                GlobalConfig.EnableTouch = FALSE;
+// Applies one config line through its ConfigOptions[] row.
+static
+VOID HandleConfigOption (
+    IN CHAR16 **TokenList,
+    IN UINTN    TokenCount,
+    IN CHAR16  *FileName
+) {
+    CONFIG_OPTION  *Option;
+    UINTN           i;
+    STRING_BUILDER  Builder;
+
+    Option = FindConfigOption (TokenList[0]);
+    if (Option == NULL) {
+        return;
+    }
+
+    if ((TokenCount < Option->MinTokens) ||
+        ((Option->MaxTokens > 0) && (TokenCount > Option->MaxTokens))
+    ) {
+        return;
+    }
+
+    switch (Option->Type) {
+        case CONFIG_TYPE_BOOLEAN:
+            *((BOOLEAN *) Option->Target) = HandleBoolean (TokenList, TokenCount);
+
+            break;
+        case CONFIG_TYPE_DECLINE:
+            *((BOOLEAN *) Option->Target) = HandleBoolean (TokenList, TokenCount) ? FALSE : TRUE;
+
+            break;
+        case CONFIG_TYPE_INT:
+            HandleInt (TokenList, TokenCount, (UINTN *) Option->Target);
+
+            break;
+        case CONFIG_TYPE_SIGNED_INT:
+            // Signed integer as can have negative value
+            HandleSignedInt (TokenList, TokenCount, (INTN *) Option->Target);
+
+            break;
+        case CONFIG_TYPE_STRING:
+            HandleString (TokenList, TokenCount, (CHAR16 **) Option->Target);
+
+            break;
+        case CONFIG_TYPE_STRINGS:
+            HandleStrings (TokenList, TokenCount, (CHAR16 **) Option->Target);
+
+            break;
+        case CONFIG_TYPE_VOLUMES:
+            // Note: Do not use HandleStrings() because it modifies slashes.
+            //       However, This might be present in the volume name.
+            StrBuilderInit (&Builder);
+            for (i = 1; i < TokenCount; i++) {
+                StrBuilderMerge (&Builder, TokenList[i], L',');
             }
+            MY_FREE_POOL(*((CHAR16 **) Option->Target));
+            *((CHAR16 **) Option->Target) = StrBuilderDetach (&Builder);
+
+            break;
+        default:
+            HandleCustomOption (Option, TokenList, TokenCount, FileName);
+
+            break;
+    } // switch
+
+    if (Option->Leakable) {
+        LEAKABLE (*((CHAR16 **) Option->Target), Option->Leakable);
+    }
+} // static VOID HandleConfigOption()
+
+#if REFIT_DEBUG > 0
+// Logs the value each generic option ended up with once the config has been read.
+// Alternate spellings are only listed once and custom options are not listed.
+VOID LogEffectiveConfig (VOID) {
+    CONFIG_OPTION  *Option;
+    UINTN           i, j;
+
+    LOG(3, LOG_LINE_NORMAL, L"Effective Configuration:");
+    for (i = 0; i < CONFIG_OPTION_COUNT; i++) {
+        Option = &ConfigOptions[i];
+        if (Option->Type == CONFIG_TYPE_CUSTOM) {
+            continue;
         }
-        else if (MyStriCmp (TokenList[0], L"enable_touch")) {
-            GlobalConfig.EnableTouch = HandleBoolean (TokenList, TokenCount);
-            if (GlobalConfig.EnableTouch) {
-                GlobalConfig.EnableMouse = FALSE;
+
+        for (j = 0; j < i; j++) {
+            if (ConfigOptions[j].Target == Option->Target) {
+                break;
             }
         }
-        else if (MyStriCmp (TokenList[0], L"ignore_previous_boot")) {
-            GlobalConfig.IgnorePreviousBoot = HandleBoolean (TokenList, TokenCount);
-        }
-        else if (MyStriCmp (TokenList[0], L"ignore_hidden_icons")) {
-            GlobalConfig.IgnoreHiddenIcons = HandleBoolean (TokenList, TokenCount);
-        }
-        else if (MyStriCmp (TokenList[0], L"all_hidden_icons")) {
-            GlobalConfig.AllHiddenIcons = HandleBoolean (TokenList, TokenCount);
+        if (j < i) {
+            continue;
         }
-        else if (MyStriCmp (TokenList[0], L"prefer_hidden_icons")) {
-            GlobalConfig.PreferHiddenIcons = HandleBoolean (TokenList, TokenCount);
-        }
-        else if (MyStriCmp (TokenList[0], L"text_renderer")) {
-            GlobalConfig.TextRenderer = HandleBoolean (TokenList, TokenCount);
-        }
-        else if (MyStriCmp (TokenList[0], L"uga_pass_through")) {
-            GlobalConfig.UgaPassThrough = HandleBoolean (TokenList, TokenCount);
-        }
-        else if (MyStriCmp (TokenList[0], L"provide_console_gop")) {
-            GlobalConfig.ProvideConsoleGOP = HandleBoolean (TokenList, TokenCount);
-        }
-        else if (MyStriCmp (TokenList[0], L"direct_gop_renderer")) {
-            GlobalConfig.UseDirectGop = HandleBoolean (TokenList, TokenCount);
-        }
-        else if (MyStriCmp (TokenList[0], L"continue_on_warning")) {
-            GlobalConfig.ContinueOnWarning = HandleBoolean (TokenList, TokenCount);
-        }
-        else if (MyStriCmp (TokenList[0], L"force_trim")) {
-            GlobalConfig.ForceTRIM = HandleBoolean (TokenList, TokenCount);
-        }
-        else if (MyStriCmp (TokenList[0], L"disable_compat_check")) {
-            GlobalConfig.DisableCompatCheck = HandleBoolean (TokenList, TokenCount);
-        }
-        else if (MyStriCmp (TokenList[0], L"disable_amfi")) {
-            GlobalConfig.DisableAMFI = HandleBoolean (TokenList, TokenCount);
-        }
-        else if (MyStriCmp (TokenList[0], L"decline_reloadgop")) {
-            DeclineSetting = HandleBoolean (TokenList, TokenCount);
-            GlobalConfig.ReloadGOP = DeclineSetting ? FALSE : TRUE;
-        }
-        else if (MyStriCmp (TokenList[0], L"decline_nvmeload")) {
-            DeclineSetting = HandleBoolean (TokenList, TokenCount);
-            GlobalConfig.SupplyNVME = DeclineSetting ? FALSE : TRUE;
-        }
-        else if (MyStriCmp (TokenList[0], L"decline_apfsload")) {
-            DeclineSetting = HandleBoolean (TokenList, TokenCount);
-            GlobalConfig.SupplyAPFS = DeclineSetting ? FALSE : TRUE;
-        }
-        else if (MyStriCmp (TokenList[0], L"decline_apfsmute")) {
-            DeclineSetting = HandleBoolean (TokenList, TokenCount);
-            GlobalConfig.SilenceAPFS = DeclineSetting ? FALSE : TRUE;
-        }
-        else if (MyStriCmp (TokenList[0], L"decline_apfssync")) {
-            DeclineSetting = HandleBoolean (TokenList, TokenCount);
-            GlobalConfig.SyncAPFS = DeclineSetting ? FALSE : TRUE;
-        }
-        else if (MyStriCmp (TokenList[0], L"decline_nvramprotect")) {
-            DeclineSetting = HandleBoolean (TokenList, TokenCount);
-            GlobalConfig.ProtectNVRAM = DeclineSetting ? FALSE : TRUE;
 
+        switch (Option->Type) {
+            case CONFIG_TYPE_BOOLEAN:
+                LOG(3, LOG_LINE_NORMAL, L"  - %s:- '%s'",
+                    Option->Keyword,
+                    *((BOOLEAN *) Option->Target) ? L"true" : L"false"
+                );
+
+                break;
+            case CONFIG_TYPE_DECLINE:
+                LOG(3, LOG_LINE_NORMAL, L"  - %s:- '%s'",
+                    Option->Keyword,
+                    *((BOOLEAN *) Option->Target) ? L"false" : L"true"
+                );
+
+                break;
+            case CONFIG_TYPE_INT:
+                LOG(3, LOG_LINE_NORMAL, L"  - %s:- '%d'", Option->Keyword, *((UINTN *) Option->Target));
+
+                break;
+            case CONFIG_TYPE_SIGNED_INT:
+                LOG(3, LOG_LINE_NORMAL, L"  - %s:- '%d'", Option->Keyword, *((INTN *) Option->Target));
+
+                break;
+            default:
+                LOG(3, LOG_LINE_NORMAL, L"  - %s:- '%s'",
+                    Option->Keyword,
+                    *((CHAR16 **) Option->Target) ? *((CHAR16 **) Option->Target) : L"NULL"
+                );
+
+                break;
+        } // switch
+    } // for
+} // VOID LogEffectiveConfig()
+#endif
+
+// read config file
+VOID ReadConfig (
+    CHAR16 *FileName
+) {
+    EFI_STATUS        Status;
+    REFIT_FILE        File;
+    CHAR16          **TokenList;
+    CHAR16           *TempStr = NULL;
+    CHAR16           *MsgStr;
+    UINTN             TokenCount, i;
+    STRING_BUILDER    Builder;
+
+    LOGPROCENTRY("%s", FileName);
+    PROFILE_BEGIN("ReadConfig");
+
+    // Set a few defaults only if we are loading the default file.
+    if (MyStriCmp (FileName, GlobalConfig.ConfigFilename)) {
+        MY_FREE_POOL(GlobalConfig.DontScanTools);
+
+        MY_FREE_POOL(GlobalConfig.AlsoScan);
+        GlobalConfig.AlsoScan = StrDuplicate (ALSO_SCAN_DIRS);
+
+        MY_FREE_POOL(GlobalConfig.DontScanDirs);
+        StrBuilderInit (&Builder);
+        if (SelfVolume) {
+            TempStr = GuidAsString (&(SelfVolume->PartGuid));
+            StrBuilderAppend (&Builder, TempStr);
+            MY_FREE_POOL(TempStr);
         }
-        else if (MyStriCmp (TokenList[0], L"decline_espfilter")) {
-            DeclineSetting = HandleBoolean (TokenList, TokenCount);
-            GlobalConfig.ScanAllESP = DeclineSetting ? FALSE : TRUE;
-        }
-        else if (MyStriCmp (TokenList[0], L"decline_tagshelp")) {
-            DeclineSetting = HandleBoolean (TokenList, TokenCount);
-            GlobalConfig.TagsHelp = DeclineSetting ? FALSE : TRUE;
-        }
-        else if (MyStriCmp (TokenList[0], L"normalise_csr")) {
-            GlobalConfig.NormaliseCSR = HandleBoolean (TokenList, TokenCount);
-        }
-        else if (MyStriCmp (TokenList[0], L"scale_ui")) {
-            // Signed integer as can have negative value
-            HandleSignedInt (TokenList, TokenCount, &(GlobalConfig.ScaleUI));
-        }
-        else if (MyStriCmp (TokenList[0], L"active_csr")) {
-            // Signed integer as can have negative value
-            HandleSignedInt (TokenList, TokenCount, &(GlobalConfig.ActiveCSR));
+        StrBuilderMerge (&Builder, SelfDirPath, L':');
+        StrBuilderMerge (&Builder, MEMTEST_LOCATIONS, L',');
+        GlobalConfig.DontScanDirs = StrBuilderDetach (&Builder);
+
+        MY_FREE_POOL(GlobalConfig.DontScanFiles);
+        StrBuilderAppend (&Builder, DONT_SCAN_FILES);
+        StrBuilderMerge (&Builder, MOK_NAMES, L',');
+        StrBuilderMerge (&Builder, FWUPDATE_NAMES, L',');
+        GlobalConfig.DontScanFiles = StrBuilderDetach (&Builder);
+
+        MY_FREE_POOL(GlobalConfig.DontScanFirmware);
+
+        MY_FREE_POOL(GlobalConfig.DontScanVolumes);
+        GlobalConfig.DontScanVolumes = StrDuplicate (DONT_SCAN_VOLUMES);
+
+        MY_FREE_POOL(GlobalConfig.WindowsRecoveryFiles);
+        GlobalConfig.WindowsRecoveryFiles = StrDuplicate (WINDOWS_RECOVERY_FILES);
+
+        MY_FREE_POOL(GlobalConfig.MacOSRecoveryFiles);
+        GlobalConfig.MacOSRecoveryFiles = StrDuplicate (MACOS_RECOVERY_FILES);
+
+        MY_FREE_POOL(GlobalConfig.DefaultSelection);
+        GlobalConfig.DefaultSelection = StrDuplicate (L"+");
+
+        LEAKABLE (GlobalConfig.AlsoScan, "AlsoScan");
+        LEAKABLE (GlobalConfig.DontScanDirs, "DontScanDirs");
+        LEAKABLE (GlobalConfig.DontScanFiles, "DontScanFiles");
+        LEAKABLE (GlobalConfig.DontScanVolumes, "DontScanVolumes");
+        LEAKABLE (GlobalConfig.WindowsRecoveryFiles, "WindowsRecoveryFiles");
+        LEAKABLE (GlobalConfig.MacOSRecoveryFiles, "MacOSRecoveryFiles");
+        LEAKABLE (GlobalConfig.DefaultSelection, "DefaultSelection");
+    } // if
+
+    if (!FileExists (SelfDir, FileName)) {
+        SwitchToText (FALSE);
+
+        MsgStr = L"  - WARN: Cannot Find Configuration File ... Loading Defaults!!";
+        PrintUglyText (MsgStr, NEXTLINE);
+
+        #if REFIT_DEBUG > 0
+        MsgLog ("%s\n", MsgStr);
+        #endif
+
+        if (!FileExists (SelfDir, L"icons")) {
+            MsgStr = L"  - WARN: Cannot Find Icons Directory ... Switching to Text Mode!!";
+            PrintUglyText (MsgStr, NEXTLINE);
+
+            #if REFIT_DEBUG > 0
+            MsgLog ("%s\n", MsgStr);
+            #endif
+
+            GlobalConfig.TextOnly = TRUE;
         }
-        else if (MyStriCmp (TokenList[0], L"mouse_speed") && (TokenCount == 2)) {
-            HandleInt (TokenList, TokenCount, &i);
-            if (i < 1)  i = 1;
-            if (i > 32) i = 32;
-            GlobalConfig.MouseSpeed = i;
+
+        PauseForKey();
+        SwitchToGraphics();
+
+        PROFILE_END("ReadConfig");
+        LOGPROCEXIT("(file not found)");
+        return;
+    }
+
+    Status = ReadConfigFile (FileName, &File);
+    if (EFI_ERROR(Status)) {
+        PROFILE_END("ReadConfig");
+        LOGPROCEXIT("(read error)");
+        return;
+    }
+
+    for (;;) {
+        TokenCount = ReadTokenLine (&File, &TokenList);
+        if (TokenCount == 0) {
+            break;
         }
 
+        HandleConfigOption (TokenList, TokenCount, FileName);
+
         FreeTokenLine (&TokenList, &TokenCount);
     } // for
     FreeTokenLine (&TokenList, &TokenCount);
@@ -1193,6 +1851,10 @@ VOID ReadConfig (
     }
     MY_FREE_POOL(File.Buffer);
 
+    if (MyStriCmp (FileName, GlobalConfig.ConfigFilename)) {
+        ConfigCacheSave();
+    }
+
     if (!FileExists (SelfDir, L"icons") && !FileExists (SelfDir, GlobalConfig.IconsDir)) {
         #if REFIT_DEBUG > 0
         MsgLog ("  - WARN: Cannot Find Icons Directory ... Switching to Text Mode\n");
@@ -1207,6 +1869,7 @@ VOID ReadConfig (
     }
 
     SilenceAPFS = GlobalConfig.SilenceAPFS;
+    PROFILE_END("ReadConfig");
     LOGPROCEXIT();
 } // VOID ReadConfig()
 
@@ -1634,13 +2297,13 @@ VOID ScanUserConfigured (
     EFI_STATUS         Status;
     REFIT_FILE         File;
     CHAR16           **TokenList;
-    UINTN              TokenCount, size;
+    UINTN              TokenCount;
     LOADER_ENTRY      *Entry;
 
     static UINTN EntryCount = 0;
 
     if (FileExists (SelfDir, FileName)) {
-        Status = RefitReadFile (SelfDir, FileName, &File, &size);
+        Status = ReadConfigFile (FileName, &File);
         if (!EFI_ERROR(Status)) {
             LOGBLOCKENTRY("ScanUserConfigured loop");
             while ((TokenCount = ReadTokenLine (&File, &TokenList)) > 0) {
@@ -1706,13 +2369,13 @@ static
 REFIT_FILE * GenerateOptionsFromEtcFstab (
     REFIT_VOLUME *Volume
 ) {
-    EFI_STATUS    Status;
-    UINTN         TokenCount, i;
-    CHAR16      **TokenList;
-    CHAR16       *Line;
-    CHAR16       *Root    = NULL;
-    REFIT_FILE   *Options = NULL;
-    REFIT_FILE   *Fstab   = NULL;
+    EFI_STATUS       Status;
+    UINTN            TokenCount, i;
+    CHAR16         **TokenList;
+    CHAR16          *Root    = NULL;
+    REFIT_FILE      *Options = NULL;
+    REFIT_FILE      *Fstab   = NULL;
+    STRING_BUILDER   Lines;
 
     LOG(4, LOG_BLANK_LINE_SEP, L"X");
     LOG(4, LOG_LINE_FORENSIC, L"In GenerateOptionsFromEtcFstab ... 1 - START");
@@ -1752,6 +2415,7 @@ REFIT_FILE * GenerateOptionsFromEtcFstab (
             LOG(4, LOG_LINE_FORENSIC, L"In GenerateOptionsFromEtcFstab ... 1a 4b 1");
             // File read; locate root fs and create entries
             Options->Encoding = ENCODING_UTF16_LE;
+            StrBuilderInit (&Lines);
 
             LOG(4, LOG_LINE_FORENSIC, L"In GenerateOptionsFromEtcFstab ... 1a 4b 2");
             while ((TokenCount = ReadTokenLine (Fstab, &TokenList)) > 0) {
@@ -1798,27 +2462,12 @@ REFIT_FILE * GenerateOptionsFromEtcFstab (
                         }
 
                         LOG(4, LOG_LINE_FORENSIC, L"In GenerateOptionsFromEtcFstab ... 1a 4b 2a 1a 2a 2");
-                        Line = PoolPrint (L"\"Boot with Normal Options\"    \"ro root=%s\"\n", Root);
+                        StrBuilderFormat (&Lines, L"\"Boot with Normal Options\"    \"ro root=%s\"\n", Root);
 
                         LOG(4, LOG_LINE_FORENSIC, L"In GenerateOptionsFromEtcFstab ... 1a 4b 2a 1a 2a 3");
-                        MergeStrings ((CHAR16 **) &(Options->Buffer), Line, 0);
+                        StrBuilderFormat (&Lines, L"\"Boot into Single User Mode\"  \"ro root=%s single\"\n", Root);
 
                         LOG(4, LOG_LINE_FORENSIC, L"In GenerateOptionsFromEtcFstab ... 1a 4b 2a 1a 2a 4");
-                        MY_FREE_POOL(Line);
-
-                        LOG(4, LOG_LINE_FORENSIC, L"In GenerateOptionsFromEtcFstab ... 1a 4b 2a 1a 2a 5");
-                        Line = PoolPrint (L"\"Boot into Single User Mode\"  \"ro root=%s single\"\n", Root);
-
-                        LOG(4, LOG_LINE_FORENSIC, L"In GenerateOptionsFromEtcFstab ... 1a 4b 2a 1a 2a 6");
-                        MergeStrings ((CHAR16**) &(Options->Buffer), Line, 0);
-
-                        LOG(4, LOG_LINE_FORENSIC, L"In GenerateOptionsFromEtcFstab ... 1a 4b 2a 1a 2a 7");
-                        MY_FREE_POOL(Line);
-
-                        LOG(4, LOG_LINE_FORENSIC, L"In GenerateOptionsFromEtcFstab ... 1a 4b 2a 1a 2a 8");
-                        Options->BufferSize = StrLen ((CHAR16*) Options->Buffer) * sizeof(CHAR16);
-
-                        LOG(4, LOG_LINE_FORENSIC, L"In GenerateOptionsFromEtcFstab ... 1a 4b 2a 1a 2a 9");
                     } // if
 
                     LOG(4, LOG_LINE_FORENSIC, L"In GenerateOptionsFromEtcFstab ... 1a 4b 2a 1a 3");
@@ -1837,6 +2486,9 @@ REFIT_FILE * GenerateOptionsFromEtcFstab (
             } // while
             FreeTokenLine (&TokenList, &TokenCount);
 
+            Options->BufferSize = Lines.Length * sizeof (CHAR16);
+            Options->Buffer     = (UINT8 *) StrBuilderDetach (&Lines);
+
             LOG(4, LOG_LINE_FORENSIC, L"In GenerateOptionsFromEtcFstab ... 1a 4b 3");
             if (Options->Buffer) {
                 LOG(4, LOG_LINE_FORENSIC, L"In GenerateOptionsFromEtcFstab ... 1a 4b 3a 1");
@@ -1877,8 +2529,9 @@ REFIT_FILE * GenerateOptionsFromEtcFstab (
 // if the type code is set incorrectly.
 static
 REFIT_FILE * GenerateOptionsFromPartTypes (VOID) {
-    REFIT_FILE   *Options = NULL;
-    CHAR16       *Line, *GuidString, *WriteStatus;
+    REFIT_FILE       *Options = NULL;
+    CHAR16           *GuidString, *WriteStatus;
+    STRING_BUILDER    Lines;
 
     LOG(4, LOG_BLANK_LINE_SEP, L"X");
     LOG(4, LOG_LINE_FORENSIC, L"In GenerateOptionsFromPartTypes ... 1 - START");
@@ -1902,35 +2555,27 @@ REFIT_FILE * GenerateOptionsFromPartTypes (VOID) {
             LOG(4, LOG_LINE_FORENSIC, L"In GenerateOptionsFromPartTypes ... 1a 2a 5");
             if (GuidString) {
                 LOG(4, LOG_LINE_FORENSIC, L"In GenerateOptionsFromPartTypes ... 1a 2a 5a 1");
-                Line = PoolPrint (
+                StrBuilderInit (&Lines);
+                StrBuilderFormat (&Lines,
                     L"\"Boot with Normal Options\"    \"%s root=/dev/disk/by-partuuid/%s\"\n",
                     WriteStatus, GuidString
                 );
 
                 LOG(4, LOG_LINE_FORENSIC, L"In GenerateOptionsFromPartTypes ... 1a 2a 5a 2");
-                MergeStrings ((CHAR16 **) &(Options->Buffer), Line, 0);
-
-                LOG(4, LOG_LINE_FORENSIC, L"In GenerateOptionsFromPartTypes ... 1a 2a 5a 3");
-                MY_FREE_POOL(Line);
-
-                LOG(4, LOG_LINE_FORENSIC, L"In GenerateOptionsFromPartTypes ... 1a 2a 5a 4");
-                Line = PoolPrint (
+                StrBuilderFormat (&Lines,
                     L"\"Boot into Single User Mode\"  \"%s root=/dev/disk/by-partuuid/%s single\"\n",
                     WriteStatus, GuidString
                 );
 
-                LOG(4, LOG_LINE_FORENSIC, L"In GenerateOptionsFromPartTypes ... 1a 2a 5a 5");
-                MergeStrings ((CHAR16**) &(Options->Buffer), Line, 0);
-
-                LOG(4, LOG_LINE_FORENSIC, L"In GenerateOptionsFromPartTypes ... 1a 2a 5a 6");
-                MY_FREE_POOL(Line);
+                LOG(4, LOG_LINE_FORENSIC, L"In GenerateOptionsFromPartTypes ... 1a 2a 5a 3");
+                Options->BufferSize = Lines.Length * sizeof (CHAR16);
+                Options->Buffer     = (UINT8 *) StrBuilderDetach (&Lines);
                 MY_FREE_POOL(GuidString);
 
-                LOG(4, LOG_LINE_FORENSIC, L"In GenerateOptionsFromPartTypes ... 1a 2a 5a 7");
+                LOG(4, LOG_LINE_FORENSIC, L"In GenerateOptionsFromPartTypes ... 1a 2a 5a 4");
             } // if (GuidString)
 
             LOG(4, LOG_LINE_FORENSIC, L"In GenerateOptionsFromPartTypes ... 1a 2a 6");
-            Options->BufferSize   = StrLen ((CHAR16*) Options->Buffer) * sizeof(CHAR16);
             Options->Current8Ptr  = (CHAR8 *) Options->Buffer;
             Options->End8Ptr      = Options->Current8Ptr + Options->BufferSize;
             Options->Current16Ptr = (CHAR16 *) Options->Buffer;
@@ -84,6 +84,9 @@ typedef struct {
 
 EFI_STATUS RefitReadFile (IN EFI_FILE_HANDLE BaseDir, CHAR16 *FileName, REFIT_FILE *File, UINTN *size);
 VOID ReadConfig (CHAR16 *FileName);
+#if REFIT_DEBUG > 0
+VOID LogEffectiveConfig (VOID);
+#endif
 VOID ScanUserConfigured (CHAR16 *FileName);
 UINTN ReadTokenLine (IN REFIT_FILE *File, OUT CHAR16 ***TokenList);
 VOID FreeTokenLine (IN OUT CHAR16 ***TokenList, IN OUT UINTN *TokenCount);
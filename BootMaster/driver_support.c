@@ -66,6 +66,7 @@
 #include "launch_efi.h"
 #include "../include/refit_call_wrapper.h"
 #include "leaks.h"
+#include "profile.h"
 
 #if 0
 #include "../../ShellPkg/Library/UefiHandleParsingLib/UefiHandleParsingLib.h"
@@ -668,12 +669,13 @@ static
 UINTN ScanDriverDir (
     IN CHAR16 *Path
 ) {
-    EFI_STATUS       Status;
-    REFIT_DIR_ITER   DirIter;
-    EFI_FILE_INFO   *DirEntry;
-    CHAR16          *FileName;
-    CHAR16          *ErrMsg;
-    UINTN            NumFound  = 0;
+    EFI_STATUS         Status;
+    REFIT_DIR_ITER     DirIter;
+    FILE_PATTERN_SET   Patterns;
+    EFI_FILE_INFO     *DirEntry;
+    CHAR16            *FileName;
+    CHAR16            *ErrMsg;
+    UINTN              NumFound  = 0;
 
     LOGPROCENTRY("'%s' Folder", Path);
 
@@ -687,11 +689,11 @@ UINTN ScanDriverDir (
 
     // look through contents of the directory
     DirIterOpen (SelfRootDir, Path, &DirIter);
+    FilePatternSetCompile (LOADER_MATCH_PATTERNS, &Patterns);
 
-    while (DirIterNext (&DirIter, 2, LOADER_MATCH_PATTERNS, &DirEntry)) {
+    while (DirIterNext (&DirIter, 2, &Patterns, &DirEntry)) {
         if (DirEntry->FileName[0] == '.') {
             // skip this
-            MY_FREE_POOL(DirEntry);
             continue;
         }
 
@@ -705,8 +707,6 @@ UINTN ScanDriverDir (
             FALSE, TRUE
         );
 
-        MY_FREE_POOL(DirEntry);
-
         #if REFIT_DEBUG > 0
         MsgLog ("  - %r ... UEFI Driver:- '%s'\n", Status, FileName);
         #endif
@@ -715,6 +715,7 @@ UINTN ScanDriverDir (
         MY_FREE_POOL(FileName);
     } // while
 
+    FilePatternSetFree (&Patterns);
     Status = DirIterClose (&DirIter);
     if (Status != EFI_NOT_FOUND) {
         ErrMsg = PoolPrint (L"While Scanning the '%s' Directory", Path);
@@ -740,6 +741,7 @@ BOOLEAN LoadDrivers (VOID) {
     UINTN    CurFound = 0;
 
     LOGPROCENTRY();
+    PROFILE_BEGIN("LoadDrivers");
     #if REFIT_DEBUG > 0
     CHAR16  *MsgNotFound = L"Not Found or Empty";
 
@@ -839,6 +841,7 @@ BOOLEAN LoadDrivers (VOID) {
     // DA-TAG: Always run this
     ConnectAllDriversToAllControllers (TRUE);
 
+    PROFILE_END("LoadDrivers");
     LOGPROCEXIT("Found:%d", NumFound);
     return (NumFound > 0);
 } // BOOLEAN LoadDrivers()
@@ -439,6 +439,11 @@ typedef struct {
     BOOLEAN           ShutdownAfterTimeout;
     BOOLEAN           Install;
     BOOLEAN           WriteSystemdVars;
+    BOOLEAN           IconCache;
+    BOOLEAN           LogDropWhenFull;
+    BOOLEAN           ConfigCache;
+    BOOLEAN           Profile;
+    BOOLEAN           ScanCache;
     UINTN             RequestedScreenWidth;
     UINTN             RequestedScreenHeight;
     UINTN             BannerBottomEdge;
@@ -18,17 +18,36 @@ VOID DebugLog (
 );
 
 #if REFIT_DEBUG == 0
-    #define DONTMSG(DebugMode, Msg) TRUE
+    #define SKIPMSG(DebugMode) TRUE
 #else
-    #define DONTMSG(DebugMode, Msg)    (DebugMode < 1 || !Msg || GlobalConfig.LogLevel < 0 /* || (!UseMsgLog && !NativeLogger && GlobalConfig.LogLevel > 0) */)
+    #define SKIPMSG(DebugMode)        (DebugMode < 1 || GlobalConfig.LogLevel < 0 /* || (!NativeLogger && GlobalConfig.LogLevel > 0) */)
 #endif
-#define DONTLOG(DebugMode, level, Msg) (DebugMode < 1 || !Msg || GlobalConfig.LogLevel < level || GlobalConfig.LogLevel < 1 /* || NativeLogger */ || MuteLogger)
+#define SKIPLOG(DebugMode, level)     (DebugMode < 1 || GlobalConfig.LogLevel < level || GlobalConfig.LogLevel < 1 /* || NativeLogger */ || MuteLogger)
+
+#define DONTMSG(DebugMode, Msg)        (!Msg || SKIPMSG(DebugMode))
+#define DONTLOG(DebugMode, level, Msg) (!Msg || SKIPLOG(DebugMode, level))
 
 VOID DeepLoggger (
-    IN  INTN     DebugMode,
-    IN  INTN     level,
-    IN  INTN     type,
-    IN  CHAR16 **Msg
+    IN        INTN    DebugMode,
+    IN        INTN    level,
+    IN        INTN    type,
+    IN  const CHAR16 *Format, ...
+);
+
+VOID DeepLogggerAffixed (
+    IN        INTN    DebugMode,
+    IN        INTN    level,
+    IN        INTN    type,
+    IN  const CHAR16 *Prefix,
+    IN  const CHAR16 *Suffix,
+    IN  const CHAR16 *Format, ...
+);
+
+VOID DebugLogAffixed (
+    IN        INTN    DebugMode,
+    IN  const CHAR16 *Prefix,
+    IN  const CHAR16 *Suffix,
+    IN  const CHAR16 *Format, ...
 );
 
 #if REFIT_DEBUG < 1
@@ -37,11 +56,12 @@ VOID DeepLoggger (
 #else
 #   define MsgLog(...)  DebugLog(REFIT_DEBUG, __VA_ARGS__)
 
-    // NB: '_logTemp' is handled in 'DeepLoggger'
-#   define LOG(level, type, ...)                              \
-        do {                                                  \
-            CHAR16 *_logTemp = PoolPrint(__VA_ARGS__);        \
-            DeepLoggger(REFIT_DEBUG, level, type, &_logTemp); \
+    // NB: Arguments are only evaluated and formatted if the level is being logged
+#   define LOG(level, type, ...)                                    \
+        do {                                                        \
+            if (!SKIPLOG(REFIT_DEBUG, level)) {                     \
+                DeepLoggger(REFIT_DEBUG, level, type, __VA_ARGS__); \
+            }                                                       \
         } while (FALSE)
 
 // #define MsgLog(f,...) AsciiPrint(f, ##__VA_ARGS__)
@@ -54,18 +74,18 @@ VOID DeepLoggger (
 
 #else
 
+// Goes to the upstream format log if the level is being logged and the
+// line is not a normal one, and to the native format log otherwise
 #define LOG4(_v, _l, _p, _x, _p2, _x2, ...) \
     do { \
-        CHAR16 *_MsgStr = PoolPrint (__VA_ARGS__); \
-        BOOLEAN _dm = DONTMSG(REFIT_DEBUG, _MsgStr); \
-        BOOLEAN _dl = DONTLOG(REFIT_DEBUG, _v, _MsgStr); \
-        if (!_dm && !_dl) { \
-            _dl = (_l == LOG_LINE_NORMAL); \
-            _dm = !_dl; \
+        if (!SKIPMSG(REFIT_DEBUG)) { \
+            if (SKIPLOG(REFIT_DEBUG, _v) || _l == LOG_LINE_NORMAL) { \
+                DebugLogAffixed (REFIT_DEBUG, _p, _x, __VA_ARGS__); \
+            } \
+            else { \
+                DeepLogggerAffixed (REFIT_DEBUG, _v, _l, _p2, _x2, __VA_ARGS__); \
+            } \
         } \
-        if (_dm) LOG(_v, _l, L"%s%s%s", _p2, _MsgStr, _x2); \
-        if (_dl) MsgLog ("%s%s%s", _p, _MsgStr, _x); \
-        MY_FREE_POOL(_MsgStr); \
     } while(0)
 
 #endif // #if REFIT_DEBUG > 0
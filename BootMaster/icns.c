@@ -79,9 +79,10 @@ PoolImage * BuiltinIcon(IN UINTN Id)
     }
 
     if (!GetPoolImage (&BuiltinIconTable[Id].Image)) {
-        AssignCachedPoolImage (&BuiltinIconTable[Id].Image, egFindIcon(
+        AssignCachedPoolImage (&BuiltinIconTable[Id].Image, GetAtlasIcon (
             BuiltinIconTable[Id].FileName,
-            GlobalConfig.IconSizes[BuiltinIconTable[Id].IconSize]
+            GlobalConfig.IconSizes[BuiltinIconTable[Id].IconSize],
+            ICON_VARIANT_PLAIN
         ));
         if (!GetPoolImage (&BuiltinIconTable[Id].Image)) {
             if (Id == BUILTIN_ICON_TOOL_BOOTKICKER) {
@@ -107,22 +108,198 @@ PoolImage * BuiltinIcon(IN UINTN Id)
     return &BuiltinIconTable[Id].Image_PI_;
 }
 
+//
+// Icon atlas
+//
+
+// Icons found via egFindIcon() are kept for the whole session, keyed by base
+// name, icon size and variant, so that each distinct icon is only decoded and
+// scaled once however many menu entries show it. Atlas images are shared and
+// must be attached with AssignCachedPoolImage(), which retains them; the
+// PoolImage functions release them again. Lookups that found no icon file are
+// kept as well, so later lookups for the same name are also free.
+
+typedef struct {
+    CHAR16      *BaseName;
+    UINTN        IconSize;
+    UINTN        Variant;
+    EG_IMAGE    *Image;
+    UINTN        RefCount;
+    BOOLEAN      Stale;
+} ICON_ATLAS_ENTRY;
+
+static ICON_ATLAS_ENTRY  *IconAtlas          = NULL;
+static UINTN              IconAtlasCount     = 0;
+static CHAR16            *IconAtlasIconsDir  = NULL;
+static UINTN              IconAtlasLookups   = 0;
+static UINTN              IconAtlasDecodes   = 0;
+
+static
+VOID FreeAtlasEntry (
+    IN UINTN Index
+) {
+    MY_FREE_POOL(IconAtlas[Index].BaseName);
+    MY_FREE_IMAGE(IconAtlas[Index].Image);
+
+    IconAtlasCount--;
+    if (Index < IconAtlasCount) {
+        IconAtlas[Index] = IconAtlas[IconAtlasCount];
+    }
+} // static VOID FreeAtlasEntry()
+
+// Entries from a previous 'icons_dir' setting no longer match lookups. They are
+// freed as soon as nothing refers to them.
+static
+VOID RetireIconAtlas (VOID) {
+    UINTN i = IconAtlasCount;
+
+    while (i-- > 0) {
+        IconAtlas[i].Stale = TRUE;
+        if (IconAtlas[i].RefCount == 0) {
+            FreeAtlasEntry (i);
+        }
+    }
+} // static VOID RetireIconAtlas()
+
+static
+ICON_ATLAS_ENTRY * FindAtlasImage (
+    IN EG_IMAGE *Image
+) {
+    UINTN i;
+
+    if (Image == NULL) {
+        return NULL;
+    }
+
+    for (i = 0; i < IconAtlasCount; i++) {
+        if (IconAtlas[i].Image == Image) {
+            return &IconAtlas[i];
+        }
+    }
+
+    return NULL;
+} // static ICON_ATLAS_ENTRY * FindAtlasImage()
+
+// Returns the shared image for BaseName at IconSize, loading it on first use.
+// Returns NULL if no icon file exists. The image belongs to the atlas.
+EG_IMAGE * GetAtlasIcon (
+    IN CHAR16 *BaseName,
+    IN UINTN   IconSize,
+    IN UINTN   Variant
+) {
+    UINTN             i;
+    CHAR16           *FileName;
+    ICON_ATLAS_ENTRY  NewEntry;
+
+    if (BaseName == NULL) {
+        return NULL;
+    }
+
+    if ((IconAtlasIconsDir == NULL) != (GlobalConfig.IconsDir == NULL) ||
+        (IconAtlasIconsDir != NULL && !MyStriCmp (IconAtlasIconsDir, GlobalConfig.IconsDir))
+    ) {
+        RetireIconAtlas();
+        MY_FREE_POOL(IconAtlasIconsDir);
+        if (GlobalConfig.IconsDir != NULL) {
+            IconAtlasIconsDir = StrDuplicate (GlobalConfig.IconsDir);
+        }
+    }
+
+    IconAtlasLookups++;
+    for (i = 0; i < IconAtlasCount; i++) {
+        if (!IconAtlas[i].Stale                &&
+            IconAtlas[i].IconSize == IconSize &&
+            IconAtlas[i].Variant  == Variant  &&
+            MyStriCmp (IconAtlas[i].BaseName, BaseName)
+        ) {
+            return IconAtlas[i].Image;
+        }
+    }
+
+    switch (Variant) {
+        case ICON_VARIANT_OS:    FileName = PoolPrint (L"os_%s",   BaseName); break;
+        case ICON_VARIANT_BOOT:  FileName = PoolPrint (L"boot_%s", BaseName); break;
+        case ICON_VARIANT_DUMMY: FileName = NULL;                             break;
+        default:                 FileName = StrDuplicate (BaseName);
+    }
+
+    IconAtlasDecodes++;
+    NewEntry.BaseName = StrDuplicate (BaseName);
+    NewEntry.IconSize = IconSize;
+    NewEntry.Variant  = Variant;
+    NewEntry.Image    = (Variant == ICON_VARIANT_DUMMY)
+        ? DummyImage (IconSize)
+        : egFindIcon (FileName, IconSize);
+    NewEntry.RefCount = 0;
+    NewEntry.Stale    = FALSE;
+    MY_FREE_POOL(FileName);
+
+    if (NewEntry.BaseName == NULL) {
+        // Cannot index the result ... Hand it over untracked
+        return NewEntry.Image;
+    }
+
+    AddListElementSized (
+        (VOID **) &IconAtlas, &IconAtlasCount,
+        &NewEntry, sizeof (NewEntry)
+    );
+
+    return NewEntry.Image;
+} // EG_IMAGE * GetAtlasIcon()
+
+// Called by the PoolImage functions when a cached image is attached to or
+// detached from a PoolImage. Images that are not in the atlas are ignored.
+VOID RetainAtlasIcon (
+    IN EG_IMAGE *Image
+) {
+    ICON_ATLAS_ENTRY *Entry = FindAtlasImage (Image);
+
+    if (Entry != NULL) {
+        Entry->RefCount++;
+    }
+} // VOID RetainAtlasIcon()
+
+VOID ReleaseAtlasIcon (
+    IN EG_IMAGE *Image
+) {
+    ICON_ATLAS_ENTRY *Entry = FindAtlasImage (Image);
+
+    if (Entry != NULL && Entry->RefCount > 0) {
+        Entry->RefCount--;
+        if (Entry->RefCount == 0 && Entry->Stale) {
+            FreeAtlasEntry (Entry - IconAtlas);
+        }
+    }
+} // VOID ReleaseAtlasIcon()
+
+VOID LogIconAtlasStats (VOID) {
+    #if REFIT_DEBUG > 0
+    LOG(2, LOG_THREE_STAR_MID,
+        L"Icon Atlas:- %d Entries ... %d Lookups ... %d Decodes ... %d Decodes Avoided",
+        IconAtlasCount, IconAtlasLookups, IconAtlasDecodes,
+        IconAtlasLookups - IconAtlasDecodes
+    );
+    #endif
+} // VOID LogIconAtlasStats()
+
 //
 // Load an icon for an operating system
 //
 
 // Load an OS icon from among the comma-delimited list provided in OSIconName.
 // Searches for icons with extensions in the ICON_EXTENSIONS list (via
-// egFindIcon()).
-// Returns image data. On failure, returns an ugly "dummy" icon.
+// egFindIcon()) through the icon atlas.
+// Returns shared image data, to be attached with AssignCachedPoolImage().
+// On failure, returns an ugly "dummy" icon.
 EG_IMAGE * LoadOSIcon(
     IN  CHAR16  *OSIconName OPTIONAL,
     IN  CHAR16  *FallbackIconName,
     IN  BOOLEAN  BootLogo
 ) {
     EG_IMAGE        *Image = NULL;
-    CHAR16          *CutoutName, *BaseName;
+    CHAR16          *CutoutName;
     UINTN            Index = 0;
+    UINTN            Variant = BootLogo ? ICON_VARIANT_BOOT : ICON_VARIANT_OS;
 
     if (!AllowGraphicsMode) {
         // skip loading if it is not used anyway
@@ -133,34 +310,28 @@ EG_IMAGE * LoadOSIcon(
     while ((Image == NULL) &&
         ((CutoutName = FindCommaDelimited (OSIconName, Index++)) != NULL)
     ) {
-        BaseName = PoolPrint (L"%s_%s", BootLogo ? L"boot" : L"os", CutoutName);
-        Image    = egFindIcon (BaseName, GlobalConfig.IconSizes[ICON_SIZE_BIG]);
+        Image = GetAtlasIcon (CutoutName, GlobalConfig.IconSizes[ICON_SIZE_BIG], Variant);
         MY_FREE_POOL(CutoutName);
-        MY_FREE_POOL(BaseName);
     }
 
     // If that fails, try again using the FallbackIconName.
     if (Image == NULL) {
-        BaseName = PoolPrint (L"%s_%s", BootLogo ? L"boot" : L"os", FallbackIconName);
-
         #if REFIT_DEBUG > 0
-       LOG(2, LOG_LINE_NORMAL, L"Trying to find an icon from '%s'", BaseName);
+        LOG(2, LOG_LINE_NORMAL, L"Trying to find an icon from '%s_%s'",
+            BootLogo ? L"boot" : L"os", FallbackIconName
+        );
         #endif
 
-        Image = egFindIcon (BaseName, GlobalConfig.IconSizes[ICON_SIZE_BIG]);
-        MY_FREE_POOL(BaseName);
+        Image = GetAtlasIcon (FallbackIconName, GlobalConfig.IconSizes[ICON_SIZE_BIG], Variant);
     }
 
     // If that fails and if BootLogo was set, try again using the "os_" start of the name.
     if (BootLogo && (Image == NULL)) {
-        BaseName = PoolPrint (L"os_%s", FallbackIconName);
-
         #if REFIT_DEBUG > 0
-       LOG(2, LOG_LINE_NORMAL, L"Trying to find an icon from '%s'", BaseName);
+        LOG(2, LOG_LINE_NORMAL, L"Trying to find an icon from 'os_%s'", FallbackIconName);
         #endif
 
-        Image = egFindIcon (BaseName, GlobalConfig.IconSizes[ICON_SIZE_BIG]);
-        MY_FREE_POOL(BaseName);
+        Image = GetAtlasIcon (FallbackIconName, GlobalConfig.IconSizes[ICON_SIZE_BIG], ICON_VARIANT_OS);
     }
 
     // If all of these fail, return the dummy image.
@@ -169,7 +340,7 @@ EG_IMAGE * LoadOSIcon(
         LOG(2, LOG_LINE_NORMAL, L"Setting dummy image");
         #endif
 
-        Image = DummyImage (GlobalConfig.IconSizes[ICON_SIZE_BIG]);
+        Image = GetAtlasIcon (L"", GlobalConfig.IconSizes[ICON_SIZE_BIG], ICON_VARIANT_DUMMY);
     }
 
     return Image;
@@ -57,6 +57,17 @@
 
 EG_IMAGE * LoadOSIcon(IN CHAR16 *OSIconName OPTIONAL, IN CHAR16 *FallbackIconName, BOOLEAN BootLogo);
 
+// Icon atlas variants
+#define ICON_VARIANT_PLAIN  (0)
+#define ICON_VARIANT_OS     (1)
+#define ICON_VARIANT_BOOT   (2)
+#define ICON_VARIANT_DUMMY  (3)
+
+EG_IMAGE * GetAtlasIcon(IN CHAR16 *BaseName, IN UINTN IconSize, IN UINTN Variant);
+VOID RetainAtlasIcon(IN EG_IMAGE *Image);
+VOID ReleaseAtlasIcon(IN EG_IMAGE *Image);
+VOID LogIconAtlasStats(VOID);
+
 EG_IMAGE * DummyImage(IN UINTN PixelSize);
 
 PoolImage * BuiltinIcon(IN UINTN Id);
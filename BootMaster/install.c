@@ -440,8 +440,8 @@ EFI_STATUS CopyDirectory (
 
         MY_FREE_POOL(DestFileName);
         MY_FREE_POOL(SourceFileName);
-        MY_FREE_POOL(DirEntry);
     } // while
+    DirIterClose (&DirIter);
 
     return (Status);
 } // EFI_STATUS CopyDirectory()
@@ -56,6 +56,7 @@
 #include "../include/refit_call_wrapper.h"
 #include "launch_efi.h"
 #include "scan.h"
+#include "scan_cache.h"
 #include "BootLog.h"
 
 //
@@ -144,20 +145,425 @@ VOID WarnSecureBootError(
     MY_FREE_POOL(MsgStrE);
 } // VOID WarnSecureBootError()
 
+// Returns TRUE if Header, the first Size bytes of a file, shows an EFI loader
+// for this architecture. Size must be 512 for the check to pass.
+BOOLEAN IsValidLoaderHeader (
+    IN CHAR8 *Header,
+    IN UINTN  Size
+) {
+#if defined (EFIX64) | defined (EFI32) | defined (EFIAARCH64)
+    UINTN Offset;
+
+    if ((Header == NULL) || (Size != 512)) {
+        return FALSE;
+    }
+
+    return (
+        (Header[0] == 'M' && Header[1] == 'Z' &&
+        (Offset = *(UINT32 *) &Header[0x3c]) < 0x180 &&
+        Header[Offset] == 'P' && Header[Offset+1] == 'E' &&
+        Header[Offset+2] == 0 && Header[Offset+3] == 0 &&
+        *(UINT16 *) &Header[Offset+4] == EFI_STUB_ARCH) ||
+        (*(UINT32 *) Header == FAT_ARCH)
+    );
+#else
+    return TRUE;
+#endif
+} // BOOLEAN IsValidLoaderHeader()
+
+// PE/COFF layout, as far as the loader probe reads it
+#define PE_HEADER_SIZE            (24)    // 'PE\0\0' plus the COFF file header
+#define PE_SECTION_HEADER_SIZE    (40)
+#define PE_OPT_MAGIC_PE32_PLUS    (0x20b)
+#define PE_SECURITY_DIRECTORY     (4)
+
+// Bytes read from the start of a loader, enough for the headers and the
+// section table of most images, and the most read from a UKI text section
+#define LOADER_PROBE_HEADER_SIZE  (4096)
+#define LOADER_PROBE_SECTION_MAX  (4096)
+
+static LOADER_INFO  **LoaderInfos     = NULL;
+static UINTN          LoaderInfoCount = 0;
+
+static
+BOOLEAN ReadLoaderBytes (
+    IN  EFI_FILE_HANDLE  FileHandle,
+    IN  UINT64           Offset,
+    IN  UINTN            Size,
+    OUT VOID            *Buffer
+) {
+    EFI_STATUS  Status;
+    UINTN       ReadSize = Size;
+
+    Status = REFIT_CALL_2_WRAPPER(FileHandle->SetPosition, FileHandle, Offset);
+    if (!EFI_ERROR(Status)) {
+        Status = REFIT_CALL_3_WRAPPER(FileHandle->Read, FileHandle, &ReadSize, Buffer);
+    }
+
+    return (!EFI_ERROR(Status) && (ReadSize == Size));
+} // static BOOLEAN ReadLoaderBytes()
+
+// Returns TRUE if the 8 byte, zero padded, section name is Name
+static
+BOOLEAN IsPeSectionName (
+    IN CHAR8 *SectionName,
+    IN CHAR8 *Name
+) {
+    UINTN i;
+
+    for (i = 0; i < 8; i++) {
+        if (SectionName[i] != Name[i]) {
+            return FALSE;
+        }
+        if (Name[i] == '\0') {
+            break;
+        }
+    }
+
+    return TRUE;
+} // static BOOLEAN IsPeSectionName()
+
+// Returns a CHAR16 copy of the first Length characters of Data
+static
+CHAR16 * AsciiSpanToStr (
+    IN CHAR8 *Data,
+    IN UINTN  Length
+) {
+    CHAR16  *Str;
+    UINTN    i;
+
+    Str = AllocatePool ((Length + 1) * sizeof (CHAR16));
+    if (Str != NULL) {
+        for (i = 0; i < Length; i++) {
+            Str[i] = (CHAR16) (UINT8) Data[i];
+        }
+        Str[Length] = L'\0';
+    }
+
+    return Str;
+} // static CHAR16 * AsciiSpanToStr()
+
+// Returns the value of Key in the os-release text held in Data, without
+// any quotes, or NULL if the key is not set.
+static
+CHAR16 * GetOsRelValue (
+    IN CHAR8 *Data,
+    IN UINTN  Size,
+    IN CHAR8 *Key
+) {
+    UINTN    KeyLength, Start, End;
+
+    KeyLength = AsciiStrLen (Key);
+    for (Start = 0; Start < Size; Start = End + 1) {
+        End = Start;
+        while ((End < Size) && (Data[End] != '\n') && (Data[End] != '\0')) {
+            End++;
+        }
+
+        if ((End - Start <= KeyLength) ||
+            (CompareMem (&Data[Start], Key, KeyLength) != 0) ||
+            (Data[Start + KeyLength] != '=')
+        ) {
+            continue;
+        }
+
+        Start += KeyLength + 1;
+        if ((End > Start) && (Data[End - 1] == '\r')) {
+            End--;
+        }
+        if ((End - Start >= 2) &&
+            ((Data[Start] == '"') || (Data[Start] == '\'')) &&
+            (Data[End - 1] == Data[Start])
+        ) {
+            Start++;
+            End--;
+        }
+        if (End == Start) {
+            return NULL;
+        }
+
+        return AsciiSpanToStr (&Data[Start], End - Start);
+    } // for
+
+    return NULL;
+} // static CHAR16 * GetOsRelValue()
+
+// Reads up to LOADER_PROBE_SECTION_MAX bytes of a section's file data.
+// The caller must free the returned buffer.
+static
+CHAR8 * ReadPeSection (
+    IN  EFI_FILE_HANDLE  FileHandle,
+    IN  UINT8           *SectionHeader,
+    OUT UINTN           *Size
+) {
+    CHAR8   *Data;
+    UINT32   VirtualSize = *(UINT32 *) &SectionHeader[8];
+    UINT32   RawSize     = *(UINT32 *) &SectionHeader[16];
+    UINT32   RawOffset   = *(UINT32 *) &SectionHeader[20];
+
+    *Size = RawSize;
+    if ((VirtualSize != 0) && (VirtualSize < *Size)) {
+        *Size = VirtualSize;
+    }
+    if (*Size > LOADER_PROBE_SECTION_MAX) {
+        *Size = LOADER_PROBE_SECTION_MAX;
+    }
+    if (*Size == 0) {
+        return NULL;
+    }
+
+    Data = AllocatePool (*Size);
+    if ((Data != NULL) && !ReadLoaderBytes (FileHandle, RawOffset, *Size, Data)) {
+        MY_FREE_POOL(Data);
+    }
+
+    return Data;
+} // static CHAR8 * ReadPeSection()
+
+// Fills in the PE/COFF details of a loader whose first HeaderSize bytes
+// are in Header, reading the section table and the Unified Kernel Image
+// text sections from FileHandle where they lie beyond the header.
+static
+VOID ProbePeImage (
+    IN     EFI_FILE_HANDLE  FileHandle,
+    IN     UINT8           *Header,
+    IN     UINTN            HeaderSize,
+    IN OUT LOADER_INFO     *Info
+) {
+    UINT8   *OptHeader;
+    UINT8   *Table;
+    UINT8   *Section;
+    CHAR8   *Data;
+    UINTN    PeOffset, TableOffset, TableSize;
+    UINTN    DirOffset, DataSize, DataLength, i;
+    UINT16   NumSections, OptSize;
+
+    if ((HeaderSize < 0x40) || (Header[0] != 'M') || (Header[1] != 'Z')) {
+        return;
+    }
+
+    PeOffset = *(UINT32 *) &Header[0x3c];
+    if ((PeOffset > HeaderSize) ||
+        (HeaderSize - PeOffset < PE_HEADER_SIZE) ||
+        (CompareMem (&Header[PeOffset], "PE\0\0", 4) != 0)
+    ) {
+        return;
+    }
+
+    Info->Machine = *(UINT16 *) &Header[PeOffset + 4];
+    NumSections   = *(UINT16 *) &Header[PeOffset + 6];
+    OptSize       = *(UINT16 *) &Header[PeOffset + 20];
+    OptHeader     = &Header[PeOffset + PE_HEADER_SIZE];
+    TableOffset   = PeOffset + PE_HEADER_SIZE + OptSize;
+    if (TableOffset > HeaderSize) {
+        return;
+    }
+
+    // Subsystem sits at the same offset in PE32 and PE32+ optional headers
+    if (OptSize >= 70) {
+        Info->Subsystem = *(UINT16 *) &OptHeader[68];
+    }
+
+    // An Authenticode signature is held in the security data directory
+    if (OptSize >= 2) {
+        DirOffset = (*(UINT16 *) OptHeader == PE_OPT_MAGIC_PE32_PLUS) ? 112 : 96;
+        if ((OptSize >= DirOffset + (PE_SECURITY_DIRECTORY + 1) * 8) &&
+            (*(UINT32 *) &OptHeader[DirOffset - 4] > PE_SECURITY_DIRECTORY)
+        ) {
+            Info->IsSigned = (*(UINT32 *) &OptHeader[DirOffset + PE_SECURITY_DIRECTORY * 8 + 4] != 0);
+        }
+    }
+
+    TableSize = (UINTN) NumSections * PE_SECTION_HEADER_SIZE;
+    if (TableOffset + TableSize <= HeaderSize) {
+        Table = &Header[TableOffset];
+    }
+    else {
+        Table = AllocatePool (TableSize);
+        if ((Table == NULL) || !ReadLoaderBytes (FileHandle, TableOffset, TableSize, Table)) {
+            MY_FREE_POOL(Table);
+            return;
+        }
+    }
+
+    for (i = 0; i < NumSections; i++) {
+        Section = &Table[i * PE_SECTION_HEADER_SIZE];
+        if (IsPeSectionName ((CHAR8 *) Section, ".linux")) {
+            Info->IsUki = TRUE;
+        }
+        else if (IsPeSectionName ((CHAR8 *) Section, ".cmdline")) {
+            Info->HasCmdline = TRUE;
+        }
+        else if (IsPeSectionName ((CHAR8 *) Section, ".osrel") && (Info->OsRelName == NULL)) {
+            Data = ReadPeSection (FileHandle, Section, &DataSize);
+            if (Data != NULL) {
+                Info->OsRelName = GetOsRelValue (Data, DataSize, "PRETTY_NAME");
+                if (Info->OsRelName == NULL) {
+                    Info->OsRelName = GetOsRelValue (Data, DataSize, "NAME");
+                }
+                MY_FREE_POOL(Data);
+            }
+        }
+        else if (IsPeSectionName ((CHAR8 *) Section, ".uname") && (Info->Uname == NULL)) {
+            Data = ReadPeSection (FileHandle, Section, &DataSize);
+            if (Data != NULL) {
+                DataLength = 0;
+                while ((DataLength < DataSize) && (Data[DataLength] > ' ')) {
+                    DataLength++;
+                }
+                Info->Uname = (DataLength > 0) ? AsciiSpanToStr (Data, DataLength) : NULL;
+                MY_FREE_POOL(Data);
+            }
+        }
+    } // for
+
+    if (Table != &Header[TableOffset]) {
+        MY_FREE_POOL(Table);
+    }
+} // static VOID ProbePeImage()
+
+// Returns what a single open of FileName on Volume finds about it as a
+// loader. Results are kept for the volume and path, so later checks while
+// scanning, building the menu and launching do not read the file again.
+// Returns NULL only if there is nothing to open.
+LOADER_INFO * GetLoaderInfo (
+    IN REFIT_VOLUME *Volume,
+    IN CHAR16       *FileName
+) {
+    EFI_STATUS        Status;
+    EFI_FILE_HANDLE   FileHandle;
+    EFI_FILE_INFO    *FileInfo;
+    LOADER_INFO      *Info;
+    CHAR16           *Name;
+    UINT8            *Header;
+    UINTN             Size;
+    UINTN             i;
+
+    if ((Volume == NULL) || (Volume->RootDir == NULL) || (FileName == NULL)) {
+        return NULL;
+    }
+
+    // Paths are kept without a leading backslash, as scanning finds them
+    Name = FileName;
+    while (*Name == L'\\') {
+        Name++;
+    }
+
+    for (i = 0; i < LoaderInfoCount; i++) {
+        if ((LoaderInfos[i]->DeviceHandle == Volume->DeviceHandle) &&
+            MyStriCmp (LoaderInfos[i]->FileName, Name)
+        ) {
+            return LoaderInfos[i];
+        }
+    }
+
+    Info = AllocateZeroPool (sizeof (LOADER_INFO));
+    if (Info == NULL) {
+        return NULL;
+    }
+    Info->DeviceHandle = Volume->DeviceHandle;
+    Info->FileName     = StrDuplicate (Name);
+
+    LEAKABLEEXTERNALSTART ("GetLoaderInfo Open");
+    Status = REFIT_CALL_5_WRAPPER(
+        Volume->RootDir->Open, Volume->RootDir,
+        &FileHandle, FileName,
+        EFI_FILE_MODE_READ, 0
+    );
+    LEAKABLEEXTERNALSTOP ();
+
+    if (!EFI_ERROR(Status)) {
+        Info->Exists = TRUE;
+
+        FileInfo = LibFileInfo (FileHandle);
+        if (FileInfo != NULL) {
+            Info->FileSize = FileInfo->FileSize;
+            MY_FREE_POOL(FileInfo);
+        }
+
+        Header = AllocatePool (LOADER_PROBE_HEADER_SIZE);
+        if (Header != NULL) {
+            Size   = LOADER_PROBE_HEADER_SIZE;
+            Status = REFIT_CALL_3_WRAPPER(FileHandle->Read, FileHandle, &Size, Header);
+            if (!EFI_ERROR(Status)) {
+                // IsValidLoaderHeader expects exactly the first 512 bytes
+                Info->IsValid = IsValidLoaderHeader ((CHAR8 *) Header, (Size >= 512) ? 512 : Size);
+                if (Info->IsValid) {
+                    ProbePeImage (FileHandle, Header, Size, Info);
+                }
+            }
+            MY_FREE_POOL(Header);
+        }
+
+        REFIT_CALL_1_WRAPPER(FileHandle->Close, FileHandle);
+    }
+
+    #if REFIT_DEBUG > 0
+    if (Info->IsUki) {
+        LOG(3, LOG_THREE_STAR_MID,
+            L"Unified Kernel Image:- '%s' ... Kernel '%s' ... Signed:- '%s'",
+            Info->OsRelName ? Info->OsRelName : L"Unknown OS",
+            Info->Uname     ? Info->Uname     : L"Unknown",
+            Info->IsSigned  ? L"Yes" : L"No"
+        );
+    }
+    #endif
+
+    AddListElement ((VOID ***) &LoaderInfos, &LoaderInfoCount, Info);
+
+    return Info;
+} // LOADER_INFO * GetLoaderInfo()
+
+static
+VOID FreeLoaderInfo (
+    IN LOADER_INFO *Info
+) {
+    MY_FREE_POOL(Info->FileName);
+    MY_FREE_POOL(Info->OsRelName);
+    MY_FREE_POOL(Info->Uname);
+    MY_FREE_POOL(Info);
+} // static VOID FreeLoaderInfo()
+
+// Drops the kept loader details for one device handle, as when its media
+// has been replaced or changed since the details were read.
+VOID ForgetVolumeLoaderInfo (
+    IN EFI_HANDLE DeviceHandle
+) {
+    UINTN i, Count;
+
+    Count = 0;
+    for (i = 0; i < LoaderInfoCount; i++) {
+        if (LoaderInfos[i]->DeviceHandle == DeviceHandle) {
+            FreeLoaderInfo (LoaderInfos[i]);
+        }
+        else {
+            LoaderInfos[Count++] = LoaderInfos[i];
+        }
+    }
+    LoaderInfoCount = Count;
+} // VOID ForgetVolumeLoaderInfo()
+
+// Drops the kept loader details, as after running a tool that may have
+// changed files on any volume.
+VOID ForgetLoaderInfo (VOID) {
+    UINTN i;
+
+    for (i = 0; i < LoaderInfoCount; i++) {
+        FreeLoaderInfo (LoaderInfos[i]);
+    }
+
+    MY_FREE_POOL(LoaderInfos);
+    LoaderInfoCount = 0;
+} // VOID ForgetLoaderInfo()
+
 // Returns TRUE if this file is a valid EFI loader file, and is proper ARCH
 BOOLEAN IsValidLoader (
-    EFI_FILE *RootDir,
-    CHAR16   *FileName
+    IN REFIT_VOLUME *Volume,
+    IN CHAR16       *FileName
 ) {
-    BOOLEAN IsValid;
+    LOADER_INFO *Info;
 
-#if defined (EFIX64) | defined (EFI32) | defined (EFIAARCH64)
-    EFI_STATUS      Status;
-    EFI_FILE_HANDLE FileHandle;
-    CHAR8           Header[512];
-    UINTN           Size = sizeof (Header);
-
-    if ((RootDir == NULL) || (FileName == NULL)) {
+    if ((Volume == NULL) || (Volume->RootDir == NULL) || (FileName == NULL)) {
         // Assume valid here, because Macs produce NULL RootDir (& maybe FileName)
         // when launching from a Firewire drive. This should be handled better, but
         // fix would have to be in StartEFIImage() and/or in FindVolumeAndFilename().
@@ -170,61 +576,28 @@ BOOLEAN IsValidLoader (
 
         return TRUE;
     }
-    else if (!FileExists (RootDir, FileName)) {
-        #if REFIT_DEBUG > 0
-        LOG(3, LOG_THREE_STAR_MID,
-            L"EFI File *NOT* Found:- '%s'",
-            FileName ? FileName : L"NULL"
-        );
-        #endif
-
-        // Early return if file does not exist
-        return FALSE;
-    }
 
-    LEAKABLEEXTERNALSTART ("IsValidLoader Open");
-    Status = REFIT_CALL_5_WRAPPER(
-        RootDir->Open, RootDir,
-        &FileHandle, FileName,
-        EFI_FILE_MODE_READ, 0
-    );
-    LEAKABLEEXTERNALSTOP ();
-
-    if (EFI_ERROR(Status)) {
+    Info = GetLoaderInfo (Volume, FileName);
+    if ((Info == NULL) || !Info->Exists) {
         #if REFIT_DEBUG > 0
         LOG(3, LOG_THREE_STAR_MID,
-            L"EFI File is *NOT* Valid:- '%s'",
-            FileName ? FileName : L"NULL"
+            L"EFI File *NOT* Found:- '%s'",
+            FileName
         );
         #endif
 
         return FALSE;
     }
 
-    Status = REFIT_CALL_3_WRAPPER(FileHandle->Read, FileHandle, &Size, Header);
-    REFIT_CALL_1_WRAPPER(FileHandle->Close, FileHandle);
-
-    IsValid = !EFI_ERROR(Status) &&
-              Size == sizeof (Header) &&
-              ((Header[0] == 'M' && Header[1] == 'Z' &&
-               (Size = *(UINT32 *) &Header[0x3c]) < 0x180 &&
-               Header[Size] == 'P' && Header[Size+1] == 'E' &&
-               Header[Size+2] == 0 && Header[Size+3] == 0 &&
-               *(UINT16 *) &Header[Size+4] == EFI_STUB_ARCH) ||
-              (*(UINT32 *) &Header == FAT_ARCH));
-
     #if REFIT_DEBUG > 0
     LOG(3, LOG_THREE_STAR_MID,
         L"EFI File is %s:- '%s'",
-        IsValid  ? L"Valid" : L"*NOT* Valid",
-        FileName ? FileName : L"NULL"
+        Info->IsValid ? L"Valid" : L"*NOT* Valid",
+        FileName
     );
     #endif
-#else
-    IsValid = TRUE;
-#endif
 
-    return IsValid;
+    return Info->IsValid;
 } // BOOLEAN IsValidLoader()
 
 // Launch an EFI binary.
@@ -292,7 +665,7 @@ EFI_STATUS StartEFIImage (
     // Some EFIs crash if attempting to load driver for invalid architecture, so
     // protect for this condition; but sometimes Volume comes back NULL, so provide
     // an exception. (TODO: Handle this special condition better.)
-    if (IsValidLoader (Volume->RootDir, Filename)) {
+    if (IsValidLoader (Volume, Filename)) {
         // Store loader name if booting and set to do so
         if (IsBoot && BootSelection) {
             StoreLoaderName (BootSelection);
@@ -485,6 +858,7 @@ EFI_STATUS StartEFIImage (
 
     LOGBLOCKENTRY("StartImage '%s'", ImageTitle);
     BootLogPause();
+    BootLogClose();
     LEAKABLEEXTERNALSTART (kLeakableWhatStartEFIImageStartImage);
     Status = REFIT_CALL_3_WRAPPER(
         gBS->StartImage, ChildImageHandle,
@@ -514,6 +888,12 @@ EFI_STATUS StartEFIImage (
 
     CheckError (ReturnStatus, MsgStr);
 
+    if (!IsDriver) {
+        // The child image may have written to any volume
+        ForgetVolumeHandles();
+        ForgetScannedVolumes();
+    }
+
     if (IsDriver) {
         // Below should have no effect on most systems, but works
         // around bug with some EFIs that prevents filesystem drivers
@@ -583,6 +963,7 @@ EFI_STATUS RebootIntoFirmware (VOID) {
 
     UninitRefitLib();
     BootLogPause();
+    BootLogClose();
 
     REFIT_CALL_4_WRAPPER(
         gRT->ResetSystem,
@@ -661,6 +1042,8 @@ VOID RebootIntoLoader (
 
     StoreLoaderName(GetPoolStr (&Entry->me.Title));
 
+    BootLogFlush();
+
     REFIT_CALL_4_WRAPPER(
         gRT->ResetSystem, EfiResetCold,
         EFI_SUCCESS, 0, NULL
@@ -713,8 +1096,9 @@ VOID StartLoader (
     LOADER_ENTRY *Entry,
     CHAR16       *SelectionName
 ) {
-    CHAR16 *MsgStr     = NULL;
-    CHAR16 *LoaderPath = NULL;
+    EFI_STATUS  Status;
+    CHAR16     *MsgStr     = NULL;
+    CHAR16     *LoaderPath = NULL;
 
     BootSelection = SelectionName;
     LoaderPath    = Basename (GetPoolStr (&Entry->LoaderPath));
@@ -732,7 +1116,7 @@ VOID StartLoader (
     }
 
     BeginExternalScreen (Entry->UseGraphicsMode, MsgStr);
-    StartEFIImage (
+    Status = StartEFIImage (
         Entry->Volume,
         GetPoolStr (&Entry->LoaderPath),
         GetPoolStr (&Entry->LoadOptions),
@@ -742,6 +1126,16 @@ VOID StartLoader (
         FALSE
     );
 
+    // Loaders may come from the loader cache without being checked at
+    // boot ... Make the next boot scan again if this one has gone
+    if (EFI_ERROR(Status) &&
+        Entry->DiscoveryType == DISCOVERY_TYPE_AUTO &&
+        Entry->Volume != NULL &&
+        !FileExists (Entry->Volume->RootDir, GetPoolStr (&Entry->LoaderPath))
+    ) {
+        ScanCacheInvalidate();
+    }
+
     MY_FREE_POOL(MsgStr);
     MY_FREE_POOL(LoaderPath);
 } // VOID StartLoader()
@@ -61,6 +61,22 @@
 #define EFI_OS_INDICATIONS_BOOT_TO_FW_UI 0x0000000000000001ULL
 #endif
 
+// What one read of a loader's DOS, PE and section headers found
+typedef struct {
+    EFI_HANDLE    DeviceHandle;
+    CHAR16       *FileName;
+    BOOLEAN       Exists;
+    BOOLEAN       IsValid;      // An EFI image for this ARCH or an Apple fat binary
+    UINT64        FileSize;
+    UINT16        Machine;
+    UINT16        Subsystem;
+    BOOLEAN       IsSigned;     // Has an Authenticode certificate table
+    BOOLEAN       IsUki;        // Has a '.linux' section
+    BOOLEAN       HasCmdline;   // Has a '.cmdline' section
+    CHAR16       *OsRelName;    // PRETTY_NAME, else NAME, from the '.osrel' section
+    CHAR16       *Uname;        // Kernel release from the '.uname' section
+} LOADER_INFO;
+
 EFI_STATUS StartEFIImage(IN REFIT_VOLUME *Volume,
                          IN CHAR16 *Filename,
                          IN CHAR16 *LoadOptions,
@@ -68,7 +84,11 @@ EFI_STATUS StartEFIImage(IN REFIT_VOLUME *Volume,
                          IN CHAR8 OSType,
                          IN BOOLEAN Verbose,
                          IN BOOLEAN IsDriver);
-BOOLEAN IsValidLoader(EFI_FILE *RootDir, CHAR16 *FileName);
+BOOLEAN IsValidLoader(IN REFIT_VOLUME *Volume, IN CHAR16 *FileName);
+LOADER_INFO * GetLoaderInfo(IN REFIT_VOLUME *Volume, IN CHAR16 *FileName);
+VOID ForgetVolumeLoaderInfo(IN EFI_HANDLE DeviceHandle);
+VOID ForgetLoaderInfo(VOID);
+BOOLEAN IsValidLoaderHeader(IN CHAR8 *Header, IN UINTN Size);
 EFI_STATUS RebootIntoFirmware(VOID);
 VOID StartLoader(LOADER_ENTRY *Entry, CHAR16 *SelectionName);
 VOID StartTool(IN LOADER_ENTRY *Entry);
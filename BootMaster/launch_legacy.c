@@ -57,6 +57,7 @@
 #include "screenmgt.h"
 #include "../include/syslinux_mbr.h"
 #include "mystrings.h"
+#include "volume_index.h"
 #include "../EfiLib/BdsHelper.h"
 #include "../EfiLib/legacy.h"
 #include "../include/Handle.h"
@@ -512,6 +513,7 @@ EFI_STATUS StartLegacyImageList (
 
     UninitRefitLib();
     BootLogPause();
+    BootLogClose();
 
     Status = REFIT_CALL_3_WRAPPER(
         gBS->StartImage,
@@ -679,6 +681,7 @@ VOID StartLegacyUEFI (
     LOGBLOCKEXIT("BdsLibConnectDevicePath");
     LOGBLOCKENTRY("BdsLibDoLegacyBoot");
     BootLogPause();
+    BootLogClose();
     BdsLibDoLegacyBoot (Entry->BdsOption);
     LOGBLOCKEXIT("BdsLibDoLegacyBoot");
 
@@ -763,7 +766,7 @@ VOID AddLegacyEntry (
     AssignPoolStr (&Entry->me.Title, LegacyTitle);
     Entry->me.SubScreen      = NULL; // Initial Setting
     Entry->me.ShortcutLetter = ShortcutLetter;
-    AssignPoolImage (&Entry->me.Image, LoadOSIcon (GetPoolStr (&Volume->OSIconName), L"legacy", FALSE));
+    AssignCachedPoolImage (&Entry->me.Image, LoadOSIcon (GetPoolStr (&Volume->OSIconName), L"legacy", FALSE));
     AssignVolume (&Entry->Volume, Volume);
     CopyFromPoolImage (&Entry->me.BadgeImage, &Volume->VolBadgeImage);
     AssignCachedPoolStr (&Entry->LoadOptions, (Volume->DiskKind == DISK_KIND_OPTICAL)
@@ -857,7 +860,7 @@ VOID AddLegacyEntryUEFI (
     Entry->me.Tag            = TAG_LEGACY_UEFI;
 //  Entry->me.SubScreen      = NULL; // Initial Setting
     Entry->me.ShortcutLetter = ShortcutLetter;
-    AssignPoolImage (&Entry->me.Image, LoadOSIcon (L"legacy", L"legacy", TRUE));
+    AssignCachedPoolImage (&Entry->me.Image, LoadOSIcon (L"legacy", L"legacy", TRUE));
     AssignCachedPoolStr (&Entry->LoadOptions, (DiskType == BBS_CDROM)
         ? L"CD"
         : ((DiskType == BBS_USB)
@@ -1060,6 +1063,7 @@ VOID ScanLegacyVolume (
             (StrLen (GetPoolStr (&Volume->VolName)) == 0)
         ) {
             AssignPoolStr (&Volume->VolName, GetVolumeName (Volume));
+            VolumeIndexInvalidate();
         }
 
         AddLegacyEntry (NULL, Volume);
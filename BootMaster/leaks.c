@@ -291,9 +291,23 @@ typedef enum {
     kAllocFlagExternal = 1
 } AllocFlags;
 
+// Identical call stacks are stored once and shared by every allocation made
+// from them. Each record also totals the live allocations made from its stack
+// so that DumpAllocations can report them by call site without a rescan.
+typedef struct CallStackRecord CallStackRecord;
+struct CallStackRecord {
+    CallStackRecord* Next;       // Next record in the same hash bucket.
+    UINTN Hash;                  // Hash of the IP addresses of the frames.
+    UINTN Length;                // Number of frames before the terminating zero IP address.
+    UINTN RefCount;              // Number of allocations holding this record.
+    UINTN LiveCount;             // Number of live allocations made from this call stack.
+    UINTN LiveBytes;             // Total size of those allocations.
+    StackFrame *Frames;          // The first call stack seen with these IP addresses.
+};
+
 typedef struct Allocation Allocation;
 struct Allocation {
-    Allocation* Next;            // Needs to be first element, points to the next allocation.
+    Allocation* Next;            // Points to the next allocation in FreeAllocations.
     VOID *Where;                 // Address in pool.
     UINTN Size;                  // Size of allocation (should be less than pool size).
     UINTN Num;                   // When it was allocated - it is a number that increases with each allocation, not a time stamp (maybe we should use a timestamp)
@@ -301,7 +315,7 @@ struct Allocation {
     UINTN AllocFlags;            // AllocFlags
     const CHAR8 *What;           // A constant string used for allocations that are allowed to leak once (must be a literal - or we could use another enumeration or a string compare (strings need a destructor if pool allocated))
     UINT16 *Path;                // A path describing multiple objects in a list or tree that is allowed to leak once (for the entire list or tree). See LEAKABLEPATH.
-    StackFrame *Stack;           // The callstack when the allocation was created, used to help find the source of leaks.
+    CallStackRecord *Site;       // The callstack when the allocation was created, used to help find the source of leaks.
 };
 
 UINTN StackMin = 0;
@@ -323,6 +337,11 @@ EFI_CONNECT_CONTROLLER OrigConnectController = NULL;
 #define LEAKS_DO_CLEANUP 1
 #define LEAKS_LOG_FREEING 0
 #define LEAKS_LOG_UNALLOCATED 0 // the object is allocated but we didn't keep track of it.
+#define LEAKS_LOG_TRACE 0 // log each tracked allocation and free, for replaying the allocation pattern later.
+
+#define LEAKS_LIVE_TABLE_MIN 1024 // initial number of slots in the live allocation table (a power of two).
+#define LEAKS_STACK_BUCKETS 1024 // number of hash buckets for the call stack records (a power of two).
+#define LEAKS_SITE_REPORT_MAX 16 // number of call sites listed by DumpAllocations.
 
 VOID
 CheckStackPointer () {
@@ -378,7 +397,12 @@ LeaksFreePool (
 }
 
 
-STATIC Allocation* AllocationsList = NULL;
+extern VOID *MyMemSet(VOID *s, int c, UINTN n);
+
+STATIC Allocation** LiveTable = NULL; // open addressing with linear probing, keyed by Where.
+STATIC UINTN LiveTableSize = 0;
+STATIC UINTN LiveTableCount = 0;
+STATIC CallStackRecord* StackBuckets[LEAKS_STACK_BUCKETS];
 STATIC Allocation* FreeAllocations = NULL;
 STATIC INTN DoingAlloc = 0;
 STATIC UINTN NextAllocationNum = 0;
@@ -401,16 +425,233 @@ AllocationTypeString (
 }
 
 
+STATIC
+UINTN
+HashCallStack (
+    StackFrame *Frames,
+    UINTN *Length
+) {
+    UINTN Hash = 2166136261U;
+    UINTN FrameCount;
+    for (FrameCount = 0; Frames[FrameCount].IPAddress; FrameCount++) {
+        Hash = (Hash ^ Frames[FrameCount].IPAddress) * 16777619U;
+    }
+    *Length = FrameCount;
+    return Hash;
+}
+
+
+// Returns the shared record for the call stack in Frames, taking ownership
+// of Frames. Frames is freed when a record with the same IP addresses exists.
+STATIC
+CallStackRecord *
+InternCallStack (
+    StackFrame *Frames
+) {
+    CheckStackPointer ();
+    if (!Frames) {
+        return NULL;
+    }
+
+    UINTN Length;
+    UINTN Hash = HashCallStack (Frames, &Length);
+    UINTN FrameCount;
+    CallStackRecord *r;
+    for (r = StackBuckets[Hash & (LEAKS_STACK_BUCKETS - 1)]; r; r = r->Next) {
+        if (r->Hash != Hash || r->Length != Length) {
+            continue;
+        }
+        for (FrameCount = 0; FrameCount < Length; FrameCount++) {
+            if (r->Frames[FrameCount].IPAddress != Frames[FrameCount].IPAddress) {
+                break;
+            }
+        }
+        if (FrameCount == Length) {
+            r->RefCount++;
+            FreeCallStack (Frames);
+            return r;
+        }
+    }
+
+    r = LeaksAllocatePool (sizeof(CallStackRecord));
+    if (!r) {
+        FreeCallStack (Frames);
+        return NULL;
+    }
+    r->Hash = Hash;
+    r->Length = Length;
+    r->RefCount = 1;
+    r->LiveCount = 0;
+    r->LiveBytes = 0;
+    r->Frames = Frames;
+    r->Next = StackBuckets[Hash & (LEAKS_STACK_BUCKETS - 1)];
+    StackBuckets[Hash & (LEAKS_STACK_BUCKETS - 1)] = r;
+    return r;
+}
+
+
+STATIC
+VOID
+ReleaseCallStack (
+    CallStackRecord *r
+) {
+    CheckStackPointer ();
+    if (!r || --r->RefCount) {
+        return;
+    }
+
+    CallStackRecord **Link = &StackBuckets[r->Hash & (LEAKS_STACK_BUCKETS - 1)];
+    while (*Link && *Link != r) {
+        Link = &(*Link)->Next;
+    }
+    if (*Link) {
+        *Link = r->Next;
+    }
+    FreeCallStack (r->Frames);
+    LeaksFreePool ((VOID **) &r);
+}
+
+
+STATIC
+UINTN
+LiveTableHome (
+    VOID *Where
+) {
+    // Pool buffers are at least 8 byte aligned.
+    UINTN Hash = (UINTN) Where >> 3;
+    Hash ^= Hash >> 11;
+    return Hash & (LiveTableSize - 1);
+}
+
+
+// Returns the slot holding Where, or the empty slot where it would go.
+STATIC
+UINTN
+FindLiveSlot (
+    VOID *Where
+) {
+    UINTN Slot = LiveTableHome (Where);
+    while (LiveTable[Slot] && LiveTable[Slot]->Where != Where) {
+        Slot = (Slot + 1) & (LiveTableSize - 1);
+    }
+    return Slot;
+}
+
+
+STATIC
+Allocation *
+FindAllocation (
+    VOID *Where
+) {
+    CheckStackPointer ();
+    if (!LiveTable) {
+        return NULL;
+    }
+    return LiveTable[FindLiveSlot (Where)];
+}
+
+
+STATIC
+BOOLEAN
+GrowLiveTable () {
+    CheckStackPointer ();
+    UINTN NewSize = LiveTableSize ? LiveTableSize * 2 : LEAKS_LIVE_TABLE_MIN;
+    Allocation **NewTable = LeaksAllocatePool (NewSize * sizeof(*NewTable));
+    if (!NewTable) {
+        return FALSE;
+    }
+    MyMemSet (NewTable, 0, NewSize * sizeof(*NewTable));
+
+    Allocation **OldTable = LiveTable;
+    UINTN OldSize = LiveTableSize;
+    LiveTable = NewTable;
+    LiveTableSize = NewSize;
+
+    UINTN Slot;
+    for (Slot = 0; Slot < OldSize; Slot++) {
+        if (OldTable[Slot]) {
+            LiveTable[FindLiveSlot (OldTable[Slot]->Where)] = OldTable[Slot];
+        }
+    }
+    if (OldTable) {
+        LeaksFreePool ((VOID **) &OldTable);
+    }
+    return TRUE;
+}
+
+
+STATIC
+BOOLEAN
+InsertAllocation (
+    Allocation *a
+) {
+    CheckStackPointer ();
+    // Keep the table at most half full so probe sequences stay short.
+    if ((LiveTableCount + 1) * 2 > LiveTableSize && !GrowLiveTable ()) {
+        if (LiveTableCount + 1 >= LiveTableSize) {
+            return FALSE;
+        }
+    }
+
+    LiveTable[FindLiveSlot (a->Where)] = a;
+    LiveTableCount++;
+    if (a->Site) {
+        a->Site->LiveCount++;
+        a->Site->LiveBytes += a->Size;
+    }
+    return TRUE;
+}
+
+
+STATIC
+VOID
+RemoveAllocation (
+    Allocation *a
+) {
+    CheckStackPointer ();
+    if (!LiveTable) {
+        return;
+    }
+
+    UINTN Mask = LiveTableSize - 1;
+    UINTN Hole = FindLiveSlot (a->Where);
+    if (LiveTable[Hole] != a) {
+        return;
+    }
+    LiveTable[Hole] = NULL;
+    LiveTableCount--;
+    if (a->Site) {
+        a->Site->LiveCount--;
+        a->Site->LiveBytes -= a->Size;
+    }
+
+    // Shift back any later entries in the probe run that can no longer be
+    // reached from their home slot, so that no tombstones are needed.
+    UINTN Slot = (Hole + 1) & Mask;
+    while (LiveTable[Slot]) {
+        UINTN Home = LiveTableHome (LiveTable[Slot]->Where);
+        if ((Slot > Hole && (Home <= Hole || Home > Slot))
+            || (Slot < Hole && (Home <= Hole && Home > Slot))
+        ) {
+            LiveTable[Hole] = LiveTable[Slot];
+            LiveTable[Slot] = NULL;
+            Hole = Slot;
+        }
+        Slot = (Slot + 1) & Mask;
+    }
+}
+
+
 STATIC
 VOID
 CleanAllocation (
     Allocation *a
 ) {
-    if (a->Stack) {
+    if (a->Site) {
         #if LEAKS_DO_CLEANUP
-        FreeCallStack (a->Stack);
+        ReleaseCallStack (a->Site);
         #endif
-        a->Stack = NULL;
+        a->Site = NULL;
     }
     if (a->Path) {
         #if LEAKS_DO_CLEANUP
@@ -432,17 +673,6 @@ AddFreeAllocation (
 }
 
 
-STATIC
-VOID
-RemoveAllocation (
-    Allocation *prev,
-    Allocation *a
-) {
-    CheckStackPointer ();
-    prev->Next = a->Next;
-}
-
-
 STATIC
 VOID
 GetStackLimits (
@@ -918,52 +1148,46 @@ AddAllocation(
         return;
     }
 
-    Allocation *prev = (Allocation *)&AllocationsList;
-    Allocation *a = AllocationsList;
-    while (a) {
-        if (a->Where == Buffer) {
-            if (
-                (
-                    a->Size == Size
-                    // Ignore size for kAllocationTypeFindLoadedImageFileName because we
-                    // don't know the allocation size for that type in all cases.
-                    || Type == kAllocationTypeFindLoadedImageFileName
-                )
-                && Type != kAllocationTypeAllocatePool
-                && a->Type == kAllocationTypeAllocatePool
-            ) {
-                // If the size is also the same and the previous type was kAllocationTypeAllocatePool
-                // and the new type is not, then we just want to change the type.
-                a->Type = Type;
-                return;
+    Allocation *a = FindAllocation (Buffer);
+    if (a) {
+        if (
+            (
+                a->Size == Size
+                // Ignore size for kAllocationTypeFindLoadedImageFileName because we
+                // don't know the allocation size for that type in all cases.
+                || Type == kAllocationTypeFindLoadedImageFileName
+            )
+            && Type != kAllocationTypeAllocatePool
+            && a->Type == kAllocationTypeAllocatePool
+        ) {
+            // If the size is also the same and the previous type was kAllocationTypeAllocatePool
+            // and the new type is not, then we just want to change the type.
+            a->Type = Type;
+            return;
+        }
+        else {
+            RemoveAllocation (a);
+
+            // if the previous type was not kAllocationTypeAllocatePool but the new type is,
+            // then it probably means we missed a free so don't report it.
+            BOOLEAN reportit = !(Type == kAllocationTypeAllocatePool && a->Type != kAllocationTypeAllocatePool);
+            if (reportit) {
+                MsgLog ("Allocation Error: already allocated %p (%d) (was %d) Type:%s (was %s)\n",
+                    Buffer, Size, a->Size, AllocationTypeString (Type), AllocationTypeString (a->Type)
+                );
             }
-            else {
-                RemoveAllocation (prev, a);
-
-                // if the previous type was not kAllocationTypeAllocatePool but the new type is,
-                // then it probably means we missed a free so don't report it.
-                BOOLEAN reportit = !(Type == kAllocationTypeAllocatePool && a->Type != kAllocationTypeAllocatePool);
-                if (reportit) {
-                    MsgLog ("Allocation Error: already allocated %p (%d) (was %d) Type:%s (was %s)\n",
-                        Buffer, Size, a->Size, AllocationTypeString (Type), AllocationTypeString (a->Type)
-                    );
-                }
-                StackFrame *PrevousStack = a->Stack;
-                a->Stack = NULL;
-                AddFreeAllocation (a);
-                if (reportit) {
-                    DumpCallStack (NULL, FALSE);
-                    MsgLog ("Previous:\n");
-                    if (PrevousStack) DumpCallStack (PrevousStack, FALSE);
-                }
-                #if LEAKS_DO_CLEANUP
-                FreeCallStack (PrevousStack);
-                #endif
+            CallStackRecord *PrevousSite = a->Site;
+            a->Site = NULL;
+            AddFreeAllocation (a);
+            if (reportit) {
+                DumpCallStack (NULL, FALSE);
+                MsgLog ("Previous:\n");
+                if (PrevousSite) DumpCallStack (PrevousSite->Frames, FALSE);
             }
-            break;
+            #if LEAKS_DO_CLEANUP
+            ReleaseCallStack (PrevousSite);
+            #endif
         }
-        prev = a;
-        a = a->Next;
     }
 
     if (FreeAllocations) {
@@ -984,7 +1208,7 @@ AddAllocation(
             a->AllocFlags |= kAllocFlagExternal;
         }
         a->Path = NULL;
-        a->Stack = NULL;
+        a->Site = NULL;
         if (!(a->AllocFlags & kAllocFlagExternal)) {
             if (!DoingAlloc) {
                 DoingAlloc++;
@@ -992,7 +1216,7 @@ AddAllocation(
                 if (STACK_SCAN_TYPE) {
                     LoadedImages = GetLoadedImages ();
                 }
-                a->Stack = GetCallStack (AsmGetStackPointerAddress (), AsmGetCurrentIpAddress (), AsmGetFramePointerAddress (), STACK_SCAN_TYPE, LoadedImages);
+                a->Site = InternCallStack (GetCallStack (AsmGetStackPointerAddress (), AsmGetCurrentIpAddress (), AsmGetFramePointerAddress (), STACK_SCAN_TYPE, LoadedImages));
                 if (STACK_SCAN_TYPE) {
                     FreeLoadedImages (LoadedImages);
                 }
@@ -1000,14 +1224,19 @@ AddAllocation(
             }
         }
 
-        a->Next = AllocationsList;
-        AllocationsList = a;
+        if (!InsertAllocation (a)) {
+            MsgLog ("Allocation Error: cannot track %p (%d)\n", Buffer, Size);
+            AddFreeAllocation (a);
+        }
+        #if LEAKS_LOG_TRACE
+        else {
+            MsgLog ("Trace: A %p %d\n", Buffer, Size);
+        }
+        #endif
     }
 }
 
 
-extern VOID *MyMemSet(VOID *s, int c, UINTN n);
-
 
 STATIC
 LoadedImageRec *
@@ -1290,6 +1519,49 @@ BOOLEAN LeakablePathsAreEqual (
     );
 }
 
+// Lists the call sites holding the most live bytes, from the totals kept
+// in each call stack record.
+STATIC
+VOID
+DumpAllocationSites (
+    LoadedImageRec *LoadedImages
+) {
+    CheckStackPointer ();
+    CallStackRecord *Top[LEAKS_SITE_REPORT_MAX];
+    UINTN TopCount = 0;
+    UINTN Bucket;
+    UINTN Index;
+    CallStackRecord *r;
+
+    for (Bucket = 0; Bucket < LEAKS_STACK_BUCKETS; Bucket++) {
+        for (r = StackBuckets[Bucket]; r; r = r->Next) {
+            if (!r->LiveCount) {
+                continue;
+            }
+            // Insertion into the list sorted by LiveBytes, largest first.
+            Index = TopCount < LEAKS_SITE_REPORT_MAX ? TopCount++ : LEAKS_SITE_REPORT_MAX;
+            while (Index > 0 && Top[Index - 1]->LiveBytes < r->LiveBytes) {
+                if (Index < LEAKS_SITE_REPORT_MAX) {
+                    Top[Index] = Top[Index - 1];
+                }
+                Index--;
+            }
+            if (Index < LEAKS_SITE_REPORT_MAX) {
+                Top[Index] = r;
+            }
+        }
+    }
+
+    if (TopCount) {
+        MsgLog ("Call Sites:\n");
+    }
+    for (Index = 0; Index < TopCount; Index++) {
+        MsgLog ("  %d allocations totalling %d bytes from:\n", Top[Index]->LiveCount, Top[Index]->LiveBytes);
+        DumpOneCallStack (Top[Index]->Frames, LoadedImages);
+    }
+}
+
+
 VOID
 DumpAllocations (
     UINTN MinAllocationNum,
@@ -1320,15 +1592,21 @@ DumpAllocations (
     }
 
     LoadedImageRec *LoadedImages = GetLoadedImages ();
-    Allocation *a = AllocationsList;
-    while (a) {
+    Allocation *a;
+    UINTN Slot;
+    for (Slot = 0; Slot < LiveTableSize; Slot++) {
+        a = LiveTable[Slot];
+        if (!a) {
+            continue;
+        }
+
         TypeIndex = 0;
-        StackLength = GetCallStackLength (a->Stack);
+        StackLength = a->Site ? a->Site->Length : 0;
 
         if (a->Num < MinAllocationNum || a->Num >= MaxAllocationNum) {
             TypeIndex |= atExcludedRange;
         }
-        if (a->Stack && StackLength < MinStackLength) {
+        if (a->Site && StackLength < MinStackLength) {
             TypeIndex |= atExcludedStackSize;
         }
         if (a->AllocFlags & kAllocFlagExternal) {
@@ -1338,16 +1616,17 @@ DumpAllocations (
             TypeIndex |= atTypeLeakable;
             TypeIndex |= atExcludedLeakable;
             // Report leakable allocation only if there is another occurrence.
-            Allocation *b = AllocationsList;
-            while (b) {
+            Allocation *b;
+            UINTN OtherSlot;
+            for (OtherSlot = 0; OtherSlot < LiveTableSize; OtherSlot++) {
+                b = LiveTable[OtherSlot];
                 // Report if the items are different but have the same What.
-                if (b != a && LeakablePathsAreEqual (a->What, b->What, a->Path, b->Path, TRUE)) {
+                if (b && b != a && LeakablePathsAreEqual (a->What, b->What, a->Path, b->Path, TRUE)) {
                     // Report if neither doesn't have a path or the paths are the same.
                     // Basically, only one item is allowed to have a What and Path combination, otherwise it's a leak.
                     TypeIndex &= ~atExcludedLeakable;
                     break;
                 }
-                b = b->Next;
             }
         }
 
@@ -1372,16 +1651,14 @@ DumpAllocations (
                 DumpLeakablePath (a->Path);
             }
             MsgLog ("\n");
-            DumpOneCallStack (a->Stack, LoadedImages);
+            DumpOneCallStack (a->Site ? a->Site->Frames : NULL, LoadedImages);
         }
 
         if (AllocTypes) {
             AllocTypes[TypeIndex]++;
         }
         TotalAllocs++;
-
-        a = a->Next;
-    } // while
+    } // for
 
     if (AllocTypes) {
         BOOLEAN CountsTitle = TRUE;
@@ -1408,6 +1685,7 @@ DumpAllocations (
     if (TotalAllocs > 0) {
         MsgLog ("  %5d:, Total\n", TotalAllocs);
     }
+    DumpAllocationSites (LoadedImages);
     DumpLoadedImages (LoadedImages);
     FreeLoadedImages (LoadedImages);
 
@@ -1477,15 +1755,12 @@ FreePoolEx (
 
     //LOGPROCENTRY("%p", Buffer);
     if (Buffer) {
-        Allocation *prev = (Allocation *)&AllocationsList;
-        a = AllocationsList;
-        while (a && a->Where != Buffer) {
-            prev = a;
-            a = a->Next;
-        }
-
+        a = FindAllocation (Buffer);
         if (a) {
-            RemoveAllocation (prev, a);
+            RemoveAllocation (a);
+            #if LEAKS_LOG_TRACE
+            MsgLog ("Trace: F %p\n", Buffer);
+            #endif
         }
 
         size = LogPoolProc(Buffer, &Buffer, "Buffer", &Type, (VOID **)&head, (VOID **)&tail, __FILE__, __LINE__, FALSE, FALSE);
@@ -1594,9 +1869,9 @@ FreePoolEx (
         }
         DumpCallStack (NULL, FALSE);
         if (a) {
-            if (a->Stack) {
+            if (a->Site) {
                 MsgLog ("Stack when allocation %p (%d) was created:\n", a->Where, a->Size);
-                DumpCallStack (a->Stack, FALSE);
+                DumpCallStack (a->Site->Frames, FALSE);
             }
             else {
                 MsgLog ("No stack recorded when allocation %p (%d) was created.\n", a->Where, a->Size);
@@ -1809,23 +2084,19 @@ LEAKABLEPATHSET (
 
     if (Buffer) {
         LOGPOOL(Buffer);
-        Allocation *a = AllocationsList;
-        while (a) {
-            if (a->Where == Buffer) {
-                if (a->Path) {
-                    UINTN LeakablePathSize = (a->Path[0]+1) * sizeof(a->Path[0]);
-                    CopyMem (LEAKABLEPATH, a->Path, LeakablePathSize);
-                    LEAKABLEROOTOBJECTID = LEAKABLEPATH[1];
-                }
-                else {
-                    MsgLog ("Allocation Error: %p doesn't have a path\n", Buffer);
-                    DumpCallStack (NULL, FALSE);
-                }
-                break;
+        Allocation *a = FindAllocation (Buffer);
+        if (a) {
+            if (a->Path) {
+                UINTN LeakablePathSize = (a->Path[0]+1) * sizeof(a->Path[0]);
+                CopyMem (LEAKABLEPATH, a->Path, LeakablePathSize);
+                LEAKABLEROOTOBJECTID = LEAKABLEPATH[1];
+            }
+            else {
+                MsgLog ("Allocation Error: %p doesn't have a path\n", Buffer);
+                DumpCallStack (NULL, FALSE);
             }
-            a = a->Next;
         }
-        if (!a) {
+        else {
            MsgLog ("Allocation Error: %p doesn't have allocation information\n", Buffer);
         }
     }
@@ -1885,32 +2156,28 @@ LeakableProc (
 
     if (Buffer) {
         LOGPOOL(Buffer);
-        Allocation *a = AllocationsList;
-        while (a) {
-            if (a->Where == Buffer) {
-                if (a->What && !LeakablePathsAreEqual (a->What, What, a->Path, LEAKABLEPATH, FALSE)) {
-                    MsgLog ("Allocation Error: %p (%d) already marked leakable:%a (Was:%a)\n", a->Where, a->Size, What, a->What);
-                    MsgLog ("  Old Path:");
-                    DumpLeakablePath (a->Path);
-                    MsgLog ("\n");
-                    MsgLog ("  New Path:");
-                    DumpLeakablePath (LEAKABLEPATH);
-                    MsgLog ("\n");
-                }
-                a->What = What;
+        Allocation *a = FindAllocation (Buffer);
+        if (a) {
+            if (a->What && !LeakablePathsAreEqual (a->What, What, a->Path, LEAKABLEPATH, FALSE)) {
+                MsgLog ("Allocation Error: %p (%d) already marked leakable:%a (Was:%a)\n", a->Where, a->Size, What, a->What);
+                MsgLog ("  Old Path:");
+                DumpLeakablePath (a->Path);
+                MsgLog ("\n");
+                MsgLog ("  New Path:");
+                DumpLeakablePath (LEAKABLEPATH);
+                MsgLog ("\n");
+            }
+            a->What = What;
+            if (a->Path) {
+                LeaksFreePool ((VOID **) &a->Path);
+            }
+            if (IncludePath) {
+                UINTN LeakablePathSize = (LEAKABLEPATH[0]+1) * sizeof(LEAKABLEPATH[0]);
+                a->Path = LeaksAllocatePool (LeakablePathSize);
                 if (a->Path) {
-                    LeaksFreePool ((VOID **) &a->Path);
+                    CopyMem (a->Path, LEAKABLEPATH, LeakablePathSize);
                 }
-                if (IncludePath) {
-                    UINTN LeakablePathSize = (LEAKABLEPATH[0]+1) * sizeof(LEAKABLEPATH[0]);
-                    a->Path = LeaksAllocatePool (LeakablePathSize);
-                    if (a->Path) {
-                        CopyMem (a->Path, LEAKABLEPATH, LeakablePathSize);
-                    }
-                }
-                break;
             }
-            a = a->Next;
         }
     }
 }
@@ -58,6 +58,10 @@
 #include "apple.h"
 #include "mystrings.h"
 #include "leaks.h"
+#include "profile.h"
+#include "sha256.h"
+#include "volume_index.h"
+#include "launch_efi.h"
 
 #ifdef __MAKEWITH_GNUEFI
 #define EfiReallocatePool ReallocatePool
@@ -65,6 +69,8 @@
 #define LibLocateHandle gBS->LocateHandleBuffer
 #define DevicePathProtocol gEfiDevicePathProtocolGuid
 #define BlockIoProtocol gEfiBlockIoProtocolGuid
+#define BlockIo2Protocol gEfiBlockIo2ProtocolGuid
+#define FileSystemProtocol gEfiSimpleFileSystemProtocolGuid
 #define LibFileSystemInfo EfiLibFileSystemInfo
 #define LibOpenRoot EfiLibOpenRoot
 EFI_DEVICE_PATH EndDevicePath[] = {
@@ -72,11 +78,11 @@ EFI_DEVICE_PATH EndDevicePath[] = {
 };
 #endif
 
-// "Magic" signatures for various filesystems
-#define FAT_MAGIC                        0xAA55
-#define EXT2_SUPER_MAGIC                 0xEF53
-#define HFSPLUS_MAGIC1                   0x2B48
-#define HFSPLUS_MAGIC2                   0x5848
+// "Magic" signatures for various filesystems, as stored on disk
+#define FAT_MAGIC                        "\x55\xAA"   /* 0xAA55 */
+#define EXT2_SUPER_MAGIC                 "\x53\xEF"   /* 0xEF53 */
+#define HFSPLUS_MAGIC1                   "\x48\x2B"   /* 0x2B48 */
+#define HFSPLUS_MAGIC2                   "\x48\x58"   /* 0x5848 */
 #define REISERFS_SUPER_MAGIC_STRING      "ReIsErFs"
 #define REISER2FS_SUPER_MAGIC_STRING     "ReIsEr2Fs"
 #define REISER2FS_JR_SUPER_MAGIC_STRING  "ReIsEr3Fs"
@@ -352,6 +358,8 @@ VOID UninitVolume (
         (*Volume)->DeviceHandle = NULL;
         (*Volume)->BlockIO = NULL;
         (*Volume)->WholeDiskBlockIO = NULL;
+
+        VolumeIndexInvalidate();
     }
 } // static VOID UninitVolume()
 
@@ -393,6 +401,7 @@ VOID ReinitVolume (
                     MsgLog ("Volume '%s' device handle changed %p -> %p\n", GetPoolStr (&Volume->VolName), Volume->OldDeviceHandle, DeviceHandle);
                 }
                 Volume->DeviceHandle = DeviceHandle;
+                VolumeIndexInvalidate();
 
                 // get the root directory
                 Volume->RootDir = LibOpenRoot (Volume->DeviceHandle);
@@ -914,6 +923,8 @@ VOID FreeVolumes (
         LOGPROCENTRY("%p->%p[%d]", ListVolumes, *ListVolumes, ListCount ? *ListCount : -1);
         UINTN i;
 
+        VolumeIndexForget (*ListVolumes);
+
         if (ListCount && *ListCount) {
             for (i = 0; i < *ListCount; i++) {
                 FreeVolume (&(*ListVolumes)[i]);
@@ -1067,38 +1078,161 @@ VOID SetFilesystemName (
     MY_FREE_POOL(FileSystemInfoPtr);
 } // VOID *SetFilesystemName()
 
+// The start of a volume, read one stage at a time as the signatures being
+// tested need it. A stage is SECTOR_SIZE bytes when that is a whole number
+// of blocks, so most volumes are identified from two or three sectors
+// instead of the full SAMPLE_SIZE. A prefetched sample is already complete.
+typedef struct {
+    REFIT_VOLUME  *Volume;
+    UINT8         *Buffer;       // SAMPLE_SIZE bytes, only loaded stages valid
+    UINTN          StageSize;
+    UINT32         Loaded;       // Bit per stage read
+    UINT32         Failed;       // Bit per stage that could not be read
+} VOLUME_SAMPLE;
+
+// Makes sure that Size bytes at Offset into the sample have been read.
+static
+EFI_STATUS ReadSample (
+    IN OUT VOLUME_SAMPLE *Sample,
+    IN     UINTN          Offset,
+    IN     UINTN          Size
+) {
+    EFI_STATUS              Status;
+    EFI_BLOCK_IO_PROTOCOL  *BlockIO;
+    UINTN                   Stage;
+    UINTN                   LastStage;
+
+    if (Size == 0 || Offset + Size > SAMPLE_SIZE) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    BlockIO   = Sample->Volume->BlockIO;
+    LastStage = (Offset + Size - 1) / Sample->StageSize;
+    for (Stage = Offset / Sample->StageSize; Stage <= LastStage; Stage++) {
+        if (Sample->Loaded & (1U << Stage)) {
+            continue;
+        }
+        if (Sample->Failed & (1U << Stage)) {
+            return EFI_DEVICE_ERROR;
+        }
+
+        LEAKABLEEXTERNALSTART ("ReadSample ReadBlocks");
+        Status = REFIT_CALL_5_WRAPPER(
+            BlockIO->ReadBlocks,
+            BlockIO,
+            BlockIO->Media->MediaId,
+            Sample->Volume->BlockIOOffset + (Stage * Sample->StageSize) / BlockIO->Media->BlockSize,
+            Sample->StageSize,
+            Sample->Buffer + Stage * Sample->StageSize
+        );
+        LEAKABLEEXTERNALSTOP ();
+
+        if (EFI_ERROR(Status)) {
+            Sample->Failed |= (1U << Stage);
+
+            return Status;
+        }
+        Sample->Loaded |= (1U << Stage);
+    }
+
+    return EFI_SUCCESS;
+} // static EFI_STATUS ReadSample()
+
+// Reads whatever part of the sample is needed to compare Size bytes at Offset.
+static
+BOOLEAN SampleHas (
+    IN OUT VOLUME_SAMPLE *Sample,
+    IN     UINTN          Offset,
+    IN     CONST CHAR8   *Pattern,
+    IN     UINTN          Size
+) {
+    if (EFI_ERROR(ReadSample (Sample, Offset, Size))) {
+        return FALSE;
+    }
+
+    return (CompareMem (Sample->Buffer + Offset, Pattern, Size) == 0);
+} // static BOOLEAN SampleHas()
+
+// Filesystem signatures in the order they are tested; the first found decides
+// the type. Entries needing the boot signature are only tested on volumes with
+// FAT_MAGIC at the end of the first sector, which are otherwise whole disks.
+typedef struct {
+    UINTN          Offset;
+    CONST CHAR8   *Magic;
+    UINTN          MagicSize;
+    UINT32         FSType;
+    UINTN          UuidOffset;
+    UINTN          UuidSize;
+    BOOLEAN        NeedsBootSignature;
+} FS_SIGNATURE;
+
+static FS_SIGNATURE FsSignatures[] = {
+    { 1024 + 56,  EXT2_SUPER_MAGIC,                2, FS_TYPE_EXT2,     1024 + 104,  sizeof (EFI_GUID), FALSE },
+    { 65536 + 52, REISERFS_SUPER_MAGIC_STRING,     8, FS_TYPE_REISERFS, 65536 + 84,  sizeof (EFI_GUID), FALSE },
+    { 65536 + 52, REISER2FS_SUPER_MAGIC_STRING,    9, FS_TYPE_REISERFS, 65536 + 84,  sizeof (EFI_GUID), FALSE },
+    { 65536 + 52, REISER2FS_JR_SUPER_MAGIC_STRING, 9, FS_TYPE_REISERFS, 65536 + 84,  sizeof (EFI_GUID), FALSE },
+    { 65536 + 64, BTRFS_SIGNATURE,                 8, FS_TYPE_BTRFS,    0,           0,                 FALSE },
+    { 0,          XFS_SIGNATURE,                   4, FS_TYPE_XFS,      0,           0,                 FALSE },
+    { 32768,      JFS_SIGNATURE,                   4, FS_TYPE_JFS,      0,           0,                 FALSE },
+    { 1024,       HFSPLUS_MAGIC1,                  2, FS_TYPE_HFSPLUS,  0,           0,                 FALSE },
+    { 1024,       HFSPLUS_MAGIC2,                  2, FS_TYPE_HFSPLUS,  0,           0,                 FALSE },
+    { 3,          NTFS_SIGNATURE,                  8, FS_TYPE_NTFS,     0x48,        sizeof (UINT64),   TRUE  },
+    { 0x36,       FAT12_SIGNATURE,                 8, FS_TYPE_FAT,      0x27,        sizeof (UINT32),   TRUE  },
+    { 0x36,       FAT16_SIGNATURE,                 8, FS_TYPE_FAT,      0x27,        sizeof (UINT32),   TRUE  },
+    { 0x52,       FAT32_SIGNATURE,                 8, FS_TYPE_FAT,      0x43,        sizeof (UINT32),   TRUE  }
+};
+
+#define FS_SIGNATURE_COUNT (sizeof (FsSignatures) / sizeof (FsSignatures[0]))
+
 // Identify the filesystem type and record the filesystem's UUID/serial number,
-// if possible. Expects a Buffer containing the first few (normally at least
-// 4096) bytes of the filesystem. Sets the filesystem type code in Volume->FSType
-// and the UUID/serial number in Volume->VolUuid. Note that the UUID value is
-// recognized differently for each filesystem, and is currently supported only
-// for NTFS, FAT, ext2/3/4fs, and ReiserFS (and for NTFS and FAT it is really a
-// 64-bit or 32-bit serial number not a UUID or GUID). If the UUID can't be
-// determined, it is set to 0. Also, the UUID is just read directly into memory;
-// it is *NOT* valid when displayed by GuidAsString() or used in other
-// GUID/UUID-manipulating functions. (As I write, it is being used merely to
-// detect partitions that are part of a RAID 1 array.)
+// if possible. Expects a Sample of the start of the filesystem, of which only
+// the sectors holding the signatures tested are read. Sets the filesystem type
+// code in Volume->FSType and the UUID/serial number in Volume->VolUuid. Note
+// that the UUID value is recognized differently for each filesystem, and is
+// currently supported only for NTFS, FAT, ext2/3/4fs, and ReiserFS (and for
+// NTFS and FAT it is really a 64-bit or 32-bit serial number not a UUID or
+// GUID). If the UUID can't be determined, it is set to 0. Also, the UUID is
+// just read directly into memory; it is *NOT* valid when displayed by
+// GuidAsString() or used in other GUID/UUID-manipulating functions. (As I
+// write, it is being used merely to detect partitions that are part of a
+// RAID 1 array.)
 static
 VOID SetFilesystemData (
-    IN     UINT8        *Buffer,
-    IN     UINTN         BufferSize,
-    IN OUT REFIT_VOLUME *Volume
+    IN OUT VOLUME_SAMPLE *Sample,
+    IN OUT REFIT_VOLUME  *Volume
 ) {
-    UINT32  *Ext2Compat;
-    UINT32  *Ext2Incompat;
-    UINT16  *Magic16;
-    char    *MagicString;
+    FS_SIGNATURE  *Signature;
+    UINT32        *Ext2Compat;
+    UINT32        *Ext2Incompat;
+    BOOLEAN        BootSignature;
+    UINTN          i;
 
-    if ((Buffer != NULL) && (Volume != NULL)) {
+    if ((Sample != NULL) && (Volume != NULL)) {
         SetMem(&(Volume->VolUuid), sizeof(EFI_GUID), 0);
         Volume->FSType = FS_TYPE_UNKNOWN;
 
-        if (BufferSize >= (1024 + 100)) {
-            Magic16 = (UINT16*) (Buffer + 1024 + 56);
-            if (*Magic16 == EXT2_SUPER_MAGIC) {
-                // ext2/3/4
-                Ext2Compat   = (UINT32*) (Buffer + 1024 + 92);
-                Ext2Incompat = (UINT32*) (Buffer + 1024 + 96);
+        BootSignature = SampleHas (Sample, 510, FAT_MAGIC, 2);
+
+        for (i = 0; i < FS_SIGNATURE_COUNT; i++) {
+            Signature = &FsSignatures[i];
+            if (Signature->NeedsBootSignature && !BootSignature) {
+                continue;
+            }
+            if (!SampleHas (Sample, Signature->Offset, Signature->Magic, Signature->MagicSize)) {
+                continue;
+            }
+
+            Volume->FSType = Signature->FSType;
+            if (Signature->UuidSize > 0 &&
+                !EFI_ERROR(ReadSample (Sample, Signature->UuidOffset, Signature->UuidSize))
+            ) {
+                CopyMem(&(Volume->VolUuid), Sample->Buffer + Signature->UuidOffset, Signature->UuidSize);
+            }
+
+            if (Volume->FSType == FS_TYPE_EXT2) {
+                // Sits in the same sector as the ext2/3/4 magic
+                Ext2Compat   = (UINT32*) (Sample->Buffer + 1024 + 92);
+                Ext2Incompat = (UINT32*) (Sample->Buffer + 1024 + 96);
 
                 if ((*Ext2Incompat & 0x0040) || (*Ext2Incompat & 0x0200)) {
                     // check for extents or flex_bg
@@ -1108,96 +1242,19 @@ VOID SetFilesystemData (
                     // check for journal
                     Volume->FSType = FS_TYPE_EXT3;
                 }
-                else {
-                    // none of these features. Assume it is ext2
-                    Volume->FSType = FS_TYPE_EXT2;
-                }
-                CopyMem(&(Volume->VolUuid), Buffer + 1024 + 104, sizeof(EFI_GUID));
-
-                return;
-            }
-        } // search for ext2/3/4 magic
-
-        if (BufferSize >= (65536 + 100)) {
-            MagicString = (char*) (Buffer + 65536 + 52);
-            if ((CompareMem(MagicString, REISERFS_SUPER_MAGIC_STRING,     8) == 0) ||
-                (CompareMem(MagicString, REISER2FS_SUPER_MAGIC_STRING,    9) == 0) ||
-                (CompareMem(MagicString, REISER2FS_JR_SUPER_MAGIC_STRING, 9) == 0)
-            ) {
-                Volume->FSType = FS_TYPE_REISERFS;
-                CopyMem(&(Volume->VolUuid), Buffer + 65536 + 84, sizeof(EFI_GUID));
-
-                return;
             }
-        } // search for ReiserFS magic
 
-        if (BufferSize >= (65536 + 64 + 8)) {
-            MagicString = (char*) (Buffer + 65536 + 64);
-            if (CompareMem(MagicString, BTRFS_SIGNATURE, 8) == 0) {
-                Volume->FSType = FS_TYPE_BTRFS;
-
-                return;
-            }
-        } // search for Btrfs magic
-
-        if (BufferSize >= 512) {
-            MagicString = (char*) Buffer;
-            if (CompareMem(MagicString, XFS_SIGNATURE, 4) == 0) {
-                Volume->FSType = FS_TYPE_XFS;
-
-                return;
-            }
-        } // search for XFS magic
-
-        if (BufferSize >= (32768 + 4)) {
-            MagicString = (char*) (Buffer + 32768);
-            if (CompareMem (MagicString, JFS_SIGNATURE, 4) == 0) {
-                Volume->FSType = FS_TYPE_JFS;
+            return;
+        } // for i = 0
 
-                return;
+        if (BootSignature) {
+            // MBR/EBR without a recognised filesystem
+            if (!Volume->BlockIO->Media->LogicalPartition) {
+                Volume->FSType = FS_TYPE_WHOLEDISK;
             }
-        } // search for JFS magic
 
-        if (BufferSize >= (1024 + 2)) {
-            Magic16 = (UINT16*) (Buffer + 1024);
-            if ((*Magic16 == HFSPLUS_MAGIC1) ||
-                (*Magic16 == HFSPLUS_MAGIC2)
-            ) {
-                Volume->FSType = FS_TYPE_HFSPLUS;
-
-                return;
-            }
-        } // search for HFS+ magic
-
-        if (BufferSize >= 512) {
-            // Search for NTFS, FAT, and MBR/EBR.
-            // These all have 0xAA55 at the end of the first sector, so we must
-            // also search for NTFS, FAT12, FAT16, and FAT32 signatures to
-            // figure out where to look for the filesystem serial numbers.
-            Magic16 = (UINT16*) (Buffer + 510);
-            if (*Magic16 == FAT_MAGIC) {
-                MagicString = (char*) Buffer;
-                if (CompareMem(MagicString + 3, NTFS_SIGNATURE, 8) == 0) {
-                    Volume->FSType = FS_TYPE_NTFS;
-                    CopyMem(&(Volume->VolUuid), Buffer + 0x48, sizeof(UINT64));
-                }
-                else if ((CompareMem(MagicString + 0x36, FAT12_SIGNATURE, 8) == 0) ||
-                    (CompareMem(MagicString + 0x36,      FAT16_SIGNATURE, 8) == 0)
-                ) {
-                    Volume->FSType = FS_TYPE_FAT;
-                    CopyMem(&(Volume->VolUuid), Buffer + 0x27, sizeof(UINT32));
-                }
-                else if (CompareMem(MagicString + 0x52, FAT32_SIGNATURE, 8) == 0) {
-                    Volume->FSType = FS_TYPE_FAT;
-                    CopyMem(&(Volume->VolUuid), Buffer + 0x43, sizeof(UINT32));
-                }
-                else if (!Volume->BlockIO->Media->LogicalPartition) {
-                    Volume->FSType = FS_TYPE_WHOLEDISK;
-                }
-
-                return;
-            }
-        } // search for FAT and NTFS magic
+            return;
+        }
 
         // If no other filesystem is identified and block size is right, assume ISO-9660
         if (Volume->BlockIO->Media->BlockSize == 2048) {
@@ -1216,9 +1273,436 @@ VOID SetFilesystemData (
             Volume->FSType = FS_TYPE_HFSPLUS;
             return;
         }
-    } // if ((Buffer != NULL) && (Volume != NULL))
+    } // if ((Sample != NULL) && (Volume != NULL))
 } // UINT32 SetFilesystemData()
 
+// Boot sector reads issued for all handles ahead of the first volume scan
+// pass, so that slow devices are read concurrently instead of one by one.
+// Handles without Block I/O 2, or whose request is refused, are left to the
+// synchronous read in ScanVolumeBootcode.
+typedef struct {
+    EFI_HANDLE              DeviceHandle;
+    EFI_BLOCK_IO2_TOKEN     Token;
+    EFI_STATUS              Status;
+    BOOLEAN                 Pending;
+    UINT8                  *Buffer;
+} BOOT_SECTOR_READ;
+
+static BOOT_SECTOR_READ *BootSectorReads     = NULL;
+static UINTN             BootSectorReadCount = 0;
+
+static
+VOID StartBootSectorReads (
+    IN EFI_HANDLE *Handles,
+    IN UINTN       HandleCount
+) {
+    EFI_STATUS              Status;
+    EFI_BLOCK_IO2_PROTOCOL *BlockIo2;
+    EFI_BLOCK_IO_MEDIA     *Media;
+    BOOT_SECTOR_READ       *Read;
+    UINTN                   i;
+
+    BootSectorReads = AllocateZeroPool (sizeof (BOOT_SECTOR_READ) * HandleCount);
+    if (BootSectorReads == NULL) {
+        return;
+    }
+    BootSectorReadCount = HandleCount;
+
+    for (i = 0; i < HandleCount; i++) {
+        Read               = &BootSectorReads[i];
+        Read->DeviceHandle = Handles[i];
+        Read->Status       = EFI_NOT_STARTED;
+
+        BlockIo2 = NULL;
+        Status   = REFIT_CALL_3_WRAPPER(
+            gBS->HandleProtocol,
+            Handles[i],
+            &BlockIo2Protocol,
+            (VOID **) &BlockIo2
+        );
+        if (EFI_ERROR(Status) || BlockIo2 == NULL) {
+            continue;
+        }
+
+        Media = BlockIo2->Media;
+        if (!Media->MediaPresent ||
+            Media->BlockSize == 0 ||
+            Media->BlockSize > SAMPLE_SIZE ||
+            (SAMPLE_SIZE % Media->BlockSize) != 0 ||
+            Media->IoAlign > EFI_PAGE_SIZE
+        ) {
+            continue;
+        }
+
+        // Page allocation satisfies any IoAlign up to EFI_PAGE_SIZE
+        Read->Buffer = AllocatePages (EFI_SIZE_TO_PAGES(SAMPLE_SIZE));
+        if (Read->Buffer == NULL) {
+            continue;
+        }
+
+        Status = REFIT_CALL_5_WRAPPER(gBS->CreateEvent, 0, 0, NULL, NULL, &Read->Token.Event);
+        if (!EFI_ERROR(Status)) {
+            Read->Token.TransactionStatus = EFI_NOT_READY;
+
+            LEAKABLEEXTERNALSTART ("StartBootSectorReads ReadBlocksEx");
+            Status = REFIT_CALL_6_WRAPPER(
+                BlockIo2->ReadBlocksEx,
+                BlockIo2,
+                Media->MediaId,
+                0,
+                &Read->Token,
+                SAMPLE_SIZE,
+                Read->Buffer
+            );
+            LEAKABLEEXTERNALSTOP ();
+
+            if (!EFI_ERROR(Status)) {
+                Read->Pending = TRUE;
+
+                continue;
+            }
+
+            REFIT_CALL_1_WRAPPER(gBS->CloseEvent, Read->Token.Event);
+        }
+
+        FreePages (Read->Buffer, EFI_SIZE_TO_PAGES(SAMPLE_SIZE));
+        Read->Buffer = NULL;
+    } // for
+} // static VOID StartBootSectorReads()
+
+static
+VOID WaitBootSectorRead (
+    IN OUT BOOT_SECTOR_READ *Read
+) {
+    EFI_STATUS  Status;
+    UINTN       Index;
+
+    if (!Read->Pending) {
+        return;
+    }
+
+    Status = REFIT_CALL_3_WRAPPER(gBS->WaitForEvent, 1, &Read->Token.Event, &Index);
+    Read->Status = EFI_ERROR(Status) ? Status : Read->Token.TransactionStatus;
+
+    REFIT_CALL_1_WRAPPER(gBS->CloseEvent, Read->Token.Event);
+    Read->Pending = FALSE;
+} // static VOID WaitBootSectorRead()
+
+// Returns the prefetched boot sector sample for Volume, waiting for the read
+// to complete if needed, or NULL if there is none and the caller must read it.
+static
+UINT8 * TakeBootSectorRead (
+    IN REFIT_VOLUME *Volume
+) {
+    UINTN i;
+
+    if (Volume->BlockIOOffset != 0) {
+        return NULL;
+    }
+
+    for (i = 0; i < BootSectorReadCount; i++) {
+        if (BootSectorReads[i].DeviceHandle == Volume->DeviceHandle) {
+            if (BootSectorReads[i].Buffer == NULL) {
+                return NULL;
+            }
+
+            WaitBootSectorRead (&BootSectorReads[i]);
+
+            return EFI_ERROR(BootSectorReads[i].Status) ? NULL : BootSectorReads[i].Buffer;
+        }
+    }
+
+    return NULL;
+} // static UINT8 * TakeBootSectorRead()
+
+static
+VOID FinishBootSectorReads (VOID) {
+    UINTN i;
+
+    // Buffers must outlive any read still in flight
+    for (i = 0; i < BootSectorReadCount; i++) {
+        if (BootSectorReads[i].Buffer != NULL) {
+            WaitBootSectorRead (&BootSectorReads[i]);
+            FreePages (BootSectorReads[i].Buffer, EFI_SIZE_TO_PAGES(SAMPLE_SIZE));
+        }
+    }
+
+    MY_FREE_POOL(BootSectorReads);
+    BootSectorReadCount = 0;
+} // static VOID FinishBootSectorReads()
+
+// What each Block I/O handle looked like when ScanVolumes last read it. A
+// volume whose handle still shows the same protocol instances and medium is
+// kept as it is by the next ScanVolumes call, along with its names and icons,
+// so that a rescan only reads volumes that were added or have changed.
+typedef struct {
+    EFI_HANDLE     DeviceHandle;
+    VOID          *BlockIo;
+    VOID          *FileSystem;
+    UINT32         MediaId;
+    BOOLEAN        MediaPresent;
+    EFI_LBA        LastBlock;
+    EFI_GUID       VolUuid;         // As first read, before any APFS details
+} VOLUME_HANDLE_STATE;
+
+static VOLUME_HANDLE_STATE *VolumeHandleStates     = NULL;
+static UINTN                VolumeHandleStateCount = 0;
+
+static
+VOID GetVolumeHandleState (
+    IN  EFI_HANDLE           DeviceHandle,
+    OUT VOLUME_HANDLE_STATE *State
+) {
+    EFI_STATUS      Status;
+    EFI_BLOCK_IO   *BlockIo;
+
+    ZeroMem (State, sizeof (VOLUME_HANDLE_STATE));
+    State->DeviceHandle = DeviceHandle;
+
+    Status = REFIT_CALL_3_WRAPPER(
+        gBS->HandleProtocol,
+        DeviceHandle,
+        &BlockIoProtocol,
+        (VOID **) &BlockIo
+    );
+    if (!EFI_ERROR(Status) && BlockIo != NULL) {
+        State->BlockIo      = BlockIo;
+        State->MediaId      = BlockIo->Media->MediaId;
+        State->MediaPresent = BlockIo->Media->MediaPresent;
+        State->LastBlock    = BlockIo->Media->LastBlock;
+    }
+
+    Status = REFIT_CALL_3_WRAPPER(
+        gBS->HandleProtocol,
+        DeviceHandle,
+        &FileSystemProtocol,
+        &State->FileSystem
+    );
+    if (EFI_ERROR(Status)) {
+        State->FileSystem = NULL;
+    }
+} // static VOID GetVolumeHandleState()
+
+// Returns the volume from the last ScanVolumes call for the handle in State,
+// if the handle has not changed since, or NULL if it must be scanned again.
+static
+REFIT_VOLUME * FindUnchangedVolume (
+    IN REFIT_VOLUME        **OldVolumes,
+    IN UINTN                 OldVolumesCount,
+    IN VOLUME_HANDLE_STATE  *State
+) {
+    UINTN                 i;
+    REFIT_VOLUME         *Volume;
+    VOLUME_HANDLE_STATE  *OldState = NULL;
+
+    for (i = 0; i < VolumeHandleStateCount; i++) {
+        if (VolumeHandleStates[i].DeviceHandle == State->DeviceHandle) {
+            OldState = &VolumeHandleStates[i];
+            break;
+        }
+    }
+
+    if (OldState == NULL             ||
+        OldState->BlockIo      != State->BlockIo      ||
+        OldState->FileSystem   != State->FileSystem   ||
+        OldState->MediaId      != State->MediaId      ||
+        OldState->MediaPresent != State->MediaPresent ||
+        OldState->LastBlock    != State->LastBlock
+    ) {
+        return NULL;
+    }
+
+    Volume = VolumeIndexFind (OldVolumes, OldVolumesCount, VOLUME_KEY_HANDLE, State->DeviceHandle);
+    if (Volume != NULL) {
+        State->VolUuid = OldState->VolUuid;
+    }
+
+    return Volume;
+} // static REFIT_VOLUME * FindUnchangedVolume()
+
+// Makes the next ScanVolumes call read every volume again.
+VOID ForgetVolumeHandles (VOID) {
+    MY_FREE_POOL(VolumeHandleStates);
+    VolumeHandleStateCount = 0;
+
+    // Loader details read from the volumes may be out of date too
+    ForgetLoaderInfo();
+} // VOID ForgetVolumeHandles()
+
+// Boot code signatures. Anchored ones must sit at Offset; floating ones may
+// start anywhere in the first Limit bytes, as with FindMem. All lie within
+// the first SECTOR_SIZE bytes of the volume.
+typedef struct {
+    UINTN          Offset;
+    UINTN          Limit;
+    CONST CHAR8   *Pattern;
+    UINTN          Size;
+} BOOT_CODE_SIGNATURE;
+
+#define BOOT_CODE_FLOATING  ((UINTN) -1)
+
+#define BOOT_CODE_AT(Offset, Pattern)     { Offset, 0, Pattern, sizeof (Pattern) - 1 }
+#define BOOT_CODE_IN(Limit, Pattern)      { BOOT_CODE_FLOATING, Limit, Pattern, sizeof (Pattern) - 1 }
+
+#define BC_LILO_2            0
+#define BC_LILO_6            1
+#define BC_SYSLINUX          2
+#define BC_FREEBSD_ZERO      3
+#define BC_FREEBSD_MAGIC     4
+#define BC_BOOT_SIGNATURE    5
+#define BC_NETBSD_MAGIC      6
+#define BC_ISOLINUX          7
+#define BC_GRUB              8
+#define BC_BTX               9
+#define BC_TOO_LARGE        10
+#define BC_IO_ERROR         11
+#define BC_OPENBSD          12
+#define BC_CDBOOT           13
+#define BC_BOOTXX           14
+#define BC_NTLDR            15
+#define BC_BOOTMGR          16
+#define BC_CPUBOOT          17
+#define BC_KERNEL           18
+#define BC_OS2LDR           19
+#define BC_OS2BOOT          20
+#define BC_BEOS             21
+#define BC_ZETA             22
+#define BC_ZBEOS            23
+#define BC_HAIKU            24
+#define BC_EXFAT            25
+#define BC_NON_SYSTEM       26
+#define BC_NOT_BOOTABLE     27
+#define BC_PRESS_ANY_KEY    28
+
+#define BC(Signature)       (1U << (Signature))
+
+// Indexed by the BC_ values above
+static BOOT_CODE_SIGNATURE BootCodeSignatures[] = {
+    BOOT_CODE_AT(2,    "LILO"),
+    BOOT_CODE_AT(6,    "LILO"),
+    BOOT_CODE_AT(3,    "SYSLINUX"),
+    BOOT_CODE_AT(502,  "\x00\x00\x00\x00"),
+    BOOT_CODE_AT(506,  "\x50\xC3\x00\x00"),        /* 50000 */
+    BOOT_CODE_AT(510,  FAT_MAGIC),
+    BOOT_CODE_AT(1028, "\xD1\xB6\x86\x78"),        /* 0x7886b6d1 */
+    BOOT_CODE_IN(SECTOR_SIZE, "ISOLINUX"),
+    BOOT_CODE_IN(512,         "Geom\0Hard Disk\0Read\0 Error"),
+    BOOT_CODE_IN(SECTOR_SIZE, "Starting the BTX loader"),
+    BOOT_CODE_IN(SECTOR_SIZE, "Boot loader too large"),
+    BOOT_CODE_IN(SECTOR_SIZE, "I/O error loading boot loader"),
+    BOOT_CODE_IN(512,         "!Loading"),
+    BOOT_CODE_IN(SECTOR_SIZE, "/cdboot\0/CDBOOT\0"),
+    BOOT_CODE_IN(512,         "Not a bootxx image"),
+    BOOT_CODE_IN(SECTOR_SIZE, "NTLDR"),
+    BOOT_CODE_IN(SECTOR_SIZE, "BOOTMGR"),
+    BOOT_CODE_IN(512,         "CPUBOOT SYS"),
+    BOOT_CODE_IN(512,         "KERNEL  SYS"),
+    BOOT_CODE_IN(512,         "OS2LDR"),
+    BOOT_CODE_IN(512,         "OS2BOOT"),
+    BOOT_CODE_IN(512,         "Be Boot Loader"),
+    BOOT_CODE_IN(512,         "yT Boot Loader"),
+    BOOT_CODE_IN(512,         "\x04" "beos\x06" "system\x05" "zbeos"),
+    BOOT_CODE_IN(512,         "\x06" "system\x0c" "haiku_loader"),
+    BOOT_CODE_IN(512,         "EXFAT"),
+    BOOT_CODE_IN(512,         "Non-system disk"),
+    BOOT_CODE_IN(512,         "This is not a bootable disk"),
+    BOOT_CODE_IN(512,         "Press any key to restart")
+};
+
+#define BOOT_CODE_SIGNATURE_COUNT (sizeof (BootCodeSignatures) / sizeof (BootCodeSignatures[0]))
+
+// Legacy OS boot codes in the order they are tested. A rule matches when all
+// the signatures in any one of its Any masks were found.
+#define BOOT_CODE_ANY_COUNT 4
+
+typedef struct {
+    UINT32    Any[BOOT_CODE_ANY_COUNT];
+    CHAR16   *OSIconName;
+    CHAR16   *OSName;
+} BOOT_CODE_RULE;
+
+/**
+ * NOTE: If you add an operating system with a name that starts with 'W' or 'L',
+ *       you need to fix AddLegacyEntry in BootMaster/launch_legacy.c.
+ *       DA-TAGGED
+**/
+static BOOT_CODE_RULE BootCodeRules[] = {
+    { { BC(BC_LILO_2), BC(BC_LILO_6), BC(BC_SYSLINUX), BC(BC_ISOLINUX) },       L"linux",       L"Linux (Legacy)"       },
+    { { BC(BC_GRUB) },                                                          L"grub,linux",  L"Linux (Legacy)"       },
+    { { BC(BC_FREEBSD_ZERO) | BC(BC_FREEBSD_MAGIC) | BC(BC_BOOT_SIGNATURE),
+        BC(BC_BTX) },                                                           L"freebsd",     L"FreeBSD (Legacy)"     },
+    // If more differentiation needed, also search for
+    // "Invalid partition table" &/or "Missing boot loader".
+    { { BC(BC_BOOT_SIGNATURE) | BC(BC_TOO_LARGE) | BC(BC_IO_ERROR) },           L"freebsd",     L"FreeBSD (Legacy)"     },
+    { { BC(BC_OPENBSD), BC(BC_CDBOOT) },                                        L"openbsd",     L"OpenBSD (Legacy)"     },
+    { { BC(BC_BOOTXX), BC(BC_NETBSD_MAGIC) },                                   L"netbsd",      L"NetBSD (Legacy)"      },
+    // Windows NT/200x/XP
+    { { BC(BC_NTLDR) },                                                         L"win",         L"Windows (NT/XP)"      },
+    // Windows Vista/7/8/10
+    { { BC(BC_BOOTMGR) },                                                       L"win8,win",    L"Windows (Legacy)"     },
+    { { BC(BC_CPUBOOT), BC(BC_KERNEL) },                                        L"freedos",     L"FreeDOS (Legacy)"     },
+    { { BC(BC_OS2LDR), BC(BC_OS2BOOT) },                                        L"ecomstation", L"eComStation (Legacy)" },
+    { { BC(BC_BEOS) },                                                          L"beos",        L"BeOS (Legacy)"        },
+    { { BC(BC_ZETA) },                                                          L"zeta,beos",   L"ZETA (Legacy)"        },
+    { { BC(BC_ZBEOS), BC(BC_HAIKU) },                                           L"haiku,beos",  L"Haiku (Legacy)"       }
+};
+
+#define BOOT_CODE_RULE_COUNT (sizeof (BootCodeRules) / sizeof (BootCodeRules[0]))
+
+// Returns the BC() mask of the boot code signatures found in the first
+// SECTOR_SIZE bytes of Buffer. Floating signatures are all looked for in one
+// pass over the sector, comparing only those starting with the current byte.
+static
+UINT32 FindBootCodeSignatures (
+    IN UINT8 *Buffer
+) {
+    BOOT_CODE_SIGNATURE  *Signature;
+    UINT32                Found;
+    UINT32                Candidates;
+    UINTN                 Pos;
+    UINTN                 i;
+
+    static UINT32         FirstByte[256];
+    static BOOLEAN        FirstByteReady = FALSE;
+
+    if (!FirstByteReady) {
+        for (i = 0; i < BOOT_CODE_SIGNATURE_COUNT; i++) {
+            if (BootCodeSignatures[i].Offset == BOOT_CODE_FLOATING) {
+                FirstByte[(UINT8) BootCodeSignatures[i].Pattern[0]] |= BC(i);
+            }
+        }
+        FirstByteReady = TRUE;
+    }
+
+    Found = 0;
+    for (i = 0; i < BOOT_CODE_SIGNATURE_COUNT; i++) {
+        Signature = &BootCodeSignatures[i];
+        if (Signature->Offset != BOOT_CODE_FLOATING &&
+            CompareMem (Buffer + Signature->Offset, Signature->Pattern, Signature->Size) == 0
+        ) {
+            Found |= BC(i);
+        }
+    }
+
+    for (Pos = 0; Pos < SECTOR_SIZE; Pos++) {
+        Candidates = FirstByte[Buffer[Pos]] & ~Found;
+        for (i = 0; Candidates != 0; i++, Candidates >>= 1) {
+            if ((Candidates & 1) == 0) {
+                continue;
+            }
+
+            Signature = &BootCodeSignatures[i];
+            if (Pos + Signature->Size < Signature->Limit &&
+                CompareMem (Buffer + Pos, Signature->Pattern, Signature->Size) == 0
+            ) {
+                Found |= BC(i);
+            }
+        }
+    }
+
+    return Found;
+} // static UINT32 FindBootCodeSignatures()
+
 static
 VOID ScanVolumeBootcode (
     IN OUT REFIT_VOLUME  *Volume,
@@ -1226,7 +1710,11 @@ VOID ScanVolumeBootcode (
 ) {
     EFI_STATUS           Status;
     UINTN                i;
-    UINT8                Buffer[SAMPLE_SIZE];
+    UINTN                j;
+    UINT8                SampleBuffer[SAMPLE_SIZE];
+    UINT8               *Buffer;
+    UINT32               Found;
+    VOLUME_SAMPLE        Sample;
     BOOLEAN              MbrTableFound = FALSE;
     MBR_PARTITION_INFO  *MbrTable;
 
@@ -1244,25 +1732,33 @@ VOID ScanVolumeBootcode (
     if (Volume->BlockIO == NULL) {
         return;
     }
-    if (Volume->BlockIO->Media->BlockSize > SAMPLE_SIZE) {
+    if (Volume->BlockIO->Media->BlockSize == 0 ||
+        Volume->BlockIO->Media->BlockSize > SAMPLE_SIZE
+    ) {
         // our buffer is too small
         return;
     }
 
-    LEAKABLEEXTERNALSTART ("ScanVolumeBootcode ReadBlocks");
     // look at the boot sector (this is used for both hard disks and El Torito images!)
-    Status = REFIT_CALL_5_WRAPPER(
-        Volume->BlockIO->ReadBlocks,
-        Volume->BlockIO,
-        Volume->BlockIO->Media->MediaId,
-        Volume->BlockIOOffset,
-        SAMPLE_SIZE,
-        Buffer
-    );
-    LEAKABLEEXTERNALSTOP ();
+    Sample.Volume    = Volume;
+    Sample.Buffer    = TakeBootSectorRead (Volume);
+    Sample.StageSize = SAMPLE_SIZE;
+    Sample.Loaded    = 0;
+    Sample.Failed    = 0;
+    if (Sample.Buffer != NULL) {
+        Sample.Loaded = 0xFFFFFFFF;
+    }
+    else {
+        Sample.Buffer = SampleBuffer;
+        if ((SECTOR_SIZE % Volume->BlockIO->Media->BlockSize) == 0) {
+            Sample.StageSize = SECTOR_SIZE;
+        }
+    }
 
+    Status = ReadSample (&Sample, 0, SECTOR_SIZE);
     if (!EFI_ERROR(Status)) {
-        SetFilesystemData (Buffer, SAMPLE_SIZE, Volume);
+        Buffer = Sample.Buffer;
+        SetFilesystemData (&Sample, Volume);
 
         if (GlobalConfig.LegacyType != LEGACY_TYPE_MAC) {
             #if REFIT_DEBUG > 0
@@ -1282,115 +1778,32 @@ VOID ScanVolumeBootcode (
             return;
         }
 
-        if ((*((UINT16 *)(Buffer + 510)) == 0xaa55 && Buffer[0] != 0) &&
-            (FindMem (Buffer, 512, "EXFAT", 5) == -1)
+        Found = FindBootCodeSignatures (Buffer);
+
+        if ((Found & BC(BC_BOOT_SIGNATURE)) && Buffer[0] != 0 &&
+            (Found & BC(BC_EXFAT)) == 0
         ) {
             *Bootable            = TRUE;
              Volume->HasBootCode = TRUE;
         }
 
         // detect specific boot codes
-        if (CompareMem (Buffer + 2, "LILO",           4) == 0 ||
-            CompareMem (Buffer + 6, "LILO",           4) == 0 ||
-            CompareMem (Buffer + 3, "SYSLINUX",       8) == 0 ||
-            FindMem (Buffer, SECTOR_SIZE, "ISOLINUX", 8) >= 0
-        ) {
-            Volume->HasBootCode  = TRUE;
-            AssignCachedPoolStr (&Volume->OSIconName, L"linux");
-            AssignCachedPoolStr (&Volume->OSName, L"Linux (Legacy)");
-        }
-        else if (FindMem (Buffer, 512, "Geom\0Hard Disk\0Read\0 Error", 26) >= 0) {
-            // GRUB
-            Volume->HasBootCode  = TRUE;
-            AssignCachedPoolStr (&Volume->OSIconName, L"grub,linux");
-            AssignCachedPoolStr (&Volume->OSName, L"Linux (Legacy)");
-        }
-        else if ((*((UINT32 *)(Buffer + 502)) == 0 &&
-            *((UINT32 *)(Buffer + 506)) == 50000 &&
-            *((UINT16 *)(Buffer + 510)) == 0xaa55) ||
-            FindMem (Buffer, SECTOR_SIZE, "Starting the BTX loader", 23) >= 0
-        ) {
-            Volume->HasBootCode  = TRUE;
-            AssignCachedPoolStr (&Volume->OSIconName, L"freebsd");
-            AssignCachedPoolStr (&Volume->OSName, L"FreeBSD (Legacy)");
-        }
-        else if ((*((UINT16 *)(Buffer + 510)) == 0xaa55) &&
-            (FindMem (Buffer, SECTOR_SIZE, "Boot loader too large",         21) >= 0) &&
-            (FindMem (Buffer, SECTOR_SIZE, "I/O error loading boot loader", 29) >= 0)
-        ) {
-            // If more differentiation needed, also search for
-            // "Invalid partition table" &/or "Missing boot loader".
-            Volume->HasBootCode  = TRUE;
-            AssignCachedPoolStr (&Volume->OSIconName, L"freebsd");
-            AssignCachedPoolStr (&Volume->OSName, L"FreeBSD (Legacy)");
-        }
-        else if (
-            FindMem (Buffer, 512,    "!Loading",            8) >= 0 ||
-            FindMem (Buffer, SECTOR_SIZE, "/cdboot\0/CDBOOT\0", 16) >= 0
-        ) {
-            Volume->HasBootCode  = TRUE;
-            AssignCachedPoolStr (&Volume->OSIconName, L"openbsd");
-            AssignCachedPoolStr (&Volume->OSName, L"OpenBSD (Legacy)");
-        }
-        else if (FindMem (Buffer, 512, "Not a bootxx image", 18) >= 0 ||
-            *((UINT32 *)(Buffer + 1028)) == 0x7886b6d1
-        ) {
-            Volume->HasBootCode  = TRUE;
-            AssignCachedPoolStr (&Volume->OSIconName, L"netbsd");
-            AssignCachedPoolStr (&Volume->OSName, L"NetBSD (Legacy)");
-        }
-        else if (FindMem (Buffer, SECTOR_SIZE, "NTLDR", 5) >= 0) {
-            // Windows NT/200x/XP
-            Volume->HasBootCode  = TRUE;
-            AssignCachedPoolStr (&Volume->OSIconName, L"win");
-            AssignCachedPoolStr (&Volume->OSName, L"Windows (NT/XP)");
-        }
-        else if (FindMem (Buffer, SECTOR_SIZE, "BOOTMGR", 7) >= 0) {
-            // Windows Vista/7/8/10
-            Volume->HasBootCode  = TRUE;
-            AssignCachedPoolStr (&Volume->OSIconName, L"win8,win");
-            AssignCachedPoolStr (&Volume->OSName, L"Windows (Legacy)");
-        }
-        else if (
-            FindMem (Buffer, 512, "CPUBOOT SYS", 11) >= 0 ||
-            FindMem (Buffer, 512, "KERNEL  SYS", 11) >= 0
-        ) {
-            Volume->HasBootCode  = TRUE;
-            AssignCachedPoolStr (&Volume->OSIconName, L"freedos");
-            AssignCachedPoolStr (&Volume->OSName, L"FreeDOS (Legacy)");
-        }
-        else if (
-            FindMem (Buffer, 512, "OS2LDR",  6) >= 0 ||
-            FindMem (Buffer, 512, "OS2BOOT", 7) >= 0
-        ) {
-            Volume->HasBootCode  = TRUE;
-            AssignCachedPoolStr (&Volume->OSIconName, L"ecomstation");
-            AssignCachedPoolStr (&Volume->OSName, L"eComStation (Legacy)");
-        }
-        else if (FindMem (Buffer, 512, "Be Boot Loader", 14) >= 0) {
-            Volume->HasBootCode  = TRUE;
-            AssignCachedPoolStr (&Volume->OSIconName, L"beos");
-            AssignCachedPoolStr (&Volume->OSName, L"BeOS (Legacy)");
-        }
-        else if (FindMem (Buffer, 512, "yT Boot Loader", 14) >= 0) {
-            Volume->HasBootCode  = TRUE;
-            AssignCachedPoolStr (&Volume->OSIconName, L"zeta,beos");
-            AssignCachedPoolStr (&Volume->OSName, L"ZETA (Legacy)");
-        }
-        else if (
-            FindMem (Buffer, 512, "\x04" "beos\x06" "system\x05" "zbeos", 18) >= 0 ||
-            FindMem (Buffer, 512, "\x06" "system\x0c" "haiku_loader",     20) >= 0
-        ) {
-            Volume->HasBootCode  = TRUE;
-            AssignCachedPoolStr (&Volume->OSIconName, L"haiku,beos");
-            AssignCachedPoolStr (&Volume->OSName, L"Haiku (Legacy)");
-        } // CompareMem
+        for (i = 0; i < BOOT_CODE_RULE_COUNT; i++) {
+            for (j = 0; j < BOOT_CODE_ANY_COUNT; j++) {
+                if (BootCodeRules[i].Any[j] != 0 &&
+                    (Found & BootCodeRules[i].Any[j]) == BootCodeRules[i].Any[j]
+                ) {
+                    break;
+                }
+            }
+            if (j < BOOT_CODE_ANY_COUNT) {
+                Volume->HasBootCode  = TRUE;
+                AssignCachedPoolStr (&Volume->OSIconName, BootCodeRules[i].OSIconName);
+                AssignCachedPoolStr (&Volume->OSName, BootCodeRules[i].OSName);
 
-        /**
-         * NOTE: If you add an operating system with a name that starts with 'W' or 'L',
-         *       you need to fix AddLegacyEntry in BootMaster/launch_legacy.c.
-         *       DA-TAGGED
-        **/
+                break;
+            }
+        } // for i = 0
 
         if (Volume->HasBootCode) {
             // verify Windows boot sector on Macs
@@ -1399,15 +1812,15 @@ VOID ScanVolumeBootcode (
             ) {
                 Volume->HasBootCode = HasWindowsBiosBootFiles (Volume);
             }
-            else if (FindMem (Buffer, 512, "Non-system disk", 15) >= 0) {
+            else if (Found & BC(BC_NON_SYSTEM)) {
                 // dummy FAT boot sector (created by OS X's newfs_msdos)
                 Volume->HasBootCode = FALSE;
             }
-            else if (FindMem (Buffer, 512, "This is not a bootable disk", 27) >= 0) {
+            else if (Found & BC(BC_NOT_BOOTABLE)) {
                 // dummy FAT boot sector (created by Linux's mkdosfs)
                 Volume->HasBootCode = FALSE;
             }
-            else if (FindMem (Buffer, 512, "Press any key to restart", 24) >= 0) {
+            else if (Found & BC(BC_PRESS_ANY_KEY)) {
                 // dummy FAT boot sector (created by Windows)
                 Volume->HasBootCode = FALSE;
             }
@@ -1431,7 +1844,7 @@ VOID ScanVolumeBootcode (
         #endif
 
         // check for MBR partition table
-        if (*((UINT16 *)(Buffer + 510)) == 0xaa55) {
+        if (Found & BC(BC_BOOT_SIGNATURE)) {
             MbrTable = (MBR_PARTITION_INFO *)(Buffer + 446);
             for (i = 0; i < 4; i++) {
                 if (MbrTable[i].StartLBA && MbrTable[i].Size) {
@@ -2245,8 +2658,9 @@ VOID VetSyncAPFS (VOID) {
         #endif
     }
     else {
-        UINTN i, j;
+        UINTN i;
         UINTN numRemapped = 0;
+        REFIT_VOLUME *SystemVolume;
 
         #if REFIT_DEBUG > 0
         LOG2(1, LOG_LINE_THIN_SEP, L"\n", L":\n", L"ReMap APFS Volumes");
@@ -2258,14 +2672,15 @@ VOID VetSyncAPFS (VOID) {
         // Filter '- Data' string tag out of Volume Group name if present
         for (i = 0; i < DataVolumesCount; i++) {
             LOG2(2, LOG_LINE_NORMAL, L"  - ", L"\n", L"Data Volume:- '%s'", GetPoolStr (&DataVolumes[i]->VolName));
-            for (j = 0; j < SystemVolumesCount; j++) {
-                if (GuidsAreEqual (&DataVolumes[i]->VolGroup, &SystemVolumes[j]->VolGroup)) {
-                    CopyFromPoolStr (&DataVolumes[i]->VolName, &SystemVolumes[j]->VolName);
-                    LOG2(2, LOG_LINE_NORMAL, L"  - ", L"\n", L"            > '%s'", GetPoolStr (&DataVolumes[i]->VolName));
-                    numRemapped++;
-                    break;
-                }
-            } // for j = 0
+            SystemVolume = VolumeIndexFind (
+                SystemVolumes, SystemVolumesCount,
+                VOLUME_KEY_VOL_GROUP, &DataVolumes[i]->VolGroup
+            );
+            if (SystemVolume != NULL) {
+                CopyFromPoolStr (&DataVolumes[i]->VolName, &SystemVolume->VolName);
+                LOG2(2, LOG_LINE_NORMAL, L"  - ", L"\n", L"            > '%s'", GetPoolStr (&DataVolumes[i]->VolName));
+                numRemapped++;
+            }
         } // for i = 0
 
         #if REFIT_DEBUG > 0
@@ -2300,9 +2715,15 @@ CHAR16 * GetApfsRoleString (
 VOID ScanVolumes (VOID) {
     EFI_STATUS          Status;
     EFI_HANDLE         *Handles = NULL;
+    EFI_HANDLE         *ReadHandles = NULL;
     REFIT_VOLUME       *Volume = NULL;
     REFIT_VOLUME       *WholeDiskVolume = NULL;
+    REFIT_VOLUME      **OldVolumes = NULL;
+    REFIT_VOLUME      **KeptVolumes = NULL;
     MBR_PARTITION_INFO *MbrTable;
+    VOLUME_HANDLE_STATE *HandleStates = NULL;
+    UINTN               OldVolumesCount = 0;
+    UINTN               ReadCount;
     UINTN               HandleCount = 0;
     UINTN               HandleIndex;
     UINTN               VolumeIndex;
@@ -2314,12 +2735,15 @@ VOID ScanVolumes (VOID) {
     CHAR16             *RoleStr      = NULL;
     CHAR16             *PartType     = NULL;
     BOOLEAN             DupFlag;
-    EFI_GUID           *UuidList;
+    GUID_SET            UuidSet;
     EFI_GUID            VolumeGuid;
     EFI_GUID            VolumeGroup;
     APPLE_APFS_VOLUME_ROLE VolumeRole;
 
     LOGPROCENTRY();
+    PROFILE_BEGIN("ScanVolumes");
+
+    ZeroMem (&UuidSet, sizeof (UuidSet));
 
     #if REFIT_DEBUG > 0
     CHAR16  *PartName      = NULL;
@@ -2341,10 +2765,11 @@ VOID ScanVolumes (VOID) {
 
     if (SelfVolRun) {
         // Clear Volume Lists if not Scanning for Self Volume
-        FreeVolumes (
-            &Volumes,
-            &VolumesCount
-        );
+        // Keep the old main list until unchanged volumes are picked from it
+        OldVolumes      = Volumes;
+        OldVolumesCount = VolumesCount;
+        Volumes         = NULL;
+        VolumesCount    = 0;
 
         FreeVolumes (
             &RecoveryVolumes,
@@ -2392,19 +2817,49 @@ VOID ScanVolumes (VOID) {
     );
     #endif
 
-    UuidList = AllocateZeroPool (sizeof (EFI_GUID) * HandleCount);
-    if (UuidList == NULL) {
+    if (!GuidSetInit (&UuidSet, HandleCount)) {
+        #if REFIT_DEBUG > 0
+        LOG(1, LOG_BLANK_LINE_SEP, L"X");
+        LOG3(1, LOG_THREE_STAR_SEP, L"\n\n** WARN: ", L"\n\n", L"!!", L"In ScanVolumes ... '%r' While Allocating 'UuidSet'", EFI_BUFFER_TOO_SMALL);
+        #endif
+
+        goto Done;
+    }
+
+    HandleStates = AllocateZeroPool (sizeof (VOLUME_HANDLE_STATE) * HandleCount);
+    KeptVolumes  = AllocateZeroPool (sizeof (REFIT_VOLUME *) * HandleCount);
+    ReadHandles  = AllocatePool (sizeof (EFI_HANDLE) * HandleCount);
+    if (HandleStates == NULL || KeptVolumes == NULL || ReadHandles == NULL) {
         #if REFIT_DEBUG > 0
         LOG(1, LOG_BLANK_LINE_SEP, L"X");
-        LOG3(1, LOG_THREE_STAR_SEP, L"\n\n** WARN: ", L"\n\n", L"!!", L"In ScanVolumes ... '%r' While Allocating 'UuidList'", EFI_BUFFER_TOO_SMALL);
+        LOG3(1, LOG_THREE_STAR_SEP, L"\n\n** WARN: ", L"\n\n", L"!!", L"In ScanVolumes ... '%r' While Allocating 'HandleStates'", EFI_BUFFER_TOO_SMALL);
         #endif
 
+        GuidSetFree (&UuidSet);
+        MY_FREE_POOL(Handles);
+
         goto Done;
     }
 
+    // find volumes from the last scan whose handles have not changed
+    ReadCount = 0;
+    for (HandleIndex = 0; HandleIndex < HandleCount; HandleIndex++) {
+        GetVolumeHandleState (Handles[HandleIndex], &HandleStates[HandleIndex]);
+        KeptVolumes[HandleIndex] = FindUnchangedVolume (
+            OldVolumes, OldVolumesCount,
+            &HandleStates[HandleIndex]
+        );
+        if (KeptVolumes[HandleIndex] == NULL) {
+            ReadHandles[ReadCount++] = Handles[HandleIndex];
+        }
+    }
+
     // first pass: collect information about all handles
     ScannedOnce = FALSE;
 
+    // queue boot sector reads on all handles to be scanned so slow devices overlap
+    StartBootSectorReads (ReadHandles, ReadCount);
+
     LOGBLOCKENTRY("ScanVolumes first pass [%d]", HandleCount);
     for (HandleIndex = 0; HandleIndex < HandleCount; HandleIndex++) {
         LOGBLOCKENTRY("Volumes[%d]", HandleIndex);
@@ -2413,45 +2868,55 @@ VOID ScanVolumes (VOID) {
         LOG(2, LOG_THREE_STAR_SEP, L"NEXT VOLUME");
         #endif
 
-        AllocateVolume (&Volume);
-        if (Volume == NULL) {
+        if (KeptVolumes[HandleIndex] != NULL) {
+            // Unchanged since the last scan ... Keep the volume as it is
+            AssignVolume (&Volume, KeptVolumes[HandleIndex]);
+            AddPartitionTable (Volume);
+            Volume->IsReadable = (Volume->RootDir != NULL);
+
             #if REFIT_DEBUG > 0
-            LOG(1, LOG_BLANK_LINE_SEP, L"X");
-            LOG3(1, LOG_THREE_STAR_SEP, L"\n\n** WARN: ", L"\n\n", L"!!", L"In ScanVolumes ... '%r' While Allocating 'Volumes'", EFI_BUFFER_TOO_SMALL);
+            LOG(2, LOG_LINE_NORMAL,
+                L"Kept Unchanged Volume:- '%s'",
+                GetPoolStr (&Volume->VolName)
+            );
             #endif
-
-            goto Done;
         }
+        else {
+            AllocateVolume (&Volume);
+            if (Volume == NULL) {
+                #if REFIT_DEBUG > 0
+                LOG(1, LOG_BLANK_LINE_SEP, L"X");
+                LOG3(1, LOG_THREE_STAR_SEP, L"\n\n** WARN: ", L"\n\n", L"!!", L"In ScanVolumes ... '%r' While Allocating 'Volumes'", EFI_BUFFER_TOO_SMALL);
+                #endif
+
+                goto Done;
+            }
 
-        Volume->DeviceHandle = Handles[HandleIndex];
-        AddPartitionTable (Volume);
-        ScanVolume (Volume);
+            // New or changed media ... do not trust what was read from the handle before
+            ForgetVolumeLoaderInfo (Handles[HandleIndex]);
 
-        UuidList[HandleIndex] = Volume->VolUuid;
+            Volume->DeviceHandle = Handles[HandleIndex];
+            AddPartitionTable (Volume);
+            ScanVolume (Volume);
+        }
+
+        if (KeptVolumes[HandleIndex] == NULL) {
+            HandleStates[HandleIndex].VolUuid = Volume->VolUuid;
+        }
         // Deduplicate filesystem UUID so that we do not add duplicate entries for file systems
         // that are part of RAID mirrors. Do not deduplicate ESP partitions though, since unlike
         // normal file systems they are likely to all share the same volume UUID, and it is also
         // unlikely that they are part of software RAID mirrors.
-        for (i = 0; i < HandleIndex; i++) {
-            if (GlobalConfig.ScanAllESP) {
-                DupFlag = (
-                    (!GuidsAreEqual (&(Volume->PartTypeGuid), &GuidESP)) &&
-                    (CompareMem (&(Volume->VolUuid), &(UuidList[i]), sizeof (EFI_GUID)) == 0) &&
-                    (CompareMem (&(Volume->VolUuid), &GuidNull,      sizeof (EFI_GUID)) != 0)
-                );
-            }
-            else {
-                DupFlag = (
-                    (CompareMem (&(Volume->VolUuid), &(UuidList[i]), sizeof (EFI_GUID)) == 0) &&
-                    (CompareMem (&(Volume->VolUuid), &GuidNull,      sizeof (EFI_GUID)) != 0)
-                );
-            }
+        DupFlag = GuidSetContains (&UuidSet, &(HandleStates[HandleIndex].VolUuid));
+        if (GlobalConfig.ScanAllESP && GuidsAreEqual (&(Volume->PartTypeGuid), &GuidESP)) {
+            DupFlag = FALSE;
+        }
+        GuidSetAdd (&UuidSet, &(HandleStates[HandleIndex].VolUuid));
 
-            if (DupFlag) {
-                // This is a duplicate filesystem item
-                Volume->IsReadable = FALSE;
-            }
-        } // for
+        if (DupFlag) {
+            // This is a duplicate filesystem item
+            Volume->IsReadable = FALSE;
+        }
 
         if (SelfVolRun) {
             // Update/Create Volumes List if not Scanning for Self Volume
@@ -2616,7 +3081,17 @@ VOID ScanVolumes (VOID) {
     } // for: first pass
     LOGBLOCKEXIT("ScanVolumes first pass");
 
-    MY_FREE_POOL(UuidList);
+    FinishBootSectorReads();
+
+    if (SelfVolRun) {
+        // Remember the handles for the next scan
+        MY_FREE_POOL(VolumeHandleStates);
+        VolumeHandleStates     = HandleStates;
+        VolumeHandleStateCount = HandleCount;
+        HandleStates           = NULL;
+    }
+
+    GuidSetFree (&UuidSet);
     MY_FREE_POOL(Handles);
 
     if (!SelfVolSet || !SelfVolRun) {
@@ -2762,6 +3237,23 @@ VOID ScanVolumes (VOID) {
     }
 
 Done:
+    // in case the first pass was left early
+    FinishBootSectorReads();
+    GuidSetFree (&UuidSet);
+
+    // Names, UUIDs and handles of listed volumes may have been updated
+    VolumeIndexInvalidate();
+
+    // Volumes not kept from the last scan are released here
+    FreeVolumes (
+        &OldVolumes,
+        &OldVolumesCount
+    );
+
+    MY_FREE_POOL(HandleStates);
+    MY_FREE_POOL(KeptVolumes);
+    MY_FREE_POOL(ReadHandles);
+
     // since Volume started as NULL, free it if it is not NULL
     FreeVolume (&Volume);
     // since WholeDiskVolume started as NULL, free it if it is not NULL
@@ -2772,13 +3264,14 @@ Done:
     LEAKABLEPARTITIONS();
 #endif
 
+    PROFILE_END("ScanVolumes");
     LOGPROCEXIT();
 } // VOID ScanVolumes()
 
 static
 VOID GetVolumeBadgeIcons (VOID) {
     LOGPROCENTRY();
-    UINTN         i, VolumeIndex;
+    UINTN         VolumeIndex;
     BOOLEAN       FoundSysVol = FALSE;
     REFIT_VOLUME *Volume;
 
@@ -2811,13 +3304,12 @@ VOID GetVolumeBadgeIcons (VOID) {
         Volume = Volumes[VolumeIndex];
 
         if (GlobalConfig.SyncAPFS && Volume->FSType == FS_TYPE_APFS) {
-            FoundSysVol = FALSE;
-            for (i = 0; i < SystemVolumesCount; i++) {
-                if (GuidsAreEqual (&(SystemVolumes[i]->VolUuid), &(Volume->VolUuid))) {
-                    FoundSysVol = TRUE;
-                    break;
-                }
-            }
+            FoundSysVol = (
+                VolumeIndexFind (
+                    SystemVolumes, SystemVolumesCount,
+                    VOLUME_KEY_VOL_UUID, &(Volume->VolUuid)
+                ) != NULL
+            );
 
             // Skip APFS system volumes when SyncAPFS is active
             if (FoundSysVol) {
@@ -3005,33 +3497,153 @@ BOOLEAN FileExists (
     return FALSE;
 }
 
+// File digests are kept against the volume, path, size and modification
+// time of the file so that each file is read at most once per boot.
+typedef struct {
+    EFI_HANDLE   DeviceHandle;
+    CHAR16      *FullName;
+    UINT64       FileSize;
+    EFI_TIME     ModificationTime;
+    UINT8        Digest[SHA256_DIGEST_SIZE];
+} FILE_DIGEST;
+
+#define FILE_DIGEST_CHUNK_SIZE  (64 * 1024)
+
+static FILE_DIGEST  *FileDigests     = NULL;
+static UINTN         FileDigestCount = 0;
+
+// Gets the SHA-256 digest of a file whose directory entry is FileInfo.
+// FileHandle may be an open handle on the file or NULL to have it opened here.
+// The file is read in fixed size chunks and only if no digest is cached for it.
+// Returns FALSE if the file could not be read in full.
+BOOLEAN GetFileDigest (
+    IN  REFIT_VOLUME    *Volume,
+    IN  CHAR16          *FullName,
+    IN  EFI_FILE_HANDLE  FileHandle OPTIONAL,
+    IN  EFI_FILE_INFO   *FileInfo,
+    OUT UINT8           *Digest
+) {
+    EFI_STATUS    Status;
+    FILE_DIGEST   NewDigest;
+    REFIT_SHA256  Context;
+    UINT8        *Chunk;
+    UINT64        Total       = 0;
+    UINTN         Size;
+    UINTN         i;
+    BOOLEAN       CloseHandle = FALSE;
+
+    if ((Volume == NULL) || (FullName == NULL) || (FileInfo == NULL)) {
+        return FALSE;
+    }
+
+    for (i = 0; i < FileDigestCount; i++) {
+        if ((FileDigests[i].DeviceHandle == Volume->DeviceHandle) &&
+            (FileDigests[i].FileSize     == FileInfo->FileSize) &&
+            (CompareMem (
+                &FileDigests[i].ModificationTime,
+                &FileInfo->ModificationTime,
+                sizeof (EFI_TIME)
+            ) == 0) &&
+            MyStriCmp (FileDigests[i].FullName, FullName)
+        ) {
+            CopyMem (Digest, FileDigests[i].Digest, SHA256_DIGEST_SIZE);
+
+            return TRUE;
+        }
+    } // for
+
+    if (FileHandle == NULL) {
+        LEAKABLEEXTERNALSTART ("GetFileDigest Open");
+        Status = REFIT_CALL_5_WRAPPER(
+            Volume->RootDir->Open, Volume->RootDir,
+            &FileHandle, FullName,
+            EFI_FILE_MODE_READ, 0
+        );
+        LEAKABLEEXTERNALSTOP ();
+        if (EFI_ERROR(Status)) {
+            return FALSE;
+        }
+
+        CloseHandle = TRUE;
+    }
+    else {
+        Status = REFIT_CALL_2_WRAPPER(FileHandle->SetPosition, FileHandle, 0);
+    }
+
+    Chunk = AllocatePool (FILE_DIGEST_CHUNK_SIZE);
+    if (Chunk == NULL) {
+        Status = EFI_OUT_OF_RESOURCES;
+    }
+
+    RefitSha256Init (&Context);
+    while (!EFI_ERROR(Status)) {
+        Size   = FILE_DIGEST_CHUNK_SIZE;
+        Status = REFIT_CALL_3_WRAPPER(FileHandle->Read, FileHandle, &Size, Chunk);
+        if (EFI_ERROR(Status) || (Size == 0)) {
+            break;
+        }
+
+        RefitSha256Update (&Context, Chunk, Size);
+        Total += Size;
+    } // while
+
+    MY_FREE_POOL(Chunk);
+    if (CloseHandle) {
+        REFIT_CALL_1_WRAPPER(FileHandle->Close, FileHandle);
+    }
+
+    if (EFI_ERROR(Status) || (Total != FileInfo->FileSize)) {
+        return FALSE;
+    }
+
+    RefitSha256Final (&Context, Digest);
+
+    NewDigest.DeviceHandle = Volume->DeviceHandle;
+    NewDigest.FullName     = StrDuplicate (FullName);
+    NewDigest.FileSize     = FileInfo->FileSize;
+    CopyMem (&NewDigest.ModificationTime, &FileInfo->ModificationTime, sizeof (EFI_TIME));
+    CopyMem (NewDigest.Digest, Digest, SHA256_DIGEST_SIZE);
+    if (NewDigest.FullName != NULL) {
+        AddListElementSized ((VOID **) &FileDigests, &FileDigestCount, &NewDigest, sizeof (FILE_DIGEST));
+    }
+
+    return TRUE;
+} // BOOLEAN GetFileDigest()
+
+// Reads the next entry into the iterator's buffer, growing it as needed.
+// The buffer is kept for later entries, so no allocation is made once it is
+// big enough for the longest name in the directory.
 static
 EFI_STATUS DirNextEntry (
-    IN  EFI_FILE       *Directory,
-    OUT EFI_FILE_INFO **DirEntry,
-    IN  UINTN           FilterMode
+    IN OUT REFIT_DIR_ITER  *DirIter,
+    OUT    EFI_FILE_INFO  **DirEntry,
+    IN     UINTN            FilterMode
 ) {
-    VOID       *Buffer;
-    UINTN       LastBufferSize;
     UINTN       BufferSize;
     INTN        IterCount;
 
     EFI_STATUS Status = EFI_BAD_BUFFER_SIZE;
     *DirEntry = NULL;
-    for (;;) {
-        // read next directory entry
-        LastBufferSize = BufferSize = 256;
-        Buffer         = AllocatePool (BufferSize);
-        if (Buffer == NULL) {
+
+    if (DirIter->Buffer == NULL) {
+        DirIter->BufferSize = DIR_ITER_BUFFER_SIZE;
+        DirIter->Buffer     = AllocatePool (DirIter->BufferSize);
+        if (DirIter->Buffer == NULL) {
+            DirIter->BufferSize = 0;
             return EFI_BAD_BUFFER_SIZE;
         }
+    }
 
+    for (;;) {
+        // read next directory entry
         for (IterCount = 0; ; IterCount++) {
+            BufferSize = DirIter->BufferSize;
+
             LEAKABLEEXTERNALSTART ("DirNextEntry Read");
             Status = REFIT_CALL_3_WRAPPER(
-                Directory->Read, Directory,
+                DirIter->DirHandle->Read, DirIter->DirHandle,
                 &BufferSize,
-                Buffer
+                DirIter->Buffer
             );
             LEAKABLEEXTERNALSTOP ();
 
@@ -3039,34 +3651,39 @@ EFI_STATUS DirNextEntry (
                 break;
             }
 
-            if (BufferSize <= LastBufferSize) {
+            if (BufferSize <= DirIter->BufferSize) {
                 #if REFIT_DEBUG > 0
                 LOG2(2, LOG_LINE_NORMAL, L"\n", L"", L"FS Driver Requests Bad Buffer Size %d (was %d) ... Using %d Instead",
                     BufferSize,
-                    LastBufferSize,
-                    LastBufferSize * 2
+                    DirIter->BufferSize,
+                    DirIter->BufferSize * 2
                 );
                 #endif
 
-                BufferSize = LastBufferSize * 2;
+                BufferSize = DirIter->BufferSize * 2;
             }
             else {
                 #if REFIT_DEBUG > 0
                 if (IterCount > 0) {
                     LOG2(2, LOG_LINE_NORMAL, L"\n", L"\n", L"Reallocating Buffer from %d to %d",
-                        LastBufferSize, BufferSize
+                        DirIter->BufferSize, BufferSize
                     );
                 }
                 #endif
             }
-            Buffer = EfiReallocatePool (
-                Buffer, LastBufferSize, BufferSize
+
+            // The old buffer is released even if this fails
+            DirIter->Buffer = EfiReallocatePool (
+                DirIter->Buffer, DirIter->BufferSize, BufferSize
             );
-            LastBufferSize = BufferSize;
+            if (DirIter->Buffer == NULL) {
+                DirIter->BufferSize = 0;
+                return EFI_BAD_BUFFER_SIZE;
+            }
+            DirIter->BufferSize = BufferSize;
         }
 
         if (EFI_ERROR(Status)) {
-            MY_FREE_POOL(Buffer);
             break;
         }
 
@@ -3074,12 +3691,11 @@ EFI_STATUS DirNextEntry (
 
         if (BufferSize == 0) {
             // end of directory listing
-            MY_FREE_POOL(Buffer);
             break;
         }
 
         // entry is ready to be returned
-        *DirEntry = (EFI_FILE_INFO *)Buffer;
+        *DirEntry = DirIter->Buffer;
 
         // filter results
         if (FilterMode == 1) {
@@ -3098,7 +3714,7 @@ EFI_STATUS DirNextEntry (
             // no filter or unknown filter -> return everything
             break;
         }
-        MY_FREE_POOL(*DirEntry);
+        *DirEntry = NULL;
     } // for ;;
 
     return Status;
@@ -3109,6 +3725,9 @@ VOID DirIterOpen (
     IN  CHAR16          *RelativePath OPTIONAL,
     OUT REFIT_DIR_ITER  *DirIter
 ) {
+    DirIter->Buffer     = NULL;
+    DirIter->BufferSize = 0;
+
     if (RelativePath == NULL) {
         DirIter->LastStatus     = EFI_SUCCESS;
         DirIter->DirHandle      = BaseDir;
@@ -3126,65 +3745,301 @@ VOID DirIterOpen (
     }
 }
 
-#ifndef __MAKEWITH_GNUEFI
-EFI_UNICODE_COLLATION_PROTOCOL *mUnicodeCollation = NULL;
-
+// Upper cases a character as the English Unicode Collation Protocol does.
+static
+CHAR16 FoldPatternChar (
+    IN CHAR16 Char
+) {
+    return ((Char >= L'a') && (Char <= L'z')) ? (Char - (L'a' - L'A')) : Char;
+} // static CHAR16 FoldPatternChar()
+
+// Tests an upper cased character against the '[...]' set starting just
+// after the opening bracket at 'Set'. Members and ranges are read exactly as
+// the collation protocol's MetaiMatch reads them, so a range runs from the
+// previous member (or from 0) and a malformed range fails the match.
+// On success, '*Next' is set past the closing bracket.
 static
-EFI_STATUS InitializeUnicodeCollationProtocol (VOID) {
-   EFI_STATUS  Status;
+BOOLEAN MatchPatternSet (
+    IN  CHAR16  *Set,
+    IN  CHAR16  *PatternEnd,
+    IN  CHAR16   Char,
+    OUT CHAR16 **Next
+) {
+    CHAR16  *Cur;
+    CHAR16   Low   = 0;
+    BOOLEAN  Found = FALSE;
+
+    for (Cur = Set; !Found && (Cur < PatternEnd) && (*Cur != L']'); Cur++) {
+        if (*Cur == L'-') {
+            if ((Cur + 1 >= PatternEnd) || (Cur[1] == L']')) {
+                return FALSE;
+            }
+            Found = ((Char >= Low) && (Char <= Cur[1])) || (Char == Cur[1]);
+            Low   = Cur[1];
 
-   if (mUnicodeCollation != NULL) {
-      return EFI_SUCCESS;
-   }
+            // The upper bound is then read again, so it may itself be a '-'
+            continue;
+        }
 
-   //
-   // BUGBUG: Proper impelmentation is to locate all Unicode Collation Protocol
-   // instances first and then select one which support English language.
-   // Current implementation just pick the first instance.
-   //
-   Status = REFIT_CALL_3_WRAPPER(
-       gBS->LocateProtocol,
-       &gEfiUnicodeCollation2ProtocolGuid,
-       NULL,
-       (VOID **) &mUnicodeCollation
-   );
-   if (EFI_ERROR(Status)) {
-       Status = REFIT_CALL_3_WRAPPER(
-           gBS->LocateProtocol,
-           &gEfiUnicodeCollationProtocolGuid,
-           NULL,
-           (VOID **) &mUnicodeCollation
-       );
-   }
+        Low   = *Cur;
+        Found = (Char == *Cur);
+    } // for
 
-   return Status;
-}
+    if (!Found) {
+        return FALSE;
+    }
+
+    while ((Cur < PatternEnd) && (*Cur != L']')) {
+        Cur++;
+    }
+    *Next = Cur + 1;
 
+    return TRUE;
+} // static BOOLEAN MatchPatternSet()
+
+// Matches the name span [Name, NameEnd) against the upper cased pattern span
+// [Pattern, PatternEnd). Every element other than '*' takes exactly one
+// character, so backtracking to the last '*' seen is enough and no
+// recursion is needed.
 static
-BOOLEAN MetaiMatch (
-    IN CHAR16 *String,
-    IN CHAR16 *Pattern
+BOOLEAN MatchPatternSpan (
+    IN CHAR16 *Pattern,
+    IN CHAR16 *PatternEnd,
+    IN CHAR16 *Name,
+    IN CHAR16 *NameEnd
 ) {
-   if (!mUnicodeCollation) {
-      InitializeUnicodeCollationProtocol();
-   }
-   if (mUnicodeCollation) {
-       return mUnicodeCollation->MetaiMatch (mUnicodeCollation, String, Pattern);
-   }
+    CHAR16  *StarPattern = NULL;
+    CHAR16  *StarName    = NULL;
+    CHAR16  *Next;
+    CHAR16   Char;
+    BOOLEAN  Matched;
 
-   // Should not happen
-   return FALSE;
-}
+    for (;;) {
+        if ((Pattern < PatternEnd) && (*Pattern == L'*')) {
+            StarPattern = ++Pattern;
+            StarName    = Name;
+            continue;
+        }
 
-#endif
+        if (Name == NameEnd) {
+            return (Pattern == PatternEnd);
+        }
+
+        Matched = FALSE;
+        if (Pattern < PatternEnd) {
+            Char = FoldPatternChar (*Name);
+            Next = Pattern + 1;
+            if (*Pattern == L'?') {
+                Matched = TRUE;
+            }
+            else if (*Pattern == L'[') {
+                Matched = MatchPatternSet (Pattern + 1, PatternEnd, Char, &Next);
+            }
+            else {
+                Matched = (Char == *Pattern);
+            }
+        }
+
+        if (Matched) {
+            Pattern = Next;
+            Name++;
+            continue;
+        }
+
+        if (StarPattern == NULL) {
+            return FALSE;
+        }
+
+        // Let the last '*' take one more character and retry from there
+        Pattern = StarPattern;
+        Name    = ++StarName;
+    } // for
+} // static BOOLEAN MatchPatternSpan()
+
+// Splits a comma-delimited file pattern list, as used by DirIterNext, into
+// upper cased patterns. The literal characters at each end of a pattern and
+// the shortest name it can match are noted so that most names are rejected
+// without walking the wildcards. A NULL FilePattern yields a set that
+// matches everything. A pattern with an unterminated '[' set is dropped,
+// as the collation protocol reads past the end of such a pattern.
+VOID FilePatternSetCompile (
+    IN  CHAR16           *FilePattern OPTIONAL,
+    OUT FILE_PATTERN_SET *PatternSet
+) {
+    FILE_PATTERN  *Compiled;
+    CHAR16        *OnePattern;
+    UINTN          Capacity = 0;
+    UINTN          Start, LastWildEnd, i, j;
+    BOOLEAN        Wild, Dropped;
+
+    ZeroMem (PatternSet, sizeof (FILE_PATTERN_SET));
+
+    if (FilePattern == NULL) {
+        return;
+    }
+
+    PatternSet->Source = StrDuplicate (FilePattern);
+
+    j = 0;
+    while ((OnePattern = FindCommaDelimited (FilePattern, j++)) != NULL) {
+        if (PatternSet->Count == Capacity) {
+            Capacity = (Capacity == 0) ? 4 : Capacity * 2;
+            Compiled = ReallocatePool (
+                PatternSet->Count * sizeof (FILE_PATTERN),
+                Capacity * sizeof (FILE_PATTERN),
+                PatternSet->Patterns
+            );
+            if (Compiled == NULL) {
+                MY_FREE_POOL(OnePattern);
+                break;
+            }
+            PatternSet->Patterns = Compiled;
+        }
+
+        Compiled = &PatternSet->Patterns[PatternSet->Count];
+        ZeroMem (Compiled, sizeof (FILE_PATTERN));
+        Compiled->Pattern = OnePattern;
+        Compiled->Length  = StrLen (OnePattern);
+        Compiled->Fixed   = TRUE;
+
+        Wild = Dropped = FALSE;
+        LastWildEnd = 0;
+        for (i = 0; i < Compiled->Length; ) {
+            Start = i;
+            OnePattern[i] = FoldPatternChar (OnePattern[i]);
+            if (OnePattern[i] == L'*') {
+                Compiled->Fixed = FALSE;
+                i++;
+            }
+            else if (OnePattern[i] == L'?') {
+                Compiled->MinLength++;
+                i++;
+            }
+            else if (OnePattern[i] == L'[') {
+                for (i++; (i < Compiled->Length) && (OnePattern[i] != L']'); i++) {
+                    OnePattern[i] = FoldPatternChar (OnePattern[i]);
+                }
+                if (i == Compiled->Length) {
+                    Dropped = TRUE;
+                    break;
+                }
+                Compiled->MinLength++;
+                i++;
+            }
+            else {
+                Compiled->MinLength++;
+                i++;
+                continue;
+            }
+
+            if (!Wild) {
+                Wild = TRUE;
+                Compiled->PrefixLength = Start;
+            }
+            LastWildEnd = i;
+        } // for
+
+        if (Dropped) {
+            #if REFIT_DEBUG > 0
+            LOG(2, LOG_LINE_NORMAL, L"Ignoring Unterminated File Pattern '%s'", OnePattern);
+            #endif
+
+            MY_FREE_POOL(Compiled->Pattern);
+            continue;
+        }
+
+        if (!Wild) {
+            Compiled->PrefixLength = Compiled->Length;
+        }
+        else {
+            Compiled->SuffixLength = Compiled->Length - LastWildEnd;
+        }
+
+        PatternSet->Count++;
+    } // while
+} // VOID FilePatternSetCompile()
+
+// Returns TRUE if FileName matches any pattern in the set, or if the set
+// was compiled from a NULL pattern list.
+BOOLEAN FilePatternSetMatch (
+    IN FILE_PATTERN_SET *PatternSet,
+    IN CHAR16           *FileName
+) {
+    FILE_PATTERN  *Compiled;
+    CHAR16        *NameEnd;
+    UINTN          NameLength;
+    UINTN          i, j;
+
+    if (PatternSet->Source == NULL) {
+        return TRUE;
+    }
+
+    NameLength = StrLen (FileName);
+    NameEnd    = FileName + NameLength;
+
+    for (i = 0; i < PatternSet->Count; i++) {
+        Compiled = &PatternSet->Patterns[i];
+        if ((NameLength < Compiled->MinLength) ||
+            (Compiled->Fixed && (NameLength != Compiled->MinLength))
+        ) {
+            continue;
+        }
+
+        for (j = 0; j < Compiled->PrefixLength; j++) {
+            if (FoldPatternChar (FileName[j]) != Compiled->Pattern[j]) {
+                break;
+            }
+        }
+        if (j < Compiled->PrefixLength) {
+            continue;
+        }
+
+        for (j = 1; j <= Compiled->SuffixLength; j++) {
+            if (FoldPatternChar (NameEnd[-(INTN) j]) != Compiled->Pattern[Compiled->Length - j]) {
+                break;
+            }
+        }
+        if (j <= Compiled->SuffixLength) {
+            continue;
+        }
 
+        if (MatchPatternSpan (
+                Compiled->Pattern + Compiled->PrefixLength,
+                Compiled->Pattern + Compiled->Length - Compiled->SuffixLength,
+                FileName + Compiled->PrefixLength,
+                NameEnd - Compiled->SuffixLength
+            )
+        ) {
+            return TRUE;
+        }
+    } // for
+
+    return FALSE;
+} // BOOLEAN FilePatternSetMatch()
+
+VOID FilePatternSetFree (
+    IN OUT FILE_PATTERN_SET *PatternSet
+) {
+    UINTN i;
+
+    for (i = 0; i < PatternSet->Count; i++) {
+        MY_FREE_POOL(PatternSet->Patterns[i].Pattern);
+    }
+
+    MY_FREE_POOL(PatternSet->Patterns);
+    MY_FREE_POOL(PatternSet->Source);
+    PatternSet->Count = 0;
+} // VOID FilePatternSetFree()
+
+// Returns the next entry that passes FilterMode and PatternSet.
+// The entry is held in the iterator's buffer and is only valid until the
+// next DirIterNext or DirIterClose call; callers must not free it.
 BOOLEAN DirIterNext (
-    IN  OUT REFIT_DIR_ITER  *DirIter,
-    IN      UINTN            FilterMode,
-    IN      CHAR16          *FilePattern OPTIONAL,
-        OUT EFI_FILE_INFO  **DirEntry
+    IN  OUT REFIT_DIR_ITER    *DirIter,
+    IN      UINTN              FilterMode,
+    IN      FILE_PATTERN_SET  *PatternSet OPTIONAL,
+        OUT EFI_FILE_INFO    **DirEntry
 ) {
-    CHAR16 *OnePattern;
     EFI_FILE_INFO *LastFileInfo;
 
     if (EFI_ERROR(DirIter->LastStatus)) {
@@ -3194,28 +4049,19 @@ BOOLEAN DirIterNext (
 
     for (;;) {
         DirIter->LastStatus = DirNextEntry (
-            DirIter->DirHandle,
+            DirIter,
             &LastFileInfo,
             FilterMode
         );
         if (EFI_ERROR(DirIter->LastStatus) || LastFileInfo == NULL) {
             return FALSE;
         }
-        if (FilePattern == NULL || LastFileInfo->Attribute & EFI_FILE_DIRECTORY) {
+        if (PatternSet == NULL || LastFileInfo->Attribute & EFI_FILE_DIRECTORY) {
             break;
         }
-        BOOLEAN Found = FALSE;
-        UINTN i = 0;
-        while (!Found && (OnePattern = FindCommaDelimited (FilePattern, i++)) != NULL) {
-           if (MetaiMatch (LastFileInfo->FileName, OnePattern)) {
-               Found = TRUE;
-           }
-               MY_FREE_POOL(OnePattern);
-        } // while
-        if (Found) {
+        if (FilePatternSetMatch (PatternSet, LastFileInfo->FileName)) {
             break;
         }
-        MY_FREE_POOL(LastFileInfo);
    } // for
 
     *DirEntry = LastFileInfo;
@@ -3228,10 +4074,176 @@ EFI_STATUS DirIterClose (
     if ((DirIter->CloseDirHandle) && (DirIter->DirHandle->Close)) {
         REFIT_CALL_1_WRAPPER(DirIter->DirHandle->Close, DirIter->DirHandle);
     }
+    DirIter->CloseDirHandle = FALSE;
+
+    MY_FREE_POOL(DirIter->Buffer);
+    DirIter->BufferSize = 0;
 
     return DirIter->LastStatus;
 }
 
+// Orders names as MyStriCmp compares them.
+static
+INTN CompareFoldedNames (
+    IN CHAR16 *Name1,
+    IN CHAR16 *Name2
+) {
+    while ((*Name1 != L'\0') && ((*Name1 & ~0x20) == (*Name2 & ~0x20))) {
+        Name1++;
+        Name2++;
+    }
+
+    return (INTN) (*Name1 & ~0x20) - (INTN) (*Name2 & ~0x20);
+} // static INTN CompareFoldedNames()
+
+// Reads every file entry in a directory with one enumeration, so later
+// existence checks on files in the directory need no further Open calls.
+// Snapshot->Status holds the status DirIterClose would have returned.
+VOID DirSnapshotOpen (
+    IN  EFI_FILE     *BaseDir,
+    IN  CHAR16       *RelativePath OPTIONAL,
+    OUT DIR_SNAPSHOT *Snapshot
+) {
+    REFIT_DIR_ITER       DirIter;
+    EFI_FILE_INFO       *DirEntry;
+    DIR_SNAPSHOT_ENTRY  *NewEntries;
+    UINT8               *NewArena;
+    UINT8               *Arena     = NULL;
+    UINTN                ArenaSize = 0;
+    UINTN                ArenaUsed = 0;
+    UINTN                Capacity  = 0;
+    UINTN                EntrySize, SlotSize, NewSize;
+    UINTN                Low, High, Mid, i;
+
+    ZeroMem (Snapshot, sizeof (DIR_SNAPSHOT));
+
+    // The entries are packed into one arena, so the directory costs a few
+    // allocations however many files it holds
+    DirIterOpen (BaseDir, RelativePath, &DirIter);
+    while (DirIterNext (&DirIter, 2, NULL, &DirEntry)) {
+        if (Snapshot->Count == Capacity) {
+            Capacity   = (Capacity == 0) ? 32 : Capacity * 2;
+            NewEntries = ReallocatePool (
+                Snapshot->Count * sizeof (DIR_SNAPSHOT_ENTRY),
+                Capacity * sizeof (DIR_SNAPSHOT_ENTRY),
+                Snapshot->Entries
+            );
+            if (NewEntries == NULL) {
+                break;
+            }
+            Snapshot->Entries = NewEntries;
+        }
+
+        // Keep each entry's UINT64 fields aligned
+        EntrySize = SIZE_OF_EFI_FILE_INFO + StrSize (DirEntry->FileName);
+        SlotSize  = (EntrySize + 7) & ~((UINTN) 7);
+        if (ArenaUsed + SlotSize > ArenaSize) {
+            NewSize = (ArenaSize == 0) ? DIR_SNAPSHOT_ARENA_SIZE : ArenaSize * 2;
+            while (NewSize < ArenaUsed + SlotSize) {
+                NewSize *= 2;
+            }
+            NewArena = ReallocatePool (ArenaUsed, NewSize, Arena);
+            if (NewArena == NULL) {
+                break;
+            }
+            Arena     = NewArena;
+            ArenaSize = NewSize;
+        }
+        CopyMem (Arena + ArenaUsed, DirEntry, EntrySize);
+
+        // Info holds the arena offset until the arena stops moving
+        Snapshot->Entries[Snapshot->Count].Info  = (EFI_FILE_INFO *) ArenaUsed;
+        Snapshot->Entries[Snapshot->Count].Flags = 0;
+        Snapshot->Count++;
+
+        ArenaUsed += SlotSize;
+    } // while
+    Snapshot->Status = DirIterClose (&DirIter);
+
+    if (Snapshot->Count == 0) {
+        MY_FREE_POOL(Arena);
+        return;
+    }
+
+    Snapshot->Arena = Arena;
+    for (i = 0; i < Snapshot->Count; i++) {
+        Snapshot->Entries[i].Info = (EFI_FILE_INFO *) (Arena + (UINTN) Snapshot->Entries[i].Info);
+    }
+
+    Snapshot->Sorted = AllocatePool (Snapshot->Count * sizeof (DIR_SNAPSHOT_ENTRY *));
+    if (Snapshot->Sorted == NULL) {
+        return;
+    }
+
+    // Binary insertion; directories seldom hold more than a few hundred files
+    for (i = 0; i < Snapshot->Count; i++) {
+        Low  = 0;
+        High = i;
+        while (Low < High) {
+            Mid = (Low + High) / 2;
+            if (CompareFoldedNames (
+                    Snapshot->Sorted[Mid]->Info->FileName,
+                    Snapshot->Entries[i].Info->FileName
+                ) <= 0
+            ) {
+                Low = Mid + 1;
+            }
+            else {
+                High = Mid;
+            }
+        } // while
+
+        CopyMem (
+            &Snapshot->Sorted[Low + 1],
+            &Snapshot->Sorted[Low],
+            (i - Low) * sizeof (DIR_SNAPSHOT_ENTRY *)
+        );
+        Snapshot->Sorted[Low] = &Snapshot->Entries[i];
+    } // for
+} // VOID DirSnapshotOpen()
+
+// Returns the snapshot entry for FileName, matched case-insensitively,
+// or NULL if the directory holds no such file.
+DIR_SNAPSHOT_ENTRY * DirSnapshotFind (
+    IN DIR_SNAPSHOT *Snapshot,
+    IN CHAR16       *FileName
+) {
+    UINTN Low, High, Mid;
+    INTN  Order;
+
+    if ((Snapshot->Sorted == NULL) || (FileName == NULL)) {
+        return NULL;
+    }
+
+    Low  = 0;
+    High = Snapshot->Count;
+    while (Low < High) {
+        Mid   = (Low + High) / 2;
+        Order = CompareFoldedNames (FileName, Snapshot->Sorted[Mid]->Info->FileName);
+        if (Order == 0) {
+            return Snapshot->Sorted[Mid];
+        }
+
+        if (Order < 0) {
+            High = Mid;
+        }
+        else {
+            Low = Mid + 1;
+        }
+    } // while
+
+    return NULL;
+} // DIR_SNAPSHOT_ENTRY * DirSnapshotFind()
+
+VOID DirSnapshotFree (
+    IN OUT DIR_SNAPSHOT *Snapshot
+) {
+    MY_FREE_POOL(Snapshot->Arena);
+    MY_FREE_POOL(Snapshot->Entries);
+    MY_FREE_POOL(Snapshot->Sorted);
+    Snapshot->Count = 0;
+} // VOID DirSnapshotFree()
+
 //
 // file name manipulation
 //
@@ -3534,18 +4546,28 @@ BOOLEAN FindVolume (
     IN REFIT_VOLUME **Volume,
     IN CHAR16        *Identifier
 ) {
-    UINTN     i = 0;
-    BOOLEAN   Found = FALSE;
+    REFIT_VOLUME  *FoundVolume;
+    EFI_GUID       TargetVolGuid = NULL_GUID_VALUE;
 
-    while ((i < VolumesCount) && (!Found)) {
-        if (VolumeMatchesDescription (Volumes[i], Identifier)) {
-            AssignVolume (Volume, Volumes[i]);
-            Found   = TRUE;
-        }
-        i++;
+    if (Identifier == NULL) {
+        return FALSE;
     }
 
-    return (Found);
+    if (IsGuid (Identifier)) {
+        TargetVolGuid = StringAsGuid (Identifier);
+        FoundVolume   = VolumeIndexFind (Volumes, VolumesCount, VOLUME_KEY_PART_GUID, &TargetVolGuid);
+    }
+    else {
+        FoundVolume   = VolumeIndexFind (Volumes, VolumesCount, VOLUME_KEY_NAME, Identifier);
+    }
+
+    if (FoundVolume == NULL) {
+        return FALSE;
+    }
+
+    AssignVolume (Volume, FoundVolume);
+
+    return TRUE;
 } // static VOID FindVolume()
 
 // Returns TRUE if Description matches Volume's VolName, FsName, or (once
@@ -3584,33 +4606,30 @@ BOOLEAN FilenameIn (
     IN CHAR16       *Filename,
     IN CHAR16       *List
 ) {
+    UINTN           i;
+    CSV_LIST       *Compiled;
+    CSV_PATH_PARTS *Parts;
 
-    CHAR16    *OneElement;
-    CHAR16    *TargetVolName  = NULL;
-    CHAR16    *TargetPath     = NULL;
-    CHAR16    *TargetFilename = NULL;
-    UINTN      i              = 0;
-    BOOLEAN    Found          = FALSE;
-
-    if (Filename && List) {
-        while (!Found && (OneElement = FindCommaDelimited (List, i++))) {
-            Found = TRUE;
-            SplitPathName (OneElement, &TargetVolName, &TargetPath, &TargetFilename);
-            if ((TargetVolName  != NULL && !VolumeMatchesDescription (Volume, TargetVolName)) ||
-                (TargetPath     != NULL && !MyStriCmp (TargetPath, Directory)) ||
-                (TargetFilename != NULL && !MyStriCmp (TargetFilename, Filename))
-            ) {
-                Found = FALSE;
-            }
-            MY_FREE_POOL(OneElement);
-        }
+    if (!Filename || !List) {
+        return FALSE;
+    }
 
-        MY_FREE_POOL(TargetVolName);
-        MY_FREE_POOL(TargetPath);
-        MY_FREE_POOL(TargetFilename);
+    Compiled = GetCsvList (List);
+    Parts    = GetCsvListPathParts (Compiled);
+    if (Parts == NULL) {
+        return FALSE;
     }
 
-    return Found;
+    for (i = 0; i < Compiled->Count; i++) {
+        if ((Parts[i].VolName  == NULL || VolumeMatchesDescription (Volume, Parts[i].VolName)) &&
+            (Parts[i].Path     == NULL || MyStriCmp (Parts[i].Path, Directory)) &&
+            (Parts[i].Filename == NULL || MyStriCmp (Parts[i].Filename, Filename))
+        ) {
+            return TRUE;
+        }
+    } // for
+
+    return FALSE;
 } // BOOLEAN FilenameIn()
 
 // Eject all removable media.
@@ -3744,6 +4763,7 @@ AddToVolumeList (
         if (LOGPOOL(*Volumes));
     }
     if (LOGPOOL(Volume));
+    VolumeIndexForget (*Volumes);
     AddListElement ((VOID***)Volumes, VolumesCount, Volume);
     if (Volume) {
         RetainVolume (Volume);
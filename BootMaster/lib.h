@@ -71,12 +71,60 @@
 
 // types
 
+// Starting sizes in bytes of a directory iterator's entry buffer
+// and of a directory snapshot's entry arena
+#define DIR_ITER_BUFFER_SIZE      (512)
+#define DIR_SNAPSHOT_ARENA_SIZE   (4096)
+
+// 'Buffer' holds the entry last returned by DirIterNext and is reused
+// for each entry, so it is freed by DirIterClose rather than by callers.
 typedef struct {
     EFI_STATUS          LastStatus;
     EFI_FILE_HANDLE     DirHandle;
     BOOLEAN             CloseDirHandle;
+    EFI_FILE_INFO      *Buffer;
+    UINTN               BufferSize;
 } REFIT_DIR_ITER;
 
+// Flags recorded against a directory snapshot entry by whoever probes the file
+#define DIR_ENTRY_PROBED    (1)
+#define DIR_ENTRY_LOADER    (2)
+#define DIR_ENTRY_SYMLINK   (4)
+
+typedef struct {
+    EFI_FILE_INFO      *Info;
+    UINTN               Flags;
+} DIR_SNAPSHOT_ENTRY;
+
+// The files in a directory, read in one pass.
+// 'Entries' is in directory order and 'Sorted' by case folded name.
+// Each entry's 'Info' points into 'Arena'.
+typedef struct {
+    EFI_STATUS           Status;
+    UINTN                Count;
+    DIR_SNAPSHOT_ENTRY  *Entries;
+    DIR_SNAPSHOT_ENTRY **Sorted;
+    VOID                *Arena;
+} DIR_SNAPSHOT;
+
+// One upper cased element of a comma-delimited file pattern list.
+// 'PrefixLength' and 'SuffixLength' count the literal characters at each end.
+// 'Fixed' is set when there is no '*', so names must be 'MinLength' long.
+typedef struct {
+    CHAR16    *Pattern;
+    UINTN      Length;
+    UINTN      PrefixLength;
+    UINTN      SuffixLength;
+    UINTN      MinLength;
+    BOOLEAN    Fixed;
+} FILE_PATTERN;
+
+typedef struct {
+    CHAR16         *Source;
+    UINTN           Count;
+    FILE_PATTERN   *Patterns;
+} FILE_PATTERN_SET;
+
 #define DISK_KIND_INTERNAL  (0)
 #define DISK_KIND_EXTERNAL  (1)
 #define DISK_KIND_OPTICAL   (2)
@@ -122,6 +170,7 @@ EFI_STATUS EfivarSetRaw (
 );
 
 VOID ScanVolumes (VOID);
+VOID ForgetVolumeHandles (VOID);
 VOID ReinitVolumes (VOID);
 VOID UninitRefitLib (VOID);
 VOID SetVolumeIcons (VOID);
@@ -173,6 +222,17 @@ VOID DirIterOpen (
     IN  CHAR16         *RelativePath OPTIONAL,
     OUT REFIT_DIR_ITER *DirIter
 );
+VOID DirSnapshotOpen (
+    IN  EFI_FILE     *BaseDir,
+    IN  CHAR16       *RelativePath OPTIONAL,
+    OUT DIR_SNAPSHOT *Snapshot
+);
+VOID DirSnapshotFree (IN OUT DIR_SNAPSHOT *Snapshot);
+VOID FilePatternSetCompile (
+    IN  CHAR16           *FilePattern OPTIONAL,
+    OUT FILE_PATTERN_SET *PatternSet
+);
+VOID FilePatternSetFree (IN OUT FILE_PATTERN_SET *PatternSet);
 VOID FindVolumeAndFilename (
     IN  EFI_DEVICE_PATH  *loadpath,
     OUT REFIT_VOLUME    **DeviceVolume,
@@ -201,11 +261,21 @@ BOOLEAN FilenameIn (
     IN CHAR16       *List
 );
 BOOLEAN DirIterNext (
-    IN  OUT REFIT_DIR_ITER  *DirIter,
-    IN      UINTN            FilterMode,
-    IN      CHAR16          *FilePattern OPTIONAL,
-        OUT EFI_FILE_INFO  **DirEntry
+    IN  OUT REFIT_DIR_ITER    *DirIter,
+    IN      UINTN              FilterMode,
+    IN      FILE_PATTERN_SET  *PatternSet OPTIONAL,
+        OUT EFI_FILE_INFO    **DirEntry
+);
+BOOLEAN FilePatternSetMatch (IN FILE_PATTERN_SET *PatternSet, IN CHAR16 *FileName);
+BOOLEAN GetFileDigest (
+    IN  REFIT_VOLUME    *Volume,
+    IN  CHAR16          *FullName,
+    IN  EFI_FILE_HANDLE  FileHandle OPTIONAL,
+    IN  EFI_FILE_INFO   *FileInfo,
+    OUT UINT8           *Digest
 );
 
+DIR_SNAPSHOT_ENTRY * DirSnapshotFind (IN DIR_SNAPSHOT *Snapshot, IN CHAR16 *FileName);
+
 REFIT_VOLUME * CopyVolume (IN REFIT_VOLUME *VolumeToCopy);
 #endif
@@ -89,6 +89,7 @@ CHAR16 * FindInitrd (
     STRING_LIST         *CurrentInitrdName = NULL;
     EFI_FILE_INFO       *DirEntry;
     REFIT_DIR_ITER       DirIter;
+    FILE_PATTERN_SET     InitrdPatterns;
 
     LOGPROCENTRY("to match '%s' on '%s'", LoaderPath, GetPoolStr (&Volume->VolName));
     #if REFIT_DEBUG > 0
@@ -128,6 +129,7 @@ CHAR16 * FindInitrd (
 
     LOG(4, LOG_LINE_FORENSIC, L"In FindInitrd ... 6");
     DirIterOpen (Volume->RootDir, Path, &DirIter);
+    FilePatternSetCompile (L"init*,booster*", &InitrdPatterns);
 
     // Now add a trailing backslash if it was NOT added earlier, for consistency in
     // building the InitrdName later
@@ -139,7 +141,7 @@ CHAR16 * FindInitrd (
     }
 
     LOG(4, LOG_LINE_FORENSIC, L"In FindInitrd ... 8");
-    while (DirIterNext (&DirIter, 2, L"init*,booster*", &DirEntry)) {
+    while (DirIterNext (&DirIter, 2, &InitrdPatterns, &DirEntry)) {
         LOG(4, LOG_LINE_FORENSIC, L"In FindInitrd ... 8a 0");
         InitrdVersion = FindNumbers (DirEntry->FileName);
 
@@ -191,11 +193,12 @@ CHAR16 * FindInitrd (
         }
         LOG(4, LOG_LINE_FORENSIC, L"In FindInitrd ... 8a 2a 5");
         MY_FREE_POOL(InitrdVersion);
-        MY_FREE_POOL(DirEntry);
 
         LOG(4, LOG_LINE_FORENSIC, L"In FindInitrd ... 8a 3 - END WHILE LOOP");
         LOG(4, LOG_BLANK_LINE_SEP, L"X");
     } // while
+    DirIterClose (&DirIter);
+    FilePatternSetFree (&InitrdPatterns);
 
     LOG(4, LOG_LINE_FORENSIC, L"In FindInitrd ... 9");
     if (InitrdNames) {
@@ -378,9 +381,9 @@ CHAR16 * GetMainLinuxOptions (
 // /etc/lsb-release and /etc/os-release files.
 static
 VOID ParseReleaseFile (
-    CHAR16       **OSIconName,
-    REFIT_VOLUME  *Volume,
-    CHAR16        *FileName
+    STRING_BUILDER *OSIconName,
+    REFIT_VOLUME   *Volume,
+    CHAR16         *FileName
 ) {
     UINTN         FileSize   = 0;
     UINTN         TokenCount = 0;
@@ -389,7 +392,7 @@ VOID ParseReleaseFile (
     BOOLEAN       GotLine;
 
     if ((Volume == NULL) || (FileName == NULL) ||
-        (OSIconName == NULL) || (*OSIconName == NULL)
+        (OSIconName == NULL) || (OSIconName->Buffer == NULL)
     ) {
         return;
     }
@@ -407,7 +410,7 @@ VOID ParseReleaseFile (
                     MyStriCmp (TokenList[0], L"DISTRIB_ID")
                 )
             ) {
-                MergeUniqueWords (OSIconName, TokenList[1], L',');
+                StrBuilderMergeWords (OSIconName, TokenList[1], L',', TRUE);
             }
 
             FreeTokenLine (&TokenList, &TokenCount);
@@ -420,9 +423,9 @@ VOID ParseReleaseFile (
 // Try to guess the name of the Linux distribution & add that name to
 // OSIconName list.
 VOID GuessLinuxDistribution (
-    CHAR16       **OSIconName,
-    REFIT_VOLUME  *Volume,
-    CHAR16        *LoaderPath
+    STRING_BUILDER *OSIconName,
+    REFIT_VOLUME   *Volume,
+    CHAR16         *LoaderPath
 ) {
     LOG(4, LOG_BLANK_LINE_SEP, L"X");
     LOG(4, LOG_LINE_FORENSIC, L"In GuessLinuxDistribution ... 1 - START");
@@ -438,7 +441,7 @@ VOID GuessLinuxDistribution (
     LOG(4, LOG_LINE_FORENSIC, L"In GuessLinuxDistribution ... 4");
     if (StriSubCmp (L".fc", LoaderPath)) {
         LOG(4, LOG_LINE_FORENSIC, L"In GuessLinuxDistribution ... 4a 1");
-        MergeStrings (OSIconName, L"fedora", L',');
+        StrBuilderMerge (OSIconName, L"fedora", L',');
 
         LOG(4, LOG_LINE_FORENSIC, L"In GuessLinuxDistribution ... 4a 2");
     }
@@ -446,7 +449,7 @@ VOID GuessLinuxDistribution (
     LOG(4, LOG_LINE_FORENSIC, L"In GuessLinuxDistribution ... 5");
     if (StriSubCmp (L".el", LoaderPath)) {
         LOG(4, LOG_LINE_FORENSIC, L"In GuessLinuxDistribution ... 5a 1");
-        MergeStrings (OSIconName, L"redhat", L',');
+        StrBuilderMerge (OSIconName, L"redhat", L',');
 
         LOG(4, LOG_LINE_FORENSIC, L"In GuessLinuxDistribution ... 5a 2");
     }
@@ -463,7 +466,7 @@ VOID AddKernelToSubmenu (
 ) {
     REFIT_FILE          *File;
     CHAR16             **TokenList = NULL, *InitrdName, *SubmenuName = NULL, *VolName = NULL;
-    CHAR16              *Path = NULL, *KernelVersion = NULL;
+    CHAR16              *Path = NULL, *KernelVersion = NULL, *KernelOptions = NULL;
     REFIT_MENU_SCREEN   *SubScreen;
     LOADER_ENTRY        *SubEntry;
     UINTN                TokenCount;
@@ -500,7 +503,9 @@ VOID AddKernelToSubmenu (
         while ((TokenCount = ReadTokenLine (File, &TokenList)) > 1) {
             LOG(4, LOG_BLANK_LINE_SEP, L"X");
             LOG(4, LOG_LINE_FORENSIC, L"In AddKernelToSubmenu ... 2b 4a 1 - START WHILE LOOP");
-            ReplaceSubstring (&(TokenList[1]), KERNEL_VERSION, KernelVersion);
+            // Tokens point into the file buffer, so replace in a copy
+            KernelOptions = StrDuplicate (TokenList[1]);
+            ReplaceSubstring (&KernelOptions, KERNEL_VERSION, KernelVersion);
 
             LOG(4, LOG_LINE_FORENSIC, L"In AddKernelToSubmenu ... 2b 4a 2");
             SubEntry = InitializeLoaderEntry (TargetLoader);
@@ -531,7 +536,7 @@ VOID AddKernelToSubmenu (
                 AssignPoolStr (&SubEntry->me.Title, Title);
 
                 LOG(4, LOG_LINE_FORENSIC, L"In AddKernelToSubmenu ... 2b 4a 3a 8");
-                AssignPoolStr (&SubEntry->LoadOptions, AddInitrdToOptions (TokenList[1], InitrdName));
+                AssignPoolStr (&SubEntry->LoadOptions, AddInitrdToOptions (KernelOptions, InitrdName));
 
                 LOG(4, LOG_LINE_FORENSIC, L"In AddKernelToSubmenu ... 2b 4a 3a 9");
                 CopyPoolStr (&SubEntry->LoaderPath, FileName);
@@ -553,6 +558,7 @@ VOID AddKernelToSubmenu (
             }
             LOG(4, LOG_LINE_FORENSIC, L"In AddKernelToSubmenu ... 2b 4a 4");
             FreeTokenLine (&TokenList, &TokenCount);
+            MY_FREE_POOL(KernelOptions);
 
             LOG(4, LOG_LINE_FORENSIC, L"In AddKernelToSubmenu ... 2b 4a 5 - END WHILE LOOP");
             LOG(4, LOG_BLANK_LINE_SEP, L"X");
@@ -578,29 +584,3 @@ VOID AddKernelToSubmenu (
     #endif
 } // static VOID AddKernelToSubmenu()
 
-// Returns TRUE if a file with the same name as the original but with
-// ".efi.signed" is also present in the same directory. Ubuntu is using
-// this filename as a signed version of the original unsigned kernel, and
-// there is no point in cluttering the display with two kernels that will
-// behave identically on non-SB systems, or when one will fail when SB
-// is active.
-// CAUTION: *FullName MUST be properly cleaned up (via CleanUpPathNameSlashes())
-BOOLEAN HasSignedCounterpart(IN REFIT_VOLUME *Volume, IN CHAR16 *FullName) {
-    CHAR16 *NewFile = NULL;
-    BOOLEAN retval = FALSE;
-
-    MergeStrings(&NewFile, FullName, 0);
-    MergeStrings(&NewFile, L".efi.signed", 0);
-    if (NewFile != NULL) {
-        if (FileExists(Volume->RootDir, NewFile)) {
-            #if REFIT_DEBUG > 0
-            LOG(2, LOG_LINE_NORMAL, L"Found signed counterpart to '%s'", FullName);
-            #endif
-
-            retval = TRUE;
-        }
-        MY_FREE_POOL(NewFile);
-    } // if
-
-    return retval;
-} // BOOLEAN HasSignedCounterpart()
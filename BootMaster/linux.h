@@ -61,9 +61,8 @@
 CHAR16 * FindInitrd(IN CHAR16 *LoaderPath, IN REFIT_VOLUME *Volume);
 CHAR16 *AddInitrdToOptions(CHAR16 *Options, CHAR16 *InitrdPath);
 CHAR16 * GetMainLinuxOptions(IN CHAR16 * LoaderPath, IN REFIT_VOLUME *Volume);
-VOID GuessLinuxDistribution(CHAR16 **OSIconName, REFIT_VOLUME *Volume, CHAR16 *LoaderPath);
+VOID GuessLinuxDistribution(STRING_BUILDER *OSIconName, REFIT_VOLUME *Volume, CHAR16 *LoaderPath);
 VOID AddKernelToSubmenu(LOADER_ENTRY * TargetLoader, CHAR16 *FileName, REFIT_VOLUME *Volume);
-BOOLEAN HasSignedCounterpart(IN REFIT_VOLUME *Volume, IN CHAR16 *FullName);
 
 #endif
 
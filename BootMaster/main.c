@@ -62,6 +62,7 @@
 #include "driver_support.h"
 #include "launch_efi.h"
 #include "scan.h"
+#include "scan_cache.h"
 #include "../include/refit_call_wrapper.h"
 #include "../libeg/efiConsoleControl.h"
 #include "../libeg/efiUgaDraw.h"
@@ -72,6 +73,7 @@
 #include "gpt.h"
 #include "BootLog.h"
 #include "MemLogLib.h"
+#include "profile.h"
 
 extern VOID *MyMemSet(VOID *s, int c, UINTN n);
 
@@ -151,6 +153,11 @@ REFIT_CONFIG GlobalConfig = {
     /* ShutdownAfterTimeout = */ FALSE,
     /* Install = */ FALSE,
     /* WriteSystemdVars = */ FALSE,
+    /* IconCache = */ FALSE,
+    /* LogDropWhenFull = */ FALSE,
+    /* ConfigCache = */ FALSE,
+    /* Profile = */ FALSE,
+    /* ScanCache = */ FALSE,
     /* RequestedScreenWidth = */ 0,
     /* RequestedScreenHeight = */ 0,
     /* BannerBottomEdge = */ 0,
@@ -1298,6 +1305,9 @@ AssignPoolImage_PI_ (
             if (!object->Cached) {
                 MY_FREE_IMAGE (object->Image);
             }
+            else {
+                ReleaseAtlasIcon (object->Image);
+            }
             if (LOGPOOL (image));
             object->Image = image;
             object->Cached = FALSE;
@@ -1316,6 +1326,10 @@ AssignCachedPoolImage_PI_ (
             if (!object->Cached) {
                 MY_FREE_IMAGE (object->Image);
             }
+            else {
+                ReleaseAtlasIcon (object->Image);
+            }
+            RetainAtlasIcon (image);
             object->Image = image;
             object->Cached = TRUE;
         }
@@ -1363,6 +1377,10 @@ FreePoolImage_PI_ (
         if (!object->Cached) {
             MY_FREE_IMAGE (object->Image);
         }
+        else {
+            ReleaseAtlasIcon (object->Image);
+            object->Image = NULL;
+        }
     }
 }
 
@@ -1383,12 +1401,15 @@ VOID RescanAll (
     NativeLogger = TRUE;
     MsgLog("NativeLogger = TRUE\n");
 
-    FreeMenuScreen (&MainMenu);
+    // Loaders on volumes that ScanVolumes keeps unchanged are carried
+    // over from the old menu by ScanForBootloaders, which then frees it
+    KeepPreviousMenu (MainMenu);
     MainMenu = CopyMenuScreen (&MainMenuSrc);
     MainMenu->TimeoutSeconds = GlobalConfig.Timeout;
 
     // ConnectAllDriversToAllControllers() can cause system hangs with some
     // buggy filesystem drivers, so do it only if necessary.
+    // ScanVolumes() only reads volumes whose handles were added or changed.
     if (Reconnect) {
         ConnectAllDriversToAllControllers (FALSE);
         ScanVolumes();
@@ -1402,6 +1423,8 @@ VOID RescanAll (
     SetVolumeIcons();
     ScanForBootloaders (DisplayMessage);
     ScanForTools();
+    egIconCacheSave();
+    LogIconAtlasStats();
 
     /* Disable Forced Native Logging */
     MsgLog("NativeLogger = FALSE\n");
@@ -1485,6 +1508,8 @@ BOOLEAN SecureBootUninstall (VOID) {
 
             PauseSeconds (9);
 
+            BootLogFlush();
+
             REFIT_CALL_4_WRAPPER(
                 gRT->ResetSystem,
                 EfiResetShutdown,
@@ -1981,6 +2006,9 @@ EFI_STATUS EFIAPI efi_main (
     // DA-TAG: Also on RELEASE Builds as we need the timer
     InitBooterLog();
 
+    // Profile from the start ... Stopped after reading the config if not wanted
+    ProfileStart();
+
     //MyPrint("MsgLog Loading RefindPlus\n");
     #if REFIT_DEBUG > 0
     /* Start Logging */
@@ -2090,6 +2118,10 @@ EFI_STATUS EFIAPI efi_main (
     ReadConfig (GlobalConfig.ConfigFilename);
     AdjustDefaultSelection();
 
+    if (!GlobalConfig.Profile) {
+        ProfileStop();
+    }
+
 
     #if REFIT_DEBUG > 0
     MsgLog ("INFO: RefitDBG:- '%d'",   REFIT_DEBUG                                            );
@@ -2125,6 +2157,8 @@ EFI_STATUS EFIAPI efi_main (
     MsgLog ("      IgnorePreviousBoot:- %s", GlobalConfig.IgnorePreviousBoot ? L"'Active'" : L"'Inactive'");
     MsgLog ("\n");
 
+    LogEffectiveConfig();
+
     // Prime Status for SupplyAPFS
     Status = EFI_NOT_STARTED;
     #endif
@@ -2240,6 +2274,8 @@ EFI_STATUS EFIAPI efi_main (
 
         PauseSeconds (9);
 
+        BootLogFlush();
+
         REFIT_CALL_4_WRAPPER(
             gRT->ResetSystem,
             EfiResetShutdown,
@@ -2296,6 +2332,8 @@ EFI_STATUS EFIAPI efi_main (
     SetVolumeIcons();
     ScanForBootloaders (FALSE);
     ScanForTools();
+    egIconCacheSave();
+    LogIconAtlasStats();
     LEAKABLEVOLUMES();
     LEAKABLEPARTITIONS();
     LEAKABLEROOTMENU (kLeakableMenuMain, MainMenu);
@@ -2496,6 +2534,7 @@ EFI_STATUS EFIAPI efi_main (
         }
 
         MenuExit = RunMainMenu (&MainMenu, &SelectionName, &ChosenEntry);
+        ProfileSave();
 
         // Ignore MenuExit if FlushFailedTag is set and not previously reset
         if (FlushFailedTag && !FlushFailReset) {
@@ -2518,6 +2557,11 @@ EFI_STATUS EFIAPI efi_main (
             MsgLog ("  - Escape Key Pressed ... Rescan All\n\n");
             #endif
 
+            // Look at every volume afresh rather than trust the loader cache
+            // or what the last scan found on volumes that look unchanged
+            ScanCacheBypass = TRUE;
+            ForgetVolumeHandles();
+            ForgetScannedVolumes();
             RescanAll (TRUE, TRUE);
             continue;
         }
@@ -2597,6 +2641,8 @@ EFI_STATUS EFIAPI efi_main (
                     MsgLog ("\n-----------------\n\n");
                     #endif
 
+                    BootLogFlush();
+
                     REFIT_CALL_4_WRAPPER(
                         gRT->ResetSystem,
                         EfiResetCold,
@@ -2673,6 +2719,8 @@ EFI_STATUS EFIAPI efi_main (
                 LOG(1, LOG_STAR_SEPARATOR, L"Restarting System");
                 #endif
 
+                BootLogFlush();
+
                 REFIT_CALL_4_WRAPPER(
                     gRT->ResetSystem,
                     EfiResetCold,
@@ -2704,6 +2752,8 @@ EFI_STATUS EFIAPI efi_main (
 
                 TerminateScreen();
 
+                BootLogFlush();
+
                 REFIT_CALL_4_WRAPPER(
                     gRT->ResetSystem,
                     EfiResetShutdown,
@@ -3107,6 +3157,10 @@ EFI_STATUS EFIAPI efi_main (
                 #endif
 
                 InstallRefindPlus();
+
+                // The target volume now holds another loader
+                ForgetVolumeHandles();
+                ForgetScannedVolumes();
                 break;
 
             case TAG_BOOTORDER:
@@ -3145,6 +3199,8 @@ EFI_STATUS EFIAPI efi_main (
     MsgLog ("System Reset:\n\n");
     #endif
 
+    BootLogFlush();
+
     REFIT_CALL_4_WRAPPER(
         gRT->ResetSystem,
         EfiResetCold,
@@ -59,6 +59,7 @@
 #include "mystrings.h"
 #include "icns.h"
 #include "scan.h"
+#include "profile.h"
 #include "../include/version.h"
 #include "../include/refit_call_wrapper.h"
 
@@ -1448,6 +1449,33 @@ UINT8 AverageBrightness (
     return (UINT8) Sum;
 } // UINT8 AverageBrightness()
 
+// Rendered labels, keyed by text and position, so redrawing a label that was
+// already drawn against the current background is a single blit. The rendered
+// pixels depend on the background under the label, which is why the position
+// is part of the key rather than just the brightness derived from it. Entries
+// are dropped whenever the screen background is replaced.
+#define TEXT_LABEL_CACHE_SIZE (16)
+
+typedef struct {
+    CHAR16     *Text;
+    UINTN       XPos;
+    UINTN       YPos;
+    EG_IMAGE   *Image;
+} TEXT_LABEL;
+
+static TEXT_LABEL TextLabelCache[TEXT_LABEL_CACHE_SIZE];
+static UINTN      TextLabelNext = 0;
+
+VOID FlushTextLabelCache (VOID) {
+    UINTN i;
+
+    for (i = 0; i < TEXT_LABEL_CACHE_SIZE; i++) {
+        MY_FREE_POOL(TextLabelCache[i].Text);
+        MY_FREE_IMAGE(TextLabelCache[i].Image);
+    }
+    TextLabelNext = 0;
+} // VOID FlushTextLabelCache()
+
 // Display text against the screen's background image. Special case: If Text is NULL
 // or 0-length, clear the line. Does NOT indent the text or reposition it relative
 // to the specified XPos and YPos values.
@@ -1457,8 +1485,10 @@ VOID DrawTextWithTransparency (
     IN UINTN   XPos,
     IN UINTN   YPos
 ) {
-    UINTN TextWidth;
-    EG_IMAGE *TextBuffer = NULL;
+    UINTN       i;
+    UINTN       TextWidth;
+    EG_IMAGE   *TextBuffer = NULL;
+    TEXT_LABEL *Label;
 
     if (Text == NULL) {
         Text = L"";
@@ -1471,6 +1501,20 @@ VOID DrawTextWithTransparency (
         XPos      = 0;
     }
 
+    for (i = 0; i < TEXT_LABEL_CACHE_SIZE; i++) {
+        Label = &TextLabelCache[i];
+        if (Label->Image        != NULL &&
+            Label->XPos         == XPos &&
+            Label->YPos         == YPos &&
+            Label->Image->Width == TextWidth &&
+            StrCmp (Label->Text, Text) == 0
+        ) {
+            BltImage (Label->Image, XPos, YPos);
+
+            return;
+        }
+    }
+
     TextBuffer = egCropImage (
         GlobalConfig.ScreenBackground,
         XPos, YPos,
@@ -1497,7 +1541,27 @@ VOID DrawTextWithTransparency (
         TextBuffer->Height
     );
 
-    MY_FREE_IMAGE(TextBuffer);
+    // An opaque label is drawn as is ... Keep it for the next redraw
+    if (TextBuffer->HasAlpha) {
+        MY_FREE_IMAGE(TextBuffer);
+
+        return;
+    }
+
+    Label = &TextLabelCache[TextLabelNext];
+    TextLabelNext = (TextLabelNext + 1) % TEXT_LABEL_CACHE_SIZE;
+
+    MY_FREE_POOL(Label->Text);
+    MY_FREE_IMAGE(Label->Image);
+    Label->Text = StrDuplicate (Text);
+    if (Label->Text == NULL) {
+        MY_FREE_IMAGE(TextBuffer);
+
+        return;
+    }
+    Label->XPos  = XPos;
+    Label->YPos  = YPos;
+    Label->Image = TextBuffer;
 }
 
 /* Compute the size & position of the window that will hold a subscreen's information.
@@ -2307,11 +2371,13 @@ VOID MainMenuStyle (
             break;
 
         case MENU_FUNCTION_PAINT_ALL:
+            PROFILE_BEGIN("PaintMainMenu");
             PaintAll (Screen, State, itemPosX, row0PosY, row1PosY, textPosY);
             // For PaintArrows(), the starting Y position is moved to the midpoint
             // of the surrounding row; PaintIcon() adjusts this back up by half the
             // icon's height to properly center it.
             PaintArrows (State, row0PosX - TILE_XSPACING, row0PosY + (TileSizes[0] / 2), row0Loaders);
+            PROFILE_END("PaintMainMenu");
             break;
 
         case MENU_FUNCTION_PAINT_SELECTION:
@@ -2801,6 +2867,8 @@ VOID ManageHiddenTags (VOID) {
     }
 
     if (doRescanAll) {
+        // Loaders just unhidden must be found again on their volumes
+        ForgetScannedVolumes();
         RescanAll (FALSE, FALSE);
     }
 
@@ -3035,13 +3103,39 @@ BOOLEAN HideLegacyTag (
     return TagHidden;
 } // BOOLEAN HideLegacyTag()
 
+// Takes a newly hidden entry out of the main menu in place, so that
+// hiding a tag does not need a rescan.
+static
+VOID RemoveMainMenuEntry (
+    IN REFIT_MENU_ENTRY *Entry
+) {
+    UINTN i;
+
+    for (i = 0; i < MainMenu->EntryCount; i++) {
+        if (MainMenu->Entries[i] == Entry) {
+            FreeMenuEntry (&MainMenu->Entries[i]);
+            MainMenu->EntryCount--;
+            CopyMem (
+                &MainMenu->Entries[i],
+                &MainMenu->Entries[i + 1],
+                (MainMenu->EntryCount - i) * sizeof (REFIT_MENU_ENTRY *)
+            );
+            AssignShortcutKeys();
+
+            break;
+        }
+    }
+} // static VOID RemoveMainMenuEntry()
+
+// Returns TRUE if ChosenEntry was hidden and removed from the main menu.
 static
-VOID HideTag (
+BOOLEAN HideTag (
     REFIT_MENU_ENTRY *ChosenEntry
 ) {
     LOGPROCENTRY("%s", GetPoolStr (&ChosenEntry->Title));
     LOADER_ENTRY      *Loader        = (LOADER_ENTRY *) ChosenEntry;
     LEGACY_ENTRY      *LegacyLoader  = (LEGACY_ENTRY *) ChosenEntry;
+    BOOLEAN            TagHidden     = FALSE;
     REFIT_MENU_SCREEN *HideItemMenu = NULL;
     REFIT_MENU_SCREEN  HideItemMenuSrc = {
         NULLPS, NULLPI, 0, NULL, 0, NULL, 0, NULLPS,
@@ -3051,24 +3145,20 @@ VOID HideTag (
 
     if (ChosenEntry == NULL) {
         LOGPROCEXIT("(no menu entry)");
-        return;
+        return FALSE;
     }
 
     HideItemMenu = CopyMenuScreen (&HideItemMenuSrc);
     if (!HideItemMenu) {
         LOGPROCEXIT("(no menu screen)");
-        return;
+        return FALSE;
     }
 
     CopyFromPoolImage_PI_ (&HideItemMenu->TitleImage_PI_, BuiltinIcon (BUILTIN_ICON_FUNC_HIDDEN));
-    // BUG: The RescanAll() calls should be conditional on successful calls to
-    // HideEfiTag() or HideLegacyTag(); but for the former, this causes
-    // crashes on a second call hide a tag if the user chose "No" to the first
-    // call. This seems to be related to memory management of Volumes; the
-    // crash occurs in FindVolumeAndFilename() and lib.c when calling
-    // DevicePathToStr(). Calling RescanAll() on all returns from HideEfiTag()
-    // seems to be an effective workaround, but there is likely a memory
-    // management bug somewhere that is the root cause.
+    // A hidden entry is taken out of the main menu in place. Entries are only
+    // removed once the tag was actually hidden, and the volume references they
+    // hold are counted, so the crashes that once called for a full rescan after
+    // every return from HideEfiTag() do not arise.
     switch (ChosenEntry->Tag) {
         case TAG_LOADER:
             if (Loader->DiscoveryType != DISCOVERY_TYPE_AUTO) {
@@ -3079,35 +3169,31 @@ VOID HideTag (
             }
             else {
                 AssignCachedPoolStr (&HideItemMenu->Title, L"Hide EFI OS Tag");
-                HideEfiTag (Loader, HideItemMenu, L"HiddenTags");
+                TagHidden = HideEfiTag (Loader, HideItemMenu, L"HiddenTags");
 
                 #if REFIT_DEBUG > 0
                 MsgLog ("User Input Received:\n");
                 MsgLog ("  - %s\n\n", GetPoolStr (&HideItemMenu->Title));
                 #endif
-
-                RescanAll (FALSE, FALSE);
             }
             break;
 
         case TAG_LEGACY:
         case TAG_LEGACY_UEFI:
             AssignCachedPoolStr (&HideItemMenu->Title, L"Hide Legacy (BIOS) OS Tag");
-            if (HideLegacyTag (LegacyLoader, HideItemMenu)) {
-                #if REFIT_DEBUG > 0
+            TagHidden = HideLegacyTag (LegacyLoader, HideItemMenu);
+
+            #if REFIT_DEBUG > 0
+            if (TagHidden) {
                 MsgLog ("User Input Received:\n");
                 MsgLog ("  - %s\n\n", GetPoolStr (&HideItemMenu->Title));
-                #endif
-
-                RescanAll (FALSE, FALSE);
             }
+            #endif
             break;
 
         case TAG_FIRMWARE_LOADER:
             AssignCachedPoolStr (&HideItemMenu->Title, L"Hide Firmware Boot Option Tag");
-            if (HideFirmwareTag(Loader, HideItemMenu)) {
-                RescanAll(FALSE, FALSE);
-            }
+            TagHidden = HideFirmwareTag (Loader, HideItemMenu);
             break;
 
         #define TAGS_BUILTIN
@@ -3120,20 +3206,24 @@ VOID HideTag (
 
         case TAG_TOOL:
             AssignCachedPoolStr (&HideItemMenu->Title, L"Hide Tool Tag");
-            HideEfiTag (Loader, HideItemMenu, L"HiddenTools");
+            TagHidden = HideEfiTag (Loader, HideItemMenu, L"HiddenTools");
             MY_FREE_POOL(gHiddenTools);
 
             #if REFIT_DEBUG > 0
             MsgLog ("User Input Received:\n");
             MsgLog ("  - %s\n\n", GetPoolStr (&HideItemMenu->Title));
             #endif
-
-            RescanAll (FALSE, FALSE);
             break;
     } // switch
     FreeMenuScreen (&HideItemMenu);
-    LOGPROCEXIT();
-} // VOID HideTag()
+
+    if (TagHidden) {
+        RemoveMainMenuEntry (ChosenEntry);
+    }
+
+    LOGPROCEXIT("%d", TagHidden);
+    return TagHidden;
+} // BOOLEAN HideTag()
 
 UINTN RunMenu (
     IN  REFIT_MENU_SCREEN  *Screen,
@@ -3329,7 +3419,12 @@ UINTN RunMainMenu (
             LOG(4, LOG_LINE_FORENSIC, L"In RunMainMenu ... 9a 4a 1");
             if (GlobalConfig.HiddenTags) {
                 LOG(4, LOG_LINE_FORENSIC, L"In RunMainMenu ... 9a 4a 1a 1");
-                HideTag (TempChosenEntry);
+                if (HideTag (TempChosenEntry) &&
+                    DefaultEntryIndex >= (INTN) Screen->EntryCount
+                ) {
+                    // The selected entry was the last one
+                    DefaultEntryIndex = (INTN) Screen->EntryCount - 1;
+                }
                 LOG(4, LOG_LINE_FORENSIC, L"In RunMainMenu ... 9a 4a 1a 2");
             }
 
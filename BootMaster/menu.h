@@ -133,6 +133,7 @@ VOID AddMenuEntry (IN REFIT_MENU_SCREEN *Screen, IN REFIT_MENU_ENTRY *Entry);
 VOID AddMenuEntryCopy (IN REFIT_MENU_SCREEN *Screen, IN REFIT_MENU_ENTRY *Entry);
 
 VOID DisplaySimpleMessage (CHAR16 *Title, CHAR16 *Message);
+VOID FlushTextLabelCache (VOID);
 VOID ManageHiddenTags (VOID);
 VOID GenerateWaitList (VOID);
 VOID MainMenuStyle (
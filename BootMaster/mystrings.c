@@ -413,20 +413,33 @@ VOID MergeUniqueStrings (
 
             //LOG(4, LOG_LINE_FORENSIC, L"In MergeUniqueStrings ... 5a 4a 2");
             if (AddChar) {
-                UINTN   i       = 0;
-                CHAR16 *TestStr = NULL;
+                CHAR16  Saved;
+                CHAR16 *TestStr = NewString;
+                CHAR16 *TestEnd;
 
                 LOG(4, LOG_LINE_FORENSIC,
                     L"In MergeUniqueStrings ... 5a 4a 2a 1 - WHILE LOOP:- START/ENTER"
                 );
-                while (!SkipMerge
-                    && (TestStr = FindCommaDelimited (NewString, i++)) != NULL
-                ) {
+                // Test each comma-delimited item in place rather than
+                // copying them out one at a time with FindCommaDelimited.
+                while (!SkipMerge) {
+                    TestEnd = TestStr;
+                    while (*TestEnd != L'\0' && *TestEnd != L',') {
+                        TestEnd++;
+                    }
+
+                    Saved    = *TestEnd;
+                    *TestEnd = L'\0';
                     if (MyStrStr (TestStr, Second)) {
                         SkipMerge = TRUE;
                     }
+                    *TestEnd = Saved;
+
+                    if (Saved == L'\0') {
+                        break;
+                    }
 
-                    MY_FREE_POOL(TestStr);
+                    TestStr = TestEnd + 1;
                 } // while
                 LOG(4, LOG_LINE_FORENSIC,
                     L"In MergeUniqueStrings ... 5a 4a 2a 2 - WHILE LOOP:- END/EXIT"
@@ -473,40 +486,20 @@ VOID MergeWords (
     CHAR16  *InString,
     CHAR16   AddChar
 ) {
-    CHAR16  *Temp, *Word, *p;
-    BOOLEAN  LineFinished = FALSE;
+    STRING_BUILDER Builder;
 
     if (!InString) {
         return;
     }
 
-    Temp = Word = p = StrDuplicate (InString);
-    if (Temp) {
-        while (!LineFinished) {
-            if ((*p == L' ') ||
-                (*p == L':') ||
-                (*p == L'_') ||
-                (*p == L'-') ||
-                (*p == L'\0')
-            ) {
-                if (*p == L'\0') {
-                    LineFinished = TRUE;
-                }
-
-                *p = L'\0';
-
-                if (*Word != L'\0') {
-                    MergeStrings (MergeTo, Word, AddChar);
-                }
-
-                Word = p + 1;
-            }
-
-            p++;
-        } // while
-
-        MY_FREE_POOL(Temp);
+    StrBuilderInit (&Builder);
+    if (*MergeTo != NULL) {
+        StrBuilderAppend (&Builder, *MergeTo);
     }
+    StrBuilderMergeWords (&Builder, InString, AddChar, FALSE);
+
+    MY_FREE_POOL(*MergeTo);
+    *MergeTo = StrBuilderDetach (&Builder);
 } // VOID MergeWords()
 
 // As MergeWords, but only unique words are merged
@@ -514,55 +507,287 @@ VOID MergeUniqueWords (
     CHAR16 **MergeTo,
     CHAR16  *InString,
     CHAR16   AddChar
+) {
+    STRING_BUILDER Builder;
+
+    if (!InString) {
+        return;
+    }
+
+    StrBuilderInit (&Builder);
+    if (*MergeTo != NULL) {
+        StrBuilderAppend (&Builder, *MergeTo);
+    }
+    StrBuilderMergeWords (&Builder, InString, AddChar, TRUE);
+
+    MY_FREE_POOL(*MergeTo);
+    *MergeTo = StrBuilderDetach (&Builder);
+} // VOID MergeUniqueWords()
+
+VOID StrBuilderInit (
+    OUT STRING_BUILDER *Builder
+) {
+    Builder->Buffer   = NULL;
+    Builder->Length   = 0;
+    Builder->Capacity = 0;
+    Builder->Failed   = FALSE;
+} // VOID StrBuilderInit()
+
+VOID StrBuilderFree (
+    IN OUT STRING_BUILDER *Builder
+) {
+    MY_FREE_POOL(Builder->Buffer);
+    StrBuilderInit (Builder);
+} // VOID StrBuilderFree()
+
+// Makes room for 'Extra' more characters plus the terminator.
+// The buffer is always allocated after a successful call, even if 'Extra' is 0.
+BOOLEAN StrBuilderReserve (
+    IN OUT STRING_BUILDER *Builder,
+    IN     UINTN           Extra
+) {
+    UINTN   Needed;
+    UINTN   NewCapacity;
+    CHAR16 *NewBuffer;
+
+    if (Builder->Failed) {
+        return FALSE;
+    }
+
+    Needed = Builder->Length + Extra + 1;
+    if (Needed <= Builder->Capacity) {
+        return TRUE;
+    }
+
+    NewCapacity = (Builder->Capacity == 0) ? 64 : Builder->Capacity;
+    while (NewCapacity < Needed) {
+        NewCapacity *= 2;
+    }
+
+    NewBuffer = ReallocatePool (
+        Builder->Capacity * sizeof (CHAR16),
+        NewCapacity * sizeof (CHAR16),
+        Builder->Buffer
+    );
+    if (NewBuffer == NULL) {
+        // ReallocatePool leaves the old buffer alone on failure
+        MY_FREE_POOL(Builder->Buffer);
+        Builder->Length   = 0;
+        Builder->Capacity = 0;
+        Builder->Failed   = TRUE;
+
+        return FALSE;
+    }
+
+    if (Builder->Buffer == NULL) {
+        NewBuffer[0] = L'\0';
+    }
+    Builder->Buffer   = NewBuffer;
+    Builder->Capacity = NewCapacity;
+
+    return TRUE;
+} // BOOLEAN StrBuilderReserve()
+
+// Appends the first 'Length' characters of 'String'.
+BOOLEAN StrBuilderAppendN (
+    IN OUT STRING_BUILDER *Builder,
+    IN     CHAR16         *String,
+    IN     UINTN           Length
+) {
+    if (!StrBuilderReserve (Builder, Length)) {
+        return FALSE;
+    }
+
+    if (Length > 0) {
+        CopyMem (&Builder->Buffer[Builder->Length], String, Length * sizeof (CHAR16));
+        Builder->Length += Length;
+    }
+    Builder->Buffer[Builder->Length] = L'\0';
+
+    return TRUE;
+} // BOOLEAN StrBuilderAppendN()
+
+BOOLEAN StrBuilderAppend (
+    IN OUT STRING_BUILDER *Builder,
+    IN     CHAR16         *String
+) {
+    return StrBuilderAppendN (Builder, String, String ? StrLen (String) : 0);
+} // BOOLEAN StrBuilderAppend()
+
+BOOLEAN StrBuilderAppendChar (
+    IN OUT STRING_BUILDER *Builder,
+    IN     CHAR16          Char
+) {
+    return StrBuilderAppendN (Builder, &Char, 1);
+} // BOOLEAN StrBuilderAppendChar()
+
+// As MergeStrings, appending to the builder.
+// 'AddChar', if not 0, is placed before 'String' unless the builder is empty.
+BOOLEAN StrBuilderMerge (
+    IN OUT STRING_BUILDER *Builder,
+    IN     CHAR16         *String,
+    IN     CHAR16          AddChar
+) {
+    if (AddChar && (Builder->Length > 0)) {
+        StrBuilderAppendChar (Builder, AddChar);
+    }
+
+    return StrBuilderAppend (Builder, String);
+} // BOOLEAN StrBuilderMerge()
+
+// As MergeUniqueStrings, appending to the builder.
+// 'String' is skipped if it is found within any 'AddChar' delimited item.
+BOOLEAN StrBuilderMergeUnique (
+    IN OUT STRING_BUILDER *Builder,
+    IN     CHAR16         *String,
+    IN     CHAR16          AddChar
+) {
+    CHAR16  Saved;
+    CHAR16 *TestStr;
+    CHAR16 *TestEnd;
+    BOOLEAN Found;
+
+    if (!AddChar || (String == NULL) || (Builder->Length == 0)) {
+        return StrBuilderMerge (Builder, String, AddChar);
+    }
+
+    // Test each item in place with the item end terminated temporarily
+    Found   = FALSE;
+    TestStr = Builder->Buffer;
+    while (!Found) {
+        TestEnd = TestStr;
+        while (*TestEnd != L'\0' && *TestEnd != AddChar) {
+            TestEnd++;
+        }
+
+        Saved    = *TestEnd;
+        *TestEnd = L'\0';
+        if (MyStrStr (TestStr, String)) {
+            Found = TRUE;
+        }
+        *TestEnd = Saved;
+
+        if (Saved == L'\0') {
+            break;
+        }
+
+        TestStr = TestEnd + 1;
+    } // while
+
+    if (Found) {
+        return !Builder->Failed;
+    }
+
+    return StrBuilderMerge (Builder, String, AddChar);
+} // BOOLEAN StrBuilderMergeUnique()
+
+// Merges every word in 'InString' as for MergeWords and MergeUniqueWords.
+// Words are string fragments separated by ' ', ':', '_', or '-'.
+BOOLEAN StrBuilderMergeWords (
+    IN OUT STRING_BUILDER *Builder,
+    IN     CHAR16         *InString,
+    IN     CHAR16          AddChar,
+    IN     BOOLEAN         Unique
 ) {
     CHAR16 *Temp, *Word, *p;
     BOOLEAN LineFinished = FALSE;
 
     if (!InString) {
-        return;
+        return !Builder->Failed;
     }
 
     Temp = Word = p = StrDuplicate (InString);
-    if (Temp) {
-        while (!LineFinished) {
-            if ((*p == L' ') ||
-                (*p == L':') ||
-                (*p == L'_') ||
-                (*p == L'-') ||
-                (*p == L'\0')
-            ) {
-                if (*p == L'\0') {
-                    LineFinished = TRUE;
-                }
+    if (!Temp) {
+        return FALSE;
+    }
 
-                *p = L'\0';
+    while (!LineFinished) {
+        if ((*p == L' ') ||
+            (*p == L':') ||
+            (*p == L'_') ||
+            (*p == L'-') ||
+            (*p == L'\0')
+        ) {
+            if (*p == L'\0') {
+                LineFinished = TRUE;
+            }
 
-                if (*Word != L'\0') {
-                    MergeUniqueStrings (MergeTo, Word, AddChar);
-                }
+            *p = L'\0';
 
-                Word = p + 1;
+            if (*Word != L'\0') {
+                if (Unique) {
+                    StrBuilderMergeUnique (Builder, Word, AddChar);
+                }
+                else {
+                    StrBuilderMerge (Builder, Word, AddChar);
+                }
             }
 
-            p++;
-        } // while
+            Word = p + 1;
+        }
 
-        MY_FREE_POOL(Temp);
+        p++;
+    } // while
+
+    MY_FREE_POOL(Temp);
+
+    return !Builder->Failed;
+} // BOOLEAN StrBuilderMergeWords()
+
+// Appends formatted text as for PoolPrint.
+BOOLEAN EFIAPI StrBuilderFormat (
+    IN OUT STRING_BUILDER *Builder,
+    IN     CHAR16         *Format,
+    ...
+) {
+    CHAR16  *Text;
+    BOOLEAN  Result;
+    VA_LIST  Args;
+
+    VA_START(Args, Format);
+    Text = CatVSPrint (NULL, Format, Args);
+    VA_END(Args);
+
+    if (Text == NULL) {
+        StrBuilderFree (Builder);
+        Builder->Failed = TRUE;
+
+        return FALSE;
     }
-} // VOID MergeUniqueWords()
+
+    Result = StrBuilderAppend (Builder, Text);
+    MY_FREE_POOL(Text);
+
+    return Result;
+} // BOOLEAN StrBuilderFormat()
+
+// Hands the built string to the caller, who must free it, and empties the builder.
+// Returns NULL if nothing, not even an empty string, was appended or if an
+// allocation failed.
+CHAR16 * StrBuilderDetach (
+    IN OUT STRING_BUILDER *Builder
+) {
+    CHAR16 *Result = Builder->Buffer;
+
+    StrBuilderInit (Builder);
+
+    return Result;
+} // CHAR16 * StrBuilderDetach()
 
 // Replaces special characters in the input string with a space.
 CHAR16 * SanitiseString (
     CHAR16  *InString
 ) {
-    CHAR16  *Temp, *Word, *p;
-    CHAR16  *OutString    = NULL;
-    BOOLEAN  LineFinished = FALSE;
+    CHAR16         *Temp, *Word, *p;
+    BOOLEAN         LineFinished = FALSE;
+    STRING_BUILDER  OutString;
 
     if (!InString) {
         return NULL;
     }
 
+    StrBuilderInit (&OutString);
+
     Temp = Word = p = StrDuplicate (InString);
     if (Temp) {
         while (!LineFinished) {
@@ -581,7 +806,7 @@ CHAR16 * SanitiseString (
                 *p = L'\0';
 
                 if (*Word != L'\0') {
-                    MergeStrings (&OutString, Word, L' ');
+                    StrBuilderMerge (&OutString, Word, L' ');
                 }
 
                 Word = p + 1;
@@ -593,11 +818,11 @@ CHAR16 * SanitiseString (
         MY_FREE_POOL(Temp);
     }
 
-    if (!OutString) {
-        OutString = StrDuplicate (InString);
+    if (OutString.Buffer == NULL) {
+        return StrDuplicate (InString);
     }
 
-    return OutString;
+    return StrBuilderDetach (&OutString);
 } // CHAR16 * SanitiseString()
 
 // Restrict 'TheString' to at most 'Limit' characters.
@@ -799,6 +1024,214 @@ CHAR16 * FindCommaDelimited (
     return FoundString;
 } // CHAR16 *FindCommaDelimited()
 
+// Comma-delimited lists are compiled once and kept in a small cache keyed
+// by content. The config lists are edited in place during scans, so a list
+// is only reused while its text is unchanged and is recompiled otherwise.
+#define CSV_LIST_CACHE_SLOTS  8
+
+typedef struct {
+    CSV_LIST  *List;
+    UINTN      LastUse;
+} CSV_LIST_SLOT;
+
+static CSV_LIST_SLOT  CsvListCache[CSV_LIST_CACHE_SLOTS];
+static UINTN          CsvListTick = 0;
+
+// Returns an FNV-1a hash of the first Length characters of String, folded
+// the same way as MyStriCmp so that case-insensitive matches hash alike.
+UINT32 CsvFoldedHash (
+    IN CHAR16 *String,
+    IN UINTN   Length
+) {
+    UINTN   i;
+    UINT32  Hash = 2166136261U;
+
+    for (i = 0; i < Length; i++) {
+        Hash ^= (UINT32) (String[i] & ~0x20);
+        Hash *= 16777619U;
+    }
+
+    return Hash;
+} // UINT32 CsvFoldedHash()
+
+static
+VOID FreeCsvList (
+    IN CSV_LIST *List
+) {
+    UINTN i;
+
+    if (List == NULL) {
+        return;
+    }
+
+    if (List->Parts != NULL) {
+        for (i = 0; i < List->Count; i++) {
+            MY_FREE_POOL(List->Parts[i].VolName);
+            MY_FREE_POOL(List->Parts[i].Path);
+            MY_FREE_POOL(List->Parts[i].Filename);
+            MY_FREE_POOL(List->Parts[i].Rest);
+        }
+        MY_FREE_POOL(List->Parts);
+    }
+
+    MY_FREE_POOL(List->Source);
+    MY_FREE_POOL(List->Buffer);
+    MY_FREE_POOL(List->Items);
+    MY_FREE_POOL(List->Lengths);
+    MY_FREE_POOL(List->Hashes);
+    MY_FREE_POOL(List);
+} // static VOID FreeCsvList()
+
+// Splits InString into its elements in a single pass.
+// Element numbering matches FindCommaDelimited, so an empty string has one
+// empty element and a trailing comma adds an empty element.
+static
+CSV_LIST * CompileCsvList (
+    IN CHAR16 *InString
+) {
+    UINTN     i, Count = 1, Length;
+    CHAR16   *Walker;
+    CSV_LIST *List;
+
+    Length = StrLen (InString);
+    for (i = 0; i < Length; i++) {
+        if (InString[i] == L',') {
+            Count++;
+        }
+    }
+
+    List = AllocateZeroPool (sizeof (CSV_LIST));
+    if (List == NULL) {
+        return NULL;
+    }
+
+    List->Count   = Count;
+    List->Source  = StrDuplicate (InString);
+    List->Buffer  = StrDuplicate (InString);
+    List->Items   = AllocatePool (Count * sizeof (CHAR16 *));
+    List->Lengths = AllocatePool (Count * sizeof (UINTN));
+    List->Hashes  = AllocatePool (Count * sizeof (UINT32));
+    if (List->Source  == NULL || List->Buffer == NULL || List->Items == NULL ||
+        List->Lengths == NULL || List->Hashes == NULL
+    ) {
+        FreeCsvList (List);
+
+        return NULL;
+    }
+
+    Walker = List->Buffer;
+    for (i = 0; i < Count; i++) {
+        List->Items[i] = Walker;
+        while (*Walker != L'\0' && *Walker != L',') {
+            Walker++;
+        }
+
+        List->Lengths[i] = Walker - List->Items[i];
+        List->Hashes[i]  = CsvFoldedHash (List->Items[i], List->Lengths[i]);
+
+        if (*Walker == L',') {
+            *Walker++ = L'\0';
+        }
+    } // for
+
+    LEAKABLE(List->Source,  "CsvList Source");
+    LEAKABLE(List->Buffer,  "CsvList Buffer");
+    LEAKABLE(List->Items,   "CsvList Items");
+    LEAKABLE(List->Lengths, "CsvList Lengths");
+    LEAKABLE(List->Hashes,  "CsvList Hashes");
+    LEAKABLE(List,          "CsvList");
+
+    return List;
+} // static CSV_LIST * CompileCsvList()
+
+// Returns the compiled form of the comma-delimited InString, or NULL if
+// InString is NULL or memory runs out. The result is owned by the cache and
+// stays valid until more than CSV_LIST_CACHE_SLOTS other lists are used, so
+// callers should not keep it beyond the current lookup.
+CSV_LIST * GetCsvList (
+    IN CHAR16 *InString
+) {
+    UINTN     i, Victim = 0;
+    CSV_LIST *List;
+
+    if (InString == NULL) {
+        return NULL;
+    }
+
+    CsvListTick++;
+    for (i = 0; i < CSV_LIST_CACHE_SLOTS; i++) {
+        List = CsvListCache[i].List;
+        if (List != NULL && StrCmp (List->Source, InString) == 0) {
+            CsvListCache[i].LastUse = CsvListTick;
+
+            return List;
+        }
+
+        if (CsvListCache[i].LastUse < CsvListCache[Victim].LastUse) {
+            Victim = i;
+        }
+    } // for
+
+    List = CompileCsvList (InString);
+    if (List == NULL) {
+        return NULL;
+    }
+
+    FreeCsvList (CsvListCache[Victim].List);
+    CsvListCache[Victim].List    = List;
+    CsvListCache[Victim].LastUse = CsvListTick;
+
+    return List;
+} // CSV_LIST * GetCsvList()
+
+// Returns the volume, path and file name parts of each element in List,
+// splitting the elements on first use.
+CSV_PATH_PARTS * GetCsvListPathParts (
+    IN CSV_LIST *List
+) {
+    UINTN           i;
+    CHAR16         *VolName;
+    CSV_PATH_PARTS *Parts;
+
+    if (List == NULL) {
+        return NULL;
+    }
+
+    if (List->Parts != NULL) {
+        return List->Parts;
+    }
+
+    Parts = AllocateZeroPool (List->Count * sizeof (CSV_PATH_PARTS));
+    if (Parts == NULL) {
+        return NULL;
+    }
+
+    for (i = 0; i < List->Count; i++) {
+        SplitPathName (
+            List->Items[i],
+            &Parts[i].VolName,
+            &Parts[i].Path,
+            &Parts[i].Filename
+        );
+
+        VolName       = NULL;
+        Parts[i].Rest = StrDuplicate (List->Items[i]);
+        SplitVolumeAndFilename (&Parts[i].Rest, &VolName);
+        CleanUpPathNameSlashes (Parts[i].Rest);
+        MY_FREE_POOL(VolName);
+
+        LEAKABLE(Parts[i].VolName,  "CsvList VolName");
+        LEAKABLE(Parts[i].Path,     "CsvList Path");
+        LEAKABLE(Parts[i].Filename, "CsvList Filename");
+        LEAKABLE(Parts[i].Rest,     "CsvList Rest");
+    } // for
+    LEAKABLE(Parts, "CsvList Parts");
+
+    List->Parts = Parts;
+
+    return Parts;
+} // CSV_PATH_PARTS * GetCsvListPathParts()
+
 // Delete an element from a list of comma separated values.
 // Modifies the *List string, but not the *ToDelete string!
 // Returns TRUE if the item was deleted, FALSE otherwise.
@@ -845,23 +1278,31 @@ BOOLEAN IsIn (
     IN CHAR16 *SmallString,
     IN CHAR16 *List
 ) {
-   UINTN     i = 0;
-   BOOLEAN   Found = FALSE;
-   CHAR16    *OneElement;
+    UINTN     i, Length;
+    UINT32    Hash;
+    CSV_LIST *Compiled;
+
+    if (!SmallString || !List) {
+        return FALSE;
+    }
 
-   if (!SmallString || !List) {
-       return FALSE;
-   }
+    Compiled = GetCsvList (List);
+    if (Compiled == NULL) {
+        return FALSE;
+    }
 
-    while (!Found && (OneElement = FindCommaDelimited (List, i++))) {
-        if (MyStriCmp (OneElement, SmallString)) {
-            Found = TRUE;
+    Length = StrLen (SmallString);
+    Hash   = CsvFoldedHash (SmallString, Length);
+    for (i = 0; i < Compiled->Count; i++) {
+        if (Compiled->Lengths[i] == Length &&
+            Compiled->Hashes[i]  == Hash &&
+            MyStriCmp (Compiled->Items[i], SmallString)
+        ) {
+            return TRUE;
         }
+    } // for
 
-        MY_FREE_POOL(OneElement);
-    } // while
-
-   return Found;
+    return FALSE;
 } // BOOLEAN IsIn()
 
 // Returns TRUE if any element of List can be found as a substring of
@@ -870,33 +1311,28 @@ BOOLEAN IsInSubstring (
     IN CHAR16 *BigString,
     IN CHAR16 *List
 ) {
-    UINTN   i = 0, ElementLength;
-    BOOLEAN Found = FALSE;
-    CHAR16  *OneElement;
+    UINTN     i, BigLength;
+    CSV_LIST *Compiled;
 
     if (!BigString || !List) {
         return FALSE;
     }
 
-    while (!Found && (OneElement = FindCommaDelimited (List, i++))) {
-        ElementLength = StrLen(OneElement);
-        if (
-            ElementLength <= StrLen(BigString) &&
-            ElementLength > 0 &&
-            StriSubCmp (OneElement, BigString)
-        ) {
-            Found = TRUE;
-        } // if
+    Compiled = GetCsvList (List);
+    if (Compiled == NULL) {
+        return FALSE;
+    }
 
-        if ((ElementLength <= StrLen (BigString)) &&
-            (StriSubCmp (OneElement, BigString))
+    BigLength = StrLen (BigString);
+    for (i = 0; i < Compiled->Count; i++) {
+        if ((Compiled->Lengths[i] <= BigLength) &&
+            (StriSubCmp (Compiled->Items[i], BigString))
         ) {
-            Found = TRUE;
+            return TRUE;
         }
-        MY_FREE_POOL(OneElement);
-    } // while
+    } // for
 
-    return Found;
+    return FALSE;
 } // BOOLEAN IsSubstringIn()
 
 // Replace *SearchString in **MainString with *ReplString -- but if *SearchString
@@ -907,8 +1343,9 @@ BOOLEAN ReplaceSubstring (
     IN     CHAR16  *SearchString,
     IN     CHAR16  *ReplString
 ) {
-    BOOLEAN WasReplaced = FALSE;
-    CHAR16 *FoundSearchString, *NewString, *EndString;
+    BOOLEAN         WasReplaced = FALSE;
+    CHAR16         *FoundSearchString, *EndString;
+    STRING_BUILDER  NewString;
 
     LOG(4, LOG_BLANK_LINE_SEP, L"X");
     LOG(4, LOG_LINE_FORENSIC,
@@ -927,38 +1364,30 @@ BOOLEAN ReplaceSubstring (
     //LOG(4, LOG_LINE_FORENSIC, L"In ReplaceSubstring ... 2");
     if (FoundSearchString) {
         //LOG(4, LOG_LINE_FORENSIC, L"In ReplaceSubstring ... 2a 1");
-        NewString = AllocateZeroPool (sizeof (CHAR16) * StrLen(*MainString));
+        EndString = &(FoundSearchString[StrLen (SearchString)]);
 
         //LOG(4, LOG_LINE_FORENSIC, L"In ReplaceSubstring ... 2a 2");
-        if (NewString) {
+        if ((FoundSearchString > *MainString) && (FoundSearchString[-1] == L'%')) {
             //LOG(4, LOG_LINE_FORENSIC, L"In ReplaceSubstring ... 2a 2a 1");
-            EndString = &(FoundSearchString[StrLen (SearchString)]);
-            FoundSearchString[0] = L'\0';
-
-            //LOG(4, LOG_LINE_FORENSIC, L"In ReplaceSubstring ... 2a 2a 2");
-            if ((FoundSearchString > *MainString) && (FoundSearchString[-1] == L'%')) {
-                //LOG(4, LOG_LINE_FORENSIC, L"In ReplaceSubstring ... 2a 2a 2a 1");
-                FoundSearchString[-1] = L'\0';
-                ReplString = SearchString;
-            }
-
-            //LOG(4, LOG_LINE_FORENSIC, L"In ReplaceSubstring ... 2a 2a 3");
-            StrCpy (NewString, *MainString);
-
-            //LOG(4, LOG_LINE_FORENSIC, L"In ReplaceSubstring ... 2a 2a 4");
-            MergeStrings (&NewString, ReplString, L'\0');
-
-            //LOG(4, LOG_LINE_FORENSIC, L"In ReplaceSubstring ... 2a 2a 5");
-            MergeStrings (&NewString, EndString, L'\0');
-
-            //LOG(4, LOG_LINE_FORENSIC, L"In ReplaceSubstring ... 2a 2a 6");
-            MY_FREE_POOL(MainString);
-            *MainString = NewString;
+            FoundSearchString--;
+            ReplString = SearchString;
+        }
 
-            //LOG(4, LOG_LINE_FORENSIC, L"In ReplaceSubstring ... 2a 2a 7 - WasReplaced = TRUE");
+        //LOG(4, LOG_LINE_FORENSIC, L"In ReplaceSubstring ... 2a 3");
+        StrBuilderInit (&NewString);
+        StrBuilderReserve (&NewString, StrLen (*MainString) + StrLen (ReplString));
+        StrBuilderAppendN (&NewString, *MainString, FoundSearchString - *MainString);
+        StrBuilderAppend (&NewString, ReplString);
+        StrBuilderAppend (&NewString, EndString);
+
+        //LOG(4, LOG_LINE_FORENSIC, L"In ReplaceSubstring ... 2a 4");
+        if (!NewString.Failed) {
+            //LOG(4, LOG_LINE_FORENSIC, L"In ReplaceSubstring ... 2a 4a 1 - WasReplaced = TRUE");
+            MY_FREE_POOL(*MainString);
+            *MainString = StrBuilderDetach (&NewString);
             WasReplaced = TRUE;
         }
-        //LOG(4, LOG_LINE_FORENSIC, L"In ReplaceSubstring ... 2a 3");
+        //LOG(4, LOG_LINE_FORENSIC, L"In ReplaceSubstring ... 2a 5");
     }
 
     LOG(4, LOG_LINE_FORENSIC,
@@ -39,6 +39,38 @@ typedef struct _string_list {
     struct _string_list  *Next;
 } STRING_LIST;
 
+// Volume, path and file name parts of a list element, as from SplitPathName.
+// 'Rest' is the element after any volume, as matched against directories.
+typedef struct {
+    CHAR16   *VolName;
+    CHAR16   *Path;
+    CHAR16   *Filename;
+    CHAR16   *Rest;
+} CSV_PATH_PARTS;
+
+// A comma-delimited list split into its elements once.
+// Each element has a hash of its case folded text for quick matching.
+typedef struct {
+    CHAR16           *Source;
+    CHAR16           *Buffer;
+    CHAR16          **Items;
+    UINTN            *Lengths;
+    UINT32           *Hashes;
+    CSV_PATH_PARTS   *Parts;
+    UINTN             Count;
+} CSV_LIST;
+
+// A string grown in place by appending to it.
+// The buffer doubles when full, so building a string from many fragments
+// copies each character a constant number of times on average.
+// 'Failed' is set if an allocation fails; the builder then ignores appends.
+typedef struct {
+    CHAR16    *Buffer;
+    UINTN      Length;
+    UINTN      Capacity;
+    BOOLEAN    Failed;
+} STRING_BUILDER;
+
 // DA-TAG: See here for more if needed:
 //         https://www.virtualbox.org/svn/vbox/trunk/src/VBox/Devices/EFI/Firmware/MdePkg/Library/BaseLib/String.c
 BOOLEAN FoundSubStr (IN CHAR16 *RawString, IN CHAR16 *RawStrCharSet);
@@ -66,6 +98,9 @@ CHAR16 * MyStrStr (IN CHAR16 *String, IN CHAR16 *SubStr);
 CHAR16 * FindNumbers (IN CHAR16 *InString);
 CHAR16 * GuidAsString (EFI_GUID *GuidData);
 CHAR16 * FindCommaDelimited (IN CHAR16 *InString, IN UINTN Index);
+CSV_LIST * GetCsvList (IN CHAR16 *InString);
+CSV_PATH_PARTS * GetCsvListPathParts (IN CSV_LIST *List);
+UINT32 CsvFoldedHash (IN CHAR16 *String, IN UINTN Length);
 CHAR16 * SanitiseString (CHAR16 *InString);
 CHAR16 * MyAsciiStrCopyToUnicode (
     IN  CHAR8   *AsciiString,
@@ -80,6 +115,22 @@ CHAR16 * MergeStringsNew (IN CHAR16 *First, IN CHAR16 *Second, CHAR16 AddChar);
 VOID MergeUniqueStrings (IN OUT CHAR16 **First, IN CHAR16 *Second, CHAR16 AddChar);
 VOID MergeWords (CHAR16 **MergeTo, CHAR16 *InString, CHAR16 AddChar);
 VOID MergeUniqueWords (CHAR16 **MergeTo, CHAR16 *InString, CHAR16 AddChar);
+VOID StrBuilderInit (OUT STRING_BUILDER *Builder);
+VOID StrBuilderFree (IN OUT STRING_BUILDER *Builder);
+BOOLEAN StrBuilderReserve (IN OUT STRING_BUILDER *Builder, IN UINTN Extra);
+BOOLEAN StrBuilderAppendN (IN OUT STRING_BUILDER *Builder, IN CHAR16 *String, IN UINTN Length);
+BOOLEAN StrBuilderAppend (IN OUT STRING_BUILDER *Builder, IN CHAR16 *String);
+BOOLEAN StrBuilderAppendChar (IN OUT STRING_BUILDER *Builder, IN CHAR16 Char);
+BOOLEAN StrBuilderMerge (IN OUT STRING_BUILDER *Builder, IN CHAR16 *String, IN CHAR16 AddChar);
+BOOLEAN StrBuilderMergeUnique (IN OUT STRING_BUILDER *Builder, IN CHAR16 *String, IN CHAR16 AddChar);
+BOOLEAN StrBuilderMergeWords (
+    IN OUT STRING_BUILDER *Builder,
+    IN     CHAR16         *InString,
+    IN     CHAR16          AddChar,
+    IN     BOOLEAN         Unique
+);
+BOOLEAN EFIAPI StrBuilderFormat (IN OUT STRING_BUILDER *Builder, IN CHAR16 *Format, ...);
+CHAR16 * StrBuilderDetach (IN OUT STRING_BUILDER *Builder);
 VOID MyUnicodeFilterString (
     IN OUT CHAR16   *String,
     IN     BOOLEAN   SingleLine
@@ -0,0 +1,437 @@
+/*
+ * BootMaster/profile.c
+ * Boot phase profiler
+ *
+ * Distributed under the terms of the GNU General Public License (GPL)
+ * version 3 (GPLv3), or (at your option) any later version.
+ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "global.h"
+#include "lib.h"
+#include "profile.h"
+#include "MemLogLib.h"
+#include "../libeg/libeg.h"
+
+// Spans are recorded as begin and end events, stamped with the TSC, in a ring
+// allocated when profiling starts, so recording itself never allocates. Call
+// counts and times for each span name are kept alongside, as the ring wraps on
+// long sessions. ProfileSave writes the events as a Chrome trace, which loads
+// in Perfetto or chrome://tracing, and the totals as a plain text summary, to
+// the RefindPlus directory.
+//
+// Profiling starts with the program and is stopped again once the config file
+// has been read, unless the 'profile' token is set.
+#define PROFILE_TRACE_FILE_NAME    L"profile.json"
+#define PROFILE_SUMMARY_FILE_NAME  L"profile.txt"
+#define PROFILE_RING_SIZE          8192     // Must be a power of two
+#define PROFILE_SITE_SLOTS         128      // Must be a power of two
+#define PROFILE_MAX_DEPTH          32
+#define PROFILE_SUMMARY_MAX        24
+
+typedef struct {
+    UINT64         Tsc;
+    CONST CHAR8   *Name;
+    BOOLEAN        Begin;
+} PROFILE_EVENT;
+
+typedef struct {
+    CONST CHAR8   *Name;
+    UINT64         Calls;
+    UINT64         TotalTicks;
+    UINT64         SelfTicks;
+    UINT64         MaxTicks;
+} PROFILE_SITE;
+
+typedef struct {
+    CONST CHAR8   *Name;
+    UINT64         StartTsc;
+    UINT64         ChildTicks;
+} PROFILE_FRAME;
+
+typedef struct {
+    CHAR8         *Data;
+    UINTN          Length;
+    UINTN          Size;
+} PROFILE_TEXT;
+
+BOOLEAN ProfileActive = FALSE;
+
+static PROFILE_EVENT  *ProfileRing        = NULL;
+static UINTN           ProfileEventCount  = 0;    // Includes events since overwritten
+static UINTN           ProfileSavedCount  = 0;
+static PROFILE_SITE   *ProfileSites       = NULL;
+static UINTN           ProfileSiteCount   = 0;
+static PROFILE_FRAME   ProfileStack[PROFILE_MAX_DEPTH];
+static UINTN           ProfileDepth       = 0;
+static UINTN           ProfileTooDeep     = 0;    // Open spans beyond PROFILE_MAX_DEPTH
+static UINTN           ProfileUnmatched   = 0;
+static UINT64          ProfileStartTsc    = 0;
+static UINT64          ProfileTicksPerSec = 0;
+
+static
+VOID ProfileRecord (
+    IN UINT64       Tsc,
+    IN CONST CHAR8 *Name,
+    IN BOOLEAN      Begin
+) {
+    PROFILE_EVENT *Event;
+
+    Event        = &ProfileRing[ProfileEventCount & (PROFILE_RING_SIZE - 1)];
+    Event->Tsc   = Tsc;
+    Event->Name  = Name;
+    Event->Begin = Begin;
+    ProfileEventCount++;
+} // static VOID ProfileRecord()
+
+// Identical literals in different places need not share an address,
+// so names that are not the same pointer are compared as strings.
+static
+BOOLEAN ProfileSameName (
+    IN CONST CHAR8 *Name1,
+    IN CONST CHAR8 *Name2
+) {
+    return (Name1 == Name2 || AsciiStrCmp (Name1, Name2) == 0);
+} // static BOOLEAN ProfileSameName()
+
+static
+PROFILE_SITE * ProfileFindSite (
+    IN CONST CHAR8 *Name
+) {
+    UINTN         Slot;
+    CONST CHAR8  *p;
+
+    Slot = 0;
+    for (p = Name; *p != '\0'; p++) {
+        Slot = (Slot * 31) + (UINT8) *p;
+    }
+    Slot &= PROFILE_SITE_SLOTS - 1;
+
+    while (ProfileSites[Slot].Name != NULL) {
+        if (ProfileSameName (ProfileSites[Slot].Name, Name)) {
+            return &ProfileSites[Slot];
+        }
+        Slot = (Slot + 1) & (PROFILE_SITE_SLOTS - 1);
+    } // while
+
+    // Keep one slot free so that the probe above always ends
+    if (ProfileSiteCount >= PROFILE_SITE_SLOTS - 1) {
+        return NULL;
+    }
+
+    ProfileSites[Slot].Name = Name;
+    ProfileSiteCount++;
+
+    return &ProfileSites[Slot];
+} // static PROFILE_SITE * ProfileFindSite()
+
+static
+UINT64 ProfileMicroseconds (
+    IN UINT64 Ticks
+) {
+    UINT64 Seconds;
+    UINT64 Remainder;
+
+    // Whole seconds first, so that scaling cannot overflow on long sessions
+    Seconds = DivU64x64Remainder (Ticks, ProfileTicksPerSec, &Remainder);
+
+    return MultU64x32 (Seconds, 1000000)
+        + DivU64x64Remainder (MultU64x32 (Remainder, 1000000), ProfileTicksPerSec, NULL);
+} // static UINT64 ProfileMicroseconds()
+
+VOID ProfileStart (VOID) {
+    if (ProfileActive) {
+        return;
+    }
+
+    ProfileTicksPerSec = GetMemLogTscTicksPerSecond();
+    if (ProfileTicksPerSec == 0) {
+        // No timer to stamp events with
+        return;
+    }
+
+    ProfileRing  = AllocatePool (PROFILE_RING_SIZE * sizeof (PROFILE_EVENT));
+    ProfileSites = AllocateZeroPool (PROFILE_SITE_SLOTS * sizeof (PROFILE_SITE));
+    if (ProfileRing == NULL || ProfileSites == NULL) {
+        MY_FREE_POOL(ProfileRing);
+        MY_FREE_POOL(ProfileSites);
+
+        return;
+    }
+
+    ProfileEventCount = 0;
+    ProfileSavedCount = 0;
+    ProfileSiteCount  = 0;
+    ProfileDepth      = 0;
+    ProfileTooDeep    = 0;
+    ProfileUnmatched  = 0;
+    ProfileStartTsc   = AsmReadTsc();
+    ProfileActive     = TRUE;
+} // VOID ProfileStart()
+
+VOID ProfileStop (VOID) {
+    ProfileActive = FALSE;
+    MY_FREE_POOL(ProfileRing);
+    MY_FREE_POOL(ProfileSites);
+} // VOID ProfileStop()
+
+VOID ProfileBegin (
+    IN CONST CHAR8 *Name
+) {
+    UINT64 Now;
+
+    if (ProfileDepth >= PROFILE_MAX_DEPTH) {
+        ProfileTooDeep++;
+
+        return;
+    }
+
+    Now = AsmReadTsc();
+    ProfileStack[ProfileDepth].Name       = Name;
+    ProfileStack[ProfileDepth].StartTsc   = Now;
+    ProfileStack[ProfileDepth].ChildTicks = 0;
+    ProfileDepth++;
+
+    ProfileRecord (Now, Name, TRUE);
+} // VOID ProfileBegin()
+
+// Ends the innermost open span with this name. Any spans opened inside it
+// that were not ended are ended here too and counted as unmatched.
+VOID ProfileEnd (
+    IN CONST CHAR8 *Name
+) {
+    UINT64          Now;
+    UINT64          Ticks;
+    UINTN           Level;
+    PROFILE_FRAME  *Frame;
+    PROFILE_SITE   *Site;
+
+    Now = AsmReadTsc();
+
+    if (ProfileTooDeep > 0) {
+        ProfileTooDeep--;
+
+        return;
+    }
+
+    for (Level = ProfileDepth; Level > 0; Level--) {
+        if (ProfileSameName (ProfileStack[Level - 1].Name, Name)) {
+            break;
+        }
+    }
+    if (Level == 0) {
+        ProfileUnmatched++;
+
+        return;
+    }
+
+    while (ProfileDepth >= Level) {
+        Frame = &ProfileStack[--ProfileDepth];
+        if (ProfileDepth >= Level) {
+            ProfileUnmatched++;
+        }
+
+        Ticks = Now - Frame->StartTsc;
+        ProfileRecord (Now, Frame->Name, FALSE);
+
+        Site = ProfileFindSite (Frame->Name);
+        if (Site != NULL) {
+            Site->Calls++;
+            Site->TotalTicks += Ticks;
+            Site->SelfTicks  += (Frame->ChildTicks < Ticks) ? Ticks - Frame->ChildTicks : 0;
+            if (Ticks > Site->MaxTicks) {
+                Site->MaxTicks = Ticks;
+            }
+        }
+
+        if (ProfileDepth > 0) {
+            ProfileStack[ProfileDepth - 1].ChildTicks += Ticks;
+        }
+    } // while
+} // VOID ProfileEnd()
+
+static
+VOID EFIAPI ProfileAppend (
+    IN OUT PROFILE_TEXT *Text,
+    IN     CONST CHAR8  *Format,
+    ...
+) {
+    CHAR8    Line[256];
+    CHAR8   *NewData;
+    UINTN    Length;
+    UINTN    NewSize;
+    VA_LIST  Args;
+
+    VA_START(Args, Format);
+    Length = AsciiVSPrint (Line, sizeof (Line), Format, Args);
+    VA_END(Args);
+
+    if (Text->Length + Length + 1 > Text->Size) {
+        NewSize = (Text->Size == 0) ? 16384 : Text->Size;
+        while (Text->Length + Length + 1 > NewSize) {
+            NewSize *= 2;
+        }
+
+        NewData = AllocatePool (NewSize);
+        if (NewData == NULL) {
+            return;
+        }
+        if (Text->Data != NULL) {
+            CopyMem (NewData, Text->Data, Text->Length);
+            MY_FREE_POOL(Text->Data);
+        }
+        Text->Data = NewData;
+        Text->Size = NewSize;
+    }
+
+    CopyMem (Text->Data + Text->Length, Line, Length);
+    Text->Length += Length;
+    Text->Data[Text->Length] = '\0';
+} // static VOID ProfileAppend()
+
+// Span names are C identifiers or plain phrases, so they need no escaping.
+static
+VOID ProfileWriteTrace (
+    IN OUT PROFILE_TEXT *Text
+) {
+    UINTN           i;
+    UINTN           First;
+    PROFILE_EVENT  *Event;
+
+    First = (ProfileEventCount > PROFILE_RING_SIZE) ? ProfileEventCount - PROFILE_RING_SIZE : 0;
+
+    ProfileAppend (Text, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (i = First; i < ProfileEventCount; i++) {
+        Event = &ProfileRing[i & (PROFILE_RING_SIZE - 1)];
+        ProfileAppend (Text,
+            "%a{\"name\":\"%a\",\"ph\":\"%a\",\"ts\":%ld,\"pid\":1,\"tid\":1}\n",
+            (i == First) ? "" : ",",
+            Event->Name,
+            Event->Begin ? "B" : "E",
+            ProfileMicroseconds (Event->Tsc - ProfileStartTsc)
+        );
+    }
+    ProfileAppend (Text, "]}\n");
+} // static VOID ProfileWriteTrace()
+
+static
+VOID ProfileWriteTime (
+    IN OUT PROFILE_TEXT *Text,
+    IN     UINT64        Ticks
+) {
+    UINT64 Microseconds;
+    UINT64 Remainder;
+
+    Microseconds = ProfileMicroseconds (Ticks);
+    Microseconds = DivU64x64Remainder (Microseconds, 1000, &Remainder);
+    ProfileAppend (Text, "  %8ld.%03ld", Microseconds, Remainder);
+} // static VOID ProfileWriteTime()
+
+// Lists the spans with the most total time, largest first.
+static
+VOID ProfileWriteSummary (
+    IN OUT PROFILE_TEXT *Text
+) {
+    UINTN           i, j, Count;
+    PROFILE_SITE  **Order;
+    PROFILE_SITE   *Swap;
+
+    Order = AllocatePool (PROFILE_SITE_SLOTS * sizeof (PROFILE_SITE *));
+    if (Order == NULL) {
+        return;
+    }
+
+    Count = 0;
+    for (i = 0; i < PROFILE_SITE_SLOTS; i++) {
+        if (ProfileSites[i].Name != NULL && ProfileSites[i].Calls > 0) {
+            Order[Count++] = &ProfileSites[i];
+        }
+    }
+
+    ProfileAppend (Text, "RefindPlus Boot Profile\n\n");
+    ProfileAppend (Text,
+        "Events:- %ld (%ld Dropped from Trace), Unmatched Ends:- %ld\n\n",
+        (UINT64) ProfileEventCount,
+        (UINT64) ((ProfileEventCount > PROFILE_RING_SIZE) ? ProfileEventCount - PROFILE_RING_SIZE : 0),
+        (UINT64) ProfileUnmatched
+    );
+    ProfileAppend (Text, "     Calls      Total ms       Self ms        Max ms  Span\n");
+
+    for (i = 0; i < Count && i < PROFILE_SUMMARY_MAX; i++) {
+        for (j = i + 1; j < Count; j++) {
+            if (Order[j]->TotalTicks > Order[i]->TotalTicks) {
+                Swap     = Order[i];
+                Order[i] = Order[j];
+                Order[j] = Swap;
+            }
+        }
+
+        ProfileAppend (Text, "%10ld", Order[i]->Calls);
+        ProfileWriteTime (Text, Order[i]->TotalTicks);
+        ProfileWriteTime (Text, Order[i]->SelfTicks);
+        ProfileWriteTime (Text, Order[i]->MaxTicks);
+        ProfileAppend (Text, "  %a\n", Order[i]->Name);
+    } // for
+
+    MY_FREE_POOL(Order);
+} // static VOID ProfileWriteSummary()
+
+static
+EFI_STATUS ProfileSaveText (
+    IN CHAR16        *FileName,
+    IN PROFILE_TEXT  *Text
+) {
+    if (Text->Data == NULL) {
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    // egSaveFile does not truncate ... Delete any previous file first
+    egSaveFile (SelfDir, FileName, NULL, 0);
+
+    return egSaveFile (SelfDir, FileName, (UINT8 *) Text->Data, Text->Length);
+} // static EFI_STATUS ProfileSaveText()
+
+// Writes the trace and the summary if spans were recorded since the last save.
+VOID ProfileSave (VOID) {
+    EFI_STATUS    Status;
+    PROFILE_TEXT  Trace   = { NULL, 0, 0 };
+    PROFILE_TEXT  Summary = { NULL, 0, 0 };
+
+    if (!ProfileActive || SelfDir == NULL || ProfileEventCount == ProfileSavedCount) {
+        return;
+    }
+
+    ProfileWriteTrace (&Trace);
+    ProfileWriteSummary (&Summary);
+
+    Status = ProfileSaveText (PROFILE_TRACE_FILE_NAME, &Trace);
+    if (!EFI_ERROR(Status)) {
+        Status = ProfileSaveText (PROFILE_SUMMARY_FILE_NAME, &Summary);
+    }
+    MY_FREE_POOL(Trace.Data);
+    MY_FREE_POOL(Summary.Data);
+
+    if (!EFI_ERROR(Status)) {
+        ProfileSavedCount = ProfileEventCount;
+    }
+
+    #if REFIT_DEBUG > 0
+    LOG(2, LOG_LINE_NORMAL,
+        L"Save Boot Profile to '%s' and '%s' ... %r",
+        PROFILE_TRACE_FILE_NAME, PROFILE_SUMMARY_FILE_NAME, Status
+    );
+    #endif
+} // VOID ProfileSave()
@@ -0,0 +1,48 @@
+/*
+ * BootMaster/profile.h
+ * Boot phase profiler
+ *
+ * Distributed under the terms of the GNU General Public License (GPL)
+ * version 3 (GPLv3), or (at your option) any later version.
+ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __PROFILE_H_
+#define __PROFILE_H_
+
+#ifdef __MAKEWITH_GNUEFI
+#include "efi.h"
+#include "efilib.h"
+#else
+#include "../include/tiano_includes.h"
+#endif
+
+extern BOOLEAN ProfileActive;
+
+// Span names must be string literals as they are kept until saved.
+// Spans must be properly nested within each other.
+#define PROFILE_BEGIN(Name) do { if (ProfileActive) ProfileBegin (Name); } while (0)
+#define PROFILE_END(Name)   do { if (ProfileActive) ProfileEnd   (Name); } while (0)
+
+VOID ProfileStart (VOID);
+VOID ProfileStop (VOID);
+VOID ProfileBegin (IN CONST CHAR8 *Name);
+VOID ProfileEnd (IN CONST CHAR8 *Name);
+VOID ProfileSave (VOID);
+
+#endif
+
+/* EOF */
@@ -63,6 +63,10 @@
 #include "linux.h"
 #include "scan.h"
 #include "install.h"
+#include "profile.h"
+#include "sha256.h"
+#include "scan_cache.h"
+#include "volume_index.h"
 #include "../include/refit_call_wrapper.h"
 
 
@@ -127,6 +131,7 @@ BOOLEAN  FirstLoaderScan = FALSE;
 // a linked list; used to sort entries within a directory.
 struct LOADER_LIST {
     CHAR16              *FileName;
+    CHAR16              *Title;       // Name of the OS in a Unified Kernel Image
     EFI_TIME             TimeStamp;
     struct LOADER_LIST  *NextEntry;
 };
@@ -328,6 +333,7 @@ VOID GenerateSubScreen (
     LOADER_ENTRY       *SubEntry;
     CHAR16             *InitrdName;
     CHAR16             *KernelVersion = NULL;
+    CHAR16             *KernelOptions = NULL;
     CHAR16            **TokenList;
     CHAR16              DiagsFileName[256];
     UINTN               TokenCount;
@@ -442,8 +448,6 @@ VOID GenerateSubScreen (
                 KernelVersion = FindNumbers (GetPoolStr (&Entry->LoaderPath));
 
                 LOG(4, LOG_LINE_FORENSIC, L"In GenerateSubScreen OSType L ... 2a 4");
-                ReplaceSubstring (&(TokenList[1]), KERNEL_VERSION, KernelVersion);
-
                 LOG(4, LOG_LINE_FORENSIC, L"In GenerateSubScreen OSType L ... 2a 5");
                 // first entry requires special processing, since it was initially set
                 // up with a default title but correct options by InitializeSubScreen(),
@@ -467,7 +471,9 @@ VOID GenerateSubScreen (
                 while ((TokenCount = ReadTokenLine (File, &TokenList)) > 1) {
                     LOG(4, LOG_BLANK_LINE_SEP, L"X");
                     LOG(4, LOG_LINE_FORENSIC, L"In GenerateSubScreen OSType L ... 2a 7a 1 START WHILE LOOP");
-                    ReplaceSubstring (&(TokenList[1]), KERNEL_VERSION, KernelVersion);
+                    // Tokens point into the file buffer, so replace in a copy
+                    KernelOptions = StrDuplicate (TokenList[1]);
+                    ReplaceSubstring (&KernelOptions, KERNEL_VERSION, KernelVersion);
 
                     LOG(4, LOG_LINE_FORENSIC, L"In GenerateSubScreen OSType L ... 2a 7a 2");
                     SubEntry = InitializeLoaderEntry (Entry);
@@ -485,7 +491,7 @@ VOID GenerateSubScreen (
                         LOG(4, LOG_LINE_FORENSIC, L"In GenerateSubScreen OSType L ... 2a 7a 3a 2");
 
                         LOG(4, LOG_LINE_FORENSIC, L"In GenerateSubScreen OSType L ... 2a 7a 3a 3");
-                        AssignPoolStr (&SubEntry->LoadOptions, AddInitrdToOptions (TokenList[1], InitrdName));
+                        AssignPoolStr (&SubEntry->LoadOptions, AddInitrdToOptions (KernelOptions, InitrdName));
 
                         LOG(4, LOG_LINE_FORENSIC, L"In GenerateSubScreen OSType L ... 2a 7a 3a 4");
                         SubEntry->UseGraphicsMode = GlobalConfig.GraphicsFor & GRAPHICS_FOR_LINUX;
@@ -496,6 +502,7 @@ VOID GenerateSubScreen (
 
                     LOG(4, LOG_LINE_FORENSIC, L"In GenerateSubScreen OSType L ... 2a 7a 4");
                     FreeTokenLine (&TokenList, &TokenCount);
+                    MY_FREE_POOL(KernelOptions);
 
                     LOG(4, LOG_LINE_FORENSIC, L"In GenerateSubScreen OSType L ... 2a 7a 5 END WHILE LOOP");
                     LOG(4, LOG_BLANK_LINE_SEP, L"X");
@@ -605,11 +612,11 @@ VOID SetLoaderDefaults (
 ) {
     LOGPROCENTRY("for '%s'", GetPoolStr (&Entry->me.Title));
 
-    CHAR16  *PathOnly;
-    CHAR16  *NameClues;
-    CHAR16  *OSIconName     = NULL;
-    CHAR16   ShortcutLetter = 0;
-    BOOLEAN  MergeFsName    = FALSE;
+    CHAR16          *PathOnly;
+    CHAR16          *NameClues;
+    CHAR16           ShortcutLetter = 0;
+    BOOLEAN          MergeFsName    = FALSE;
+    STRING_BUILDER   OSIconName;
 
     #if REFIT_DEBUG > 0
     LOG(2, LOG_LINE_NORMAL,
@@ -618,6 +625,8 @@ VOID SetLoaderDefaults (
     );
     #endif
 
+    StrBuilderInit (&OSIconName);
+
     NameClues = Basename (LoaderPath);
 
     PathOnly  = FindPath (LoaderPath);
@@ -708,12 +717,12 @@ VOID SetLoaderDefaults (
 
             CHAR16 *Temp = FindLastDirName (LoaderPath);
 
-            MergeStrings (&OSIconName, Temp, L',');
+            StrBuilderMerge (&OSIconName, Temp, L',');
 
             MY_FREE_POOL(Temp);
 
-            if (OSIconName != NULL) {
-                ShortcutLetter = OSIconName[0];
+            if (OSIconName.Buffer != NULL) {
+                ShortcutLetter = OSIconName.Buffer[0];
             }
 
             // Add every "word" in the filesystem and partition names, delimited by
@@ -736,7 +745,7 @@ VOID SetLoaderDefaults (
                     }
                     #endif
 
-                    MergeUniqueWords (&OSIconName, GetPoolStr (&Volume->FsName), L',');
+                    StrBuilderMergeWords (&OSIconName, GetPoolStr (&Volume->FsName), L',', TRUE);
                 }
                 else {
                     if (GetPoolStr (&Volume->VolName) && (GetPoolStr (&Volume->VolName)[0] != L'\0')) {
@@ -763,7 +772,7 @@ VOID SetLoaderDefaults (
                         }
                         #endif
 
-                        MergeUniqueWords (&OSIconName, TargetName, L',');
+                        StrBuilderMergeWords (&OSIconName, TargetName, L',', TRUE);
 
                         MY_FREE_POOL(DisplayName);
                     }
@@ -780,7 +789,7 @@ VOID SetLoaderDefaults (
                 }
                 #endif
 
-                MergeUniqueWords (&OSIconName, GetPoolStr (&Volume->PartName), L',');
+                StrBuilderMergeWords (&OSIconName, GetPoolStr (&Volume->PartName), L',', TRUE);
             }
         } // if/else Volume->DiskKind == DISK_KIND_NET
     }
@@ -805,7 +814,7 @@ VOID SetLoaderDefaults (
 
         }
 
-        MergeStrings (&OSIconName, L"linux", L',');
+        StrBuilderMerge (&OSIconName, L"linux", L',');
         Entry->OSType = 'L';
 
         if (ShortcutLetter == 0) {
@@ -815,14 +824,14 @@ VOID SetLoaderDefaults (
         Entry->UseGraphicsMode = GlobalConfig.GraphicsFor & GRAPHICS_FOR_LINUX;
     }
     else if (StriSubCmp (L"refit", LoaderPath)) {
-        MergeStrings (&OSIconName, L"refit", L',');
+        StrBuilderMerge (&OSIconName, L"refit", L',');
 
         Entry->OSType = 'R';
         ShortcutLetter = 'R';
 
     }
     else if (StriSubCmp (L"refind", LoaderPath)) {
-        MergeStrings (&OSIconName, L"refind", L',');
+        StrBuilderMerge (&OSIconName, L"refind", L',');
 
         Entry->OSType = 'R';
         ShortcutLetter = 'R';
@@ -832,13 +841,13 @@ VOID SetLoaderDefaults (
         if (FileExists (Volume->RootDir, L"EFI\\refind\\config.conf") ||
             FileExists (Volume->RootDir, L"EFI\\refind\\refind.conf")
         ) {
-            MergeStrings (&OSIconName, L"refind", L',');
+            StrBuilderMerge (&OSIconName, L"refind", L',');
 
             Entry->OSType = 'R';
             ShortcutLetter = 'R';
         }
         else {
-            MergeStrings (&OSIconName, L"mac", L',');
+            StrBuilderMerge (&OSIconName, L"mac", L',');
 
             Entry->OSType = 'M';
             ShortcutLetter = 'M';
@@ -846,13 +855,13 @@ VOID SetLoaderDefaults (
         }
     }
     else if (MyStriCmp (NameClues, L"diags.efi")) {
-        MergeStrings (&OSIconName, L"hwtest", L',');
+        StrBuilderMerge (&OSIconName, L"hwtest", L',');
     }
     else if (MyStriCmp (NameClues, L"e.efi") ||
         MyStriCmp (NameClues, L"elilo.efi")  ||
         StriSubCmp (L"elilo", NameClues)
     ) {
-        MergeStrings (&OSIconName, L"elilo,linux", L',');
+        StrBuilderMerge (&OSIconName, L"elilo,linux", L',');
         Entry->OSType = 'E';
 
         if (ShortcutLetter == 0) {
@@ -861,7 +870,7 @@ VOID SetLoaderDefaults (
         Entry->UseGraphicsMode = GlobalConfig.GraphicsFor & GRAPHICS_FOR_ELILO;
     }
     else if (StriSubCmp (L"grub", NameClues)) {
-        MergeStrings (&OSIconName, L"grub,linux", L',');
+        StrBuilderMerge (&OSIconName, L"grub,linux", L',');
 
         Entry->OSType = 'G';
         ShortcutLetter = 'G';
@@ -872,31 +881,31 @@ VOID SetLoaderDefaults (
         MyStriCmp (NameClues, L"bootmgfw.efi") ||
         MyStriCmp (NameClues, L"bkpbootmgfw.efi")
     ) {
-        MergeStrings (&OSIconName, L"win8", L',');
+        StrBuilderMerge (&OSIconName, L"win8", L',');
 
         Entry->OSType = 'W';
         ShortcutLetter = 'W';
         Entry->UseGraphicsMode = GlobalConfig.GraphicsFor & GRAPHICS_FOR_WINDOWS;
     }
     else if (MyStriCmp (NameClues, L"xom.efi")) {
-        MergeStrings (&OSIconName, L"xom,win,win8", L',');
+        StrBuilderMerge (&OSIconName, L"xom,win,win8", L',');
 
         Entry->OSType = 'X';
         ShortcutLetter = 'W';
         Entry->UseGraphicsMode = GlobalConfig.GraphicsFor & GRAPHICS_FOR_WINDOWS;
     }
     else if (MyStriCmp (NameClues, L"opencore")) {
-        MergeStrings (&OSIconName, L"opencore", L',');
+        StrBuilderMerge (&OSIconName, L"opencore", L',');
 
         Entry->UseGraphicsMode = GlobalConfig.GraphicsFor & GRAPHICS_FOR_OPENCORE;
     }
     else if (MyStriCmp (NameClues, L"clover")) {
-        MergeStrings (&OSIconName, L"clover", L',');
+        StrBuilderMerge (&OSIconName, L"clover", L',');
 
         Entry->UseGraphicsMode = GlobalConfig.GraphicsFor & GRAPHICS_FOR_CLOVER;
     }
     else if (StriSubCmp (L"ipxe", NameClues)) {
-        MergeStrings (&OSIconName, L"network", L',');
+        StrBuilderMerge (&OSIconName, L"network", L',');
         Entry->OSType = 'N';
         ShortcutLetter = 'N';
     }
@@ -911,15 +920,15 @@ VOID SetLoaderDefaults (
         #if REFIT_DEBUG > 0
         LOG(2, LOG_LINE_NORMAL,
             L"Trying to Locate an Icon Based on Hints:- '%s'",
-            OSIconName
+            OSIconName.Buffer
         );
         #endif
 
-        AssignPoolImage (&Entry->me.Image, LoadOSIcon (OSIconName, L"unknown", FALSE));
+        AssignCachedPoolImage (&Entry->me.Image, LoadOSIcon (OSIconName.Buffer, L"unknown", FALSE));
     }
 
     MY_FREE_POOL(PathOnly);
-    MY_FREE_POOL(OSIconName);
+    StrBuilderFree (&OSIconName);
     MY_FREE_POOL(NameClues);
 
     LOGPROCEXIT();
@@ -1015,10 +1024,10 @@ LOADER_ENTRY * AddEfiLoaderEntry (
     IN UINTN            Row,
     IN PoolImage       *Icon_PI_
 ) {
-    CHAR16        *TempStr;
-    CHAR16        *FullTitle  = NULL;
-    CHAR16        *OSIconName = NULL;
-    LOADER_ENTRY  *Entry;
+    CHAR16          *TempStr;
+    CHAR16          *FullTitle  = NULL;
+    LOADER_ENTRY    *Entry;
+    STRING_BUILDER   OSIconName;
 
     Entry = InitializeLoaderEntry (NULL);
     if (Entry) {
@@ -1054,21 +1063,22 @@ LOADER_ENTRY * AddEfiLoaderEntry (
 
         Entry->EfiBootNum = EfiBootNum;
 
-        MergeUniqueWords (&OSIconName, GetPoolStr (&Entry->me.Title), L',');
-        MergeUniqueStrings (&OSIconName, L"Unknown", L',');
+        StrBuilderInit (&OSIconName);
+        StrBuilderMergeWords (&OSIconName, GetPoolStr (&Entry->me.Title), L',', TRUE);
+        StrBuilderMergeUnique (&OSIconName, L"Unknown", L',');
 
         if (GetPoolImage (Icon)) {
             CopyFromPoolImage (&Entry->me.Image, Icon);
         }
         else {
-            AssignPoolImage (&Entry->me.Image, LoadOSIcon (OSIconName, NULL, FALSE));
+            AssignCachedPoolImage (&Entry->me.Image, LoadOSIcon (OSIconName.Buffer, NULL, FALSE));
         }
 
         if (Row == 0) {
             CopyFromPoolImage_PI_ (&Entry->me.BadgeImage_PI_, BuiltinIcon (BUILTIN_ICON_VOL_EFI));
         }
 
-        MY_FREE_POOL(OSIconName);
+        StrBuilderFree (&OSIconName);
 
 /*      // these are allready FALSE/NULL/0
         Entry->Volume      = NULL;
@@ -1184,6 +1194,18 @@ LOADER_ENTRY * AddLoaderEntry (
     return Entry;
 } // LOADER_ENTRY * AddLoaderEntry()
 
+// Adds a loader found by ScanEfiFiles, noting it for the loader cache
+static
+LOADER_ENTRY * AddScannedLoaderEntry (
+    IN CHAR16       *LoaderPath,
+    IN CHAR16       *LoaderTitle,
+    IN REFIT_VOLUME *Volume
+) {
+    ScanCacheNoteOp (SCAN_CACHE_OP_LOADER, LoaderPath, LoaderTitle);
+
+    return AddLoaderEntry (LoaderPath, LoaderTitle, Volume, TRUE);
+} // static LOADER_ENTRY * AddScannedLoaderEntry()
+
 // Returns -1 if (Time1 < Time2), +1 if (Time1 > Time2), or 0 if
 // (Time1 == Time2). Precision is only to the nearest second; since
 // this is used for sorting boot loader entries, differences smaller
@@ -1277,6 +1299,7 @@ VOID CleanUpLoaderList (
         Temp = LoaderList;
         LoaderList = LoaderList->NextEntry;
         MY_FREE_POOL(Temp->FileName);
+        MY_FREE_POOL(Temp->Title);
         MY_FREE_POOL(Temp);
     } // while
 } // static VOID CleanUpLoaderList()
@@ -1291,12 +1314,13 @@ BOOLEAN ShouldScan (
     REFIT_VOLUME *Volume,
     CHAR16       *Path
 ) {
-    UINTN    i            = 0;
-    CHAR16  *VolName      = NULL;
-    CHAR16  *VolGuid      = NULL;
-    CHAR16  *PathCopy     = NULL;
-    CHAR16  *DontScanDir  = NULL;
-    BOOLEAN  ScanIt       = TRUE;
+    UINTN            i            = 0;
+    CHAR16          *VolName      = NULL;
+    CHAR16          *VolGuid      = NULL;
+    CHAR16          *PathCopy     = NULL;
+    CSV_LIST        *DontScanDirs = NULL;
+    CSV_PATH_PARTS  *DontScanDir  = NULL;
+    BOOLEAN          ScanIt       = TRUE;
 
     if (MyStriCmp (Path, SelfDirPath)
         && (Volume->DeviceHandle == SelfVolume->DeviceHandle)
@@ -1351,55 +1375,82 @@ BOOLEAN ShouldScan (
     MY_FREE_POOL(VolName);
 
     // See if Volume is in GlobalConfig.DontScanDirs.
-    while (ScanIt &&
-        (DontScanDir = FindCommaDelimited (GlobalConfig.DontScanDirs, i++))
-    ) {
-        SplitVolumeAndFilename (&DontScanDir, &VolName);
-        CleanUpPathNameSlashes (DontScanDir);
-        if (VolName != NULL) {
-            if (VolumeMatchesDescription (Volume, VolName)
-                && MyStriCmp (DontScanDir, Path)
-            ) {
-                ScanIt = FALSE;
-            }
-        }
-        else {
-            if (MyStriCmp (DontScanDir, Path)) {
-                ScanIt = FALSE;
-            }
+    DontScanDirs = GetCsvList (GlobalConfig.DontScanDirs);
+    DontScanDir  = GetCsvListPathParts (DontScanDirs);
+    for (i = 0; ScanIt && DontScanDir && i < DontScanDirs->Count; i++) {
+        if (MyStriCmp (DontScanDir[i].Rest, Path)
+            && (DontScanDir[i].VolName == NULL
+                || VolumeMatchesDescription (Volume, DontScanDir[i].VolName))
+        ) {
+            ScanIt = FALSE;
         }
-
-        MY_FREE_POOL(DontScanDir);
-        MY_FREE_POOL(VolName);
-    } // while
+    } // for
 
     return ScanIt;
 } // BOOLEAN ShouldScan()
 
-// Returns TRUE if the file is byte-for-byte identical with the fallback file
-// on the volume AND if the file is not itself the fallback file; returns
-// FALSE if the file is not identical to the fallback file OR if the file
-// IS the fallback file. Intended for use in excluding the fallback boot
-// loader when it is a duplicate of another boot loader.
+// The fallback loader's directory entry, read once per volume scan.
+static REFIT_VOLUME   *FallbackVolume = NULL;
+static EFI_FILE_INFO  *FallbackInfo   = NULL;
+
+// Returns the directory entry for the fallback loader on Volume,
+// or NULL if there is none.
 static
-BOOLEAN DuplicatesFallback (
-    IN REFIT_VOLUME *Volume,
-    IN CHAR16       *FileName
+EFI_FILE_INFO * GetFallbackInfo (
+    IN REFIT_VOLUME *Volume
 ) {
     EFI_STATUS       Status;
-    EFI_FILE_HANDLE  FileHandle;
     EFI_FILE_HANDLE  FallbackHandle;
-    EFI_FILE_INFO   *FileInfo;
-    EFI_FILE_INFO   *FallbackInfo;
-    CHAR8           *FileContents;
-    CHAR8           *FallbackContents;
-    UINTN            FileSize     = 0;
-    UINTN            FallbackSize = 0;
+
+    if (Volume != FallbackVolume) {
+        MY_FREE_POOL(FallbackInfo);
+        FallbackVolume = Volume;
+
+        LEAKABLEEXTERNALSTART("Volume->RootDir->Open FALLBACK_FULLNAME");
+        Status = REFIT_CALL_5_WRAPPER(
+            Volume->RootDir->Open,
+            Volume->RootDir,
+            &FallbackHandle,
+            FALLBACK_FULLNAME,
+            EFI_FILE_MODE_READ,
+            0
+        );
+        LEAKABLEEXTERNALSTOP();
+
+        if (Status == EFI_SUCCESS) {
+            FallbackInfo = LibFileInfo (FallbackHandle);
+            REFIT_CALL_1_WRAPPER(FallbackHandle->Close, FallbackHandle);
+        }
+    }
+
+    return FallbackInfo;
+} // static EFI_FILE_INFO * GetFallbackInfo()
+
+// Returns TRUE if the file is identical with the fallback file on the volume
+// AND if the file is not itself the fallback file; returns FALSE if the file
+// is not identical to the fallback file OR if the file IS the fallback file.
+// Intended for use in excluding the fallback boot loader when it is a
+// duplicate of another boot loader.
+// DirEntry, if known, is the file's directory entry and saves opening the
+// file unless its size matches. Files of the same size are compared by
+// SHA-256 digest. Digests are cached, so the fallback file is read at most
+// once however many loaders match its size.
+static
+BOOLEAN DuplicatesFallback (
+    IN REFIT_VOLUME  *Volume,
+    IN CHAR16        *FileName,
+    IN EFI_FILE_INFO *DirEntry OPTIONAL
+) {
+    EFI_STATUS       Status;
+    EFI_FILE_HANDLE  FileHandle   = NULL;
+    EFI_FILE_INFO   *FileInfo     = NULL;
+    EFI_FILE_INFO   *FallbackEntry;
+    UINT8            FileDigest[SHA256_DIGEST_SIZE];
+    UINT8            FallbackDigest[SHA256_DIGEST_SIZE];
     BOOLEAN          AreIdentical = FALSE;
 
-    if (!FileExists (Volume->RootDir, FileName) ||
-        !FileExists (Volume->RootDir, FALLBACK_FULLNAME)
-    ) {
+    FallbackEntry = GetFallbackInfo (Volume);
+    if (FallbackEntry == NULL) {
         return FALSE;
     }
 
@@ -1410,132 +1461,161 @@ BOOLEAN DuplicatesFallback (
         return FALSE;
     }
 
-    LEAKABLEEXTERNALSTART("Volume->RootDir->Open FileName");
-    Status = REFIT_CALL_5_WRAPPER(
-        Volume->RootDir->Open,
-        Volume->RootDir,
-        &FileHandle,
-        FileName,
-        EFI_FILE_MODE_READ,
-        0
-    );
-    LEAKABLEEXTERNALSTOP();
+    if (DirEntry == NULL) {
+        LEAKABLEEXTERNALSTART("Volume->RootDir->Open FileName");
+        Status = REFIT_CALL_5_WRAPPER(
+            Volume->RootDir->Open,
+            Volume->RootDir,
+            &FileHandle,
+            FileName,
+            EFI_FILE_MODE_READ,
+            0
+        );
+        LEAKABLEEXTERNALSTOP();
+
+        if (Status != EFI_SUCCESS) {
+            return FALSE;
+        }
 
-    if (Status == EFI_SUCCESS) {
-        FileInfo = LibFileInfo (FileHandle);
-        FileSize = FileInfo->FileSize;
+        DirEntry = FileInfo = LibFileInfo (FileHandle);
     }
-    else {
-        return FALSE;
+
+    if ((DirEntry != NULL) && (DirEntry->FileSize == FallbackEntry->FileSize)) {
+        // could be identical; compare digests.
+        // BUG ALERT: Some systems (e.g., DUET, some Macs with large displays) crash if
+        // FileHandle is closed before the fallback file. GetFileDigest closes the
+        // fallback file before returning, so that order is kept.
+        AreIdentical = (
+            GetFileDigest (Volume, FALLBACK_FULLNAME, NULL, FallbackEntry, FallbackDigest) &&
+            GetFileDigest (Volume, FileName, FileHandle, DirEntry, FileDigest) &&
+            (CompareMem (FileDigest, FallbackDigest, SHA256_DIGEST_SIZE) == 0)
+        );
     }
 
     MY_FREE_POOL(FileInfo);
-
-    LEAKABLEEXTERNALSTART("Volume->RootDir->Open FALLBACK_FULLNAME");
-    Status = REFIT_CALL_5_WRAPPER(
-        Volume->RootDir->Open,
-        Volume->RootDir,
-        &FallbackHandle,
-        FALLBACK_FULLNAME,
-        EFI_FILE_MODE_READ,
-        0
-    );
-    LEAKABLEEXTERNALSTOP();
-
-    if (Status == EFI_SUCCESS) {
-        FallbackInfo = LibFileInfo (FallbackHandle);
-        FallbackSize = FallbackInfo->FileSize;
-    }
-    else {
-        LEAKABLEEXTERNALSTART("FileHandle->Close");
+    if (FileHandle != NULL) {
         REFIT_CALL_1_WRAPPER(FileHandle->Close, FileHandle);
-        LEAKABLEEXTERNALSTOP();
-        return FALSE;
     }
 
-    MY_FREE_POOL(FallbackInfo);
+    return AreIdentical;
+} // BOOLEAN DuplicatesFallback()
 
-    if (FallbackSize == FileSize) { // could be identical; do full check.
-        FileContents = AllocatePool (FileSize);
-        FallbackContents = AllocatePool (FallbackSize);
-        if (FileContents && FallbackContents) {
-            Status = REFIT_CALL_3_WRAPPER(
-                FileHandle->Read,
-                FileHandle,
-                &FileSize,
-                FileContents
-            );
-            if (Status == EFI_SUCCESS) {
-                Status = REFIT_CALL_3_WRAPPER
-                (FallbackHandle->Read,
-                    FallbackHandle,
-                    &FallbackSize,
-                    FallbackContents
-                );
-            }
-            if (Status == EFI_SUCCESS) {
-                AreIdentical = (CompareMem (
-                    FileContents,
-                    FallbackContents,
-                    FileSize
-                ) == 0);
-            }
+// Uses the single loader probe of a file in a directory snapshot to find
+// both whether it looks like a symbolic link and whether it is a valid loader,
+// and records the results against the snapshot entry.
+// A file whose size differs when opened from the size in its directory entry
+// is taken to be a symbolic link. EFI does not officially support symlinks
+// but this seems to be a reliable indicator. (OTOH, some disk errors might
+// cause a file to fail to open, which would give a false positive -- but as
+// this is used to exclude symbolic links from the list of boot loaders, that
+// would be fine, since such boot loaders would not work.)
+// Returns TRUE if the file is a valid loader that is not a symbolic link.
+// CAUTION: *FullName MUST be properly cleaned up (via CleanUpPathNameSlashes())
+static
+BOOLEAN ProbeLoaderFile (
+    IN     REFIT_VOLUME       *Volume,
+    IN     CHAR16             *FullName,
+    IN OUT DIR_SNAPSHOT_ENTRY *Entry
+) {
+    LOADER_INFO  *Info;
+    UINT64        FileSize2 = 0;
+
+    if ((Entry->Flags & DIR_ENTRY_PROBED) == 0) {
+        Entry->Flags |= DIR_ENTRY_PROBED;
+
+        Info = GetLoaderInfo (Volume, FullName);
+        if ((Info != NULL) && Info->Exists) {
+            FileSize2 = Info->FileSize;
+        }
+
+        if (Entry->Info->FileSize != FileSize2) {
+            Entry->Flags |= DIR_ENTRY_SYMLINK;
+        }
+        else if ((Info != NULL) && Info->IsValid) {
+            Entry->Flags |= DIR_ENTRY_LOADER;
         }
 
-        MY_FREE_POOL(FileContents);
-        MY_FREE_POOL(FallbackContents);
+        #if REFIT_DEBUG > 0
+        LOG(3, LOG_THREE_STAR_MID,
+            L"EFI File is %s:- '%s'",
+            (Entry->Flags & DIR_ENTRY_LOADER) ? L"Valid" : L"*NOT* Valid",
+            FullName
+        );
+        #endif
     }
 
-    // BUG ALERT: Some systems (e.g., DUET, some Macs with large displays) crash if the
-    // following two calls are reversed.
-    REFIT_CALL_1_WRAPPER(FileHandle->Close, FallbackHandle);
-    REFIT_CALL_1_WRAPPER(FileHandle->Close, FileHandle);
+    return ((Entry->Flags & (DIR_ENTRY_LOADER | DIR_ENTRY_SYMLINK)) == DIR_ENTRY_LOADER);
+} // static BOOLEAN ProbeLoaderFile()
 
-    return AreIdentical;
-} // BOOLEAN DuplicatesFallback()
+// Returns TRUE if a file with the same name as the snapshot entry plus
+// ".efi.signed" is also present in the directory. Ubuntu is using this
+// filename as a signed version of the original unsigned kernel, and there is
+// no point in cluttering the display with two kernels that will behave
+// identically on non-SB systems, or when one will fail when SB is active.
+static
+BOOLEAN HasSignedCounterpart (
+    IN DIR_SNAPSHOT       *Snapshot,
+    IN DIR_SNAPSHOT_ENTRY *Entry
+) {
+    CHAR16  *SignedName;
+    BOOLEAN  Found;
 
-// Returns FALSE if two measures of file size are identical for a single file,
-// TRUE if not or if the file can't be opened and the other measure is non-0.
-// Despite the function's name, this is not really a direct test of symbolic
-// link status, since EFI does not officially support symlinks. It does seem
-// to be a reliable indicator, though. (OTOH, some disk errors might cause a
-// file to fail to open, which would return a false positive -- but as I use
-// this function to exclude symbolic links from the list of boot loaders,
-// that would be fine, since such boot loaders wouldn't work.)
-// CAUTION: *FullName MUST be properly cleaned up (via CleanUpPathNameSlashes())
+    SignedName = PoolPrint (L"%s.efi.signed", Entry->Info->FileName);
+    Found      = (DirSnapshotFind (Snapshot, SignedName) != NULL);
+
+    #if REFIT_DEBUG > 0
+    if (Found) {
+        LOG(2, LOG_LINE_NORMAL, L"Found signed counterpart to '%s'", Entry->Info->FileName);
+    }
+    #endif
+
+    MY_FREE_POOL(SignedName);
+
+    return Found;
+} // static BOOLEAN HasSignedCounterpart()
+
+// Adds the loaders found in one directory, newest first, to the menu.
+// Linux kernels after the first are folded into its submenu if set.
 static
-BOOLEAN IsSymbolicLink (
-    REFIT_VOLUME  *Volume,
-    CHAR16        *FullName,
-    EFI_FILE_INFO *DirEntry
+VOID AddLoaderList (
+    IN REFIT_VOLUME        *Volume,
+    IN struct LOADER_LIST  *LoaderList
 ) {
-    EFI_FILE_HANDLE  FileHandle;
-    EFI_FILE_INFO   *FileInfo = NULL;
-    EFI_STATUS       Status;
-    UINTN            FileSize2 = 0;
-
-    LEAKABLEEXTERNALSTART ("IsSymbolicLink Open");
-    Status = REFIT_CALL_5_WRAPPER(
-        Volume->RootDir->Open,
-        Volume->RootDir,
-        &FileHandle,
-        FullName,
-        EFI_FILE_MODE_READ,
-        0
-    );
-    LEAKABLEEXTERNALSTOP ();
+    struct LOADER_LIST  *NewLoader;
+    LOADER_ENTRY        *FirstKernel = NULL;
+    LOADER_ENTRY        *LatestEntry = NULL;
+    BOOLEAN              IsLinux     = FALSE;
+
+    for (NewLoader = LoaderList; NewLoader != NULL; NewLoader = NewLoader->NextEntry) {
+        IsLinux = (
+            StriSubCmp (L"bzImage", NewLoader->FileName) ||
+            StriSubCmp (L"vmlinuz", NewLoader->FileName) ||
+            StriSubCmp (L"kernel", NewLoader->FileName)
+        );
 
-    if (Status == EFI_SUCCESS) {
-        FileInfo = LibFileInfo (FileHandle);
-        if (FileInfo != NULL) {
-            FileSize2 = FileInfo->FileSize;
+        if ((FirstKernel != NULL) && IsLinux && GlobalConfig.FoldLinuxKernels) {
+            AddKernelToSubmenu (FirstKernel, NewLoader->FileName, Volume);
         }
-    }
+        else {
+            LatestEntry = AddLoaderEntry (
+                NewLoader->FileName,
+                NewLoader->Title, Volume,
+                !(IsLinux && GlobalConfig.FoldLinuxKernels)
+            );
+            if (IsLinux && (FirstKernel == NULL)) {
+                FirstKernel = LatestEntry;
+            }
+        }
+    } // for
 
-    MY_FREE_POOL(FileInfo);
+    if (FirstKernel != NULL && IsLinux && GlobalConfig.FoldLinuxKernels) {
+        #if REFIT_DEBUG > 0
+        LOG(2, LOG_LINE_NORMAL, L"Adding 'Return' entry to folded Linux kernels");
+        #endif
 
-    return (DirEntry->FileSize != FileSize2);
-} // BOOLEAN IsSymbolicLink()
+        AddMenuEntryCopy (FirstKernel->me.SubScreen, &TagMenuEntry[TAG_RETURN]);
+    }
+} // static VOID AddLoaderList()
 
 // Scan an individual directory for EFI boot loader files and, if found,
 // add them to the list. Exception: Ignores FALLBACK_FULLNAME, which is picked
@@ -1544,21 +1624,22 @@ BOOLEAN IsSymbolicLink (
 // Returns TRUE if a duplicate for FALLBACK_FILENAME was found, FALSE if not.
 static
 BOOLEAN ScanLoaderDir (
-    IN REFIT_VOLUME *Volume,
-    IN CHAR16       *Path,
-    IN CHAR16       *Pattern
+    IN REFIT_VOLUME     *Volume,
+    IN CHAR16           *Path,
+    IN FILE_PATTERN_SET *Patterns
 ) {
     EFI_STATUS               Status;
-    REFIT_DIR_ITER           DirIter;
+    DIR_SNAPSHOT             Snapshot;
+    DIR_SNAPSHOT_ENTRY      *Entry;
     EFI_FILE_INFO           *DirEntry;
+    UINTN                    i;
     CHAR16                  *Message;
     CHAR16                  *Extension;
     CHAR16                  *FullName;
     struct LOADER_LIST      *NewLoader;
     struct LOADER_LIST      *LoaderList  = NULL;
-    LOADER_ENTRY            *FirstKernel = NULL;
-    LOADER_ENTRY            *LatestEntry = NULL;
-    BOOLEAN                  FoundFallbackDuplicate = FALSE, IsLinux, InSelfPath;
+    LOADER_INFO             *Info;
+    BOOLEAN                  FoundFallbackDuplicate = FALSE, InSelfPath;
 
     #if REFIT_DEBUG > 0
     CHAR16 *PathStr;
@@ -1570,7 +1651,7 @@ BOOLEAN ScanLoaderDir (
         PathStr = PoolPrint (L"%s", Path);
     }
 
-    LOG(2, LOG_LINE_NORMAL, L"Scanning for '%s' in '%s'", Pattern, PathStr);
+    LOG(2, LOG_LINE_NORMAL, L"Scanning for '%s' in '%s'", Patterns->Source, PathStr);
 
     MY_FREE_POOL(PathStr);
     #endif
@@ -1581,28 +1662,35 @@ BOOLEAN ScanLoaderDir (
         (InSelfPath && (Volume->DeviceHandle != SelfVolume->DeviceHandle)) ||
         (!InSelfPath)) && (ShouldScan (Volume, Path))
     ) {
-        // look through contents of the directory
-        DirIterOpen (Volume->RootDir, Path, &DirIter);
+        // Read the directory once; companion file checks then come from
+        // the snapshot and each plausible loader is opened just once.
+        ScanCacheNoteDir (Path);
+        DirSnapshotOpen (Volume->RootDir, Path, &Snapshot);
+
+        for (i = 0; i < Snapshot.Count; i++) {
+            Entry    = &Snapshot.Entries[i];
+            DirEntry = Entry->Info;
+            if (!FilePatternSetMatch (Patterns, DirEntry->FileName)) {
+                continue;
+            }
 
-        while (DirIterNext (&DirIter, 2, Pattern, &DirEntry)) {
             Extension = FindExtension (DirEntry->FileName);
             FullName  = StrDuplicate (Path);
 
             MergeStrings (&FullName, DirEntry->FileName, L'\\');
             CleanUpPathNameSlashes (FullName);
 
-            // IsSymbolicLink (Volume, FullName, DirEntry) = is symbolic link
-            // HasSignedCounterpart (Volume, FullName) = file with same name plus ".efi.signed" is present
+            // HasSignedCounterpart (&Snapshot, Entry) = file with same name plus ".efi.signed" is present
+            // ProbeLoaderFile (Volume, FullName, Entry) = valid loader and not a symbolic link
             if (DirEntry->FileName[0] == '.' ||
                 MyStriCmp (Extension, L".icns") ||
                 MyStriCmp (Extension, L".png") ||
                 (MyStriCmp (DirEntry->FileName, FALLBACK_BASENAME) &&
                 (MyStriCmp (Path, L"EFI\\BOOT"))) ||
                 FilenameIn (Volume, Path, DirEntry->FileName, SHELL_NAMES) ||
-                IsSymbolicLink (Volume, FullName, DirEntry) ||
-                HasSignedCounterpart (Volume, FullName) ||
+                HasSignedCounterpart (&Snapshot, Entry) ||
                 FilenameIn (Volume, Path, DirEntry->FileName, GlobalConfig.DontScanFiles) ||
-                !IsValidLoader (Volume->RootDir, FullName)
+                !ProbeLoaderFile (Volume, FullName, Entry)
             ) {
                 // skip this
             }
@@ -1612,9 +1700,16 @@ BOOLEAN ScanLoaderDir (
                 if (NewLoader != NULL) {
                     NewLoader->FileName  = StrDuplicate (FullName);
                     NewLoader->TimeStamp = DirEntry->ModificationTime;
+
+                    // Already probed above, so the title costs no read
+                    Info = GetLoaderInfo (Volume, FullName);
+                    if ((Info != NULL) && Info->IsUki && (Info->OsRelName != NULL)) {
+                        NewLoader->Title = StrDuplicate (Info->OsRelName);
+                    }
+
                     LoaderList           = AddLoaderListEntry (LoaderList, NewLoader);
 
-                    if (DuplicatesFallback (Volume, FullName)) {
+                    if (DuplicatesFallback (Volume, FullName, DirEntry)) {
                         FoundFallbackDuplicate = TRUE;
                     }
                 }
@@ -1622,49 +1717,20 @@ BOOLEAN ScanLoaderDir (
 
             MY_FREE_POOL(Extension);
             MY_FREE_POOL(FullName);
-            MY_FREE_POOL(DirEntry);
-        } // while
+        } // for
 
         if (LoaderList != NULL) {
-            IsLinux   = FALSE;
-            NewLoader = LoaderList;
-
-            while (NewLoader != NULL) {
-                IsLinux = (
-                    StriSubCmp (L"bzImage", NewLoader->FileName) ||
-                    StriSubCmp (L"vmlinuz", NewLoader->FileName) ||
-                    StriSubCmp (L"kernel", NewLoader->FileName)
-                );
-
-                if ((FirstKernel != NULL) && IsLinux && GlobalConfig.FoldLinuxKernels) {
-                    AddKernelToSubmenu (FirstKernel, NewLoader->FileName, Volume);
-                }
-                else {
-                    LatestEntry = AddLoaderEntry (
-                        NewLoader->FileName,
-                        NULL, Volume,
-                        !(IsLinux && GlobalConfig.FoldLinuxKernels)
-                    );
-                    if (IsLinux && (FirstKernel == NULL)) {
-                        FirstKernel = LatestEntry;
-                    }
-                }
-
-                NewLoader = NewLoader->NextEntry;
-            } // while
-
-            if (FirstKernel != NULL && IsLinux && GlobalConfig.FoldLinuxKernels) {
-                #if REFIT_DEBUG > 0
-                LOG(2, LOG_LINE_NORMAL, L"Adding 'Return' entry to folded Linux kernels");
-                #endif
-
-                AddMenuEntryCopy (FirstKernel->me.SubScreen, &TagMenuEntry[TAG_RETURN]);
+            for (NewLoader = LoaderList; NewLoader != NULL; NewLoader = NewLoader->NextEntry) {
+                ScanCacheNoteOp (SCAN_CACHE_OP_DIR_LOADER, NewLoader->FileName, NewLoader->Title);
             }
+            ScanCacheNoteOp (SCAN_CACHE_OP_DIR_END, NULL, NULL);
 
+            AddLoaderList (Volume, LoaderList);
             CleanUpLoaderList (LoaderList);
         }
 
-        Status = DirIterClose (&DirIter);
+        Status = Snapshot.Status;
+        DirSnapshotFree (&Snapshot);
         // NOTE: EFI_INVALID_PARAMETER really is an error that should be reported;
         // but I've gotten reports from users who are getting this error occasionally
         // and I can't find anything wrong or reproduce the problem, so I'm putting
@@ -1738,10 +1804,8 @@ VOID ScanNetboot (VOID) {
     LOG(2, LOG_LINE_NORMAL, L"Scanning for iPXE boot options");
     #endif
 
-    if (FileExists (SelfVolume->RootDir, IPXE_NAME) &&
-        FileExists (SelfVolume->RootDir, IPXE_DISCOVER_NAME) &&
-        IsValidLoader (SelfVolume->RootDir, IPXE_DISCOVER_NAME) &&
-        IsValidLoader (SelfVolume->RootDir, IPXE_NAME)
+    if (IsValidLoader (SelfVolume, IPXE_DISCOVER_NAME) &&
+        IsValidLoader (SelfVolume, IPXE_NAME)
     ) {
         Location = RuniPXEDiscover (SelfVolume->DeviceHandle);
         if (Location != NULL && FileExists (SelfVolume->RootDir, iPXEFileName)) {
@@ -1777,33 +1841,30 @@ BOOLEAN ScanMacOsLoader (
     CHAR16   *VolName            = NULL;
     CHAR16   *PathName           = NULL;
     CHAR16   *FileName           = NULL;
-    UINTN     i;
 
     SplitPathName (FullFileName, &VolName, &PathName, &FileName);
+    ScanCacheNoteDir (PathName);
     if (FileExists (Volume->RootDir, FullFileName) &&
         !FilenameIn (Volume, PathName, L"boot.efi", GlobalConfig.DontScanFiles)
     ) {
         if (FileExists (Volume->RootDir, L"EFI\\refind\\config.conf") ||
             FileExists (Volume->RootDir, L"EFI\\refind\\refind.conf")
         ) {
-            AddLoaderEntry (FullFileName, L"RefindPlus", Volume, TRUE);
+            AddScannedLoaderEntry (FullFileName, L"RefindPlus", Volume);
         }
         else {
-            if (GlobalConfig.SyncAPFS && Volume->FSType == FS_TYPE_APFS) {
-                for (i = 0; i < SystemVolumesCount; i++) {
-                    if (GuidsAreEqual (&(SystemVolumes[i]->VolUuid), &(Volume->VolUuid))) {
-                        AddThisEntry = FALSE;
-                        break;
-                    }
-                }
+            if (GlobalConfig.SyncAPFS && Volume->FSType == FS_TYPE_APFS &&
+                VolumeIndexFind (SystemVolumes, SystemVolumesCount, VOLUME_KEY_VOL_UUID, &(Volume->VolUuid)) != NULL
+            ) {
+                AddThisEntry = FALSE;
             }
 
             if (AddThisEntry) {
-                AddLoaderEntry (FullFileName, L"Mac OS", Volume, TRUE);
+                AddScannedLoaderEntry (FullFileName, L"Mac OS", Volume);
             }
         }
 
-        if (DuplicatesFallback (Volume, FullFileName)) {
+        if (DuplicatesFallback (Volume, FullFileName, NULL)) {
             ScanFallbackLoader = FALSE;
         }
     }
@@ -1815,6 +1876,197 @@ BOOLEAN ScanMacOsLoader (
     return ScanFallbackLoader;
 } // VOID ScanMacOsLoader()
 
+// Volumes whose loaders the last scan added to the main menu, with the Mac OS
+// recovery files found on each. When ScanVolumes keeps such a volume as it
+// was, a rescan moves its loaders over from the old main menu, icons and all,
+// instead of reading the volume again. The list is dropped whenever a volume
+// may have been written to since, such as when a tool returns.
+typedef struct {
+    REFIT_VOLUME  *Volume;
+    CHAR16        *RecoveryFiles;
+} SCANNED_VOLUME;
+
+static SCANNED_VOLUME     *ScannedVolumes       = NULL;
+static UINTN               ScannedVolumesCount  = 0;
+static SCANNED_VOLUME     *CarryVolumes         = NULL;
+static UINTN               CarryVolumesCount    = 0;
+static UINT32              ScannedConfigCrc     = 0;
+static REFIT_MENU_SCREEN  *PreviousMenu         = NULL;
+
+static
+VOID FreeScannedVolumes (
+    IN OUT SCANNED_VOLUME **List,
+    IN OUT UINTN           *Count
+) {
+    UINTN i;
+
+    for (i = 0; i < *Count; i++) {
+        FreeVolume (&(*List)[i].Volume);
+        MY_FREE_POOL((*List)[i].RecoveryFiles);
+    }
+    MY_FREE_POOL(*List);
+    *Count = 0;
+} // static VOID FreeScannedVolumes()
+
+// Makes the next scan read every volume again.
+VOID ForgetScannedVolumes (VOID) {
+    FreeScannedVolumes (&ScannedVolumes, &ScannedVolumesCount);
+} // VOID ForgetScannedVolumes()
+
+// Takes over the main menu being replaced by a rescan, so that loaders can
+// be carried over from it. What is left of it is freed after the scan.
+VOID KeepPreviousMenu (
+    IN REFIT_MENU_SCREEN *Menu
+) {
+    FreeMenuScreen (&PreviousMenu);
+    PreviousMenu = Menu;
+} // VOID KeepPreviousMenu()
+
+static
+VOID NoteScannedVolume (
+    IN REFIT_VOLUME *Volume
+) {
+    SCANNED_VOLUME  Scanned;
+
+    Scanned.Volume        = NULL;
+    Scanned.RecoveryFiles = NULL;
+    AssignVolume (&Scanned.Volume, Volume);
+    AddListElementSized (
+        (VOID **) &ScannedVolumes, &ScannedVolumesCount,
+        &Scanned, sizeof (Scanned)
+    );
+} // static VOID NoteScannedVolume()
+
+// Adds a Mac OS recovery file to the list for the volume being scanned.
+static
+VOID NoteScannedRecovery (
+    IN CHAR16 *FileName
+) {
+    if (ScannedVolumesCount > 0) {
+        MergeStrings (&ScannedVolumes[ScannedVolumesCount - 1].RecoveryFiles, FileName, L',');
+    }
+} // static VOID NoteScannedRecovery()
+
+static
+VOID AddRecoveryFile (
+    IN CHAR16 *FileName
+) {
+    NoteScannedRecovery (FileName);
+    if (!StriSubCmp (FileName, GlobalConfig.MacOSRecoveryFiles)) {
+        MergeStrings (&GlobalConfig.MacOSRecoveryFiles, FileName, L',');
+        LEAKABLE (GlobalConfig.MacOSRecoveryFiles, "MacOSRecoveryFiles");
+    }
+} // static VOID AddRecoveryFile()
+
+// Moves the loaders that the last scan found on Volume from the previous main
+// menu into the new one, if ScanVolumes kept the volume as it was.
+static
+BOOLEAN CarryOverLoaders (
+    IN REFIT_VOLUME *Volume
+) {
+    UINTN          i, j;
+    UINTN          Count;
+    CHAR16        *FileName;
+    LOADER_ENTRY  *Entry;
+
+    if (PreviousMenu == NULL ||
+        (GlobalConfig.SyncAPFS && Volume->FSType == FS_TYPE_APFS)
+    ) {
+        // Loaders on synced APFS volumes depend on other volumes ... Always scan
+        return FALSE;
+    }
+
+    for (i = 0; i < CarryVolumesCount; i++) {
+        if (CarryVolumes[i].Volume == Volume) {
+            break;
+        }
+    }
+    if (i == CarryVolumesCount) {
+        return FALSE;
+    }
+
+    #if REFIT_DEBUG > 0
+    LOG(2, LOG_LINE_NORMAL, L"Volume is Unchanged ... Carrying Over Loaders from Last Scan");
+    #endif
+
+    NoteScannedVolume (Volume);
+    j = 0;
+    while ((FileName = FindCommaDelimited (CarryVolumes[i].RecoveryFiles, j++)) != NULL) {
+        AddRecoveryFile (FileName);
+        MY_FREE_POOL(FileName);
+    }
+
+    Count = 0;
+    for (j = 0; j < PreviousMenu->EntryCount; j++) {
+        Entry = (LOADER_ENTRY *) PreviousMenu->Entries[j];
+        if (Entry->me.Tag == TAG_LOADER &&
+            Entry->DiscoveryType == DISCOVERY_TYPE_AUTO &&
+            Entry->Volume == Volume
+        ) {
+            AddMenuEntry (MainMenu, (REFIT_MENU_ENTRY *) Entry);
+        }
+        else {
+            PreviousMenu->Entries[Count++] = (REFIT_MENU_ENTRY *) Entry;
+        }
+    }
+    PreviousMenu->EntryCount = Count;
+
+    ScanCacheKeep (Volume);
+
+    return TRUE;
+} // static BOOLEAN CarryOverLoaders()
+
+// Adds the loaders recorded in the loader cache for a volume, in the order
+// in which its last full scan found them.
+static
+VOID AddCachedLoaders (
+    IN REFIT_VOLUME  *Volume,
+    IN SCAN_CACHE_OP *Ops,
+    IN UINTN          OpCount
+) {
+    UINTN                i;
+    struct LOADER_LIST  *NewLoader;
+    struct LOADER_LIST  *LoaderList = NULL;
+    struct LOADER_LIST  *LastLoader = NULL;
+
+    for (i = 0; i < OpCount; i++) {
+        switch (Ops[i].Type) {
+            case SCAN_CACHE_OP_LOADER:
+                AddLoaderEntry (Ops[i].Path, Ops[i].Title, Volume, TRUE);
+
+                break;
+            case SCAN_CACHE_OP_DIR_LOADER:
+                // Kept in the recorded order, which is already sorted
+                NewLoader = AllocateZeroPool (sizeof (struct LOADER_LIST));
+                if (NewLoader != NULL) {
+                    NewLoader->FileName = StrDuplicate (Ops[i].Path);
+                    NewLoader->Title    = (Ops[i].Title != NULL) ? StrDuplicate (Ops[i].Title) : NULL;
+                    if (LastLoader == NULL) {
+                        LoaderList = NewLoader;
+                    }
+                    else {
+                        LastLoader->NextEntry = NewLoader;
+                    }
+                    LastLoader = NewLoader;
+                }
+
+                break;
+            case SCAN_CACHE_OP_DIR_END:
+                AddLoaderList (Volume, LoaderList);
+                CleanUpLoaderList (LoaderList);
+                LoaderList = LastLoader = NULL;
+
+                break;
+            case SCAN_CACHE_OP_RECOVERY:
+                AddRecoveryFile (Ops[i].Path);
+
+                break;
+        } // switch
+    } // for
+
+    CleanUpLoaderList (LoaderList);
+} // static VOID AddCachedLoaders()
+
 static
 VOID ScanEfiFiles (
     REFIT_VOLUME *Volume
@@ -1827,8 +2079,11 @@ VOID ScanEfiFiles (
     CHAR16           *FileName;
     CHAR16           *SelfPath;
     CHAR16           *MatchPatterns;
+    FILE_PATTERN_SET  LoaderPatterns;
     CHAR16           *VolName            = NULL;
     CHAR16           *Directory          = NULL;
+    SCAN_CACHE_OP    *CachedOps;
+    UINTN             CachedOpCount;
     BOOLEAN           ScanFallbackLoader = TRUE;
     BOOLEAN           FoundBRBackup      = FALSE;
 
@@ -1854,16 +2109,17 @@ VOID ScanEfiFiles (
             return;
         }
 
-        if (GlobalConfig.SyncAPFS) {
-            for (i = 0; i < SystemVolumesCount; i++) {
-                if (GuidsAreEqual (&(SystemVolumes[i]->VolUuid), &(Volume->VolUuid))) {
-                    // Early Return on ReMapped Volume
-                    return;
-                }
-            }
+        if (GlobalConfig.SyncAPFS &&
+            VolumeIndexFind (SystemVolumes, SystemVolumesCount, VOLUME_KEY_VOL_UUID, &(Volume->VolUuid)) != NULL
+        ) {
+            // Early Return on ReMapped Volume
+            return;
         }
     }
 
+    // Read the fallback loader's details afresh for each volume scan
+    FallbackVolume = NULL;
+
     #if REFIT_DEBUG > 0
     if (FirstLoaderScan) {
         LogLineType = LOG_THREE_STAR_MID;
@@ -1881,16 +2137,40 @@ VOID ScanEfiFiles (
 
     FirstLoaderScan = FALSE;
 
+    if (CarryOverLoaders (Volume)) {
+        return;
+    }
+
+    NoteScannedVolume (Volume);
+    if (ScanCacheLookup (Volume, &CachedOps, &CachedOpCount)) {
+        // Nothing looked at by the last scan has changed
+        AddCachedLoaders (Volume, CachedOps, CachedOpCount);
+
+        return;
+    }
+
+    // Note what the scan depends on for the loader cache
+    ScanCacheRecordStart (Volume);
+    ScanCacheNoteDir (L"EFI");
+    ScanCacheNoteDir (L"EFI\\BOOT");
+    ScanCacheNoteDir (L"EFI\\refind");
+    if (Volume->DeviceHandle == SelfLoadedImage->DeviceHandle) {
+        ScanCacheNoteDir (SelfDirPath);
+    }
+
     MatchPatterns = StrDuplicate (LOADER_MATCH_PATTERNS);
     if (GlobalConfig.ScanAllLinux) {
         MergeStrings (&MatchPatterns, LINUX_MATCH_PATTERNS, L',');
     }
+    FilePatternSetCompile (MatchPatterns, &LoaderPatterns);
+    MY_FREE_POOL(MatchPatterns);
 
     // check for Mac OS boot loader
     if (ShouldScan (Volume, MACOSX_LOADER_DIR)) {
         FileName = StrDuplicate (MACOSX_LOADER_PATH);
         ScanFallbackLoader &= ScanMacOsLoader (Volume, FileName);
         MY_FREE_POOL(FileName);
+        ScanCacheNoteDir (L"\\");
         DirIterOpen (Volume->RootDir, L"\\", &EfiDirIter);
 
         while (DirIterNext (&EfiDirIter, 1, NULL, &EfiDirEntry)) {
@@ -1900,24 +2180,22 @@ VOID ScanEfiFiles (
                 MY_FREE_POOL(FileName);
                 FileName = PoolPrint (L"%s\\%s", EfiDirEntry->FileName, L"boot.efi");
 
-                if (!StriSubCmp (FileName, GlobalConfig.MacOSRecoveryFiles)) {
-                    MergeStrings (&GlobalConfig.MacOSRecoveryFiles, FileName, L',');
-                    LEAKABLE (GlobalConfig.MacOSRecoveryFiles, "MacOSRecoveryFiles");
-                }
+                ScanCacheNoteOp (SCAN_CACHE_OP_RECOVERY, FileName, NULL);
+                AddRecoveryFile (FileName);
 
                 MY_FREE_POOL(FileName);
             }
-            MY_FREE_POOL(EfiDirEntry);
         } // while
         DirIterClose (&EfiDirIter);
 
         // check for XOM
+        ScanCacheNoteDir (MACOSX_LOADER_DIR);
         FileName = StrDuplicate (L"System\\Library\\CoreServices\\xom.efi");
         if (FileExists (Volume->RootDir, FileName) &&
             !FilenameIn (Volume, MACOSX_LOADER_DIR, L"xom.efi", GlobalConfig.DontScanFiles)
         ) {
-            AddLoaderEntry (FileName, L"Windows XP (XoM)", Volume, TRUE);
-            if (DuplicatesFallback (Volume, FileName)) {
+            AddScannedLoaderEntry (FileName, L"Windows XP (XoM)", Volume);
+            if (DuplicatesFallback (Volume, FileName, NULL)) {
                 ScanFallbackLoader = FALSE;
             }
         }
@@ -1927,6 +2205,7 @@ VOID ScanEfiFiles (
 
     // check for Microsoft boot loader/menu
     if (ShouldScan (Volume, L"EFI\\Microsoft\\Boot")) {
+        ScanCacheNoteDir (L"EFI\\Microsoft\\Boot");
         FileName = StrDuplicate (L"EFI\\Microsoft\\Boot\\bkpbootmgfw.efi");
         if (FileExists (Volume->RootDir, FileName) &&
             !FilenameIn (
@@ -1937,9 +2216,9 @@ VOID ScanEfiFiles (
             )
         ) {
             // Boot Repair Backup
-            AddLoaderEntry (FileName, L"UEFI Windows (BRBackup)", Volume, TRUE);
+            AddScannedLoaderEntry (FileName, L"UEFI Windows (BRBackup)", Volume);
             FoundBRBackup = TRUE;
-            if (DuplicatesFallback (Volume, FileName)) {
+            if (DuplicatesFallback (Volume, FileName, NULL)) {
                 ScanFallbackLoader = FALSE;
             }
         }
@@ -1956,21 +2235,21 @@ VOID ScanEfiFiles (
             )
         ) {
             if (FoundBRBackup) {
-                AddLoaderEntry (
+                AddScannedLoaderEntry (
                     FileName,
                     L"Assumed UEFI Windows (Potentially GRUB)",
-                    Volume, TRUE
+                    Volume
                 );
             }
             else {
-                AddLoaderEntry (
+                AddScannedLoaderEntry (
                     FileName,
                     L"Windows (UEFI)",
-                    Volume, TRUE
+                    Volume
                 );
             }
 
-            if (DuplicatesFallback (Volume, FileName)) {
+            if (DuplicatesFallback (Volume, FileName, NULL)) {
                 ScanFallbackLoader = FALSE;
             }
         }
@@ -1979,7 +2258,7 @@ VOID ScanEfiFiles (
     } // if ShouldScan
 
     // scan the root directory for EFI executables
-    if (ScanLoaderDir (Volume, L"\\", MatchPatterns)) {
+    if (ScanLoaderDir (Volume, L"\\", &LoaderPatterns)) {
         ScanFallbackLoader = FALSE;
     }
 
@@ -1995,14 +2274,12 @@ VOID ScanEfiFiles (
         else {
 
             FileName = PoolPrint (L"EFI\\%s", EfiDirEntry->FileName);
-            if (ScanLoaderDir (Volume, FileName, MatchPatterns)) {
+            if (ScanLoaderDir (Volume, FileName, &LoaderPatterns)) {
                 ScanFallbackLoader = FALSE;
             }
 
             MY_FREE_POOL(FileName);
         }
-
-        MY_FREE_POOL(EfiDirEntry);
     } // while
 
     Status = DirIterClose (&EfiDirIter);
@@ -2023,7 +2300,7 @@ VOID ScanEfiFiles (
             CleanUpPathNameSlashes (Directory);
 
             Length = StrLen (Directory);
-            if ((Length > 0) && ScanLoaderDir (Volume, Directory, MatchPatterns)) {
+            if ((Length > 0) && ScanLoaderDir (Volume, Directory, &LoaderPatterns)) {
                 ScanFallbackLoader = FALSE;
             }
 
@@ -2038,7 +2315,7 @@ VOID ScanEfiFiles (
     CleanUpPathNameSlashes (SelfPath);
 
     if ((Volume->DeviceHandle == SelfLoadedImage->DeviceHandle) &&
-        DuplicatesFallback (Volume, SelfPath)
+        DuplicatesFallback (Volume, SelfPath, NULL)
     ) {
         ScanFallbackLoader = FALSE;
     }
@@ -2051,10 +2328,11 @@ VOID ScanEfiFiles (
         ShouldScan (Volume, L"EFI\\BOOT") &&
         !FilenameIn (Volume, L"EFI\\BOOT", FALLBACK_BASENAME, GlobalConfig.DontScanFiles)
     ) {
-        AddLoaderEntry (FALLBACK_FULLNAME, L"Fallback Boot Loader", Volume, TRUE);
+        AddScannedLoaderEntry (FALLBACK_FULLNAME, L"Fallback Boot Loader", Volume);
     }
 
-    MY_FREE_POOL(MatchPatterns);
+    FilePatternSetFree (&LoaderPatterns);
+    ScanCacheRecordStop();
 } // static VOID ScanEfiFiles()
 
 // Scan user-configured menu entries from config.conf
@@ -2142,9 +2420,7 @@ BOOLEAN ScanFirmwareDefined (
     BOOT_ENTRY_LIST *BootEntries;
     BOOT_ENTRY_LIST *CurrentEntry;
     BOOLEAN          ScanIt;
-    CHAR16          *OneElement  = NULL;
     CHAR16          *DontScanFirmware;
-    UINTN            i;
     BOOLEAN          result = FALSE;
 
     #if REFIT_DEBUG > 0
@@ -2207,14 +2483,7 @@ BOOLEAN ScanFirmwareDefined (
             ScanIt = FALSE;
         }
         else if (MatchThis) {
-            ScanIt = FALSE;
-            i = 0;
-            while (!ScanIt && (OneElement = FindCommaDelimited (MatchThis, i++))) {
-                if (StriSubCmp (OneElement, CurrentEntry->BootEntry.Label)) {
-                    ScanIt = TRUE;
-                }
-                MY_FREE_POOL(OneElement);
-            } // while
+            ScanIt = IsInSubstring (CurrentEntry->BootEntry.Label, MatchThis);
         }
         else {
             ScanIt = TRUE;
@@ -2307,12 +2576,84 @@ LOADER_ENTRY * AddToolEntry (
     return Entry;
 } // static LOADER_ENTRY * AddToolEntry()
 
+// Numbers the first ten first-row entries of the main menu, in order.
+VOID AssignShortcutKeys (VOID) {
+    UINTN     i;
+    CHAR16    ShortCutKey;
+
+    #if REFIT_DEBUG > 0
+    CHAR16  *MsgStr = NULL;
+
+    MsgStr = StrDuplicate (L"Assign Shortcut Keys");
+    LOG(1, LOG_LINE_SEPARATOR, L"%s", MsgStr);
+    MsgLog ("\n\n");
+    MsgLog ("%s:\n", MsgStr);
+    MY_FREE_POOL(MsgStr);
+
+    UINTN KeyNum = 0;
+    #endif
+
+    for (i = 0; i < MainMenu->EntryCount && MainMenu->Entries[i]->Row == 0; i++) {
+        if (i < 9) {
+            #if REFIT_DEBUG > 0
+            KeyNum = i + 1;
+            #endif
+
+            ShortCutKey = (CHAR16) ('1' + i);
+        }
+        else if (i == 9) {
+            ShortCutKey = (CHAR16) ('9' - i);
+
+            #if REFIT_DEBUG > 0
+            KeyNum = 0;
+            #endif
+        }
+        else {
+            break;
+        }
+        MainMenu->Entries[i]->ShortcutDigit = ShortCutKey;
+
+        #if REFIT_DEBUG > 0
+        MsgStr = PoolPrint (
+            L"Set Key '%d' to %s",
+            KeyNum, GetPoolStr (&MainMenu->Entries[i]->Title)
+        );
+        LOG(2, LOG_LINE_NORMAL, L"%s", MsgStr);
+        MsgLog ("  - %s", MsgStr);
+        MY_FREE_POOL(MsgStr);
+
+        if (KeyNum < MainMenu->EntryCount &&
+            MainMenu->Entries[i]->Row == 0 &&
+            KeyNum != 0
+        ) {
+            MsgLog ("\n");
+        }
+        else {
+            MsgLog ("\n\n");
+        }
+        #endif
+    }  // for
+
+    #if REFIT_DEBUG > 0
+    MsgStr = PoolPrint (
+        L"Assigned Shortcut Key%s to %d of %d Loader%s",
+        (i == 1) ? L"" : L"s",
+        i, MainMenu->EntryCount,
+        (MainMenu->EntryCount == 1) ? L"" : L"s"
+    );
+    LOG(1, LOG_THREE_STAR_SEP, L"%s", MsgStr);
+    MsgLog ("INFO: %s\n\n", MsgStr);
+    MY_FREE_POOL(MsgStr);
+    #endif
+} // VOID AssignShortcutKeys()
+
 // Locates boot loaders.
 // NOTE: This assumes that GlobalConfig.LegacyType is correctly set.
 VOID ScanForBootloaders (
     BOOLEAN ShowMessage
 ) {
     LOGPROCENTRY();
+    PROFILE_BEGIN("ScanForBootloaders");
     UINTN     i;
     EG_PIXEL  BGColor         = COLOR_LIGHTBLUE;
     BOOLEAN   DeleteItem          = FALSE;
@@ -2324,7 +2665,7 @@ VOID ScanForBootloaders (
     CHAR16   *OrigDontScanDirs    = NULL;
     CHAR16   *OrigDontScanFiles   = NULL;
     CHAR16   *OrigDontScanVolumes = NULL;
-    CHAR16    ShortCutKey;
+    UINT32    ConfigCrc;
 
     #if REFIT_DEBUG > 0
     CHAR16  *MsgStr = NULL;
@@ -2354,6 +2695,19 @@ VOID ScanForBootloaders (
         }
     } // for
 
+    // Loaders are carried over only if the settings steering the scan are
+    // unchanged. Hidden tags are left out here: hiding a tag takes its entry
+    // out of the menu at once, and unhiding one drops the scanned volumes.
+    ConfigCrc = ScanCacheConfigCrc();
+    if (ConfigCrc != ScannedConfigCrc) {
+        ForgetScannedVolumes();
+    }
+    ScannedConfigCrc    = ConfigCrc;
+    CarryVolumes        = ScannedVolumes;
+    CarryVolumesCount   = ScannedVolumesCount;
+    ScannedVolumes      = NULL;
+    ScannedVolumesCount = 0;
+
     // If UEFI & scanning for legacy loaders & deep legacy scan, update NVRAM boot manager list
     if ((GlobalConfig.LegacyType == LEGACY_TYPE_UEFI) &&
         ScanForLegacy && GlobalConfig.DeepLegacyScan
@@ -2499,6 +2853,7 @@ VOID ScanForBootloaders (
 */
 
     // scan for loaders and tools, add them to the menu
+    ScanCacheBegin();
     for (i = 0; i < NUM_SCAN_OPTIONS; i++) {
         switch (GlobalConfig.ScanFor[i]) {
 
@@ -2521,6 +2876,11 @@ VOID ScanForBootloaders (
             DOONEMENUKEY('f', "Scan Firmware"          , ScanFirmwareDefined(0, NULL, NULL));
         } // switch
     } // for
+    ScanCacheEnd();
+
+    // Loaders not carried over belong to volumes that were scanned again
+    FreeScannedVolumes (&CarryVolumes, &CarryVolumesCount);
+    FreeMenuScreen (&PreviousMenu);
 
     if (GlobalConfig.HiddenTags) {
         // Restore the backed-up GlobalConfig.DontScan* variables
@@ -2550,75 +2910,14 @@ VOID ScanForBootloaders (
         #endif
     }
     else {
-        // assign shortcut keys
-        #if REFIT_DEBUG > 0
-        MsgStr = StrDuplicate (L"Assign Shortcut Keys");
-        LOG(1, LOG_LINE_SEPARATOR, L"%s", MsgStr);
-        MsgLog ("\n\n");
-        MsgLog ("%s:\n", MsgStr);
-        MY_FREE_POOL(MsgStr);
-
-        UINTN KeyNum = 0;
-        #endif
-
-        for (i = 0; i < MainMenu->EntryCount && MainMenu->Entries[i]->Row == 0; i++) {
-            if (i < 9) {
-                #if REFIT_DEBUG > 0
-                KeyNum = i + 1;
-                #endif
-
-                ShortCutKey = (CHAR16) ('1' + i);
-            }
-            else if (i == 9) {
-                ShortCutKey = (CHAR16) ('9' - i);
-
-                #if REFIT_DEBUG > 0
-                KeyNum = 0;
-                #endif
-            }
-            else {
-                break;
-            }
-            MainMenu->Entries[i]->ShortcutDigit = ShortCutKey;
-
-            #if REFIT_DEBUG > 0
-            MsgStr = PoolPrint (
-                L"Set Key '%d' to %s",
-                KeyNum, GetPoolStr (&MainMenu->Entries[i]->Title)
-            );
-            LOG(2, LOG_LINE_NORMAL, L"%s", MsgStr);
-            MsgLog ("  - %s", MsgStr);
-            MY_FREE_POOL(MsgStr);
-
-            if (KeyNum < MainMenu->EntryCount &&
-                MainMenu->Entries[i]->Row == 0 &&
-                KeyNum != 0
-            ) {
-                MsgLog ("\n");
-            }
-            else {
-                MsgLog ("\n\n");
-            }
-            #endif
-        }  // for
-
-        #if REFIT_DEBUG > 0
-        MsgStr = PoolPrint (
-            L"Assigned Shortcut Key%s to %d of %d Loader%s",
-            (i == 1) ? L"" : L"s",
-            i, MainMenu->EntryCount,
-            (MainMenu->EntryCount == 1) ? L"" : L"s"
-        );
-        LOG(1, LOG_THREE_STAR_SEP, L"%s", MsgStr);
-        MsgLog ("INFO: %s\n\n", MsgStr);
-        MY_FREE_POOL(MsgStr);
-        #endif
+        AssignShortcutKeys();
     }
 
     // wait for user ACK when there were errors
     FinishTextScreen (FALSE);
 
     ScanningLoaders = FALSE;
+    PROFILE_END("ScanForBootloaders");
     LOGPROCEXIT();
 } // VOID ScanForBootloaders()
 
@@ -2629,11 +2928,14 @@ BOOLEAN IsValidTool (
     REFIT_VOLUME *BaseVolume,
     CHAR16       *PathName
 ) {
-    UINTN    i = 0;
-    CHAR16  *TestVolName = NULL, *TestPathName = NULL, *TestFileName = NULL, *DontScanTools = NULL;
-    BOOLEAN  retval = TRUE;
-
-    if (!FileExists (BaseVolume->RootDir, PathName)) {
+    UINTN         i = 0;
+    CHAR16       *TestVolName = NULL, *TestPathName = NULL, *TestFileName = NULL, *DontScanTools = NULL;
+    BOOLEAN       retval = TRUE;
+    LOADER_INFO  *Info;
+
+    // The file is opened once here; IsValidLoader below reuses what was read
+    Info = GetLoaderInfo (BaseVolume, PathName);
+    if ((Info == NULL) || !Info->Exists) {
         // Early return if file does not exist
         return FALSE;
     }
@@ -2658,31 +2960,22 @@ BOOLEAN IsValidTool (
     );
     #endif
 
-    if (!FileExists (BaseVolume->RootDir, PathName) ||
-        !IsValidLoader (BaseVolume->RootDir, PathName)
-    ) {
+    if (!IsValidLoader (BaseVolume, PathName)) {
         retval = FALSE;
     }
     else {
         SplitPathName (PathName, &TestVolName, &TestPathName, &TestFileName);
 
-        CHAR16 *DontScanThis = NULL;
-        while (retval && (DontScanThis = FindCommaDelimited(DontScanTools, i++))) {
-            CHAR16 *DontVolName = NULL, *DontPathName = NULL, *DontFileName = NULL;
-            SplitPathName (DontScanThis, &DontVolName, &DontPathName, &DontFileName);
-
-            if (MyStriCmp (TestFileName, DontFileName) &&
-                ((DontPathName == NULL) || (MyStriCmp (TestPathName, DontPathName))) &&
-                ((DontVolName == NULL) || (VolumeMatchesDescription (BaseVolume, DontVolName)))
+        CSV_LIST       *DontScanList = GetCsvList (DontScanTools);
+        CSV_PATH_PARTS *DontScanThis = GetCsvListPathParts (DontScanList);
+        for (i = 0; retval && DontScanThis && i < DontScanList->Count; i++) {
+            if (MyStriCmp (TestFileName, DontScanThis[i].Filename) &&
+                ((DontScanThis[i].Path == NULL) || (MyStriCmp (TestPathName, DontScanThis[i].Path))) &&
+                ((DontScanThis[i].VolName == NULL) || (VolumeMatchesDescription (BaseVolume, DontScanThis[i].VolName)))
             ) {
                 retval = FALSE;
             }
-
-            MY_FREE_POOL(DontVolName);
-            MY_FREE_POOL(DontScanThis);
-            MY_FREE_POOL(DontPathName);
-            MY_FREE_POOL(DontFileName);
-        } // while
+        } // for
     }
 
     MY_FREE_POOL(TestVolName);
@@ -2783,6 +3076,7 @@ VOID ScanForTools (VOID) {
     UINT32            CsrValue;
 
     LOGPROCENTRY();
+    PROFILE_BEGIN("ScanForTools");
 
     #if REFIT_DEBUG > 0
     CHAR16 *ToolStr   = NULL;
@@ -3301,5 +3595,6 @@ VOID ScanForTools (VOID) {
 
     MY_FREE_POOL(MokLocations);
 
+    PROFILE_END("ScanForTools");
     LOGPROCEXIT();
 } // VOID ScanForTools
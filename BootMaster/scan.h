@@ -66,6 +66,9 @@ VOID GenerateSubScreen(LOADER_ENTRY *Entry, IN REFIT_VOLUME *Volume, IN BOOLEAN
 VOID SetLoaderDefaults(LOADER_ENTRY *Entry, CHAR16 *LoaderPath, IN REFIT_VOLUME *Volume);
 VOID ScanForBootloaders(BOOLEAN ShowMessage);
 VOID ScanForTools(VOID);
+VOID AssignShortcutKeys (VOID);
+VOID ForgetScannedVolumes (VOID);
+VOID KeepPreviousMenu (IN REFIT_MENU_SCREEN *Menu);
 CHAR16 * GetVolumeGroupName (IN CHAR16 *LoaderPath, IN REFIT_VOLUME *Volume);
 PoolImage * GetVolumeGroupIcon (IN CHAR16 *LoaderPath, IN REFIT_VOLUME *Volume);
 
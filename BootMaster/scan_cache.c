@@ -0,0 +1,779 @@
+/*
+ * BootMaster/scan_cache.c
+ * Persistent cache of UEFI loaders found on each volume
+ *
+ * Distributed under the terms of the GNU General Public License (GPL)
+ * version 3 (GPLv3), or (at your option) any later version.
+ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "global.h"
+#include "lib.h"
+#include "mystrings.h"
+#include "crc32.h"
+#include "scan_cache.h"
+#include "../libeg/libeg.h"
+
+// The cache file lives in the RefindPlus directory and holds, for each volume
+// scanned for UEFI loaders, the steps that added its loaders to the menu and a
+// fingerprint of every directory the scan looked in. A fingerprint covers the
+// name, size, timestamp and attributes of each directory entry, so adding,
+// removing or replacing any file in one of those directories forces a full
+// scan of the volume. Volumes are told apart by their partition and volume
+// GUIDs, device path and names, and the cache is dropped whole when any of the
+// settings that steer the scan changes.
+#define SCAN_CACHE_FILE_NAME    L"loaders.cache"
+#define SCAN_CACHE_SIGNATURE    SIGNATURE_32('R','P','L','C')
+#define SCAN_CACHE_VERSION      2
+
+typedef struct {
+    UINT32    Signature;
+    UINT32    Version;
+    UINT32    RecordCount;
+    UINT32    DataSize;
+    UINT32    DataCrc;
+    UINT32    ConfigCrc;
+} SCAN_CACHE_HEADER;
+
+// Each record is followed by DirCount directories, each a SCAN_CACHE_DIR_RECORD
+// and its path, then by OpCount steps, each a UINT32 type, path and title.
+// Strings are stored as a UINT32 length in CHAR16s, including the NUL, and
+// the CHAR16s themselves. A length of zero stands for a NULL string.
+typedef struct {
+    EFI_GUID  PartGuid;
+    EFI_GUID  VolUuid;
+    UINT32    KeyCrc;
+    UINT32    DirCount;
+    UINT32    OpCount;
+    UINT32    Reserved;
+} SCAN_CACHE_RECORD;
+
+typedef struct {
+    UINT32    EntryCount;
+    UINT32    Crc;
+} SCAN_CACHE_DIR_RECORD;
+
+typedef struct {
+    CHAR16    *Path;
+    UINT32     EntryCount;
+    UINT32     Crc;
+} SCAN_CACHE_DIR;
+
+typedef struct {
+    EFI_GUID         PartGuid;
+    EFI_GUID         VolUuid;
+    UINT32           KeyCrc;
+    BOOLEAN          Keep;
+    BOOLEAN          Dropped;
+    SCAN_CACHE_DIR  *Dirs;
+    UINTN            DirCount;
+    SCAN_CACHE_OP   *Ops;
+    UINTN            OpCount;
+} SCAN_CACHE_VOLUME;
+
+typedef struct {
+    UINT8     *Data;
+    UINTN      Size;
+    UINTN      Capacity;
+    BOOLEAN    Failed;
+} SCAN_CACHE_WRITER;
+
+BOOLEAN                   ScanCacheBypass   = FALSE;
+
+static BOOLEAN            ScanCacheActive   = FALSE;
+static BOOLEAN            ScanCacheDirty    = FALSE;
+static UINT32             ScanCacheConfig   = 0;
+static SCAN_CACHE_VOLUME *CacheVolumes      = NULL;
+static UINTN              CacheVolumeCount  = 0;
+static BOOLEAN            Recording         = FALSE;
+static EFI_FILE          *RecordRoot        = NULL;
+static SCAN_CACHE_VOLUME  RecordVolume;
+
+static
+UINT32 ScanCacheCrcString (
+    IN UINT32  Crc,
+    IN CHAR16 *String OPTIONAL
+) {
+    if (String == NULL) {
+        // Keep a NULL string apart from an empty one
+        return crc32refit (Crc, "\xff", 1);
+    }
+
+    return crc32refit (Crc, String, StrSize (String));
+} // static UINT32 ScanCacheCrcString()
+
+// Settings that decide which loaders ScanEfiFiles finds on a volume
+UINT32 ScanCacheConfigCrc (VOID) {
+    UINT32   Crc;
+    BOOLEAN  Flags[4];
+
+    Flags[0] = GlobalConfig.ScanAllLinux;
+    Flags[1] = GlobalConfig.FoldLinuxKernels;
+    Flags[2] = GlobalConfig.ScanAllESP;
+    Flags[3] = GlobalConfig.SyncAPFS;
+
+    Crc = crc32refit (0, Flags, sizeof (Flags));
+    Crc = ScanCacheCrcString (Crc, GlobalConfig.DontScanDirs);
+    Crc = ScanCacheCrcString (Crc, GlobalConfig.DontScanFiles);
+    Crc = ScanCacheCrcString (Crc, GlobalConfig.DontScanVolumes);
+    Crc = ScanCacheCrcString (Crc, GlobalConfig.AlsoScan);
+    Crc = ScanCacheCrcString (Crc, SelfDirPath);
+    if (SelfVolume != NULL) {
+        Crc = crc32refit (Crc, &SelfVolume->PartGuid, sizeof (EFI_GUID));
+    }
+
+    return Crc;
+} // UINT32 ScanCacheConfigCrc()
+
+static
+UINT32 ScanCacheVolumeKey (
+    IN REFIT_VOLUME *Volume
+) {
+    UINT32  Crc;
+    CHAR16 *DevicePathStr;
+
+    DevicePathStr = (Volume->DevicePath != NULL) ? DevicePathToStr (Volume->DevicePath) : NULL;
+    Crc = ScanCacheCrcString (0, DevicePathStr);
+    Crc = ScanCacheCrcString (Crc, GetPoolStr (&Volume->VolName));
+    Crc = ScanCacheCrcString (Crc, GetPoolStr (&Volume->FsName));
+    Crc = ScanCacheCrcString (Crc, GetPoolStr (&Volume->PartName));
+    MY_FREE_POOL(DevicePathStr);
+
+    return Crc;
+} // static UINT32 ScanCacheVolumeKey()
+
+// Lists a directory in one pass and sums up its entries.
+static
+VOID ScanCacheFingerprint (
+    IN  EFI_FILE *RootDir,
+    IN  CHAR16   *Path,
+    OUT UINT32   *EntryCount,
+    OUT UINT32   *Crc
+) {
+    EFI_STATUS       Status;
+    EFI_FILE_INFO   *DirEntry;
+    REFIT_DIR_ITER   DirIter;
+    EFI_TIME        *Time;
+    UINT32           Stamp[3];
+
+    *EntryCount = 0;
+    *Crc        = 0;
+
+    DirIterOpen (RootDir, Path, &DirIter);
+    while (DirIterNext (&DirIter, 0, NULL, &DirEntry)) {
+        // Only the meaningful EFI_TIME fields ... Padding may hold anything
+        Time     = &DirEntry->ModificationTime;
+        Stamp[0] = ((UINT32) Time->Year << 16) | ((UINT32) Time->Month << 8) | Time->Day;
+        Stamp[1] = ((UINT32) Time->Hour << 16) | ((UINT32) Time->Minute << 8) | Time->Second;
+        Stamp[2] = Time->Nanosecond;
+
+        *Crc = ScanCacheCrcString (*Crc, DirEntry->FileName);
+        *Crc = crc32refit (*Crc, &DirEntry->FileSize,  sizeof (DirEntry->FileSize));
+        *Crc = crc32refit (*Crc, &DirEntry->Attribute, sizeof (DirEntry->Attribute));
+        *Crc = crc32refit (*Crc, Stamp, sizeof (Stamp));
+        (*EntryCount)++;
+    }
+
+    // A missing directory must not match an empty one
+    Status = DirIterClose (&DirIter);
+    *Crc   = crc32refit (*Crc, &Status, sizeof (Status));
+} // static VOID ScanCacheFingerprint()
+
+static
+VOID ScanCacheFreeVolume (
+    IN OUT SCAN_CACHE_VOLUME *CacheVolume
+) {
+    UINTN i;
+
+    for (i = 0; i < CacheVolume->DirCount; i++) {
+        MY_FREE_POOL(CacheVolume->Dirs[i].Path);
+    }
+    for (i = 0; i < CacheVolume->OpCount; i++) {
+        MY_FREE_POOL(CacheVolume->Ops[i].Path);
+        MY_FREE_POOL(CacheVolume->Ops[i].Title);
+    }
+    MY_FREE_POOL(CacheVolume->Dirs);
+    MY_FREE_POOL(CacheVolume->Ops);
+    CacheVolume->DirCount = 0;
+    CacheVolume->OpCount  = 0;
+} // static VOID ScanCacheFreeVolume()
+
+static
+VOID ScanCacheFreeVolumes (VOID) {
+    UINTN i;
+
+    for (i = 0; i < CacheVolumeCount; i++) {
+        ScanCacheFreeVolume (&CacheVolumes[i]);
+    }
+    MY_FREE_POOL(CacheVolumes);
+    CacheVolumeCount = 0;
+} // static VOID ScanCacheFreeVolumes()
+
+static
+BOOLEAN ScanCacheGet (
+    IN     UINT8  *Data,
+    IN     UINTN   DataSize,
+    IN OUT UINTN  *Offset,
+    OUT    VOID   *Out,
+    IN     UINTN   OutSize
+) {
+    if (DataSize - *Offset < OutSize) {
+        return FALSE;
+    }
+
+    CopyMem (Out, Data + *Offset, OutSize);
+    *Offset += OutSize;
+
+    return TRUE;
+} // static BOOLEAN ScanCacheGet()
+
+static
+BOOLEAN ScanCacheGetString (
+    IN     UINT8    *Data,
+    IN     UINTN     DataSize,
+    IN OUT UINTN    *Offset,
+    OUT    CHAR16  **String
+) {
+    UINT32  Length;
+
+    *String = NULL;
+    if (!ScanCacheGet (Data, DataSize, Offset, &Length, sizeof (Length))) {
+        return FALSE;
+    }
+    if (Length == 0) {
+        return TRUE;
+    }
+    if ((DataSize - *Offset) / sizeof (CHAR16) < Length) {
+        return FALSE;
+    }
+
+    *String = AllocatePool (Length * sizeof (CHAR16));
+    if (*String == NULL) {
+        return FALSE;
+    }
+
+    // Copy out as the stored string need not be aligned
+    ScanCacheGet (Data, DataSize, Offset, *String, Length * sizeof (CHAR16));
+    if ((*String)[Length - 1] != L'\0') {
+        MY_FREE_POOL(*String);
+
+        return FALSE;
+    }
+
+    return TRUE;
+} // static BOOLEAN ScanCacheGetString()
+
+static
+VOID ScanCacheReadFile (VOID) {
+    EFI_STATUS              Status;
+    UINT8                  *FileData;
+    UINT8                  *Data;
+    UINTN                   FileSize;
+    UINTN                   DataSize;
+    UINTN                   Offset;
+    UINTN                   i, j;
+    BOOLEAN                 Valid;
+    SCAN_CACHE_HEADER      *Header;
+    SCAN_CACHE_RECORD       Record;
+    SCAN_CACHE_DIR_RECORD   DirRecord;
+    SCAN_CACHE_VOLUME       CacheVolume;
+    SCAN_CACHE_DIR          CacheDir;
+    SCAN_CACHE_OP           CacheOp;
+
+    Status = egLoadFile (SelfDir, SCAN_CACHE_FILE_NAME, &FileData, &FileSize);
+    if (EFI_ERROR(Status)) {
+        // Nothing cached yet
+        ScanCacheDirty = TRUE;
+
+        return;
+    }
+
+    Header = (SCAN_CACHE_HEADER *) FileData;
+    if (FileSize < sizeof (SCAN_CACHE_HEADER)             ||
+        Header->Signature != SCAN_CACHE_SIGNATURE         ||
+        Header->Version   != SCAN_CACHE_VERSION           ||
+        Header->DataSize  != FileSize - sizeof (SCAN_CACHE_HEADER) ||
+        Header->DataCrc   != crc32refit (0, FileData + sizeof (SCAN_CACHE_HEADER), Header->DataSize) ||
+        Header->ConfigCrc != ScanCacheConfig
+    ) {
+        #if REFIT_DEBUG > 0
+        LOG(2, LOG_LINE_NORMAL, L"Discarding Stale or Invalid Loader Cache File");
+        #endif
+
+        MY_FREE_POOL(FileData);
+        ScanCacheDirty = TRUE;
+
+        return;
+    }
+
+    Data     = FileData + sizeof (SCAN_CACHE_HEADER);
+    DataSize = Header->DataSize;
+    Offset   = 0;
+    Valid    = TRUE;
+    for (i = 0; Valid && i < Header->RecordCount; i++) {
+        Valid = ScanCacheGet (Data, DataSize, &Offset, &Record, sizeof (Record));
+        if (!Valid) {
+            break;
+        }
+
+        ZeroMem (&CacheVolume, sizeof (CacheVolume));
+        CacheVolume.PartGuid = Record.PartGuid;
+        CacheVolume.VolUuid  = Record.VolUuid;
+        CacheVolume.KeyCrc   = Record.KeyCrc;
+
+        for (j = 0; Valid && j < Record.DirCount; j++) {
+            Valid = (
+                ScanCacheGet (Data, DataSize, &Offset, &DirRecord, sizeof (DirRecord)) &&
+                ScanCacheGetString (Data, DataSize, &Offset, &CacheDir.Path) &&
+                CacheDir.Path != NULL
+            );
+            if (Valid) {
+                CacheDir.EntryCount = DirRecord.EntryCount;
+                CacheDir.Crc        = DirRecord.Crc;
+                AddListElementSized (
+                    (VOID **) &CacheVolume.Dirs, &CacheVolume.DirCount,
+                    &CacheDir, sizeof (CacheDir)
+                );
+            }
+        }
+
+        for (j = 0; Valid && j < Record.OpCount; j++) {
+            CacheOp.Title = NULL;
+            Valid = (
+                ScanCacheGet (Data, DataSize, &Offset, &CacheOp.Type, sizeof (CacheOp.Type)) &&
+                ScanCacheGetString (Data, DataSize, &Offset, &CacheOp.Path) &&
+                ScanCacheGetString (Data, DataSize, &Offset, &CacheOp.Title)
+            );
+            if (Valid) {
+                AddListElementSized (
+                    (VOID **) &CacheVolume.Ops, &CacheVolume.OpCount,
+                    &CacheOp, sizeof (CacheOp)
+                );
+            }
+            else {
+                MY_FREE_POOL(CacheOp.Path);
+            }
+        }
+
+        if (Valid) {
+            AddListElementSized (
+                (VOID **) &CacheVolumes, &CacheVolumeCount,
+                &CacheVolume, sizeof (CacheVolume)
+            );
+        }
+        else {
+            ScanCacheFreeVolume (&CacheVolume);
+        }
+    } // for
+
+    if (!Valid) {
+        ScanCacheDirty = TRUE;
+    }
+
+    MY_FREE_POOL(FileData);
+
+    #if REFIT_DEBUG > 0
+    LOG(2, LOG_LINE_NORMAL,
+        L"Loaded %d Cached Volume%s from '%s'",
+        CacheVolumeCount, (CacheVolumeCount == 1) ? L"" : L"s",
+        SCAN_CACHE_FILE_NAME
+    );
+    #endif
+} // static VOID ScanCacheReadFile()
+
+static
+VOID ScanCachePut (
+    IN OUT SCAN_CACHE_WRITER *Writer,
+    IN     CONST VOID        *Data,
+    IN     UINTN              Size
+) {
+    UINTN  NewCapacity;
+    UINT8 *NewData;
+
+    if (Writer->Failed) {
+        return;
+    }
+
+    if (Writer->Size + Size > Writer->Capacity) {
+        NewCapacity = (Writer->Capacity == 0) ? 4096 : Writer->Capacity;
+        while (Writer->Size + Size > NewCapacity) {
+            NewCapacity *= 2;
+        }
+
+        NewData = ReallocatePool (Writer->Capacity, NewCapacity, Writer->Data);
+        if (NewData == NULL) {
+            MY_FREE_POOL(Writer->Data);
+            Writer->Failed = TRUE;
+
+            return;
+        }
+
+        Writer->Data     = NewData;
+        Writer->Capacity = NewCapacity;
+    }
+
+    CopyMem (Writer->Data + Writer->Size, Data, Size);
+    Writer->Size += Size;
+} // static VOID ScanCachePut()
+
+static
+VOID ScanCachePutString (
+    IN OUT SCAN_CACHE_WRITER *Writer,
+    IN     CHAR16            *String OPTIONAL
+) {
+    UINT32 Length;
+
+    Length = (String == NULL) ? 0 : (UINT32) (StrLen (String) + 1);
+    ScanCachePut (Writer, &Length, sizeof (Length));
+    if (Length > 0) {
+        ScanCachePut (Writer, String, Length * sizeof (CHAR16));
+    }
+} // static VOID ScanCachePutString()
+
+// Writes the records of volumes seen in this scan back to the RefindPlus
+// directory, if any were added or dropped since the file was last read.
+static
+VOID ScanCacheSave (VOID) {
+    EFI_STATUS              Status;
+    UINTN                   i, j;
+    UINT32                  RecordCount;
+    SCAN_CACHE_WRITER       Writer;
+    SCAN_CACHE_HEADER       Header;
+    SCAN_CACHE_RECORD       Record;
+    SCAN_CACHE_DIR_RECORD   DirRecord;
+    SCAN_CACHE_VOLUME      *CacheVolume;
+
+    // Records for volumes not seen this time are dropped
+    for (i = 0; i < CacheVolumeCount; i++) {
+        if (!CacheVolumes[i].Keep || CacheVolumes[i].Dropped) {
+            ScanCacheDirty = TRUE;
+        }
+    }
+
+    if (!ScanCacheDirty || SelfDir == NULL) {
+        return;
+    }
+
+    ZeroMem (&Writer, sizeof (Writer));
+    ZeroMem (&Header, sizeof (Header));
+    ScanCachePut (&Writer, &Header, sizeof (Header));
+
+    RecordCount = 0;
+    for (i = 0; i < CacheVolumeCount; i++) {
+        CacheVolume = &CacheVolumes[i];
+        if (!CacheVolume->Keep || CacheVolume->Dropped) {
+            continue;
+        }
+
+        ZeroMem (&Record, sizeof (Record));
+        Record.PartGuid = CacheVolume->PartGuid;
+        Record.VolUuid  = CacheVolume->VolUuid;
+        Record.KeyCrc   = CacheVolume->KeyCrc;
+        Record.DirCount = (UINT32) CacheVolume->DirCount;
+        Record.OpCount  = (UINT32) CacheVolume->OpCount;
+        ScanCachePut (&Writer, &Record, sizeof (Record));
+
+        for (j = 0; j < CacheVolume->DirCount; j++) {
+            DirRecord.EntryCount = CacheVolume->Dirs[j].EntryCount;
+            DirRecord.Crc        = CacheVolume->Dirs[j].Crc;
+            ScanCachePut (&Writer, &DirRecord, sizeof (DirRecord));
+            ScanCachePutString (&Writer, CacheVolume->Dirs[j].Path);
+        }
+
+        for (j = 0; j < CacheVolume->OpCount; j++) {
+            ScanCachePut (&Writer, &CacheVolume->Ops[j].Type, sizeof (UINT32));
+            ScanCachePutString (&Writer, CacheVolume->Ops[j].Path);
+            ScanCachePutString (&Writer, CacheVolume->Ops[j].Title);
+        }
+
+        RecordCount++;
+    } // for
+
+    if (Writer.Failed) {
+        return;
+    }
+
+    Header.Signature   = SCAN_CACHE_SIGNATURE;
+    Header.Version     = SCAN_CACHE_VERSION;
+    Header.RecordCount = RecordCount;
+    Header.DataSize    = (UINT32) (Writer.Size - sizeof (Header));
+    Header.DataCrc     = crc32refit (0, Writer.Data + sizeof (Header), Header.DataSize);
+    Header.ConfigCrc   = ScanCacheConfig;
+    CopyMem (Writer.Data, &Header, sizeof (Header));
+
+    // egSaveFile does not truncate ... Delete any previous file first
+    egSaveFile (SelfDir, SCAN_CACHE_FILE_NAME, NULL, 0);
+    Status = egSaveFile (SelfDir, SCAN_CACHE_FILE_NAME, Writer.Data, Writer.Size);
+    MY_FREE_POOL(Writer.Data);
+
+    if (!EFI_ERROR(Status)) {
+        ScanCacheDirty = FALSE;
+    }
+
+    #if REFIT_DEBUG > 0
+    LOG(2, LOG_LINE_NORMAL,
+        L"Save %d Cached Volume%s to '%s' ... %r",
+        RecordCount, (RecordCount == 1) ? L"" : L"s",
+        SCAN_CACHE_FILE_NAME, Status
+    );
+    #endif
+} // static VOID ScanCacheSave()
+
+// Called before volumes are scanned for loaders. The scan settings must be
+// final by now, as they are part of what the cache is checked against.
+VOID ScanCacheBegin (VOID) {
+    ScanCacheActive = (GlobalConfig.ScanCache && SelfDir != NULL);
+    if (!ScanCacheActive) {
+        ScanCacheBypass = FALSE;
+
+        return;
+    }
+
+    ScanCacheDirty  = FALSE;
+    ScanCacheConfig = ScanCacheConfigCrc();
+
+    if (ScanCacheBypass) {
+        // Rescan everything and rebuild the cache from scratch
+        #if REFIT_DEBUG > 0
+        LOG(2, LOG_LINE_NORMAL, L"Bypassing Loader Cache ... Rescan Forced");
+        #endif
+
+        ScanCacheBypass = FALSE;
+        ScanCacheDirty  = TRUE;
+
+        return;
+    }
+
+    ScanCacheReadFile();
+} // VOID ScanCacheBegin()
+
+VOID ScanCacheEnd (VOID) {
+    if (!ScanCacheActive) {
+        return;
+    }
+
+    if (Recording) {
+        ScanCacheRecordStop();
+    }
+
+    ScanCacheSave();
+    ScanCacheFreeVolumes();
+    ScanCacheActive = FALSE;
+} // VOID ScanCacheEnd()
+
+static
+SCAN_CACHE_VOLUME * ScanCacheFindVolume (
+    IN REFIT_VOLUME *Volume
+) {
+    UINTN               i;
+    UINT32              KeyCrc;
+    SCAN_CACHE_VOLUME  *CacheVolume;
+
+    if (!ScanCacheActive ||
+        Volume->RootDir == NULL ||
+        (GlobalConfig.SyncAPFS && Volume->FSType == FS_TYPE_APFS)
+    ) {
+        // Loaders on synced APFS volumes depend on other volumes ... Always scan
+        return NULL;
+    }
+
+    KeyCrc = ScanCacheVolumeKey (Volume);
+    for (i = 0; i < CacheVolumeCount; i++) {
+        CacheVolume = &CacheVolumes[i];
+        if (!CacheVolume->Dropped &&
+            CacheVolume->KeyCrc == KeyCrc &&
+            GuidsAreEqual (&CacheVolume->PartGuid, &Volume->PartGuid) &&
+            GuidsAreEqual (&CacheVolume->VolUuid,  &Volume->VolUuid)
+        ) {
+            return CacheVolume;
+        }
+    } // for
+
+    return NULL;
+} // static SCAN_CACHE_VOLUME * ScanCacheFindVolume()
+
+// Returns the recorded steps for Volume if none of the directories its last
+// scan looked in has changed since. The steps stay valid until ScanCacheEnd.
+BOOLEAN ScanCacheLookup (
+    IN  REFIT_VOLUME   *Volume,
+    OUT SCAN_CACHE_OP **Ops,
+    OUT UINTN          *OpCount
+) {
+    UINTN               j;
+    UINT32              EntryCount;
+    UINT32              Crc;
+    SCAN_CACHE_VOLUME  *CacheVolume;
+
+    CacheVolume = ScanCacheFindVolume (Volume);
+    if (CacheVolume == NULL) {
+        return FALSE;
+    }
+
+    for (j = 0; j < CacheVolume->DirCount; j++) {
+        ScanCacheFingerprint (Volume->RootDir, CacheVolume->Dirs[j].Path, &EntryCount, &Crc);
+        if (EntryCount != CacheVolume->Dirs[j].EntryCount || Crc != CacheVolume->Dirs[j].Crc) {
+            #if REFIT_DEBUG > 0
+            LOG(2, LOG_LINE_NORMAL,
+                L"Loader Cache is Stale ... '%s' has Changed",
+                CacheVolume->Dirs[j].Path
+            );
+            #endif
+
+            return FALSE;
+        }
+    }
+
+    #if REFIT_DEBUG > 0
+    LOG(2, LOG_LINE_NORMAL, L"Restoring Volume Loaders from Loader Cache");
+    #endif
+
+    CacheVolume->Keep = TRUE;
+    *Ops     = CacheVolume->Ops;
+    *OpCount = CacheVolume->OpCount;
+
+    return TRUE;
+} // BOOLEAN ScanCacheLookup()
+
+// Keeps the record for Volume, unchecked, when its loaders were carried over
+// from the previous scan in this session rather than looked up.
+VOID ScanCacheKeep (
+    IN REFIT_VOLUME *Volume
+) {
+    SCAN_CACHE_VOLUME  *CacheVolume;
+
+    CacheVolume = ScanCacheFindVolume (Volume);
+    if (CacheVolume != NULL) {
+        CacheVolume->Keep = TRUE;
+    }
+} // VOID ScanCacheKeep()
+
+// Starts recording what the scan of Volume looks at and adds.
+VOID ScanCacheRecordStart (
+    IN REFIT_VOLUME *Volume
+) {
+    if (!ScanCacheActive ||
+        Volume->RootDir == NULL ||
+        (GlobalConfig.SyncAPFS && Volume->FSType == FS_TYPE_APFS)
+    ) {
+        return;
+    }
+
+    if (Recording) {
+        ScanCacheRecordStop();
+    }
+
+    ZeroMem (&RecordVolume, sizeof (RecordVolume));
+    RecordVolume.PartGuid = Volume->PartGuid;
+    RecordVolume.VolUuid  = Volume->VolUuid;
+    RecordVolume.KeyCrc   = ScanCacheVolumeKey (Volume);
+    RecordVolume.Keep     = TRUE;
+    RecordRoot            = Volume->RootDir;
+    Recording             = TRUE;
+} // VOID ScanCacheRecordStart()
+
+VOID ScanCacheRecordStop (VOID) {
+    UINTN i;
+
+    if (!Recording) {
+        return;
+    }
+
+    // Replace any earlier record for the volume
+    for (i = 0; i < CacheVolumeCount; i++) {
+        if (!CacheVolumes[i].Dropped &&
+            CacheVolumes[i].KeyCrc == RecordVolume.KeyCrc &&
+            GuidsAreEqual (&CacheVolumes[i].PartGuid, &RecordVolume.PartGuid) &&
+            GuidsAreEqual (&CacheVolumes[i].VolUuid,  &RecordVolume.VolUuid)
+        ) {
+            ScanCacheFreeVolume (&CacheVolumes[i]);
+            CacheVolumes[i].Dropped = TRUE;
+        }
+    }
+
+    AddListElementSized (
+        (VOID **) &CacheVolumes, &CacheVolumeCount,
+        &RecordVolume, sizeof (RecordVolume)
+    );
+    ScanCacheDirty = TRUE;
+    Recording      = FALSE;
+    RecordRoot     = NULL;
+} // VOID ScanCacheRecordStop()
+
+// Notes a directory the scan being recorded depends on.
+VOID ScanCacheNoteDir (
+    IN CHAR16 *Path
+) {
+    UINTN           i;
+    SCAN_CACHE_DIR  CacheDir;
+
+    if (!Recording || Path == NULL) {
+        return;
+    }
+
+    for (i = 0; i < RecordVolume.DirCount; i++) {
+        if (MyStriCmp (RecordVolume.Dirs[i].Path, Path)) {
+            return;
+        }
+    }
+
+    CacheDir.Path = StrDuplicate (Path);
+    if (CacheDir.Path == NULL) {
+        return;
+    }
+
+    ScanCacheFingerprint (RecordRoot, Path, &CacheDir.EntryCount, &CacheDir.Crc);
+    AddListElementSized (
+        (VOID **) &RecordVolume.Dirs, &RecordVolume.DirCount,
+        &CacheDir, sizeof (CacheDir)
+    );
+} // VOID ScanCacheNoteDir()
+
+// Notes a step of the scan being recorded.
+VOID ScanCacheNoteOp (
+    IN UINT32  Type,
+    IN CHAR16 *Path  OPTIONAL,
+    IN CHAR16 *Title OPTIONAL
+) {
+    SCAN_CACHE_OP  CacheOp;
+
+    if (!Recording) {
+        return;
+    }
+
+    CacheOp.Type  = Type;
+    CacheOp.Path  = (Path  != NULL) ? StrDuplicate (Path)  : NULL;
+    CacheOp.Title = (Title != NULL) ? StrDuplicate (Title) : NULL;
+    AddListElementSized (
+        (VOID **) &RecordVolume.Ops, &RecordVolume.OpCount,
+        &CacheOp, sizeof (CacheOp)
+    );
+} // VOID ScanCacheNoteOp()
+
+// Deletes the cache file, so that the next boot scans all volumes again.
+// Used when a loader taken from the cache turns out to be missing.
+VOID ScanCacheInvalidate (VOID) {
+    if (!GlobalConfig.ScanCache || SelfDir == NULL) {
+        return;
+    }
+
+    egSaveFile (SelfDir, SCAN_CACHE_FILE_NAME, NULL, 0);
+
+    #if REFIT_DEBUG > 0
+    LOG(2, LOG_LINE_NORMAL, L"Deleted Loader Cache File ... Loader Not Found");
+    #endif
+} // VOID ScanCacheInvalidate()
+
+/* EOF */
@@ -0,0 +1,62 @@
+/*
+ * BootMaster/scan_cache.h
+ * Persistent cache of UEFI loaders found on each volume
+ *
+ * Distributed under the terms of the GNU General Public License (GPL)
+ * version 3 (GPLv3), or (at your option) any later version.
+ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SCAN_CACHE_H_
+#define __SCAN_CACHE_H_
+
+#ifdef __MAKEWITH_GNUEFI
+#include "efi.h"
+#include "efilib.h"
+#else
+#include "../include/tiano_includes.h"
+#endif
+#include "global.h"
+
+// Steps recorded while scanning a volume, replayed in the same order
+#define SCAN_CACHE_OP_LOADER      1   // AddLoaderEntry with Path and Title
+#define SCAN_CACHE_OP_DIR_LOADER  2   // Path is the next loader in a directory list, Title any UKI name
+#define SCAN_CACHE_OP_DIR_END     3   // End of the directory list
+#define SCAN_CACHE_OP_RECOVERY    4   // Path is a Mac OS recovery file
+
+typedef struct {
+    UINT32     Type;
+    CHAR16    *Path;
+    CHAR16    *Title;
+} SCAN_CACHE_OP;
+
+// Set to make the next loader scan ignore and rebuild the cache
+extern BOOLEAN ScanCacheBypass;
+
+VOID ScanCacheBegin (VOID);
+VOID ScanCacheEnd (VOID);
+BOOLEAN ScanCacheLookup (IN REFIT_VOLUME *Volume, OUT SCAN_CACHE_OP **Ops, OUT UINTN *OpCount);
+VOID ScanCacheKeep (IN REFIT_VOLUME *Volume);
+VOID ScanCacheRecordStart (IN REFIT_VOLUME *Volume);
+VOID ScanCacheRecordStop (VOID);
+VOID ScanCacheNoteDir (IN CHAR16 *Path);
+VOID ScanCacheNoteOp (IN UINT32 Type, IN CHAR16 *Path OPTIONAL, IN CHAR16 *Title OPTIONAL);
+VOID ScanCacheInvalidate (VOID);
+UINT32 ScanCacheConfigCrc (VOID);
+
+#endif
+
+/* EOF */
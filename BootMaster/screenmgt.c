@@ -54,6 +54,7 @@
 #include "leaks.h"
 #include "menu.h"
 #include "mystrings.h"
+#include "BootLog.h"
 #include "../include/refit_call_wrapper.h"
 #include "../include/egemb_refindplus_banner.h"
 
@@ -881,6 +882,9 @@ BOOLEAN CheckFatalError (
     LOG(1, LOG_STAR_SEPARATOR, Temp);
     #endif
 
+    // Make sure the log holds the error even if we never get to write again
+    BootLogFlush();
+
     MY_FREE_POOL(Temp);
 
     return TRUE;
@@ -1152,6 +1156,7 @@ VOID BltClearScreen (
 
     // DA-TAG: See notes in 'egFreeImageQEMU'
     MY_FREE_IMAGE(GlobalConfig.ScreenBackground);
+    FlushTextLabelCache();
     GlobalConfig.ScreenBackground = egCopyScreen();
     MsgLog ("GlobalConfig.ScreenBackground = egCopyScreen\n");
     LEAKABLEONEIMAGE(GlobalConfig.ScreenBackground, "ScreenBackground image");
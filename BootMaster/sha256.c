@@ -0,0 +1,175 @@
+/*
+ * BootMaster/sha256.c
+ * SHA-256 message digest, as specified in FIPS 180-4
+ *
+ * Distributed under the terms of the GNU General Public License (GPL)
+ * version 3 (GPLv3), or (at your option) any later version.
+ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sha256.h"
+
+static CONST UINT32 Sha256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROTR32(x, n)   (((x) >> (n)) | ((x) << (32 - (n))))
+
+static
+VOID Sha256Block (
+    IN OUT REFIT_SHA256 *Context,
+    IN     CONST UINT8  *Block
+) {
+    UINT32 W[64];
+    UINT32 a, b, c, d, e, f, g, h;
+    UINT32 T1, T2;
+    UINTN  i;
+
+    for (i = 0; i < 16; i++) {
+        W[i] = ((UINT32) Block[i * 4]     << 24) |
+               ((UINT32) Block[i * 4 + 1] << 16) |
+               ((UINT32) Block[i * 4 + 2] <<  8) |
+               ((UINT32) Block[i * 4 + 3]);
+    }
+    for (i = 16; i < 64; i++) {
+        W[i] = (ROTR32(W[i - 2], 17) ^ ROTR32(W[i - 2], 19) ^ (W[i - 2] >> 10)) + W[i - 7] +
+               (ROTR32(W[i - 15], 7) ^ ROTR32(W[i - 15], 18) ^ (W[i - 15] >> 3)) + W[i - 16];
+    }
+
+    a = Context->State[0];
+    b = Context->State[1];
+    c = Context->State[2];
+    d = Context->State[3];
+    e = Context->State[4];
+    f = Context->State[5];
+    g = Context->State[6];
+    h = Context->State[7];
+
+    for (i = 0; i < 64; i++) {
+        T1 = h + (ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25)) + ((e & f) ^ (~e & g)) + Sha256K[i] + W[i];
+        T2 = (ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + T1;
+        d = c;
+        c = b;
+        b = a;
+        a = T1 + T2;
+    } // for
+
+    Context->State[0] += a;
+    Context->State[1] += b;
+    Context->State[2] += c;
+    Context->State[3] += d;
+    Context->State[4] += e;
+    Context->State[5] += f;
+    Context->State[6] += g;
+    Context->State[7] += h;
+} // static VOID Sha256Block()
+
+VOID RefitSha256Init (
+    OUT REFIT_SHA256 *Context
+) {
+    Context->State[0]  = 0x6a09e667;
+    Context->State[1]  = 0xbb67ae85;
+    Context->State[2]  = 0x3c6ef372;
+    Context->State[3]  = 0xa54ff53a;
+    Context->State[4]  = 0x510e527f;
+    Context->State[5]  = 0x9b05688c;
+    Context->State[6]  = 0x1f83d9ab;
+    Context->State[7]  = 0x5be0cd19;
+    Context->Length    = 0;
+    Context->BlockUsed = 0;
+} // VOID RefitSha256Init()
+
+VOID RefitSha256Update (
+    IN OUT REFIT_SHA256 *Context,
+    IN     CONST VOID   *Data,
+    IN     UINTN         Size
+) {
+    CONST UINT8 *Bytes = Data;
+    UINTN        Take;
+
+    Context->Length += Size;
+
+    if (Context->BlockUsed > 0) {
+        Take = 64 - Context->BlockUsed;
+        if (Take > Size) {
+            Take = Size;
+        }
+
+        CopyMem (&Context->Block[Context->BlockUsed], Bytes, Take);
+        Context->BlockUsed += Take;
+        Bytes += Take;
+        Size  -= Take;
+
+        if (Context->BlockUsed < 64) {
+            return;
+        }
+
+        Sha256Block (Context, Context->Block);
+        Context->BlockUsed = 0;
+    }
+
+    while (Size >= 64) {
+        Sha256Block (Context, Bytes);
+        Bytes += 64;
+        Size  -= 64;
+    }
+
+    if (Size > 0) {
+        CopyMem (Context->Block, Bytes, Size);
+        Context->BlockUsed = Size;
+    }
+} // VOID RefitSha256Update()
+
+VOID RefitSha256Final (
+    IN OUT REFIT_SHA256 *Context,
+    OUT    UINT8        *Digest
+) {
+    UINT64 BitLength = Context->Length * 8;
+    UINTN  i;
+
+    Context->Block[Context->BlockUsed++] = 0x80;
+    if (Context->BlockUsed > 56) {
+        ZeroMem (&Context->Block[Context->BlockUsed], 64 - Context->BlockUsed);
+        Sha256Block (Context, Context->Block);
+        Context->BlockUsed = 0;
+    }
+
+    ZeroMem (&Context->Block[Context->BlockUsed], 56 - Context->BlockUsed);
+    for (i = 0; i < 8; i++) {
+        Context->Block[63 - i] = (UINT8) (BitLength >> (i * 8));
+    }
+    Sha256Block (Context, Context->Block);
+
+    for (i = 0; i < 8; i++) {
+        Digest[i * 4]     = (UINT8) (Context->State[i] >> 24);
+        Digest[i * 4 + 1] = (UINT8) (Context->State[i] >> 16);
+        Digest[i * 4 + 2] = (UINT8) (Context->State[i] >>  8);
+        Digest[i * 4 + 3] = (UINT8) (Context->State[i]);
+    }
+} // VOID RefitSha256Final()
+
+/* EOF */
@@ -0,0 +1,48 @@
+/*
+ * BootMaster/sha256.h
+ * SHA-256 message digest
+ *
+ * Distributed under the terms of the GNU General Public License (GPL)
+ * version 3 (GPLv3), or (at your option) any later version.
+ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SHA256_H_
+#define __SHA256_H_
+
+#ifdef __MAKEWITH_GNUEFI
+#include "efi.h"
+#include "efilib.h"
+#else
+#include "../include/tiano_includes.h"
+#endif
+
+#define SHA256_DIGEST_SIZE  (32)
+
+typedef struct {
+    UINT32   State[8];
+    UINT64   Length;
+    UINT8    Block[64];
+    UINTN    BlockUsed;
+} REFIT_SHA256;
+
+VOID RefitSha256Init (OUT REFIT_SHA256 *Context);
+VOID RefitSha256Update (IN OUT REFIT_SHA256 *Context, IN CONST VOID *Data, IN UINTN Size);
+VOID RefitSha256Final (IN OUT REFIT_SHA256 *Context, OUT UINT8 *Digest);
+
+#endif
+
+/* EOF */
@@ -0,0 +1,382 @@
+/*
+ * BootMaster/volume_index.c
+ * Hash indexes over volume lists
+ *
+ * Distributed under the terms of the GNU General Public License (GPL)
+ * version 3 (GPLv3), or (at your option) any later version.
+ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "global.h"
+#include "lib.h"
+#include "mystrings.h"
+#include "volume_index.h"
+
+// Indexes are built on the first lookup in a list and kept while the list's
+// array, length and the index generation stay the same. AddToVolumeList and
+// FreeVolumes drop the index of the list they change, and
+// VolumeIndexInvalidate drops them all once volumes' keys may have changed.
+// Each table holds list positions plus one, zero marking an empty slot, and
+// a lookup returns the first volume in list order with a matching key.
+#define VOLUME_INDEX_SLOTS  4
+
+typedef struct {
+    REFIT_VOLUME  **List;
+    UINTN           ListCount;
+    UINTN           Generation;
+    UINTN           TableSize;
+    UINT32         *Tables[VOLUME_KEY_COUNT];
+} VOLUME_INDEX;
+
+static VOLUME_INDEX  VolumeIndexes[VOLUME_INDEX_SLOTS];
+static UINTN         VolumeIndexGeneration = 1;
+static UINTN         VolumeIndexNext       = 0;
+
+static
+UINT32 HashBytes (
+    IN VOID   *Data,
+    IN UINTN   Size
+) {
+    UINT8   *Bytes = Data;
+    UINT32   Hash  = 2166136261U;
+    UINTN    i;
+
+    for (i = 0; i < Size; i++) {
+        Hash = (Hash ^ Bytes[i]) * 16777619U;
+    }
+
+    return Hash;
+} // static UINT32 HashBytes()
+
+// Folds each character the way MyStriCmp() compares them
+static
+UINT32 HashName (
+    IN CHAR16 *Name
+) {
+    UINT32   Hash = 2166136261U;
+    CHAR16   Char;
+
+    while (*Name != L'\0') {
+        Char = *Name++ & ~0x20;
+        Hash = (Hash ^ (Char & 0xFF)) * 16777619U;
+        Hash = (Hash ^ (Char >> 8))   * 16777619U;
+    }
+
+    return Hash;
+} // static UINT32 HashName()
+
+static
+EFI_GUID * VolumeKeyGuid (
+    IN REFIT_VOLUME *Volume,
+    IN UINTN         KeyType
+) {
+    switch (KeyType) {
+        case VOLUME_KEY_PART_GUID: return &Volume->PartGuid;
+        case VOLUME_KEY_VOL_UUID:  return &Volume->VolUuid;
+        default:                   return &Volume->VolGroup;
+    } // switch
+} // static EFI_GUID * VolumeKeyGuid()
+
+static
+UINT32 HashKey (
+    IN UINTN  KeyType,
+    IN VOID  *Key
+) {
+    switch (KeyType) {
+        case VOLUME_KEY_HANDLE: return HashBytes (&Key, sizeof (Key));
+        case VOLUME_KEY_NAME:   return HashName (Key);
+        default:                return HashBytes (Key, sizeof (EFI_GUID));
+    } // switch
+} // static UINT32 HashKey()
+
+static
+BOOLEAN VolumeHasKey (
+    IN REFIT_VOLUME *Volume,
+    IN UINTN         KeyType,
+    IN VOID         *Key
+) {
+    switch (KeyType) {
+        case VOLUME_KEY_HANDLE:
+            return (Volume->DeviceHandle == (EFI_HANDLE) Key);
+        case VOLUME_KEY_NAME:
+            return (
+                MyStriCmp (Key, GetPoolStr (&Volume->VolName))  ||
+                MyStriCmp (Key, GetPoolStr (&Volume->PartName)) ||
+                MyStriCmp (Key, GetPoolStr (&Volume->FsName))
+            );
+        default:
+            return GuidsAreEqual (VolumeKeyGuid (Volume, KeyType), (EFI_GUID *) Key);
+    } // switch
+} // static BOOLEAN VolumeHasKey()
+
+static
+VOID VolumeIndexInsert (
+    IN OUT VOLUME_INDEX *Index,
+    IN     UINTN         KeyType,
+    IN     VOID         *Key,
+    IN     UINTN         Position
+) {
+    UINT32  *Table = Index->Tables[KeyType];
+    UINTN    Mask  = Index->TableSize - 1;
+    UINTN    Slot;
+
+    Slot = HashKey (KeyType, Key) & Mask;
+    while (Table[Slot] != 0) {
+        Slot = (Slot + 1) & Mask;
+    }
+    Table[Slot] = (UINT32) (Position + 1);
+} // static VOID VolumeIndexInsert()
+
+static
+VOID VolumeIndexRelease (
+    IN OUT VOLUME_INDEX *Index
+) {
+    UINTN KeyType;
+
+    for (KeyType = 0; KeyType < VOLUME_KEY_COUNT; KeyType++) {
+        MY_FREE_POOL(Index->Tables[KeyType]);
+    }
+    ZeroMem (Index, sizeof (VOLUME_INDEX));
+} // static VOID VolumeIndexRelease()
+
+static
+BOOLEAN VolumeIndexBuild (
+    IN OUT VOLUME_INDEX  *Index,
+    IN     REFIT_VOLUME **List,
+    IN     UINTN          ListCount
+) {
+    REFIT_VOLUME  *Volume;
+    CHAR16        *Names[3];
+    UINTN          KeyType;
+    UINTN          i, j;
+
+    VolumeIndexRelease (Index);
+
+    // Room for the three names of every volume at half load or less
+    Index->TableSize = 16;
+    while (Index->TableSize < ListCount * 3 * 2) {
+        Index->TableSize <<= 1;
+    }
+
+    for (KeyType = 0; KeyType < VOLUME_KEY_COUNT; KeyType++) {
+        Index->Tables[KeyType] = AllocateZeroPool (Index->TableSize * sizeof (UINT32));
+        if (Index->Tables[KeyType] == NULL) {
+            VolumeIndexRelease (Index);
+
+            return FALSE;
+        }
+    }
+
+    for (i = 0; i < ListCount; i++) {
+        Volume = List[i];
+        if (Volume == NULL) {
+            continue;
+        }
+
+        VolumeIndexInsert (Index, VOLUME_KEY_HANDLE,    Volume->DeviceHandle, i);
+        VolumeIndexInsert (Index, VOLUME_KEY_PART_GUID, &Volume->PartGuid,    i);
+        VolumeIndexInsert (Index, VOLUME_KEY_VOL_UUID,  &Volume->VolUuid,     i);
+        VolumeIndexInsert (Index, VOLUME_KEY_VOL_GROUP, &Volume->VolGroup,    i);
+
+        Names[0] = GetPoolStr (&Volume->VolName);
+        Names[1] = GetPoolStr (&Volume->PartName);
+        Names[2] = GetPoolStr (&Volume->FsName);
+        for (j = 0; j < 3; j++) {
+            if (Names[j] != NULL) {
+                VolumeIndexInsert (Index, VOLUME_KEY_NAME, Names[j], i);
+            }
+        }
+    } // for i = 0
+
+    Index->List       = List;
+    Index->ListCount  = ListCount;
+    Index->Generation = VolumeIndexGeneration;
+
+    return TRUE;
+} // static BOOLEAN VolumeIndexBuild()
+
+// Returns the first volume in List whose KeyType key matches Key, or NULL.
+// Key is the EFI_HANDLE itself for VOLUME_KEY_HANDLE, a CHAR16 string for
+// VOLUME_KEY_NAME and an EFI_GUID pointer otherwise.
+REFIT_VOLUME * VolumeIndexFind (
+    IN REFIT_VOLUME **List,
+    IN UINTN          ListCount,
+    IN UINTN          KeyType,
+    IN VOID          *Key
+) {
+    VOLUME_INDEX  *Index = NULL;
+    UINT32        *Table;
+    UINTN          Mask;
+    UINTN          Slot;
+    UINTN          Position;
+    UINTN          Found;
+    UINTN          i;
+
+    if (List == NULL || ListCount == 0 || KeyType >= VOLUME_KEY_COUNT ||
+        (Key == NULL && KeyType != VOLUME_KEY_HANDLE)
+    ) {
+        return NULL;
+    }
+
+    for (i = 0; i < VOLUME_INDEX_SLOTS; i++) {
+        if (VolumeIndexes[i].List == List) {
+            Index = &VolumeIndexes[i];
+            break;
+        }
+    }
+
+    if (Index == NULL) {
+        Index = &VolumeIndexes[VolumeIndexNext];
+        VolumeIndexNext = (VolumeIndexNext + 1) % VOLUME_INDEX_SLOTS;
+    }
+
+    if (Index->List       != List      ||
+        Index->ListCount  != ListCount ||
+        Index->Generation != VolumeIndexGeneration
+    ) {
+        if (!VolumeIndexBuild (Index, List, ListCount)) {
+            // Fall back on a plain search
+            for (i = 0; i < ListCount; i++) {
+                if (List[i] != NULL && VolumeHasKey (List[i], KeyType, Key)) {
+                    return List[i];
+                }
+            }
+
+            return NULL;
+        }
+    }
+
+    // Entries for a key are not in list order, so check the whole run
+    Table = Index->Tables[KeyType];
+    Mask  = Index->TableSize - 1;
+    Found = ListCount;
+    for (Slot = HashKey (KeyType, Key) & Mask; Table[Slot] != 0; Slot = (Slot + 1) & Mask) {
+        Position = Table[Slot] - 1;
+        if (Position < Found && VolumeHasKey (List[Position], KeyType, Key)) {
+            Found = Position;
+        }
+    }
+
+    return (Found < ListCount) ? List[Found] : NULL;
+} // REFIT_VOLUME * VolumeIndexFind()
+
+// Drops the index kept for List, if any, when the list is changed or freed.
+VOID VolumeIndexForget (
+    IN REFIT_VOLUME **List
+) {
+    UINTN i;
+
+    if (List == NULL) {
+        return;
+    }
+
+    for (i = 0; i < VOLUME_INDEX_SLOTS; i++) {
+        if (VolumeIndexes[i].List == List) {
+            VolumeIndexRelease (&VolumeIndexes[i]);
+        }
+    }
+} // VOID VolumeIndexForget()
+
+// Makes every index be rebuilt on its next use. Call after changing the
+// handles, GUIDs or names of volumes already in a list.
+VOID VolumeIndexInvalidate (VOID) {
+    VolumeIndexGeneration++;
+} // VOID VolumeIndexInvalidate()
+
+// Sets up Set to hold Capacity GUIDs. The null GUID is never a member.
+BOOLEAN GuidSetInit (
+    OUT GUID_SET *Set,
+    IN  UINTN     Capacity
+) {
+    Set->Count = 0;
+    Set->Size  = 16;
+    while (Set->Size < Capacity * 2) {
+        Set->Size <<= 1;
+    }
+
+    Set->Guids = AllocateZeroPool (Set->Size * sizeof (EFI_GUID));
+
+    return (Set->Guids != NULL);
+} // BOOLEAN GuidSetInit()
+
+static
+UINTN GuidSetSlot (
+    IN GUID_SET *Set,
+    IN EFI_GUID *Guid
+) {
+    UINTN     Mask     = Set->Size - 1;
+    UINTN     Slot;
+    EFI_GUID  NullGuid = NULL_GUID_VALUE;
+
+    Slot = HashBytes (Guid, sizeof (EFI_GUID)) & Mask;
+    while (!GuidsAreEqual (&Set->Guids[Slot], &NullGuid) &&
+        !GuidsAreEqual (&Set->Guids[Slot], Guid)
+    ) {
+        Slot = (Slot + 1) & Mask;
+    }
+
+    return Slot;
+} // static UINTN GuidSetSlot()
+
+// Returns TRUE if Guid is a member of Set.
+BOOLEAN GuidSetContains (
+    IN GUID_SET *Set,
+    IN EFI_GUID *Guid
+) {
+    EFI_GUID NullGuid = NULL_GUID_VALUE;
+
+    if (Set->Guids == NULL || GuidsAreEqual (Guid, &NullGuid)) {
+        return FALSE;
+    }
+
+    return GuidsAreEqual (&Set->Guids[GuidSetSlot (Set, Guid)], Guid);
+} // BOOLEAN GuidSetContains()
+
+// Adds Guid to Set, unless Set is full.
+// Returns TRUE if Guid is a member of Set afterwards.
+BOOLEAN GuidSetAdd (
+    IN OUT GUID_SET *Set,
+    IN     EFI_GUID *Guid
+) {
+    UINTN     Slot;
+    EFI_GUID  NullGuid = NULL_GUID_VALUE;
+
+    if (Set->Guids == NULL || GuidsAreEqual (Guid, &NullGuid)) {
+        return FALSE;
+    }
+
+    Slot = GuidSetSlot (Set, Guid);
+    if (!GuidsAreEqual (&Set->Guids[Slot], Guid)) {
+        if (Set->Count * 2 >= Set->Size) {
+            return FALSE;
+        }
+
+        Set->Guids[Slot] = *Guid;
+        Set->Count++;
+    }
+
+    return TRUE;
+} // BOOLEAN GuidSetAdd()
+
+VOID GuidSetFree (
+    IN OUT GUID_SET *Set
+) {
+    MY_FREE_POOL(Set->Guids);
+    Set->Size  = 0;
+    Set->Count = 0;
+} // VOID GuidSetFree()
+
+/* EOF */
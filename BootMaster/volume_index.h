@@ -0,0 +1,65 @@
+/*
+ * BootMaster/volume_index.h
+ * Hash indexes over volume lists
+ *
+ * Distributed under the terms of the GNU General Public License (GPL)
+ * version 3 (GPLv3), or (at your option) any later version.
+ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __VOLUME_INDEX_H_
+#define __VOLUME_INDEX_H_
+
+#ifdef __MAKEWITH_GNUEFI
+#include "efi.h"
+#include "efilib.h"
+#else
+#include "../include/tiano_includes.h"
+#endif
+#include "global.h"
+
+// Keys a volume list can be searched by
+#define VOLUME_KEY_HANDLE     0   // DeviceHandle
+#define VOLUME_KEY_PART_GUID  1   // PartGuid
+#define VOLUME_KEY_VOL_UUID   2   // VolUuid
+#define VOLUME_KEY_VOL_GROUP  3   // VolGroup
+#define VOLUME_KEY_NAME       4   // VolName, PartName or FsName, as MyStriCmp() matches them
+#define VOLUME_KEY_COUNT      5
+
+// Open-addressed set of GUIDs
+typedef struct {
+    EFI_GUID  *Guids;
+    UINTN      Size;
+    UINTN      Count;
+} GUID_SET;
+
+REFIT_VOLUME * VolumeIndexFind (
+    IN REFIT_VOLUME **List,
+    IN UINTN          ListCount,
+    IN UINTN          KeyType,
+    IN VOID          *Key
+);
+VOID VolumeIndexForget (IN REFIT_VOLUME **List);
+VOID VolumeIndexInvalidate (VOID);
+
+BOOLEAN GuidSetInit (OUT GUID_SET *Set, IN UINTN Capacity);
+BOOLEAN GuidSetAdd (IN OUT GUID_SET *Set, IN EFI_GUID *Guid);
+BOOLEAN GuidSetContains (IN GUID_SET *Set, IN EFI_GUID *Guid);
+VOID GuidSetFree (IN OUT GUID_SET *Set);
+
+#endif
+
+/* EOF */
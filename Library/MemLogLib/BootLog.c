@@ -37,7 +37,19 @@ extern  INT16  NowMinute;
 extern  INT16  NowSecond;
 
 BOOLEAN  TimeStamp = TRUE;
-BOOLEAN  UseMsgLog = FALSE;
+
+// Log file sink ... output is staged in memory and written out in large blocks
+#define BOOT_LOG_BUFFER_SIZE     (256 * 1024)
+#define BOOT_LOG_FLUSH_SIZE      (192 * 1024)
+#define BOOT_LOG_FLUSH_INTERVAL  1000 // milliseconds
+
+static EFI_FILE_PROTOCOL  *BootLogFile          = NULL;
+static BOOLEAN             BootLogFileFailed    = FALSE;
+static CHAR8              *BootLogBuffer        = NULL;
+static UINTN               BootLogBufferLen     = 0;
+static UINTN               BootLogDropped       = 0;
+static UINT64              BootLogLastFlush     = 0;
+static BOOLEAN             BootLogInFlush       = FALSE;
 
 static
 CHAR16 * GetAltMonth (VOID) {
@@ -216,105 +228,271 @@ EFI_FILE_PROTOCOL * GetDebugLogFile (VOID) {
     return LogFile;
 } // static EFI_FILE_PROTOCOL * GetDebugLogFile()
 
+// Opens the log file once and keeps the handle positioned at EOF.
+// A failed open is not retried until the sink is closed.
+static
+EFI_FILE_PROTOCOL * OpenBootLogFile (VOID) {
+    EFI_FILE_INFO *Info;
+
+    if (BootLogFile != NULL || BootLogFileFailed) {
+        return BootLogFile;
+    }
+
+    BootLogFile = GetDebugLogFile();
+    if (BootLogFile == NULL) {
+        BootLogFileFailed = TRUE;
+
+        return NULL;
+    }
+
+    // Advance to the EOF so we append
+    LEAKABLEEXTERNALSTART (kLeakableWhatSaveMessageToDebugLogFile);
+    Info = EfiLibFileInfo (BootLogFile);
+    if (Info) {
+        REFIT_CALL_2_WRAPPER(BootLogFile->SetPosition, BootLogFile, Info->FileSize);
+        MY_FREE_POOL(Info);
+    }
+    else {
+        REFIT_CALL_1_WRAPPER(BootLogFile->Close, BootLogFile);
+        BootLogFile       = NULL;
+        BootLogFileFailed = TRUE;
+    }
+    LEAKABLEEXTERNALSTOP ();
+
+    return BootLogFile;
+} // static EFI_FILE_PROTOCOL * OpenBootLogFile()
+
+static
+UINTN WriteBootLogFile (
+    IN CHAR8 *Text,
+    IN UINTN  TextLen
+) {
+    if (TextLen == 0 || OpenBootLogFile() == NULL) {
+        return 0;
+    }
+
+    LEAKABLEEXTERNALSTART (kLeakableWhatSaveMessageToDebugLogFile);
+    REFIT_CALL_3_WRAPPER(BootLogFile->Write, BootLogFile, &TextLen, Text);
+    LEAKABLEEXTERNALSTOP ();
+
+    return TextLen;
+} // static UINTN WriteBootLogFile()
+
+// Writes out staged output and any note of dropped messages.
+// Opening the file can log or free memory, so a nested call does nothing.
+static
+VOID DrainBootLogBuffer (VOID) {
+    CHAR8 DropNote[80];
+
+    if (BootLogInFlush) {
+        return;
+    }
+    BootLogInFlush = TRUE;
+
+    WriteBootLogFile (BootLogBuffer, BootLogBufferLen);
+    BootLogBufferLen = 0;
+
+    if (BootLogDropped > 0) {
+        AsciiSPrint (
+            DropNote, sizeof (DropNote),
+            "\n** Log Buffer Full ... Dropped %d Messages **\n\n",
+            BootLogDropped
+        );
+        WriteBootLogFile (DropNote, AsciiStrLen (DropNote));
+        BootLogDropped = 0;
+    }
+
+    BootLogLastFlush = GetCurrentMS();
+    BootLogInFlush   = FALSE;
+} // static VOID DrainBootLogBuffer()
+
+// Whether enough output is staged, or enough time has passed, to write it out
+static
+BOOLEAN BootLogWriteDue (VOID) {
+    return (
+        BootLogBufferLen >= BOOT_LOG_FLUSH_SIZE
+        || GetCurrentMS() - BootLogLastFlush >= BOOT_LOG_FLUSH_INTERVAL
+    );
+} // static BOOLEAN BootLogWriteDue()
+
 static
 UINTN SaveMessageToDebugLogFile (
     IN CHAR8 *LastMessage
 ) {
-    UINTN BytesWritten = 0;
     UINTN TextLen = AsciiStrLen(LastMessage);
-    EFI_FILE_HANDLE LogFile = GetDebugLogFile();
 
-    // Write to the log file
-    if (LogFile != NULL) {
-        LEAKABLEEXTERNALSTART (kLeakableWhatSaveMessageToDebugLogFile);
-        // Advance to the EOF so we append
-        EFI_FILE_INFO *Info = EfiLibFileInfo (LogFile);
-        if (Info) {
-            LogFile->SetPosition (LogFile, Info->FileSize);
-
-            // Write out this message
-            LogFile->Write (LogFile, &TextLen, LastMessage);
-            BytesWritten = TextLen;
-            MY_FREE_POOL(Info);
+    if (GlobalConfig.LogLevel < 0 || TextLen == 0) {
+        return 0;
+    }
+
+    if (BootLogBuffer == NULL) {
+        BootLogBuffer = AllocatePool (BOOT_LOG_BUFFER_SIZE);
+        if (BootLogBuffer == NULL) {
+            // Unbuffered fallback
+            return WriteBootLogFile (LastMessage, TextLen);
         }
+        LEAKABLE (BootLogBuffer, "BootLogBuffer");
+        BootLogLastFlush = GetCurrentMS();
+    }
 
-        LogFile->Close (LogFile);
-        LEAKABLEEXTERNALSTOP ();
+    // The text is reported as taken even when it is dropped, as MemLog
+    // would otherwise hand it back on every later message
+    if (BootLogInFlush) {
+        // Logged while the buffer is being written out
+        BootLogDropped++;
+
+        return TextLen;
     }
 
-    return BytesWritten;
-} // static VOID SaveMessageToDebugLogFile()
+    if (BootLogBufferLen + TextLen > BOOT_LOG_BUFFER_SIZE) {
+        if (GlobalConfig.LogDropWhenFull && !BootLogWriteDue()) {
+            // Do not stall on the file system ... keep what is staged
+            BootLogDropped++;
 
-VOID EFIAPI DeepLoggger (
-    IN INTN     DebugMode,
-    IN INTN     level,
-    IN INTN     type,
-    IN CHAR16 **Msg
-) {
-    UINTN   Limit     = 225;
-    CHAR8  *FormatMsg = NULL;
-    CHAR16 *Tmp       = NULL;
+            return TextLen;
+        }
 
+        DrainBootLogBuffer();
 
-    // Make sure we are able to write
-    if (DONTLOG(DebugMode, level, *Msg)) {
-        MY_FREE_POOL(*Msg);
+        if (TextLen > BOOT_LOG_BUFFER_SIZE) {
+            if (WriteBootLogFile (LastMessage, TextLen) == 0) {
+                BootLogDropped++;
+            }
 
-        return;
+            return TextLen;
+        }
     }
 
-    // Truncate message at Log Levels 3 and lower (if required)
-    if (GlobalConfig.LogLevel < 4 && TruncateString (*Msg, Limit)) {
-        CHAR16 *StoreMsg = PoolPrint (L"%s ... Snipped!!", *Msg);
-        MY_FREE_POOL(*Msg);
-        *Msg = StoreMsg;
+    CopyMem (BootLogBuffer + BootLogBufferLen, LastMessage, TextLen);
+    BootLogBufferLen += TextLen;
+
+    if (BootLogWriteDue()) {
+        DrainBootLogBuffer();
     }
 
-    // Disable Timestamp
-    TimeStamp = FALSE;
+    return TextLen;
+} // static VOID SaveMessageToDebugLogFile()
+
+// Formats straight into the MemLog buffer ... callers (the LOG macros)
+// check the level first so suppressed lines cost nothing
+static
+VOID DeepLogVA (
+    IN INTN          DebugMode,
+    IN INTN          type,
+    IN const CHAR16 *InnerPrefix,
+    IN const CHAR16 *InnerSuffix,
+    IN const CHAR16 *Format,
+    IN VA_LIST       Marker
+) {
+    BOOLEAN  Timing = FALSE;
+    CHAR16  *Prefix = L"";
+    CHAR16  *Suffix = L"";
+    CHAR16   Lead[64];
+    CHAR16   Tail[64];
 
     switch (type) {
-        case LOG_BLANK_LINE_SEP: Tmp = StrDuplicate (L"\n");                                                    break;
-        case LOG_STAR_HEAD_SEP:  Tmp = PoolPrint (L"\n                ***[ %s ]\n",                      *Msg); break;
-        case LOG_STAR_SEPARATOR: Tmp = PoolPrint (L"\n* ** ** *** *** ***[ %s ]*** *** *** ** ** *\n\n", *Msg); break;
-        case LOG_LINE_SEPARATOR: Tmp = PoolPrint (L"\n===================[ %s ]===================\n",   *Msg); break;
-        case LOG_LINE_THIN_SEP:  Tmp = PoolPrint (L"\n-------------------[ %s ]-------------------\n",   *Msg); break;
-        case LOG_LINE_DASH_SEP:  Tmp = PoolPrint (L"\n- - - - - - - - - -[ %s ]- - - - - - - - - -\n",   *Msg); break;
-        case LOG_THREE_STAR_SEP: Tmp = PoolPrint (L"\n. . . . . . . . ***[ %s ]*** . . . . . . . .\n",   *Msg); break;
-        case LOG_THREE_STAR_END: Tmp = PoolPrint (  L"                ***[ %s ]***\n\n",                 *Msg); break;
-        case LOG_THREE_STAR_MID: Tmp = PoolPrint (  L"                ***[ %s ]\n",                      *Msg); break;
-        case LOG_LINE_FORENSIC:  Tmp = PoolPrint (  L"            !!! ---[ %s ]\n",                      *Msg); break;
-        case LOG_LINE_SPECIAL:   Tmp = PoolPrint (L"\n                     %s",                          *Msg); break;
-        case LOG_LINE_SAME:      Tmp = PoolPrint (  L"%s",                                               *Msg); break;
-        default:                 Tmp = PoolPrint (  L"%s\n",                                             *Msg);
+        case LOG_BLANK_LINE_SEP: Prefix = L"\n"; Format = NULL; InnerPrefix = InnerSuffix = NULL;           break;
+        case LOG_STAR_HEAD_SEP:  Prefix = L"\n                ***[ "; Suffix = L" ]\n";                       break;
+        case LOG_STAR_SEPARATOR: Prefix = L"\n* ** ** *** *** ***[ "; Suffix = L" ]*** *** *** ** ** *\n\n"; break;
+        case LOG_LINE_SEPARATOR: Prefix = L"\n===================[ "; Suffix = L" ]===================\n";  break;
+        case LOG_LINE_THIN_SEP:  Prefix = L"\n-------------------[ "; Suffix = L" ]-------------------\n";  break;
+        case LOG_LINE_DASH_SEP:  Prefix = L"\n- - - - - - - - - -[ "; Suffix = L" ]- - - - - - - - - -\n";  break;
+        case LOG_THREE_STAR_SEP: Prefix = L"\n. . . . . . . . ***[ "; Suffix = L" ]*** . . . . . . . .\n";  break;
+        case LOG_THREE_STAR_END: Prefix =   L"                ***[ "; Suffix = L" ]***\n\n";              break;
+        case LOG_THREE_STAR_MID: Prefix =   L"                ***[ "; Suffix = L" ]\n";                  break;
+        case LOG_LINE_FORENSIC:  Prefix =   L"            !!! ---[ "; Suffix = L" ]\n";                  break;
+        case LOG_LINE_SPECIAL:   Prefix = L"\n                     ";                                     break;
+        case LOG_LINE_SAME:                                                                            break;
+        default:                                                     Suffix = L"\n";
             // Should be 'LOG_LINE_NORMAL', but use 'default' so as to also catch coding errors
             // Enable Timestamp for this
-            TimeStamp = TRUE;
+            Timing = TRUE;
     } // switch
 
-    if (Tmp) {
-        FormatMsg = AllocatePool (
-            (StrLen (Tmp) + 1) * sizeof (CHAR8)
-        );
+    if (InnerPrefix != NULL && InnerPrefix[0] != L'\0') {
+        StrCpyS (Lead, sizeof (Lead) / sizeof (CHAR16), Prefix);
+        StrCatS (Lead, sizeof (Lead) / sizeof (CHAR16), InnerPrefix);
+        Prefix = Lead;
+    }
+    if (InnerSuffix != NULL && InnerSuffix[0] != L'\0') {
+        StrCpyS (Tail, sizeof (Tail) / sizeof (CHAR16), InnerSuffix);
+        StrCatS (Tail, sizeof (Tail) / sizeof (CHAR16), Suffix);
+        Suffix = Tail;
+    }
 
-        if (FormatMsg) {
-            // Use Native Logging
-            UseMsgLog = TRUE;
+    // Truncate message at Log Levels 3 and lower (if required)
+    MemLogUnicodeVA (
+        Timing, DebugMode,
+        Prefix, Format, Suffix,
+        (GlobalConfig.LogLevel < 4) ? 225 : 0,
+        Marker
+    );
+} // static VOID DeepLogVA()
 
-            // Write the Message String to File
-            UnicodeStrToAsciiStr (Tmp, FormatMsg);
-            DebugLog (DebugMode, (const CHAR8 *) FormatMsg);
+VOID EFIAPI DeepLoggger (
+    IN INTN          DebugMode,
+    IN INTN          level,
+    IN INTN          type,
+    IN const CHAR16 *Format,
+    ...
+) {
+    VA_LIST Marker;
 
-            // Disable Native Logging
-            UseMsgLog = FALSE;
-        }
+    // Make sure we are able to write
+    if (DONTLOG(DebugMode, level, Format)) {
+        return;
     }
 
-    MY_FREE_POOL(*Msg);
-    MY_FREE_POOL(Tmp);
-    MY_FREE_POOL(FormatMsg);
+    VA_START(Marker, Format);
+    DeepLogVA (DebugMode, type, NULL, NULL, Format, Marker);
+    VA_END(Marker);
 } // VOID EFIAPI DeepLoggger()
 
+// As DeepLoggger, with extra text inside the decoration for 'type'
+VOID EFIAPI DeepLogggerAffixed (
+    IN INTN          DebugMode,
+    IN INTN          level,
+    IN INTN          type,
+    IN const CHAR16 *Prefix,
+    IN const CHAR16 *Suffix,
+    IN const CHAR16 *Format,
+    ...
+) {
+    VA_LIST Marker;
+
+    // Make sure we are able to write
+    if (DONTLOG(DebugMode, level, Format)) {
+        return;
+    }
+
+    VA_START(Marker, Format);
+    DeepLogVA (DebugMode, type, Prefix, Suffix, Format, Marker);
+    VA_END(Marker);
+} // VOID EFIAPI DeepLogggerAffixed()
+
+// Writes a native format line (as MsgLog does) with a Unicode format string
+// and optional text around it ... used by the LOG2/LOG3/LOG4 macros
+VOID EFIAPI DebugLogAffixed (
+    IN INTN          DebugMode,
+    IN const CHAR16 *Prefix,
+    IN const CHAR16 *Suffix,
+    IN const CHAR16 *Format,
+    ...
+) {
+    VA_LIST Marker;
+
+    // Make sure writing is allowed/possible
+    if (DONTMSG(DebugMode, Format)) {
+        return;
+    }
+
+    VA_START(Marker, Format);
+    MemLogUnicodeVA (TimeStamp, DebugMode, Prefix, Format, Suffix, 0, Marker);
+    VA_END(Marker);
+
+    TimeStamp = TRUE;
+} // VOID EFIAPI DebugLogAffixed()
+
 VOID EFIAPI DebugLog (
     IN INTN DebugMode,
     IN const CHAR8 *FormatString,
@@ -326,10 +504,6 @@ VOID EFIAPI DebugLog (
         return;
     }
 
-    if (!UseMsgLog) {
-        UseMsgLog = NativeLogger;
-    }
-
     // Print message to log buffer
     VA_LIST Marker;
     VA_START(Marker, FormatString);
@@ -350,6 +524,19 @@ UINTN EFIAPI Debug1BootLogMemLogCallback (
     return BytesWritten;
 }
 
+static
+VOID CloseBootLogFile (VOID) {
+    if (BootLogFile != NULL) {
+        LEAKABLEEXTERNALSTART (kLeakableWhatSaveMessageToDebugLogFile);
+        REFIT_CALL_1_WRAPPER(BootLogFile->Close, BootLogFile);
+        LEAKABLEEXTERNALSTOP ();
+        BootLogFile = NULL;
+    }
+
+    // Allow a fresh attempt after file handles are reopened
+    BootLogFileFailed = FALSE;
+} // static VOID CloseBootLogFile()
+
 // DBG Build Only - END
 #endif
 
@@ -374,6 +561,32 @@ BOOLEAN BootLogIsPaused (
     return MemLogCallbackIsPaused (Debug1BooterLogCallbackIndex);
 }
 
+// Writes staged log output to the log file
+VOID BootLogFlush (VOID) {
+    #if REFIT_DEBUG > 0
+    if (BootLogBufferLen == 0 && BootLogDropped == 0) {
+        return;
+    }
+
+    DrainBootLogBuffer();
+
+    if (BootLogFile != NULL) {
+        LEAKABLEEXTERNALSTART (kLeakableWhatSaveMessageToDebugLogFile);
+        REFIT_CALL_1_WRAPPER(BootLogFile->Flush, BootLogFile);
+        LEAKABLEEXTERNALSTOP ();
+    }
+    #endif
+} // VOID BootLogFlush()
+
+// Writes staged log output and releases the log file handle
+// before control is handed elsewhere (StartImage, ResetSystem)
+VOID BootLogClose (VOID) {
+    #if REFIT_DEBUG > 0
+    BootLogFlush();
+    CloseBootLogFile();
+    #endif
+} // VOID BootLogClose()
+
 INTN BootLogPause (
 ) {
     return PauseMemLogCallback (Debug1BooterLogCallbackIndex);
@@ -386,6 +599,10 @@ VOID BootLogResume (
 
 VOID InitBooterLog (VOID) {
     #if REFIT_DEBUG > 0
+    // The log file holds the full log, so keep logging in long sessions
+    // by recycling the oldest text once the usual limit is reached
+    SetMemLogKeepSize (MEM_LOG_MAX_SIZE);
+
     Debug2BooterLogCallbackIndex = SetMemLogCallback (Debug2BootLogMemLogCallback);
     Debug1BooterLogCallbackIndex = SetMemLogCallback (Debug1BootLogMemLogCallback);
     #endif
@@ -24,6 +24,18 @@ BootLogPause (
 );
 
 
+VOID
+BootLogFlush (
+    VOID
+);
+
+
+VOID
+BootLogClose (
+    VOID
+);
+
+
 VOID
 BootLogResume (
 );
@@ -32,10 +44,32 @@ BootLogResume (
 VOID
 EFIAPI
 DeepLoggger (
-    IN INTN     DebugMode,
-    IN INTN     level,
-    IN INTN     type,
-    IN CHAR16 **Message
+    IN INTN          DebugMode,
+    IN INTN          level,
+    IN INTN          type,
+    IN CONST CHAR16 *Format, ...
+);
+
+
+VOID
+EFIAPI
+DeepLogggerAffixed (
+    IN INTN          DebugMode,
+    IN INTN          level,
+    IN INTN          type,
+    IN CONST CHAR16 *Prefix,
+    IN CONST CHAR16 *Suffix,
+    IN CONST CHAR16 *Format, ...
+);
+
+
+VOID
+EFIAPI
+DebugLogAffixed (
+    IN INTN          DebugMode,
+    IN CONST CHAR16 *Prefix,
+    IN CONST CHAR16 *Suffix,
+    IN CONST CHAR16 *Format, ...
 );
 
 
@@ -42,16 +42,29 @@
 // Struct for holding mem buffer.
 #define MAX_CALLBACKS 5
 
+// Log text is held in a list of fixed size chunks. Messages never move once
+// written and each chunk is NUL terminated where its text ends.
+typedef struct _MEM_LOG_CHUNK {
+    struct _MEM_LOG_CHUNK  *Next;
+    UINTN                   Used;
+    CHAR8                   Data[MEM_LOG_CHUNK_SIZE];
+} MEM_LOG_CHUNK;
+
 typedef struct {
     INTN              cbPause;
+    MEM_LOG_CHUNK     *cbChunk;
     CHAR8             *cbPos;
     MEM_LOG_CALLBACK  Callback;
 } MEM_LOG_CB_INFO;
 
 typedef struct {
-    CHAR8             *Buffer;
+    MEM_LOG_CHUNK     *Head;
+    MEM_LOG_CHUNK     *Tail;
     CHAR8             *Cursor;
-    UINTN             BufferSize;
+    UINTN             ChunkCount;
+    UINTN             Length;
+    UINTN             KeepSize;
+    CHAR8             LastChar;
     UINTN             CallbacksCount;
     MEM_LOG_CB_INFO   Callbacks[MAX_CALLBACKS];
 
@@ -65,8 +78,9 @@ typedef struct {
 
 
 // Guid for internal protocol for publishing mem log buffer.
-EFI_GUID  mMemLogProtocolGuid = { 0x74B91DA4, 0x2B4C, 0x11E2, \
-    { 0x99, 0x03, 0x22, 0xF0, 0x61, 0x88, 0x70, 0x9B } };
+// NB: Changed from the Clover value as the MEM_LOG layout differs
+EFI_GUID  mMemLogProtocolGuid = { 0xA6D0C34E, 0x0A18, 0x4FF5, \
+    { 0x9A, 0x35, 0xE6, 0xE9, 0x44, 0xC4, 0xC7, 0xC7 } };
 
 // Pointer to mem log buffer.
 MEM_LOG   *mMemLog = NULL;
@@ -74,6 +88,9 @@ MEM_LOG   *mMemLog = NULL;
 // Buffer for debug time.
 CHAR8     mTimingTxt[32];
 
+// Space left in the chunk being written to
+#define MEM_LOG_ROOM() (MEM_LOG_CHUNK_SIZE - (UINTN) (mMemLog->Cursor - mMemLog->Tail->Data))
+
 
 UINT64 GetCurrentMS (VOID) {
     UINT64    CurrentMS  = 0;
@@ -215,13 +232,14 @@ EFI_STATUS EFIAPI MemLogInit (VOID) {
         return EFI_OUT_OF_RESOURCES;
     }
     LEAKABLE (mMemLog, "MemLogInit mMemLog");
-    mMemLog->Buffer = AllocateZeroPool (MEM_LOG_INITIAL_SIZE);
-    if (mMemLog->Buffer == NULL) {
+    mMemLog->Head = AllocateZeroPool (sizeof (MEM_LOG_CHUNK));
+    if (mMemLog->Head == NULL) {
         return EFI_OUT_OF_RESOURCES;
     }
-    LEAKABLE (mMemLog->Buffer, "mMemLog->Buffer");
-    mMemLog->BufferSize = MEM_LOG_INITIAL_SIZE;
-    mMemLog->Cursor     = mMemLog->Buffer;
+    LEAKABLE (mMemLog->Head, "mMemLog->Head");
+    mMemLog->Tail       = mMemLog->Head;
+    mMemLog->Cursor     = mMemLog->Head->Data;
+    mMemLog->ChunkCount = 1;
     SetMemLogCallback (StandardDebugMemLogCallback);
 
     // Calibrate TSC for timings
@@ -340,96 +358,117 @@ EFI_STATUS EFIAPI MemLogInit (VOID) {
     return Status;
 }
 
-/**
-  Prints a log message to memory buffer.
+// Frees the oldest chunk. Callbacks still reading it skip to the next one.
+static
+VOID MemLogDropHead (VOID) {
+    UINTN          cbIndex;
+    MEM_LOG_CHUNK *OldHead = mMemLog->Head;
 
-  @param  Timing      TRUE to prepend timing to log.
-  @param  DebugMode   DebugMode will be passed to Callback function if it is set.
-  @param  Format      The format string for the debug message to print.
-  @param  Marker      VA_LIST with variable arguments for Format.
-**/
-VOID EFIAPI MemLogVA (
-    IN  const BOOLEAN Timing,
-    IN  const INTN    DebugMode,
-    IN  const CHAR8   *Format,
-    IN  VA_LIST       Marker
+    if (OldHead->Next == NULL) {
+        return;
+    }
+
+    mMemLog->Head = OldHead->Next;
+    mMemLog->ChunkCount--;
+    mMemLog->Length -= OldHead->Used;
+
+    for (cbIndex = 0; cbIndex < mMemLog->CallbacksCount; cbIndex++) {
+        if (mMemLog->Callbacks[cbIndex].cbChunk == OldHead) {
+            mMemLog->Callbacks[cbIndex].cbChunk = mMemLog->Head;
+            mMemLog->Callbacks[cbIndex].cbPos   = mMemLog->Head->Data;
+        }
+    }
+
+    FreePool (OldHead);
+} // static VOID MemLogDropHead()
+
+// Starts a new chunk. Existing text is never copied or moved.
+// Past the size limit, the oldest chunks are freed in ring mode
+// and new messages are refused otherwise.
+static
+BOOLEAN MemLogAddChunk (VOID) {
+    MEM_LOG_CHUNK *Chunk;
+    UINTN          Limit = (mMemLog->KeepSize > 0) ? mMemLog->KeepSize : MEM_LOG_MAX_SIZE;
+
+    while ((mMemLog->ChunkCount + 1) * MEM_LOG_CHUNK_SIZE > Limit) {
+        if (mMemLog->KeepSize == 0 || mMemLog->Head == mMemLog->Tail) {
+            // Out of resources!
+            return FALSE;
+        }
+
+        MemLogDropHead();
+    }
+
+    // Do not log while allocating
+    mMemLogPause++;
+    Chunk = AllocatePool (sizeof (MEM_LOG_CHUNK));
+    mMemLogPause--;
+
+    if (Chunk == NULL) {
+        return FALSE;
+    }
+    LEAKABLE (Chunk, "MemLog Chunk");
+
+    Chunk->Next    = NULL;
+    Chunk->Used    = 0;
+    Chunk->Data[0] = '\0';
+
+    mMemLog->Tail->Next = Chunk;
+    mMemLog->Tail       = Chunk;
+    mMemLog->Cursor     = Chunk->Data;
+    mMemLog->ChunkCount++;
+
+    return TRUE;
+} // static BOOLEAN MemLogAddChunk()
+
+// Readies the buffer for a new message and writes any timing and indent.
+// The indent is taken from the brackets in whichever format is given.
+// Returns FALSE if the message is to be skipped.
+static
+BOOLEAN MemLogStart (
+    IN  const BOOLEAN  Timing,
+    IN  const CHAR8   *AsciiFormat,
+    IN  const CHAR16  *UnicodeFormat
 ) {
     EFI_STATUS      Status;
     UINTN           DataWritten;
     STATIC INTN     mLogIndent = 0;
-    UINTN           cbIndex;
 
     mMemLogMessageNumber++;
 
     if (mMemLogPause) {
         mMemLogSkippedMessages++;
-        return;
+        return FALSE;
     }
 
-    if (Format == NULL) {
+    if (AsciiFormat == NULL && UnicodeFormat == NULL) {
         mMemLogSkippedMessages++;
-        return;
+        return FALSE;
     }
 
     Status = MemLogInit ();
     if (EFI_ERROR(Status)) {
         mMemLogSkippedMessages++;
-        return;
+        return FALSE;
     }
 
-    // Check if buffer can accept MEM_LOG_MAX_LINE_SIZE chars.
-    // Increase buffer if not.
-    if ((UINTN)(mMemLog->Cursor - mMemLog->Buffer) + MEM_LOG_MAX_LINE_SIZE > mMemLog->BufferSize) {
-
-        // Pause all callbacks before resizing the buffer.
-        mMemLogPause++;
-        for (cbIndex = 0; cbIndex < mMemLog->CallbacksCount; cbIndex++) {
-            mMemLog->Callbacks[cbIndex].cbPause++;
-        }
-
-        // not enough place for max line - make buffer bigger
-        // but not too big (if something gets out of control)
-        if (mMemLog->BufferSize + MEM_LOG_INITIAL_SIZE > MEM_LOG_MAX_SIZE) {
-            // Out of resources!
-            mMemLogSkippedMessages++;
-            return;
-        }
-
-        CHAR8 * oldBuffer = mMemLog->Buffer;
-        mMemLog->Buffer = ReallocatePool (
-            mMemLog->BufferSize,
-            mMemLog->BufferSize + MEM_LOG_INITIAL_SIZE,
-            mMemLog->Buffer
-        );
-
-        if (mMemLog->Buffer == NULL) {
-            mMemLogSkippedMessages++;
-            return;
-        }
-
-        mMemLog->BufferSize += MEM_LOG_INITIAL_SIZE;
-        mMemLog->Cursor = mMemLog->Buffer + (mMemLog->Cursor - oldBuffer);
-
-        // Adjust all call back position pointers and resume.
-        for (cbIndex = 0; cbIndex < mMemLog->CallbacksCount; cbIndex++) {
-            mMemLog->Callbacks[cbIndex].cbPos = mMemLog->Buffer + (mMemLog->Callbacks[cbIndex].cbPos - oldBuffer);
-            mMemLog->Callbacks[cbIndex].cbPause--;
-        }
-        mMemLogPause--;
-
-        LEAKABLE (mMemLog->Buffer, "mMemLog->Buffer");
+    // Check if the current chunk can accept MEM_LOG_MAX_LINE_SIZE chars.
+    // Start a new chunk if not.
+    if (MEM_LOG_ROOM() < MEM_LOG_MAX_LINE_SIZE && !MemLogAddChunk()) {
+        mMemLogSkippedMessages++;
+        return FALSE;
     }
 
     BOOLEAN OutputIndent = FALSE;
     // Add log to buffer
     if (Timing) {
         // Write timing only when starting a new line
-        if ((mMemLog->Buffer[0] == '\0') || (mMemLog->Cursor[-1] == '\n')) {
+        if ((mMemLog->Length == 0) || (mMemLog->LastChar == '\n')) {
             OutputIndent = TRUE;
 
             DataWritten = AsciiSPrint(
                 mMemLog->Cursor,
-                mMemLog->BufferSize - (mMemLog->Cursor - mMemLog->Buffer),
+                MEM_LOG_ROOM(),
                 #if 1
                     "%a  ",
                     GetTiming ()
@@ -444,11 +483,22 @@ VOID EFIAPI MemLogVA (
 
     if (OutputIndent) {
         INTN indent = 0;
-        CONST CHAR8 *c;
-        for (c = Format; *c; c++) {
-            switch (*c) {
-                case '[': indent += 2; break;
-                case ']': indent -= 2; break;
+        if (AsciiFormat != NULL) {
+            CONST CHAR8 *c;
+            for (c = AsciiFormat; *c; c++) {
+                switch (*c) {
+                    case '[': indent += 2; break;
+                    case ']': indent -= 2; break;
+                }
+            }
+        }
+        else {
+            CONST CHAR16 *c;
+            for (c = UnicodeFormat; *c; c++) {
+                switch (*c) {
+                    case L'[': indent += 2; break;
+                    case L']': indent -= 2; break;
+                }
             }
         }
 
@@ -464,7 +514,7 @@ VOID EFIAPI MemLogVA (
         if (mLogIndent > 0) {
             DataWritten = AsciiSPrint(
                 mMemLog->Cursor,
-                mMemLog->BufferSize - (mMemLog->Cursor - mMemLog->Buffer),
+                MEM_LOG_ROOM(),
                 "%*a",
                 mLogIndent, ""
             );
@@ -481,29 +531,147 @@ VOID EFIAPI MemLogVA (
         }
     }
 
-    DataWritten = AsciiVSPrint (
-        mMemLog->Cursor,
-        mMemLog->BufferSize - (mMemLog->Cursor - mMemLog->Buffer),
-        Format,
-        Marker
-    );
-    mMemLog->Cursor += DataWritten;
+    return TRUE;
+} // static BOOLEAN MemLogStart()
+
+// Accounts for the new message and hands it to the callbacks
+static
+VOID MemLogFinish (
+    IN  const INTN DebugMode
+) {
+    UINTN            cbIndex;
+    UINTN            BytesWritten;
+    UINTN            Used = (UINTN) (mMemLog->Cursor - mMemLog->Tail->Data);
+    MEM_LOG_CB_INFO *cb;
+
+    mMemLog->Length    += Used - mMemLog->Tail->Used;
+    mMemLog->Tail->Used = Used;
+    if (Used > 0) {
+        mMemLog->LastChar = mMemLog->Cursor[-1];
+    }
 
     for (cbIndex = 0; cbIndex < mMemLog->CallbacksCount; cbIndex++) {
+        cb = &mMemLog->Callbacks[cbIndex];
         if (!PauseMemLogCallback (cbIndex)) {
             // Pass this last message to callback if defined
-            if (mMemLog->Callbacks[cbIndex].Callback != NULL) {
-                UINTN BytesWritten;
-                while (
-                    mMemLog->Callbacks[cbIndex].cbPos < mMemLog->Cursor
-                    && (BytesWritten = mMemLog->Callbacks[cbIndex].Callback (DebugMode, mMemLog->Callbacks[cbIndex].cbPos))
-                ) {
-                    mMemLog->Callbacks[cbIndex].cbPos += BytesWritten;
+            while (cb->Callback != NULL) {
+                if (cb->cbPos >= cb->cbChunk->Data + cb->cbChunk->Used) {
+                    if (cb->cbChunk->Next == NULL) {
+                        break;
+                    }
+                    cb->cbChunk = cb->cbChunk->Next;
+                    cb->cbPos   = cb->cbChunk->Data;
+                    continue;
                 }
+
+                BytesWritten = cb->Callback (DebugMode, cb->cbPos);
+                if (BytesWritten == 0) {
+                    break;
+                }
+                cb->cbPos += BytesWritten;
             }
         }
         ResumeMemLogCallback (cbIndex);
     }
+} // static VOID MemLogFinish()
+
+// Copies a UCS-2 string into the buffer as ASCII
+static
+VOID MemLogAppendUnicode (
+    IN  const CHAR16 *Text
+) {
+    UINTN Room = MEM_LOG_ROOM();
+
+    if (Text == NULL) {
+        return;
+    }
+
+    while (*Text != L'\0' && Room > 1) {
+        *mMemLog->Cursor++ = (CHAR8) *Text++;
+        Room--;
+    }
+    *mMemLog->Cursor = '\0';
+}
+
+/**
+  Prints a log message to memory buffer.
+
+  @param  Timing      TRUE to prepend timing to log.
+  @param  DebugMode   DebugMode will be passed to Callback function if it is set.
+  @param  Format      The format string for the debug message to print.
+  @param  Marker      VA_LIST with variable arguments for Format.
+**/
+VOID EFIAPI MemLogVA (
+    IN  const BOOLEAN Timing,
+    IN  const INTN    DebugMode,
+    IN  const CHAR8   *Format,
+    IN  VA_LIST       Marker
+) {
+    UINTN           DataWritten;
+
+    if (!MemLogStart (Timing, Format, NULL)) {
+        return;
+    }
+
+    DataWritten = AsciiVSPrint (
+        mMemLog->Cursor,
+        MEM_LOG_ROOM(),
+        Format,
+        Marker
+    );
+    mMemLog->Cursor += DataWritten;
+
+    MemLogFinish (DebugMode);
+}
+
+/**
+  Prints a log message with a Unicode format string to memory buffer as ASCII.
+
+  @param  Timing      TRUE to prepend timing to log.
+  @param  DebugMode   DebugMode will be passed to Callback function if it is set.
+  @param  Prefix      Optional text to write before the message.
+  @param  Format      The Unicode format string for the debug message to print.
+  @param  Suffix      Optional text to write after the message.
+  @param  Limit       Maximum message length before it is snipped (0 for no limit).
+  @param  Marker      VA_LIST with variable arguments for Format.
+**/
+VOID EFIAPI MemLogUnicodeVA (
+    IN  const BOOLEAN  Timing,
+    IN  const INTN     DebugMode,
+    IN  const CHAR16  *Prefix,
+    IN  const CHAR16  *Format,
+    IN  const CHAR16  *Suffix,
+    IN  const UINTN    Limit,
+    IN  VA_LIST        Marker
+) {
+    UINTN           DataWritten;
+
+    if (!MemLogStart (Timing, NULL, (Format != NULL) ? Format : L"")) {
+        return;
+    }
+
+    MemLogAppendUnicode (Prefix);
+
+    if (Format != NULL) {
+        DataWritten = AsciiVSPrintUnicodeFormat (
+            mMemLog->Cursor,
+            MEM_LOG_ROOM(),
+            Format,
+            Marker
+        );
+
+        if (Limit > 0 && DataWritten > Limit) {
+            mMemLog->Cursor += Limit;
+            MemLogAppendUnicode (L" ... Snipped!!");
+        }
+        else {
+            mMemLog->Cursor += DataWritten;
+        }
+    }
+
+    MemLogAppendUnicode (Suffix);
+
+    MemLogFinish (DebugMode);
 }
 
 /**
@@ -536,22 +704,44 @@ VOID EFIAPI MemLog (
 
 
 /**
- Returns pointer to MemLog buffer.
+ Steps through the text held in the mem log, one contiguous block at a time.
  **/
-CHAR8 * EFIAPI GetMemLogBuffer (VOID) {
+BOOLEAN EFIAPI MemLogIterNext (
+    IN OUT MEM_LOG_ITERATOR  *Iterator,
+    OUT    CHAR8            **Text,
+    OUT    UINTN             *Length
+) {
     EFI_STATUS        Status;
+    MEM_LOG_CHUNK    *Chunk;
 
     Status = MemLogInit();
-    if (EFI_ERROR(Status)) {
-        return NULL;
+    if (EFI_ERROR(Status) || Iterator == NULL) {
+        return FALSE;
+    }
+
+    Chunk = (Iterator->Chunk == NULL)
+        ? mMemLog->Head
+        : ((MEM_LOG_CHUNK *) Iterator->Chunk)->Next;
+
+    // Skip empty chunks
+    while (Chunk != NULL && Chunk->Used == 0) {
+        Chunk = Chunk->Next;
+    }
+
+    if (Chunk == NULL) {
+        return FALSE;
     }
 
-    return mMemLog != NULL ? mMemLog->Buffer : NULL;
+    Iterator->Chunk = Chunk;
+    *Text           = Chunk->Data;
+    *Length         = Chunk->Used;
+
+    return TRUE;
 }
 
 
 /**
- Returns the length of log (number of chars written) in mem buffer.
+ Returns the length of log (number of chars held) in mem buffer.
  **/
 UINTN EFIAPI GetMemLogLen (VOID) {
     EFI_STATUS        Status;
@@ -561,7 +751,31 @@ UINTN EFIAPI GetMemLogLen (VOID) {
         return 0;
     }
 
-    return mMemLog != NULL ? mMemLog->Cursor - mMemLog->Buffer : 0;
+    return mMemLog != NULL ? mMemLog->Length : 0;
+}
+
+
+/**
+ Keeps only about the last KeepSize bytes of the log, freeing older text
+ (ring mode). Zero keeps everything up to MEM_LOG_MAX_SIZE and then
+ refuses new messages.
+ **/
+VOID EFIAPI SetMemLogKeepSize (
+    IN UINTN KeepSize
+) {
+    EFI_STATUS        Status;
+
+    Status = MemLogInit();
+    if (EFI_ERROR(Status)) {
+        return;
+    }
+
+    if (KeepSize > 0 && KeepSize < 2 * MEM_LOG_CHUNK_SIZE) {
+        // Room for the current chunk and one more
+        KeepSize = 2 * MEM_LOG_CHUNK_SIZE;
+    }
+
+    mMemLog->KeepSize = KeepSize;
 }
 
 /**
@@ -580,7 +794,8 @@ INTN EFIAPI SetMemLogCallback (
     UINTN NewCallbackIndex = mMemLog->CallbacksCount;
     if (NewCallbackIndex < MAX_CALLBACKS) {
         mMemLog->CallbacksCount++;
-        mMemLog->Callbacks[NewCallbackIndex].cbPos = mMemLog->Buffer;
+        mMemLog->Callbacks[NewCallbackIndex].cbChunk = mMemLog->Head;
+        mMemLog->Callbacks[NewCallbackIndex].cbPos = mMemLog->Head->Data;
         mMemLog->Callbacks[NewCallbackIndex].cbPause = 0;
         mMemLog->Callbacks[NewCallbackIndex].Callback = Callback;
     }
@@ -9,11 +9,17 @@
 //
 // Mem log sizes
 //
-#define MEM_LOG_INITIAL_SIZE    (128 * 1024)
+#define MEM_LOG_CHUNK_SIZE      (128 * 1024)
 #define MEM_LOG_MAX_SIZE        (10 * 1024 * 1024)
 #define MEM_LOG_MAX_LINE_SIZE   1024
 
 
+/** Position of MemLogIterNext() in the mem log. Zero it to start from the oldest text. **/
+typedef struct {
+  VOID    *Chunk;
+} MEM_LOG_ITERATOR;
+
+
 /** Callback that can be installed to be called when some message is printed with MemLog() or MemLogVA(). **/
 typedef UINTN (EFIAPI *MEM_LOG_CALLBACK) (IN INTN DebugMode, IN CHAR8 *LastMessage);
 
@@ -33,6 +39,30 @@ VOID EFIAPI MemLogVA (
   IN  VA_LIST       Marker
 );
 
+/**
+  Prints a log message with a Unicode format string to memory buffer as ASCII.
+
+  Formats straight into the buffer, without intermediate strings.
+
+  @param  Timing      TRUE to prepend timing to log.
+  @param  DebugMode   DebugMode will be passed to Callback function if it is set.
+  @param  Prefix      Optional text to write before the message.
+  @param  Format      The Unicode format string for the debug message to print.
+  @param  Suffix      Optional text to write after the message.
+  @param  Limit       Maximum message length before it is snipped (0 for no limit).
+  @param  Marker      VA_LIST with variable arguments for Format.
+
+**/
+VOID EFIAPI MemLogUnicodeVA (
+  IN  const BOOLEAN Timing,
+  IN  const INTN    DebugMode,
+  IN  const CHAR16  *Prefix,
+  IN  const CHAR16  *Format,
+  IN  const CHAR16  *Suffix,
+  IN  const UINTN   Limit,
+  IN  VA_LIST       Marker
+);
+
 /**
   Prints a log message to memory buffer.
 
@@ -54,17 +84,38 @@ VOID EFIAPI MemLog (
 
 
 /**
-  Returns pointer to MemLog buffer.
+  Steps through the text held in the mem log, one contiguous block at a time.
+
+  @param  Iterator    Position in the log. Zero it before the first call.
+  @param  Text        Returns the start of the next block of text.
+  @param  Length      Returns the number of chars in that block.
+
+  @retval TRUE        A block was returned.
+  @retval FALSE       There is no more text.
 **/
-CHAR8 * EFIAPI GetMemLogBuffer (VOID);
+BOOLEAN EFIAPI MemLogIterNext (
+  IN OUT MEM_LOG_ITERATOR  *Iterator,
+  OUT    CHAR8            **Text,
+  OUT    UINTN             *Length
+);
 
 
 /**
-  Returns the length of log (number of chars written) in mem buffer.
+  Returns the length of log (number of chars held) in mem buffer.
  **/
 UINTN EFIAPI GetMemLogLen (VOID);
 
 
+/**
+  Keeps only about the last KeepSize bytes of the log, freeing older text
+  even if a paused callback has not seen it (ring mode). Zero, the default,
+  keeps everything up to MEM_LOG_MAX_SIZE and then refuses new messages.
+ **/
+VOID EFIAPI SetMemLogKeepSize (
+  IN UINTN KeepSize
+);
+
+
 /**
   Sets callback that will be called when message is added to mem log.
   Returns a callback index.
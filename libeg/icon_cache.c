@@ -0,0 +1,499 @@
+/*
+ * libeg/icon_cache.c
+ * Persistent cache of decoded and scaled icons
+ *
+ * Distributed under the terms of the GNU General Public License (GPL)
+ * version 3 (GPLv3), or (at your option) any later version.
+ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "libegint.h"
+#include "../BootMaster/global.h"
+#include "../BootMaster/lib.h"
+#include "../BootMaster/screenmgt.h"
+#include "../BootMaster/mystrings.h"
+#include "../BootMaster/crc32.h"
+#include "../include/refit_call_wrapper.h"
+#include "libeg.h"
+#include "../BootMaster/leaks.h"
+
+// The cache file lives in the RefindPlus directory and holds icons that have
+// already been decoded and scaled to one of the configured icon sizes. Each
+// record is keyed by the source file path, the icon size and the size and
+// modification time of the source file. The icon directories are listed once
+// per session; records whose source file is no longer listed with the same
+// size and timestamp are dropped, so changing 'icons_dir' or replacing icons
+// in a theme invalidates the affected records without any extra file probes.
+#define ICON_CACHE_FILE_NAME    L"icons.cache"
+#define ICON_CACHE_SIGNATURE    SIGNATURE_32('R','P','I','C')
+#define ICON_CACHE_VERSION      1
+#define ICON_CACHE_ALIGN(x)     (((x) + 7) & ~((UINTN) 7))
+
+typedef struct {
+    UINT32    Signature;
+    UINT32    Version;
+    UINT32    RecordCount;
+    UINT32    DataSize;
+    UINT32    DataCrc;
+    UINT32    Reserved;
+} ICON_CACHE_HEADER;
+
+// Each record is followed by PathLength CHAR16s (NUL terminated) and then by
+// Width x Height EG_PIXELs in BGRA order. Records are padded to 8 bytes.
+typedef struct {
+    UINT32    RecordSize;
+    UINT32    IconSize;
+    UINT32    Width;
+    UINT32    Height;
+    UINT32    HasAlpha;
+    UINT32    PathLength;
+    UINT64    FileSize;
+    EFI_TIME  ModificationTime;
+} ICON_CACHE_RECORD;
+
+typedef struct {
+    CHAR16    *Path;
+    UINT64     FileSize;
+    EFI_TIME   ModificationTime;
+} ICON_CACHE_SOURCE;
+
+typedef struct {
+    CHAR16    *Path;
+    UINTN      IconSize;
+    UINT64     FileSize;
+    EFI_TIME   ModificationTime;
+    UINTN      Width;
+    UINTN      Height;
+    BOOLEAN    HasAlpha;
+    BOOLEAN    OwnsPixels;
+    EG_PIXEL  *Pixels;
+} ICON_CACHE_ITEM;
+
+static BOOLEAN             IconCacheLoaded   = FALSE;
+static BOOLEAN             IconCacheDirty    = FALSE;
+static CHAR16             *IconCacheIconsDir = NULL;
+static UINT8              *IconCacheFileData = NULL;
+static ICON_CACHE_SOURCE  *IconSources       = NULL;
+static UINTN               IconSourceCount   = 0;
+static ICON_CACHE_ITEM    *IconItems         = NULL;
+static UINTN               IconItemCount     = 0;
+
+static
+VOID egIconCacheFreeSources (VOID) {
+    UINTN i;
+
+    for (i = 0; i < IconSourceCount; i++) {
+        MY_FREE_POOL(IconSources[i].Path);
+    }
+    MY_FREE_POOL(IconSources);
+    IconSourceCount = 0;
+} // static VOID egIconCacheFreeSources()
+
+static
+VOID egIconCacheFreeItems (VOID) {
+    UINTN i;
+
+    for (i = 0; i < IconItemCount; i++) {
+        MY_FREE_POOL(IconItems[i].Path);
+        if (IconItems[i].OwnsPixels) {
+            MY_FREE_POOL(IconItems[i].Pixels);
+        }
+    }
+    MY_FREE_POOL(IconItems);
+    IconItemCount = 0;
+
+    // Loaded records point into the file buffer
+    MY_FREE_POOL(IconCacheFileData);
+} // static VOID egIconCacheFreeItems()
+
+// Lists the files in one icon directory in a single pass.
+static
+VOID egIconCacheListDir (
+    IN CHAR16 *DirName
+) {
+    EFI_FILE_INFO      *DirEntry;
+    REFIT_DIR_ITER      DirIter;
+    ICON_CACHE_SOURCE   Source;
+
+    DirIterOpen (SelfDir, DirName, &DirIter);
+    while (DirIterNext (&DirIter, 2, NULL, &DirEntry)) {
+        Source.Path             = PoolPrint (L"%s\\%s", DirName, DirEntry->FileName);
+        Source.FileSize         = DirEntry->FileSize;
+        Source.ModificationTime = DirEntry->ModificationTime;
+
+        if (Source.Path != NULL) {
+            AddListElementSized (
+                (VOID **) &IconSources, &IconSourceCount,
+                &Source, sizeof (Source)
+            );
+        }
+    } // while
+    DirIterClose (&DirIter);
+} // static VOID egIconCacheListDir()
+
+static
+ICON_CACHE_SOURCE * egIconCacheFindSource (
+    IN CHAR16 *Path
+) {
+    UINTN i;
+
+    for (i = 0; i < IconSourceCount; i++) {
+        if (MyStriCmp (IconSources[i].Path, Path)) {
+            return &IconSources[i];
+        }
+    }
+
+    return NULL;
+} // static ICON_CACHE_SOURCE * egIconCacheFindSource()
+
+static
+BOOLEAN egIconCacheSourceMatches (
+    IN ICON_CACHE_SOURCE *Source,
+    IN UINT64             FileSize,
+    IN EFI_TIME          *ModificationTime
+) {
+    return (
+        Source != NULL &&
+        Source->FileSize == FileSize &&
+        CompareMem (&Source->ModificationTime, ModificationTime, sizeof (EFI_TIME)) == 0
+    );
+} // static BOOLEAN egIconCacheSourceMatches()
+
+// Reads the cache file in one I/O and keeps the records that still match the
+// current icon directory listing. Pixel data is used in place.
+static
+VOID egIconCacheReadFile (VOID) {
+    EFI_STATUS          Status;
+    UINTN               FileSize;
+    UINTN               Offset;
+    UINTN               PathBytes;
+    UINTN               PixelBytes;
+    UINTN               i;
+    ICON_CACHE_HEADER  *Header;
+    ICON_CACHE_RECORD  *Record;
+    ICON_CACHE_ITEM     Item;
+    CHAR16             *RecordPath;
+
+    Status = egLoadFile (SelfDir, ICON_CACHE_FILE_NAME, &IconCacheFileData, &FileSize);
+    if (EFI_ERROR(Status)) {
+        // Nothing cached yet
+        IconCacheDirty = TRUE;
+
+        return;
+    }
+
+    Header = (ICON_CACHE_HEADER *) IconCacheFileData;
+    if (FileSize < sizeof (ICON_CACHE_HEADER)             ||
+        Header->Signature != ICON_CACHE_SIGNATURE         ||
+        Header->Version   != ICON_CACHE_VERSION           ||
+        Header->DataSize  != FileSize - sizeof (ICON_CACHE_HEADER) ||
+        Header->DataCrc   != crc32refit (0, IconCacheFileData + sizeof (ICON_CACHE_HEADER), Header->DataSize)
+    ) {
+        #if REFIT_DEBUG > 0
+        LOG(2, LOG_LINE_NORMAL, L"Discarding Invalid Icon Cache File");
+        #endif
+
+        MY_FREE_POOL(IconCacheFileData);
+        IconCacheDirty = TRUE;
+
+        return;
+    }
+
+    Offset = sizeof (ICON_CACHE_HEADER);
+    for (i = 0; i < Header->RecordCount; i++) {
+        if (FileSize - Offset < sizeof (ICON_CACHE_RECORD)) {
+            break;
+        }
+
+        Record     = (ICON_CACHE_RECORD *) (IconCacheFileData + Offset);
+        PathBytes  = Record->PathLength * sizeof (CHAR16);
+        PixelBytes = (UINTN) Record->Width * Record->Height * sizeof (EG_PIXEL);
+        if (Record->RecordSize > FileSize - Offset ||
+            Record->PathLength == 0 ||
+            sizeof (ICON_CACHE_RECORD) + PathBytes + PixelBytes > Record->RecordSize
+        ) {
+            break;
+        }
+
+        RecordPath = (CHAR16 *) (Record + 1);
+        if (RecordPath[Record->PathLength - 1] == 0 &&
+            egIconCacheSourceMatches (
+                egIconCacheFindSource (RecordPath),
+                Record->FileSize, &Record->ModificationTime
+            )
+        ) {
+            Item.Path             = StrDuplicate (RecordPath);
+            Item.IconSize         = Record->IconSize;
+            Item.FileSize         = Record->FileSize;
+            Item.ModificationTime = Record->ModificationTime;
+            Item.Width            = Record->Width;
+            Item.Height           = Record->Height;
+            Item.HasAlpha         = Record->HasAlpha ? TRUE : FALSE;
+            Item.OwnsPixels       = FALSE;
+            Item.Pixels           = (EG_PIXEL *) ((UINT8 *) RecordPath + PathBytes);
+            AddListElementSized (
+                (VOID **) &IconItems, &IconItemCount,
+                &Item, sizeof (Item)
+            );
+        }
+        else {
+            // Source was changed or removed ... Rewrite without this record
+            IconCacheDirty = TRUE;
+        }
+
+        Offset += Record->RecordSize;
+    } // for
+
+    if (i < Header->RecordCount) {
+        IconCacheDirty = TRUE;
+    }
+
+    #if REFIT_DEBUG > 0
+    LOG(2, LOG_LINE_NORMAL,
+        L"Loaded %d of %d Cached Icons from '%s'",
+        IconItemCount, Header->RecordCount, ICON_CACHE_FILE_NAME
+    );
+    #endif
+} // static VOID egIconCacheReadFile()
+
+// Prepares the cache for the current 'icons_dir' setting. The icon
+// directories are listed again, and stale records dropped, whenever
+// the setting changes.
+static
+BOOLEAN egIconCacheReady (VOID) {
+    if (SelfDir == NULL) {
+        return FALSE;
+    }
+
+    if (IconCacheLoaded) {
+        if (GlobalConfig.IconsDir == NULL && IconCacheIconsDir == NULL) {
+            return TRUE;
+        }
+        if (GlobalConfig.IconsDir != NULL &&
+            IconCacheIconsDir     != NULL &&
+            MyStriCmp (GlobalConfig.IconsDir, IconCacheIconsDir)
+        ) {
+            return TRUE;
+        }
+
+        // Save records for the old listing before they are rechecked
+        egIconCacheSave();
+        egIconCacheFreeItems();
+        egIconCacheFreeSources();
+        MY_FREE_POOL(IconCacheIconsDir);
+    }
+
+    if (GlobalConfig.IconsDir != NULL) {
+        IconCacheIconsDir = StrDuplicate (GlobalConfig.IconsDir);
+        egIconCacheListDir (GlobalConfig.IconsDir);
+    }
+    egIconCacheListDir (DEFAULT_ICONS_DIR);
+
+    IconCacheDirty  = FALSE;
+    IconCacheLoaded = TRUE;
+    egIconCacheReadFile();
+
+    return TRUE;
+} // static BOOLEAN egIconCacheReady()
+
+static
+EG_IMAGE * egIconCacheGet (
+    IN CHAR16 *Path,
+    IN UINTN   IconSize
+) {
+    UINTN      i;
+    EG_IMAGE  *Image;
+
+    for (i = 0; i < IconItemCount; i++) {
+        if (IconItems[i].IconSize == IconSize && MyStriCmp (IconItems[i].Path, Path)) {
+            Image = egCreateImage (IconItems[i].Width, IconItems[i].Height, IconItems[i].HasAlpha);
+            if (Image != NULL) {
+                CopyMem (
+                    Image->PixelData, IconItems[i].Pixels,
+                    IconItems[i].Width * IconItems[i].Height * sizeof (EG_PIXEL)
+                );
+            }
+
+            return Image;
+        }
+    }
+
+    return NULL;
+} // static EG_IMAGE * egIconCacheGet()
+
+static
+VOID egIconCachePut (
+    IN ICON_CACHE_SOURCE *Source,
+    IN UINTN              IconSize,
+    IN EG_IMAGE          *Image
+) {
+    UINTN            PixelBytes;
+    ICON_CACHE_ITEM  Item;
+
+    PixelBytes  = Image->Width * Image->Height * sizeof (EG_PIXEL);
+    Item.Pixels = AllocatePool (PixelBytes);
+    Item.Path   = StrDuplicate (Source->Path);
+    if (Item.Pixels == NULL || Item.Path == NULL) {
+        MY_FREE_POOL(Item.Pixels);
+        MY_FREE_POOL(Item.Path);
+
+        return;
+    }
+    CopyMem (Item.Pixels, Image->PixelData, PixelBytes);
+
+    Item.IconSize         = IconSize;
+    Item.FileSize         = Source->FileSize;
+    Item.ModificationTime = Source->ModificationTime;
+    Item.Width            = Image->Width;
+    Item.Height           = Image->Height;
+    Item.HasAlpha         = Image->HasAlpha;
+    Item.OwnsPixels       = TRUE;
+    AddListElementSized (
+        (VOID **) &IconItems, &IconItemCount,
+        &Item, sizeof (Item)
+    );
+
+    IconCacheDirty = TRUE;
+} // static VOID egIconCachePut()
+
+// Cached counterpart of egFindIcon(). Candidate files are resolved against the
+// icon directory listings, in the same order of preference as egFindIcon(), so
+// missing icons cost no file probes. Returns FALSE if the cache is unavailable,
+// in which case the caller should search the icon directories itself.
+BOOLEAN egFindCachedIcon (
+    IN  CHAR16    *BaseName,
+    IN  UINTN      IconSize,
+    OUT EG_IMAGE **Image
+) {
+    UINTN               i, j;
+    CHAR16             *SubdirName;
+    CHAR16             *Extension;
+    CHAR16             *FileName;
+    ICON_CACHE_SOURCE  *Source;
+
+    *Image = NULL;
+    if (!egIconCacheReady()) {
+        return FALSE;
+    }
+
+    for (i = 0; i < 2 && *Image == NULL; i++) {
+        SubdirName = (i == 0) ? GlobalConfig.IconsDir : DEFAULT_ICONS_DIR;
+        if (SubdirName == NULL) {
+            continue;
+        }
+
+        j = 0;
+        while ((*Image == NULL) && ((Extension = FindCommaDelimited (ICON_EXTENSIONS, j++)) != NULL)) {
+            FileName = PoolPrint (L"%s\\%s.%s", SubdirName, BaseName, Extension);
+            Source   = egIconCacheFindSource (FileName);
+            if (Source != NULL) {
+                *Image = egIconCacheGet (FileName, IconSize);
+                if (*Image == NULL) {
+                    *Image = egLoadIcon (SelfDir, FileName, IconSize);
+                    if (*Image != NULL) {
+                        egIconCachePut (Source, IconSize, *Image);
+                    }
+                }
+            }
+
+            MY_FREE_POOL(Extension);
+            MY_FREE_POOL(FileName);
+        } // while
+    } // for
+
+    #if REFIT_DEBUG > 0
+    LOG(3, LOG_THREE_STAR_MID,
+        L"In egFindCachedIcon ... %s:- '%s'",
+        (*Image != NULL) ? L"Found Icon" : L"No Icon File",
+        BaseName
+    );
+    #endif
+
+    return TRUE;
+} // BOOLEAN egFindCachedIcon()
+
+// Writes the icon cache back to the RefindPlus directory if new icons were
+// decoded or stale records were dropped since it was last read or written.
+VOID egIconCacheSave (VOID) {
+    EFI_STATUS          Status;
+    UINTN               DataSize;
+    UINTN               Offset;
+    UINTN               PathBytes;
+    UINTN               PixelBytes;
+    UINTN               i;
+    UINT8              *Buffer;
+    ICON_CACHE_HEADER  *Header;
+    ICON_CACHE_RECORD  *Record;
+
+    if (!IconCacheLoaded || !IconCacheDirty || SelfDir == NULL) {
+        return;
+    }
+
+    DataSize = 0;
+    for (i = 0; i < IconItemCount; i++) {
+        PathBytes  = (StrLen (IconItems[i].Path) + 1) * sizeof (CHAR16);
+        PixelBytes = IconItems[i].Width * IconItems[i].Height * sizeof (EG_PIXEL);
+        DataSize  += ICON_CACHE_ALIGN(sizeof (ICON_CACHE_RECORD) + PathBytes + PixelBytes);
+    }
+
+    Buffer = AllocateZeroPool (sizeof (ICON_CACHE_HEADER) + DataSize);
+    if (Buffer == NULL) {
+        return;
+    }
+
+    Offset = sizeof (ICON_CACHE_HEADER);
+    for (i = 0; i < IconItemCount; i++) {
+        PathBytes  = (StrLen (IconItems[i].Path) + 1) * sizeof (CHAR16);
+        PixelBytes = IconItems[i].Width * IconItems[i].Height * sizeof (EG_PIXEL);
+
+        Record                   = (ICON_CACHE_RECORD *) (Buffer + Offset);
+        Record->RecordSize       = (UINT32) ICON_CACHE_ALIGN(sizeof (ICON_CACHE_RECORD) + PathBytes + PixelBytes);
+        Record->IconSize         = (UINT32) IconItems[i].IconSize;
+        Record->Width            = (UINT32) IconItems[i].Width;
+        Record->Height           = (UINT32) IconItems[i].Height;
+        Record->HasAlpha         = IconItems[i].HasAlpha ? 1 : 0;
+        Record->PathLength       = (UINT32) (PathBytes / sizeof (CHAR16));
+        Record->FileSize         = IconItems[i].FileSize;
+        Record->ModificationTime = IconItems[i].ModificationTime;
+        CopyMem (Record + 1, IconItems[i].Path, PathBytes);
+        CopyMem ((UINT8 *) (Record + 1) + PathBytes, IconItems[i].Pixels, PixelBytes);
+
+        Offset += Record->RecordSize;
+    }
+
+    Header              = (ICON_CACHE_HEADER *) Buffer;
+    Header->Signature   = ICON_CACHE_SIGNATURE;
+    Header->Version     = ICON_CACHE_VERSION;
+    Header->RecordCount = (UINT32) IconItemCount;
+    Header->DataSize    = (UINT32) DataSize;
+    Header->DataCrc     = crc32refit (0, Buffer + sizeof (ICON_CACHE_HEADER), DataSize);
+
+    // egSaveFile does not truncate ... Delete any previous file first
+    egSaveFile (SelfDir, ICON_CACHE_FILE_NAME, NULL, 0);
+    Status = egSaveFile (SelfDir, ICON_CACHE_FILE_NAME, Buffer, sizeof (ICON_CACHE_HEADER) + DataSize);
+    MY_FREE_POOL(Buffer);
+
+    if (!EFI_ERROR(Status)) {
+        IconCacheDirty = FALSE;
+    }
+
+    #if REFIT_DEBUG > 0
+    LOG(2, LOG_LINE_NORMAL,
+        L"Save %d Cached Icons to '%s' ... %r",
+        IconItemCount, ICON_CACHE_FILE_NAME, Status
+    );
+    #endif
+} // VOID egIconCacheSave()
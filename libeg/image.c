@@ -71,6 +71,7 @@
 #include "lodepng.h"
 #include "libeg.h"
 #include "../BootMaster/leaks.h"
+#include "../BootMaster/profile.h"
 
 #define MAX_FILE_SIZE (1024*1024*1024)
 
@@ -518,8 +519,9 @@ EFI_STATUS egSaveFileNumbered (
 // Loading images from files and embedded data
 //
 
-// Decode the specified image data. The IconSize parameter is relevant only
-// for ICNS, for which it selects which ICNS sub-image is decoded.
+// Decode the specified image data. For ICNS, the IconSize parameter selects
+// which ICNS sub-image is decoded; for PNG, a non-zero IconSize lets large
+// images be reduced while decoding (see egDecodePNG). Pass 0 for native size.
 // Returns a pointer to the resulting EG_IMAGE or NULL if decoding failed.
 EG_IMAGE * egDecodeAny (
     IN UINT8    *FileData,
@@ -566,9 +568,8 @@ EG_IMAGE * egLoadImage (
         return NULL;
     }
 
-    // decode it
-    // '128' can be any arbitrary value
-    NewImage = egDecodeAny (FileData, FileDataLength, 128, WantAlpha);
+    // decode it at native size
+    NewImage = egDecodeAny (FileData, FileDataLength, 0, WantAlpha);
     MY_FREE_POOL(FileData);
 
     return NewImage;
@@ -742,13 +743,25 @@ EG_IMAGE * egLoadIconAnyType (
 // ICON_EXTENSIONS is "icns,png", this function will return myicons/os_linux.icns,
 // myicons/os_linux.png, icons/os_linux.icns, or icons/os_linux.png, in that
 // order of preference. Returns NULL if no such icon can be found. All file
-// references are relative to SelfDir.
+// references are relative to SelfDir. With 'icon_cache' set, the search is
+// served from the icon cache (see egFindCachedIcon()) when it is available.
 EG_IMAGE * egFindIcon (
     IN CHAR16 *BaseName,
     IN UINTN   IconSize
 ) {
     EG_IMAGE *Image = NULL;
 
+    PROFILE_BEGIN("egFindIcon");
+
+    if (GlobalConfig.IconCache &&
+        AllowGraphicsMode &&
+        egFindCachedIcon (BaseName, IconSize, &Image)
+    ) {
+        PROFILE_END("egFindIcon");
+
+        return Image;
+    }
+
     if (GlobalConfig.IconsDir != NULL) {
         Image = egLoadIconAnyType (
             SelfDir, GlobalConfig.IconsDir,
@@ -763,6 +776,8 @@ EG_IMAGE * egFindIcon (
         );
     }
 
+    PROFILE_END("egFindIcon");
+
     return Image;
 } // EG_IMAGE * egFindIcon()
 
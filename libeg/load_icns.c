@@ -189,10 +189,432 @@ BOOLEAN ISTYPE(UINT8 *x, CHAR8 *y) {
 }
 
 
+//
+// Index Apple .icns icon families
+//
+
+// Element formats, in the order the decoder prefers them for a given size
+#define ICNS_DATA   0   //  RGB
+#define ICNS_MASK   1   // 8 bit mask
+#define ICNS_APIC   2   // ARGB, JPEG, PNG
+#define ICNS_DPIC   3   //  RGB, JPEG, PNG
+#define ICNS_NPIC   4   //       JPEG, PNG
+#define ICNS_RPIC   5   //       JPEG, PNG      (Retina)
+#define ICNS_BIT8   6   // 8 bit color
+#define ICNS_BIT4   7   // 4 bit color
+#define ICNS_BIT1   8   // 1 bit B&W and mask
+#define ICNS_MONO   9   // 1 bit B&W no mask
+#define ICNS_FORMAT_COUNT 10
+
+// Nested families beyond this count are ignored
+#define ICNS_MAX_NESTED 8
+
+typedef struct {
+    CHAR8   *Type;
+    UINTN    Size;
+    UINTN    Format;
+    UINTN    Skip;
+} ICNS_ELEMENT_TYPE;
+
+static ICNS_ELEMENT_TYPE IcnsElementTypes[] = {
+    { "ic10", 1024, ICNS_RPIC, 0 },
+    { "ic14",  512, ICNS_RPIC, 0 },
+    { "ic09",  512, ICNS_NPIC, 0 },
+    { "ic13",  256, ICNS_RPIC, 0 },
+    { "ic08",  256, ICNS_NPIC, 0 },
+    { "it32",  128, ICNS_DATA, 4 },
+    { "t8mk",  128, ICNS_MASK, 0 },
+    { "ic07",  128, ICNS_NPIC, 0 },
+    { "ic12",   64, ICNS_RPIC, 0 },
+    { "ih32",   48, ICNS_DATA, 0 },
+    { "h8mk",   48, ICNS_MASK, 0 },
+    { "SB24",   48, ICNS_RPIC, 0 },
+    { "icp6",   48, ICNS_NPIC, 0 },
+    { "ich8",   48, ICNS_BIT8, 0 },
+    { "ich4",   48, ICNS_BIT4, 0 },
+    { "ich#",   48, ICNS_BIT1, 0 },
+    { "icsB",   36, ICNS_RPIC, 0 },
+    { "il32",   32, ICNS_DATA, 0 },
+    { "l8mk",   32, ICNS_MASK, 0 },
+    { "ic11",   32, ICNS_RPIC, 0 },
+    { "icp5",   32, ICNS_DPIC, 0 },
+    { "ic05",   32, ICNS_APIC, 0 }, // this is also Retina
+    { "icl8",   32, ICNS_BIT8, 0 },
+    { "icl4",   32, ICNS_BIT4, 0 },
+    { "ICN#",   32, ICNS_BIT1, 0 },
+    { "ICON",   32, ICNS_MONO, 0 },
+    { "sb24",   24, ICNS_NPIC, 0 },
+    { "icsb",   18, ICNS_APIC, 0 },
+    { "is32",   16, ICNS_DATA, 0 },
+    { "s8mk",   16, ICNS_MASK, 0 },
+    { "icp4",   16, ICNS_DPIC, 0 },
+    { "ic04",   16, ICNS_APIC, 0 },
+    { "ics8",   16, ICNS_BIT8, 0 },
+    { "ics4",   16, ICNS_BIT4, 0 }, // "kcs4",
+    { "ics#",   16, ICNS_BIT1, 0 }, // "ksc#", "SICN", "CURS" (first 64 bytes)
+    { "icm8",   12, ICNS_BIT8, 0 },
+    { "icm4",   12, ICNS_BIT4, 0 },
+    { "icm#",   12, ICNS_BIT1, 0 },
+    { "PAT ",    8, ICNS_MONO, 0 }  // added this one for fun (not really an icns option)
+};
+#define ICNS_ELEMENT_TYPE_COUNT (sizeof(IcnsElementTypes)/sizeof(IcnsElementTypes[0]))
+
+// Nested family types. A nested "icns" is never decoded, so it is not listed.
+static CHAR8 *IcnsNestedTypes[] = {
+    "slct",             // nested type "Selected"
+    "sbtp",             // nested type "Template"
+    "tile",             // Resorcerer can create icns resources with this nested type "Tile"
+    "drop",             // Resorcerer can create icns resources with this nested type "Drop"
+    "over",             // Resorcerer can create icns resources with this nested type "Rollover"
+    "open",             // Resorcerer can create icns resources with this nested type "Open"
+    "odrp",             // Resorcerer can create icns resources with this nested type "OpenDrop"
+    "\xFD\xD9\x2F\xA8"  // nested type "Dark Mode"
+};
+#define ICNS_NESTED_TYPE_COUNT (sizeof(IcnsNestedTypes)/sizeof(IcnsNestedTypes[0]))
+
+typedef struct {
+    UINT8    *Ptr;
+    UINTN     Len;
+} ICNS_ELEMENT;
+
+typedef struct _icns_index {
+    ICNS_ELEMENT         Elements[MAX_ICNS_SIZES][ICNS_FORMAT_COUNT];
+    BOOLEAN              HasSize[MAX_ICNS_SIZES];
+    UINTN                NestedCount;
+    ICNS_ELEMENT         Nested[ICNS_MAX_NESTED];
+    struct _icns_index  *NestedIndex[ICNS_MAX_NESTED];
+    UINTN                Level;
+} ICNS_INDEX;
+
+static
+UINTN egIcnsSizeSlot (
+    IN UINTN IconSize
+) {
+    UINTN Slot;
+
+    for (Slot = 0; Slot < MAX_ICNS_SIZES; Slot++) {
+        if (IconSizes[Slot] == IconSize) {
+            break;
+        }
+    }
+
+    return Slot;
+} // static UINTN egIcnsSizeSlot()
+
+// Walks the tagged blocks of an icon family once and records where each
+// element and nested family is. When a type repeats, the last block wins.
+static
+ICNS_INDEX * egIndexICNS (
+    IN UINT8  *FileData,
+    IN UINTN   FileDataLength,
+    IN UINTN   Level
+) {
+    UINTN        i, Slot;
+    UINT8       *Ptr       = FileData + 8;
+    UINT8       *BufferEnd = FileData + FileDataLength;
+    ICNS_INDEX  *Index;
+
+    Index = AllocateZeroPool (sizeof (ICNS_INDEX));
+    if (Index == NULL) {
+        return NULL;
+    }
+    Index->Level = Level;
+
+    // iterate over tagged blocks in the file
+    while (Ptr + 8 <= BufferEnd) {
+        UINT32 BlockLen = ((UINT32)Ptr[4] << 24) + ((UINT32)Ptr[5] << 16) + ((UINT32)Ptr[6] << 8) + (UINT32)Ptr[7];
+
+        if (BlockLen < 8 || Ptr + BlockLen > BufferEnd) {
+            // block continues beyond end of file
+            break;
+        }
+
+        for (i = 0; i < ICNS_ELEMENT_TYPE_COUNT; i++) {
+            if (ISTYPE(Ptr, IcnsElementTypes[i].Type)) {
+                if (BlockLen - 8 >= IcnsElementTypes[i].Skip) {
+                    Slot = egIcnsSizeSlot (IcnsElementTypes[i].Size);
+                    Index->Elements[Slot][IcnsElementTypes[i].Format].Ptr = Ptr + 8 + IcnsElementTypes[i].Skip;
+                    Index->Elements[Slot][IcnsElementTypes[i].Format].Len = BlockLen - 8 - IcnsElementTypes[i].Skip;
+                    Index->HasSize[Slot] = TRUE;
+                    MsgLog("IconType:%.4a Len:0x%x\n", Ptr, BlockLen - 8);
+                }
+                break;
+            }
+        }
+
+        if (i == ICNS_ELEMENT_TYPE_COUNT && Index->NestedCount < ICNS_MAX_NESTED) {
+            for (i = 0; i < ICNS_NESTED_TYPE_COUNT; i++) {
+                if (ISTYPE(Ptr, IcnsNestedTypes[i])) {
+                    Index->Nested[Index->NestedCount].Ptr = Ptr;
+                    Index->Nested[Index->NestedCount].Len = BlockLen;
+                    Index->NestedCount++;
+                    break;
+                }
+            }
+        }
+
+        Ptr += BlockLen;
+    } // while blocks
+
+    return Index;
+} // static ICNS_INDEX * egIndexICNS()
+
+static
+VOID egFreeIcnsIndex (
+    IN ICNS_INDEX *Index
+) {
+    UINTN i;
+
+    if (Index == NULL) {
+        return;
+    }
+
+    for (i = 0; i < Index->NestedCount; i++) {
+        egFreeIcnsIndex (Index->NestedIndex[i]);
+    }
+    MY_FREE_POOL(Index);
+} // static VOID egFreeIcnsIndex()
+
+
 //
 // Load Apple .icns icons
 //
 
+// Decodes the elements of one icon size from an indexed family. Embedded PNG
+// and JPEG payloads are decoded with the requested size as a hint so that the
+// PNG path can reduce large Retina elements while decoding.
+static
+EG_IMAGE * egDecodeIcnsSize (
+    IN ICNS_INDEX  *Index,
+    IN UINTN        IconSize,
+    IN UINTN        RequestedSize,
+    IN BOOLEAN      WantAlpha
+) {
+    UINTN     i;
+    UINT8    *SrcPtr;
+    EG_PIXEL *DestPtr;
+    EG_IMAGE *NewImage = NULL;
+
+    UINTN Slot = egIcnsSizeSlot (IconSize);
+    if (Slot >= MAX_ICNS_SIZES || !Index->HasSize[Slot]) {
+        return NULL;
+    }
+
+    UINTN Width = (IconSize == 12) ? 16 : IconSize;
+    UINTN PixelCount = Width * IconSize;
+
+    ICNS_ELEMENT *Elements = Index->Elements[Slot];
+    #define ONEFORMAT(_format, _id) UINT8 * _format ## Ptr = Elements[_id].Ptr; UINTN _format ## Len = Elements[_id].Len
+    ONEFORMAT(Data, ICNS_DATA);
+    ONEFORMAT(Mask, ICNS_MASK);
+    ONEFORMAT(APic, ICNS_APIC);
+    ONEFORMAT(DPic, ICNS_DPIC);
+    ONEFORMAT(NPic, ICNS_NPIC);
+    ONEFORMAT(RPic, ICNS_RPIC);
+    ONEFORMAT(Bit8, ICNS_BIT8);
+    ONEFORMAT(Bit4, ICNS_BIT4);
+    ONEFORMAT(Bit1, ICNS_BIT1);
+    ONEFORMAT(Mono, ICNS_MONO);
+    BOOLEAN IncludesAlpha = FALSE; // for ARGB
+    BOOLEAN Use1BitAlpha  = FALSE; // for 8 bit, 4 bit, 1 bit
+    BOOLEAN MakeAlpha     = FALSE; // for mono
+    BOOLEAN AddedAlpha    = FALSE;
+
+    if (!DataPtr || !MaskPtr) { // first priority is RGB with mask - if they don't exist then try other 24 bit options
+        if (APicPtr && APicLen >= 4 && ISTYPE(APicPtr, "ARGB")) { // second priority is ARGB
+            MsgLog("Doing APic\n");
+            DataPtr = APicPtr + 4;
+            DataLen = APicLen - 4;
+            IncludesAlpha = TRUE;
+        }
+        else { // third priority is PNG or JPEG
+            #define ONEPICTYPE(_format) if (!NewImage && _format ## Ptr) NewImage = egDecodeAny(_format ## Ptr, _format ## Len, RequestedSize, WantAlpha);
+            ONEPICTYPE(APic)
+            ONEPICTYPE(DPic)
+            ONEPICTYPE(NPic)
+            ONEPICTYPE(RPic)
+
+            if (NewImage) {
+                // assume JPEG and PNG have alpha
+                // (even though nanojpeg doesn't support transparency - it also doesn't support JPEG 2000 which is what Apple icons use)
+                AddedAlpha = TRUE;
+            }
+            else if (DPicPtr) {
+                if (DPicLen >= 12 && CompareMem ("\0\0\0\fjP  \r\n\x87\n", DPicPtr, 12) == 0) {
+                    // don't want to try RGB data if it looks like jpg
+                    MsgLog("Failed to decode jpeg for DPic\n");
+                }
+                else if (!DataPtr) { // for this type, if it's not a PNG or JPEG then it's RGB
+                    MsgLog("Doing DPic as Data\n");
+                    DataPtr = DPicPtr;
+                    DataLen = DPicLen;
+                }
+            }
+        }
+    }
+
+    if (!NewImage && DataPtr) { // try ARGB & RGB types
+        MsgLog("Doing Data\n");
+        NewImage = egCreateImage (Width, IconSize, WantAlpha);
+        if (!NewImage) {
+            return NULL;
+        }
+
+        if (DataLen < PixelCount * (IncludesAlpha ? 4 : 3)) {
+            // pixel data is compressed, RGB planar ... unpacked straight into the interleaved pixels
+            UINT8 *CompData = DataPtr;
+            UINTN CompLen  = DataLen;
+            if (IncludesAlpha) {
+                egDecompressIcnsRLE (&CompData, &CompLen, PLPTR(NewImage, a), PixelCount);
+            }
+            egDecompressIcnsRLE (&CompData, &CompLen, PLPTR(NewImage, r), PixelCount);
+            egDecompressIcnsRLE (&CompData, &CompLen, PLPTR(NewImage, g), PixelCount);
+            egDecompressIcnsRLE (&CompData, &CompLen, PLPTR(NewImage, b), PixelCount);
+            // possible assertion: CompLen == 0
+            if (CompLen > 0) {
+                MsgLog ("egLoadICNSIcon: %d bytes of compressed data left\n", CompLen);
+                MsgLog ("Ignoring this icon\n");
+                MY_FREE_IMAGE (NewImage);
+                NewImage = NULL;
+            }
+        }
+        else {
+            // pixel data is uncompressed, RGB interleaved
+            SrcPtr  = DataPtr;
+            DestPtr = NewImage->PixelData;
+            for (i = 0; i < PixelCount; i++, DestPtr++) {
+                if (IncludesAlpha) {
+                    DestPtr->a = *SrcPtr++;
+                }
+                DestPtr->r = *SrcPtr++;
+                DestPtr->g = *SrcPtr++;
+                DestPtr->b = *SrcPtr++;
+            }
+        }
+        AddedAlpha = IncludesAlpha;
+
+        if (NewImage && WantAlpha && !AddedAlpha && MaskPtr && MaskLen >= PixelCount) {
+            // Add Alpha Mask if Required, Available, and Valid
+            egInsertPlane (MaskPtr, PLPTR(NewImage, a), PixelCount);
+            AddedAlpha = TRUE;
+        }
+    }
+
+    if (!NewImage) { // try clut types
+        EG_PIXEL *Clut;
+        UINTN BitShift;
+        SrcPtr = NULL;
+             if (Bit8Ptr && Bit8Len >= PixelCount    ) { BitShift = 0; Clut = Clut8; Use1BitAlpha = TRUE; SrcPtr = Bit8Ptr; } // 1st clut priority is 8 bit
+        else if (Bit4Ptr && Bit4Len >= PixelCount / 2) { BitShift = 1; Clut = Clut4; Use1BitAlpha = TRUE; SrcPtr = Bit4Ptr; } // 2nd clut priority is 4 bit
+        else if (Bit1Ptr && Bit1Len >= PixelCount / 8) { BitShift = 3; Clut = Clut1; Use1BitAlpha = TRUE; SrcPtr = Bit1Ptr; } // 3rd clut priority is 1 bit with mask
+        else if (MonoPtr && MonoLen >= PixelCount / 8) { BitShift = 3; Clut = Clut1; MakeAlpha    = TRUE; SrcPtr = MonoPtr; } // 4th clut priority is mono with no mask
+
+        if (SrcPtr) {
+            MsgLog("Doing Clut\n");
+            NewImage = egCreateImage (Width, IconSize, WantAlpha);
+            if (!NewImage) {
+                return NULL;
+            }
+
+            UINTN revshift = 3 - BitShift;
+            UINTN pixelsperbyte = 1 << BitShift;
+            UINTN bitsperpixel = 1 << revshift;
+
+            UINTN pixelindexmask = pixelsperbyte - 1;
+            UINTN pixelvaluemask = (1 << bitsperpixel) - 1;
+            UINTN colorindex;
+
+            DestPtr = NewImage->PixelData;
+            for (i = 0; i < PixelCount; i++, DestPtr++) {
+                colorindex = (SrcPtr[i >> BitShift] >> (((~i) & pixelindexmask) << revshift)) & pixelvaluemask;
+                DestPtr->r = Clut[colorindex].r;
+                DestPtr->g = Clut[colorindex].g;
+                DestPtr->b = Clut[colorindex].b;
+            }
+
+            if (WantAlpha && Use1BitAlpha && Bit1Ptr && Bit1Len >= PixelCount * 2 / 8) {
+                SrcPtr = Bit1Ptr + PixelCount / 8;
+                DestPtr = NewImage->PixelData;
+                for (i = 0; i < PixelCount; i++, DestPtr++) {
+                    DestPtr->a = ((SrcPtr[i >> 3] >> ((~i) & 7)) & 1) ? 255 : 0;
+                }
+                AddedAlpha = TRUE;
+            }
+        }
+    }
+
+    if (NewImage) {
+        if (WantAlpha) {
+            // Alpha is Required
+            if (!AddedAlpha) {
+                // Alpha is Required but Unavailable
+                if (MakeAlpha) {
+                    // Make an Alpha by doing the following:
+                    egSetPlane (PLPTR(NewImage, a), 0xff, PixelCount); // set all pixels to opaque
+                    EG_PIXEL TestColor = { 0xff, 0xff, 0xff, 0 }; // search for white pixels
+                    EG_PIXEL TestMask  = { 0xff, 0xff, 0xff, 0 }; // regardless of alpha
+                    EG_PIXEL FillColor = { 0x00, 0x00, 0x00, 0 }; // set alpha of white pixels to transparent
+                    EG_PIXEL FillMask  = { 0x00, 0x00, 0x00, 255 }; // without affecting the color
+                    egSeedFillImage (NewImage, -1, -1, &FillColor, &FillMask, &TestColor, &TestMask, FALSE, TRUE); // add an extra pixel in case the icon extends from one edge to the other so the seed fill can continue all the way around the icon in the image.
+                }
+                else {
+                    // Alpha is Required but Unavailable
+                    // Default to 'Opaque'
+                    egSetPlane (PLPTR(NewImage, a), 255, NewImage->Width * NewImage->Height);
+                }
+            }
+        }
+        else {
+            // Alpha is Not Required
+            // Default to 'Zero'
+            // NB: 'Zero' clears unused bytes and is not the opposite of opaque in this case
+            // NB: Embedded PNG may have been reduced while decoding, so use the image size
+            egSetPlane (PLPTR(NewImage, a), 0, NewImage->Width * NewImage->Height);
+        }
+    }
+
+    return NewImage;
+} // static EG_IMAGE * egDecodeIcnsSize()
+
+// Tries each candidate size against the index, first with the family's own
+// elements and then with its nested families, indexing each of those once.
+static
+EG_IMAGE * egDecodeIcnsIndex (
+    IN ICNS_INDEX  *Index,
+    IN UINTN       *SizesToTry,
+    IN UINTN        NumSizesToTry,
+    IN UINTN        RequestedSize,
+    IN BOOLEAN      WantAlpha
+) {
+    UINTN     i, SizeToTry;
+    EG_IMAGE *NewImage = NULL;
+
+    for (SizeToTry = 0; !NewImage && SizeToTry < NumSizesToTry; SizeToTry++) {
+        NewImage = egDecodeIcnsSize (Index, SizesToTry[SizeToTry], RequestedSize, WantAlpha);
+
+        for (i = 0; !NewImage && i < Index->NestedCount; i++) {
+            if (Index->NestedIndex[i] == NULL) {
+                Index->NestedIndex[i] = egIndexICNS (
+                    Index->Nested[i].Ptr, Index->Nested[i].Len,
+                    Index->Level + 1
+                );
+                if (Index->NestedIndex[i] == NULL) {
+                    continue;
+                }
+            }
+
+            // nested families are only searched for the size being tried
+            NewImage = egDecodeIcnsIndex (
+                Index->NestedIndex[i],
+                &SizesToTry[SizeToTry], 1,
+                RequestedSize, WantAlpha
+            );
+        }
+    }
+
+    return NewImage;
+} // static EG_IMAGE * egDecodeIcnsIndex()
+
 EG_IMAGE * egDecodeICNS (
     IN UINT8   *FileData,
     IN UINTN    FileDataLength,
@@ -218,7 +640,13 @@ EG_IMAGE * egDecodeICNS (
         return NULL;
     }
 
-    EG_IMAGE *NewImage = NULL;
+    EG_IMAGE   *NewImage = NULL;
+    ICNS_INDEX *Index;
+
+    if (IconSize == 0) {
+        // No size preference
+        IconSize = 128;
+    }
 
     UINTN SizesToTry[MAX_ICNS_SIZES];
     UINTN NumSizesToTry;
@@ -235,281 +663,11 @@ EG_IMAGE * egDecodeICNS (
         for (j = i; j < NumSizesToTry; j++, k++) SizesToTry[k] = IconSizes[j]; // then do icons that are smaller in size
     }
 
-    UINTN SizeToTry = 0;
-    //LOGBLOCKENTRY("while SizeToTry < %d", NumSizesToTry);
-    while (!NewImage && SizeToTry < NumSizesToTry) {
-        IconSize = SizesToTry[SizeToTry++];
-        //LOGBLOCKENTRY("SizeToTry:%d", IconSize);
-
-        UINTN Width = (IconSize == 12) ? 16 : IconSize;
-        UINTN PixelCount = Width * IconSize;
-
-        //LOGBLOCKENTRY("while DoNested");
-        UINTN DoNested = 0;
-        while (!NewImage && DoNested < 2) {
-            //LOGBLOCKENTRY("DoNested:%d", DoNested);
-            UINTN     i;
-            UINT8    *SrcPtr;
-            EG_PIXEL *DestPtr;
-
-            UINT8 *Ptr = FileData + 8;
-            UINT8 *BufferEnd = FileData + FileDataLength;
-
-            #define ONEFORMAT(_format) UINT8 * _format ## Ptr = NULL; UINTN _format ## Len = 0
-            ONEFORMAT(Data);                //  RGB
-            ONEFORMAT(Mask);                // 8 bit mask
-            ONEFORMAT(APic);                // ARGB, JPEG, PNG
-            ONEFORMAT(DPic);                //  RGB, JPEG, PNG
-            ONEFORMAT(NPic);                //       JPEG, PNG
-            ONEFORMAT(RPic);                //       JPEG, PNG      (Retina)
-            ONEFORMAT(Bit8);                // 8 bit color
-            ONEFORMAT(Bit4);                // 4 bit color
-            ONEFORMAT(Bit1);                // 1 bit B&W and mask
-            ONEFORMAT(Mono);                // 1 bit B&W no mask
-            BOOLEAN IncludesAlpha = FALSE; // for ARGB
-            BOOLEAN Use1BitAlpha  = FALSE; // for 8 bit, 4 bit, 1 bit
-            BOOLEAN MakeAlpha     = FALSE; // for mono
-            BOOLEAN AddedAlpha    = FALSE;
-
-            //LOGBLOCKENTRY("while Ptr < 0x%x", BufferEnd - FileData);
-            // iterate over tagged blocks in the file
-            while (!NewImage && Ptr + 8 <= BufferEnd) {
-                UINT32 BlockLen = ((UINT32)Ptr[4] << 24) + ((UINT32)Ptr[5] << 16) + ((UINT32)Ptr[6] << 8) + (UINT32)Ptr[7];
-                //LOGBLOCKENTRY("Ptr:0x%x Len:0x%x", Ptr - FileData, BlockLen);
-
-                if (BlockLen < 8 || Ptr + BlockLen > BufferEnd) {
-                    // block continues beyond end of file
-                    //LOGBLOCKEXIT("Ptr (invalid)");
-                    break;
-                }
-
-                if (DoNested) {
-                     if (
-                           ISTYPE(Ptr, "icns")
-                        || ISTYPE(Ptr, "slct")
-                        || ISTYPE(Ptr, "sbtp")
-                        || ISTYPE(Ptr, "tile")
-                        || ISTYPE(Ptr, "drop")
-                        || ISTYPE(Ptr, "over")
-                        || ISTYPE(Ptr, "open")
-                        || ISTYPE(Ptr, "odrp")
-                        || ISTYPE(Ptr, "\xFD\xD9\x2F\xA8")
-                    ) {
-                        NewImage = egDecodeICNS(Ptr, BlockLen, IconSize, WantAlpha, Level + 1);
-                    }
-                } // nested block
-                else {
-                    UINT8 *p = Ptr + 8; UINTN len = BlockLen - 8;
-                    #define ONEICON(_type, _format, ...) if (ISTYPE(Ptr, _type)) { _format ## Ptr = p + 0 ##__VA_ARGS__; _format ## Len = len - 0 ##__VA_ARGS__; MsgLog("IconType:%.4a Len:0x%x\n", Ptr, len); }
-
-                           if (IconSize == 1024) { ONEICON("ic10", RPic)
-                    } else if (IconSize ==  512) { ONEICON("ic14", RPic)
-                                              else ONEICON("ic09", NPic)
-                    } else if (IconSize ==  256) { ONEICON("ic13", RPic)
-                                              else ONEICON("ic08", NPic)
-                    } else if (IconSize ==  128) { ONEICON("it32", Data, 4)
-                                              else ONEICON("t8mk", Mask)
-                                              else ONEICON("ic07", NPic)
-                    } else if (IconSize ==   64) { ONEICON("ic12", RPic)
-                    } else if (IconSize ==   48) { ONEICON("ih32", Data)
-                                              else ONEICON("h8mk", Mask)
-                                              else ONEICON("SB24", RPic)
-                                              else ONEICON("icp6", NPic)
-                                              else ONEICON("ich8", Bit8)
-                                              else ONEICON("ich4", Bit4)
-                                              else ONEICON("ich#", Bit1)
-                    } else if (IconSize ==   36) { ONEICON("icsB", RPic)
-                    } else if (IconSize ==   32) { ONEICON("il32", Data)
-                                              else ONEICON("l8mk", Mask)
-                                              else ONEICON("ic11", RPic)
-                                              else ONEICON("icp5", DPic)
-                                              else ONEICON("ic05", APic) // this is also Retina
-                                              else ONEICON("icl8", Bit8)
-                                              else ONEICON("icl4", Bit4)
-                                              else ONEICON("ICN#", Bit1)
-                                              else ONEICON("ICON", Mono)
-                    } else if (IconSize ==   24) { ONEICON("sb24", NPic)
-                    } else if (IconSize ==   18) { ONEICON("icsb", APic)
-                    } else if (IconSize ==   16) { ONEICON("is32", Data)
-                                              else ONEICON("s8mk", Mask)
-                                              else ONEICON("icp4", DPic)
-                                              else ONEICON("ic04", APic)
-                                              else ONEICON("ics8", Bit8)
-                                              else ONEICON("ics4", Bit4) // "kcs4",
-                                              else ONEICON("ics#", Bit1) // "ksc#", "SICN", "CURS" (first 64 bytes)
-                    } else if (IconSize ==   12) { ONEICON("icm8", Bit8)
-                                              else ONEICON("icm4", Bit4)
-                                              else ONEICON("icm#", Bit1)
-                    } else if (IconSize ==    8) { ONEICON("PAT ", Mono) // added this one for fun (not really an icns option)
-                    }
-                } // not nested block
-
-                //LOGBLOCKEXIT("Ptr");
-                Ptr += BlockLen;
-            } // while blocks
-            //LOGBLOCKEXIT("while Ptr");
-
-            if (!NewImage && (!DataPtr || !MaskPtr)) { // first priority is RGB with mask - if they don't exist then try other 24 bit options
-                if (APicPtr && ISTYPE(APicPtr, "ARGB")) { // second priority is ARGB
-                    MsgLog("Doing APic\n");
-                    DataPtr = APicPtr + 4;
-                    DataLen = APicLen - 4;
-                    IncludesAlpha = TRUE;
-                }
-                else { // third priority is PNG or JPEG
-                    #define ONEPICTYPE(_format) if (!NewImage && _format ## Ptr) NewImage = egDecodeAny(_format ## Ptr, _format ## Len, IconSize, WantAlpha);
-                    ONEPICTYPE(APic)
-                    ONEPICTYPE(DPic)
-                    ONEPICTYPE(NPic)
-                    ONEPICTYPE(RPic)
-
-                    if (NewImage) {
-                        // assume JPEG and PNG have alpha
-                        // (even though nanojpeg doesn't support transparency - it also doesn't support JPEG 2000 which is what Apple icons use)
-                        AddedAlpha = TRUE;
-                    }
-                    else if (DPicPtr) {
-                        if (CompareMem ("\0\0\0\fjP  \r\n\x87\n", DPicPtr, 12) == 0) {
-                            // don't want to try RGB data if it looks like jpg
-                            MsgLog("Failed to decode jpeg for DPic\n");
-                        }
-                        else if (!DataPtr) { // for this type, if it's not a PNG or JPEG then it's RGB
-                            MsgLog("Doing DPic as Data\n");
-                            DataPtr = DPicPtr;
-                            DataLen = DPicLen;
-                        }
-                    }
-                }
-            }
-
-            if (!NewImage && DataPtr) { // try ARGB & RGB types
-                MsgLog("Doing Data\n");
-                NewImage = egCreateImage (Width, IconSize, WantAlpha);
-                if (!NewImage) {
-                    return NULL;
-                }
-
-                if (DataLen < PixelCount * (IncludesAlpha ? 4 : 3)) {
-                    // pixel data is compressed, RGB planar
-                    UINT8 *CompData = DataPtr;
-                    UINTN CompLen  = DataLen;
-                    if (IncludesAlpha) {
-                        egDecompressIcnsRLE (&CompData, &CompLen, PLPTR(NewImage, a), PixelCount);
-                    }
-                    egDecompressIcnsRLE (&CompData, &CompLen, PLPTR(NewImage, r), PixelCount);
-                    egDecompressIcnsRLE (&CompData, &CompLen, PLPTR(NewImage, g), PixelCount);
-                    egDecompressIcnsRLE (&CompData, &CompLen, PLPTR(NewImage, b), PixelCount);
-                    // possible assertion: CompLen == 0
-                    if (CompLen > 0) {
-                        MsgLog ("egLoadICNSIcon: %d bytes of compressed data left\n", CompLen);
-                        MsgLog ("Ignoring this icon\n");
-                        MY_FREE_IMAGE (NewImage);
-                        NewImage = NULL;
-                    }
-                }
-                else {
-                    // pixel data is uncompressed, RGB interleaved
-                    SrcPtr  = DataPtr;
-                    DestPtr = NewImage->PixelData;
-                    for (i = 0; i < PixelCount; i++, DestPtr++) {
-                        if (IncludesAlpha) {
-                            DestPtr->a = *SrcPtr++;
-                        }
-                        DestPtr->r = *SrcPtr++;
-                        DestPtr->g = *SrcPtr++;
-                        DestPtr->b = *SrcPtr++;
-                    }
-                }
-                AddedAlpha = IncludesAlpha;
-
-                if (WantAlpha && !AddedAlpha && MaskPtr && MaskLen >= PixelCount) {
-                    // Add Alpha Mask if Required, Available, and Valid
-                    egInsertPlane (MaskPtr, PLPTR(NewImage, a), PixelCount);
-                    AddedAlpha = TRUE;
-                }
-            }
-
-            if (!NewImage) { // try clut types
-                //MsgLog("Trying Clut\n");
-                EG_PIXEL *Clut;
-                UINTN BitShift;
-                SrcPtr = NULL;
-                     if (Bit8Ptr && Bit8Len >= PixelCount    ) { BitShift = 0; Clut = Clut8; Use1BitAlpha = TRUE; SrcPtr = Bit8Ptr; } // 1st clut priority is 8 bit
-                else if (Bit4Ptr && Bit4Len >= PixelCount / 2) { BitShift = 1; Clut = Clut4; Use1BitAlpha = TRUE; SrcPtr = Bit4Ptr; } // 2nd clut priority is 4 bit
-                else if (Bit1Ptr && Bit1Len >= PixelCount / 8) { BitShift = 3; Clut = Clut1; Use1BitAlpha = TRUE; SrcPtr = Bit1Ptr; } // 3rd clut priority is 1 bit with mask
-                else if (MonoPtr && MonoLen >= PixelCount / 8) { BitShift = 3; Clut = Clut1; MakeAlpha    = TRUE; SrcPtr = MonoPtr; } // 4th clut priority is mono with no mask
-
-                if (SrcPtr) {
-                    MsgLog("Doing Clut\n");
-                    NewImage = egCreateImage (Width, IconSize, WantAlpha);
-                    if (!NewImage) {
-                        return NULL;
-                    }
-
-                    UINTN revshift = 3 - BitShift;
-                    UINTN pixelsperbyte = 1 << BitShift;
-                    UINTN bitsperpixel = 1 << revshift;
-
-                    UINTN pixelindexmask = pixelsperbyte - 1;
-                    UINTN pixelvaluemask = (1 << bitsperpixel) - 1;
-                    UINTN colorindex;
-
-                    DestPtr = NewImage->PixelData;
-                    for (i = 0; i < PixelCount; i++, DestPtr++) {
-                        colorindex = (SrcPtr[i >> BitShift] >> (((~i) & pixelindexmask) << revshift)) & pixelvaluemask;
-                        DestPtr->r = Clut[colorindex].r;
-                        DestPtr->g = Clut[colorindex].g;
-                        DestPtr->b = Clut[colorindex].b;
-                    }
-
-                    if (WantAlpha && Use1BitAlpha && Bit1Ptr && Bit1Len >= PixelCount * 2 / 8) {
-                        SrcPtr = Bit1Ptr + PixelCount / 8;
-                        DestPtr = NewImage->PixelData;
-                        for (i = 0; i < PixelCount; i++, DestPtr++) {
-                            DestPtr->a = ((SrcPtr[i >> 3] >> ((~i) & 7)) & 1) ? 255 : 0;
-                        }
-                        AddedAlpha = TRUE;
-                    }
-                }
-            }
-
-            if (NewImage) {
-                if (WantAlpha) {
-                    // Alpha is Required
-                    if (!AddedAlpha) {
-                        // Alpha is Required but Unavailable
-                        if (MakeAlpha) {
-                            // Make an Alpha by doing the following:
-                            egSetPlane (PLPTR(NewImage, a), 0xff, PixelCount); // set all pixels to opaque
-                            EG_PIXEL TestColor = { 0xff, 0xff, 0xff, 0 }; // search for white pixels
-                            EG_PIXEL TestMask  = { 0xff, 0xff, 0xff, 0 }; // regardless of alpha
-                            EG_PIXEL FillColor = { 0x00, 0x00, 0x00, 0 }; // set alpha of white pixels to transparent
-                            EG_PIXEL FillMask  = { 0x00, 0x00, 0x00, 255 }; // without affecting the color
-                            egSeedFillImage (NewImage, -1, -1, &FillColor, &FillMask, &TestColor, &TestMask, FALSE, TRUE); // add an extra pixel in case the icon extends from one edge to the other so the seed fill can continue all the way around the icon in the image.
-                        }
-                        else {
-                            // Alpha is Required but Unavailable
-                            // Default to 'Opaque'
-                            egSetPlane (PLPTR(NewImage, a), 255, PixelCount);
-                        }
-                    }
-                }
-                else {
-                    // Alpha is Not Required
-                    // Default to 'Zero'
-                    // NB: 'Zero' clears unused bytes and is not the opposite of opaque in this case
-                    egSetPlane (PLPTR(NewImage, a), 0, PixelCount);
-                }
-            }
-
-            //LOGBLOCKEXIT("DoNested");
-            DoNested++;
-        } // while normal blocks, nested blocks
-        //LOGBLOCKEXIT("while DoNested");
-
-        //LOGBLOCKEXIT("SizeToTry");
-    } // while sizes
-    //LOGBLOCKEXIT("while SizeToTry");
+    Index = egIndexICNS (FileData, FileDataLength, Level);
+    if (Index != NULL) {
+        NewImage = egDecodeIcnsIndex (Index, SizesToTry, NumSizesToTry, IconSize, WantAlpha);
+        egFreeIcnsIndex (Index);
+    }
 
     // FUTURE: scale to originally requested size if we had to load another size
 
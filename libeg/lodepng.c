@@ -1343,9 +1343,43 @@ static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
   return error;
 }
 
+/*
+RefindPlus: optional consumer of inflated bytes. When one is given, the output
+vector is only used as a sliding window: bytes are handed to the sink as they
+are produced and all but the last 32 KiB (the maximum deflate distance) are
+discarded, so the output never grows to the full decompressed size.
+*/
+typedef struct LodePNGInflateSink {
+  unsigned (*emit)(void* user, const unsigned char* data, size_t size); /*returns error*/
+  void* user;
+  size_t emitted; /*bytes at the start of the window already handed to emit*/
+  unsigned adler; /*running adler32 of everything emitted*/
+} LodePNGInflateSink;
+
+#define INFLATE_WINDOW_SIZE 32768u
+#define INFLATE_SINK_FLUSH (4u * INFLATE_WINDOW_SIZE)
+
+static unsigned update_adler32(unsigned adler, const unsigned char* data, unsigned len);
+
+/*hand the pending bytes to the sink; unless final, also slide the window back to its last 32 KiB*/
+static unsigned inflateSinkDrain(ucvector* out, size_t* pos, LodePNGInflateSink* sink, unsigned final) {
+  if(*pos > sink->emitted) {
+    size_t size = *pos - sink->emitted;
+    CERROR_TRY_RETURN(sink->emit(sink->user, out->data + sink->emitted, size));
+    sink->adler = update_adler32(sink->adler, out->data + sink->emitted, (unsigned)size);
+  }
+  sink->emitted = *pos;
+  if(!final && *pos > 2u * INFLATE_WINDOW_SIZE) {
+    /*source and destination cannot overlap since pos is above twice the window size*/
+    lodepng_memcpy(out->data, out->data + *pos - INFLATE_WINDOW_SIZE, INFLATE_WINDOW_SIZE);
+    *pos = sink->emitted = out->size = INFLATE_WINDOW_SIZE;
+  }
+  return 0;
+}
+
 /*inflate a block with dynamic of fixed Huffman tree. btype must be 1 or 2.*/
 static unsigned inflateHuffmanBlock(ucvector* out, size_t* pos, LodePNGBitReader* reader,
-                                    unsigned btype) {
+                                    unsigned btype, LodePNGInflateSink* sink) {
   unsigned error = 0;
   HuffmanTree tree_ll; /*the huffman tree for literal and length codes*/
   HuffmanTree tree_d; /*the huffman tree for distance codes*/
@@ -1422,6 +1456,10 @@ static unsigned inflateHuffmanBlock(ucvector* out, size_t* pos, LodePNGBitReader
     } else /*if(code_ll == INVALIDSYMBOL)*/ {
       ERROR_BREAK(16); /*error: tried to read disallowed huffman symbol*/
     }
+    if(sink && *pos >= INFLATE_SINK_FLUSH) {
+      error = inflateSinkDrain(out, pos, sink, 0);
+      if(error) break;
+    }
     /*check if any of the ensureBits above went out of bounds*/
     if(reader->bp > reader->bitsize) {
       /*return error code 10 or 11 depending on the situation that happened in huffmanDecodeSymbol
@@ -1438,7 +1476,8 @@ static unsigned inflateHuffmanBlock(ucvector* out, size_t* pos, LodePNGBitReader
 }
 
 static unsigned inflateNoCompression(ucvector* out, size_t* pos,
-                                     LodePNGBitReader* reader, const LodePNGDecompressSettings* settings) {
+                                     LodePNGBitReader* reader, const LodePNGDecompressSettings* settings,
+                                     LodePNGInflateSink* sink) {
   size_t bytepos;
   size_t size = reader->size;
   unsigned LEN, NLEN, error = 0;
@@ -1467,12 +1506,15 @@ static unsigned inflateNoCompression(ucvector* out, size_t* pos,
 
   reader->bp = bytepos << 3u;
 
+  if(sink && *pos >= INFLATE_SINK_FLUSH) error = inflateSinkDrain(out, pos, sink, 0);
+
   return error;
 }
 
 static unsigned lodepng_inflatev(ucvector* out,
                                  const unsigned char* in, size_t insize,
-                                 const LodePNGDecompressSettings* settings) {
+                                 const LodePNGDecompressSettings* settings,
+                                 LodePNGInflateSink* sink) {
   unsigned BFINAL = 0;
   size_t pos = 0; /*byte position in the out buffer*/
   LodePNGBitReader reader;
@@ -1487,12 +1529,14 @@ static unsigned lodepng_inflatev(ucvector* out,
     BTYPE = readBits(&reader, 2);
 
     if(BTYPE == 3) return 20; /*error: invalid BTYPE*/
-    else if(BTYPE == 0) error = inflateNoCompression(out, &pos, &reader, settings); /*no compression*/
-    else error = inflateHuffmanBlock(out, &pos, &reader, BTYPE); /*compression, BTYPE 01 or 10*/
+    else if(BTYPE == 0) error = inflateNoCompression(out, &pos, &reader, settings, sink); /*no compression*/
+    else error = inflateHuffmanBlock(out, &pos, &reader, BTYPE, sink); /*compression, BTYPE 01 or 10*/
 
     if(error) return error;
   }
 
+  if(sink) error = inflateSinkDrain(out, &pos, sink, 1);
+
   return error;
 }
 
@@ -1502,7 +1546,7 @@ unsigned lodepng_inflate(unsigned char** out, size_t* outsize,
   unsigned error;
   ucvector v;
   ucvector_init_buffer(&v, *out, *outsize);
-  error = lodepng_inflatev(&v, in, insize, settings);
+  error = lodepng_inflatev(&v, in, insize, settings, 0);
   *out = v.data;
   *outsize = v.size;
   return error;
@@ -2250,9 +2294,8 @@ static unsigned adler32(const unsigned char* data, unsigned len) {
 
 #ifdef LODEPNG_COMPILE_DECODER
 
-unsigned lodepng_zlib_decompress(unsigned char** out, size_t* outsize, const unsigned char* in,
-                                 size_t insize, const LodePNGDecompressSettings* settings) {
-  unsigned error = 0;
+/*validates the 2-byte zlib header, return value is error*/
+static unsigned zlib_check_header(const unsigned char* in, size_t insize) {
   unsigned CM, CINFO, FDICT;
 
   if(insize < 2) return 53; /*error, size of zlib data too small*/
@@ -2278,6 +2321,14 @@ unsigned lodepng_zlib_decompress(unsigned char** out, size_t* outsize, const uns
     return 26;
   }
 
+  return 0;
+}
+
+unsigned lodepng_zlib_decompress(unsigned char** out, size_t* outsize, const unsigned char* in,
+                                 size_t insize, const LodePNGDecompressSettings* settings) {
+  unsigned error = zlib_check_header(in, insize);
+  if(error) return error;
+
   error = inflate(out, outsize, in + 2, insize - 2, settings);
   if(error) return error;
 
@@ -2299,6 +2350,32 @@ static unsigned zlib_decompress(unsigned char** out, size_t* outsize, const unsi
   }
 }
 
+/*
+RefindPlus: same as lodepng_zlib_decompress, but the inflated bytes are handed
+to sink->emit in order through a bounded sliding window instead of being
+returned in one buffer. custom_zlib and custom_inflate are not used here.
+*/
+static unsigned zlib_decompress_sink(LodePNGInflateSink* sink, const unsigned char* in,
+                                     size_t insize, const LodePNGDecompressSettings* settings) {
+  ucvector window;
+  unsigned error = zlib_check_header(in, insize);
+  if(error) return error;
+  if(insize < 6) return 53; /*error, no room for the adler32 checksum*/
+
+  sink->emitted = 0;
+  sink->adler = 1u;
+  ucvector_init_buffer(&window, 0, 0);
+  error = lodepng_inflatev(&window, in + 2, insize - 2, settings, sink);
+  lodepng_free(window.data);
+  if(error) return error;
+
+  if(!settings->ignore_adler32 && sink->adler != lodepng_read32bitInt(&in[insize - 4])) {
+    return 58; /*error, adler checksum not correct, data must be corrupted*/
+  }
+
+  return 0; /*no error*/
+}
+
 #endif /*LODEPNG_COMPILE_DECODER*/
 
 #ifdef LODEPNG_COMPILE_ENCODER
@@ -4827,17 +4904,16 @@ unsigned lodepng_inspect_chunk(LodePNGState* state, size_t pos,
   return error;
 }
 
-/*read a PNG, the result will be in the same color type as the PNG (hence "generic")*/
-static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
-                          LodePNGState* state,
-                          const unsigned char* in, size_t insize) {
+/*
+RefindPlus: walk the chunks following IHDR, gathering the IDAT payloads into idat
+and the palette/transparency (and ancillary) data into state->info_png.
+Split out of decodeGeneric so that lodepng_decode_bgra can share it.
+*/
+static void readChunks(ucvector* idat, LodePNGState* state,
+                       const unsigned char* in, size_t insize) {
   unsigned char IEND = 0;
   const unsigned char* chunk;
   size_t i;
-  ucvector idat; /*the data from idat chunks*/
-  unsigned char* scanlines = 0;
-  size_t scanlines_size = 0, expected_size = 0;
-  size_t outsize = 0;
 
   /*for unknown chunk order*/
   unsigned unknown = 0;
@@ -4845,19 +4921,6 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
   unsigned critical_pos = 1; /*1 = after IHDR, 2 = after PLTE, 3 = after IDAT*/
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
 
-
-  /* safe output values in case error happens */
-  *out = 0;
-  *w = *h = 0;
-
-  state->error = lodepng_inspect(w, h, state, in, insize); /*reads header and resets other parameters in state->info_png*/
-  if(state->error) return;
-
-  if(lodepng_pixel_overflow(*w, *h, &state->info_png.color, &state->info_raw)) {
-    CERROR_RETURN(state->error, 92); /*overflow possible due to amount of pixels*/
-  }
-
-  ucvector_init(&idat);
   chunk = &in[33]; /*first byte of the first chunk after the header*/
 
   /*loop through the chunks, ignoring unknown chunks and stopping at IEND chunk.
@@ -4890,11 +4953,11 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
 
     /*IDAT chunk, containing compressed image data*/
     if(lodepng_chunk_type_equals(chunk, "IDAT")) {
-      size_t oldsize = idat.size;
+      size_t oldsize = idat->size;
       size_t newsize;
       if(lodepng_addofl(oldsize, chunkLength, &newsize)) CERROR_BREAK(state->error, 95);
-      if(!ucvector_resize(&idat, newsize)) CERROR_BREAK(state->error, 83 /*alloc fail*/);
-      for(i = 0; i != chunkLength; ++i) idat.data[oldsize + i] = data[i];
+      if(!ucvector_resize(idat, newsize)) CERROR_BREAK(state->error, 83 /*alloc fail*/);
+      for(i = 0; i != chunkLength; ++i) idat->data[oldsize + i] = data[i];
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
       critical_pos = 3;
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
@@ -4982,6 +5045,30 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
   if(state->info_png.color.colortype == LCT_PALETTE && !state->info_png.color.palette) {
     state->error = 106; /* error: PNG file must have PLTE chunk if color type is palette */
   }
+}
+
+/*read a PNG, the result will be in the same color type as the PNG (hence "generic")*/
+static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
+                          LodePNGState* state,
+                          const unsigned char* in, size_t insize) {
+  ucvector idat; /*the data from idat chunks*/
+  unsigned char* scanlines = 0;
+  size_t scanlines_size = 0, expected_size = 0;
+  size_t outsize = 0;
+
+  /* safe output values in case error happens */
+  *out = 0;
+  *w = *h = 0;
+
+  state->error = lodepng_inspect(w, h, state, in, insize); /*reads header and resets other parameters in state->info_png*/
+  if(state->error) return;
+
+  if(lodepng_pixel_overflow(*w, *h, &state->info_png.color, &state->info_raw)) {
+    CERROR_RETURN(state->error, 92); /*overflow possible due to amount of pixels*/
+  }
+
+  ucvector_init(&idat);
+  readChunks(&idat, state, in, insize);
 
   /*predict output size, to allocate exact size for output buffer to avoid more dynamic allocation.
   If the decompressed size does not match the prediction, the image must be corrupt.*/
@@ -5098,6 +5185,189 @@ unsigned lodepng_decode24(unsigned char** out, unsigned* w, unsigned* h, const u
   return lodepng_decode_memory(out, w, h, in, insize, LCT_RGB, 8);
 }
 
+/*
+RefindPlus: state of a BGRA decode. Rows arrive as RGBA8 and are written to
+the caller's buffer as BGRA8, either directly or averaged over factor x factor
+boxes when downscaling.
+*/
+typedef struct LodePNGBGRASink {
+  const LodePNGColorMode* color; /*color mode of the PNG*/
+  unsigned w, h; /*source dimensions*/
+  unsigned y; /*source rows completed so far*/
+  size_t linebytes; /*source scanline bytes, excluding the filter type byte*/
+  size_t bytewidth; /*bytes per pixel for the unfilter step, at least 1*/
+  size_t fill; /*bytes of the current filtered scanline received so far*/
+  unsigned char* line; /*current scanline, filter type byte first*/
+  unsigned char* prev; /*previous unfiltered scanline, filter type byte first*/
+  unsigned char* rgba; /*one source row as RGBA8, only when downscaling*/
+  unsigned* sums; /*per-channel box sums for one output row, only when downscaling*/
+  unsigned char* out; /*BGRA8 destination*/
+  unsigned factor;
+  unsigned out_w;
+} LodePNGBGRASink;
+
+static void bgraSinkCleanup(LodePNGBGRASink* sink) {
+  lodepng_free(sink->line);
+  lodepng_free(sink->prev);
+  lodepng_free(sink->rgba);
+  lodepng_free(sink->sums);
+}
+
+static unsigned bgraSinkInit(LodePNGBGRASink* sink, unsigned char* out, unsigned factor,
+                             unsigned w, unsigned h, const LodePNGColorMode* color) {
+  unsigned bpp = lodepng_get_bpp(color);
+  lodepng_memset(sink, 0, sizeof(*sink));
+  if(bpp == 0) return 31; /*error: invalid colortype*/
+  sink->color = color;
+  sink->w = w;
+  sink->h = h;
+  sink->out = out;
+  sink->factor = factor;
+  sink->out_w = (w + factor - 1u) / factor;
+  sink->linebytes = lodepng_get_raw_size_idat(w, 1, bpp) - 1u;
+  sink->bytewidth = (bpp + 7u) / 8u;
+  sink->line = (unsigned char*)lodepng_malloc(sink->linebytes + 1u);
+  sink->prev = (unsigned char*)lodepng_malloc(sink->linebytes + 1u);
+  if(!sink->line || !sink->prev) return 83; /*alloc fail*/
+  if(factor > 1) {
+    sink->rgba = (unsigned char*)lodepng_malloc((size_t)w * 4u);
+    sink->sums = (unsigned*)lodepng_malloc((size_t)sink->out_w * 4u * sizeof(unsigned));
+    if(!sink->rgba || !sink->sums) return 83; /*alloc fail*/
+    lodepng_memset(sink->sums, 0, (size_t)sink->out_w * 4u * sizeof(unsigned));
+  }
+  return 0;
+}
+
+/*swap the red and blue channels of n RGBA8 pixels in place*/
+static void swapRedBlue(unsigned char* pixels, size_t n) {
+  size_t i;
+  for(i = 0; i != n; ++i, pixels += 4) {
+    unsigned char r = pixels[0];
+    pixels[0] = pixels[2];
+    pixels[2] = r;
+  }
+}
+
+/*accumulate one RGBA8 source row into the box sums, writing out a BGRA8 row once a band is complete*/
+static void bgraSinkAccumulate(LodePNGBGRASink* sink, const unsigned char* rgba) {
+  unsigned x, c;
+  unsigned band = sink->y % sink->factor;
+  for(x = 0; x != sink->w; ++x) {
+    unsigned* sum = &sink->sums[(x / sink->factor) * 4u];
+    for(c = 0; c != 4; ++c) sum[c] += rgba[x * 4u + c];
+  }
+  if(band == sink->factor - 1u || sink->y == sink->h - 1u) {
+    unsigned char* dst = &sink->out[(size_t)(sink->y / sink->factor) * sink->out_w * 4u];
+    unsigned rows = band + 1u;
+    for(x = 0; x != sink->out_w; ++x) {
+      unsigned* sum = &sink->sums[x * 4u];
+      unsigned cols = sink->w - x * sink->factor;
+      unsigned count;
+      if(cols > sink->factor) cols = sink->factor;
+      count = rows * cols;
+      dst[x * 4u + 0] = (unsigned char)((sum[2] + count / 2u) / count);
+      dst[x * 4u + 1] = (unsigned char)((sum[1] + count / 2u) / count);
+      dst[x * 4u + 2] = (unsigned char)((sum[0] + count / 2u) / count);
+      dst[x * 4u + 3] = (unsigned char)((sum[3] + count / 2u) / count);
+      sum[0] = sum[1] = sum[2] = sum[3] = 0;
+    }
+  }
+}
+
+/*convert one unfiltered source row, in the PNG's own color mode, to the destination*/
+static void bgraSinkRow(LodePNGBGRASink* sink, const unsigned char* row) {
+  if(sink->factor == 1) {
+    unsigned char* dst = &sink->out[(size_t)sink->y * sink->w * 4u];
+    getPixelColorsRGBA8(dst, sink->w, row, sink->color);
+    swapRedBlue(dst, sink->w);
+  } else {
+    getPixelColorsRGBA8(sink->rgba, sink->w, row, sink->color);
+    bgraSinkAccumulate(sink, sink->rgba);
+  }
+  ++sink->y;
+}
+
+/*LodePNGInflateSink callback: gather filtered scanlines, unfilter each against the previous one*/
+static unsigned bgraSinkEmit(void* user, const unsigned char* data, size_t size) {
+  LodePNGBGRASink* sink = (LodePNGBGRASink*)user;
+  while(size != 0) {
+    size_t amount = sink->linebytes + 1u - sink->fill;
+    if(sink->y == sink->h) return 91; /*decompressed size does not match prediction*/
+    if(amount > size) amount = size;
+    lodepng_memcpy(sink->line + sink->fill, data, amount);
+    sink->fill += amount;
+    data += amount;
+    size -= amount;
+    if(sink->fill == sink->linebytes + 1u) {
+      unsigned char* swap;
+      CERROR_TRY_RETURN(unfilterScanline(sink->line + 1, sink->line + 1, sink->y ? sink->prev + 1 : 0,
+                                         sink->bytewidth, sink->line[0], sink->linebytes));
+      bgraSinkRow(sink, sink->line + 1);
+      swap = sink->prev;
+      sink->prev = sink->line;
+      sink->line = swap;
+      sink->fill = 0;
+    }
+  }
+  return 0;
+}
+
+unsigned lodepng_decode_bgra(unsigned char* out, unsigned factor, LodePNGState* state,
+                             const unsigned char* in, size_t insize) {
+  unsigned w, h;
+  LodePNGBGRASink sink;
+
+  lodepng_memset(&sink, 0, sizeof(sink));
+  if(factor == 0) factor = 1;
+  /*keeps the box sums within 32 bits*/
+  if(factor > 1024) CERROR_RETURN_ERROR(state->error, 93);
+
+  state->error = lodepng_inspect(&w, &h, state, in, insize);
+  if(state->error) return state->error;
+
+  if(lodepng_pixel_overflow(w, h, &state->info_png.color, &state->info_raw)) {
+    CERROR_RETURN_ERROR(state->error, 92); /*overflow possible due to amount of pixels*/
+  }
+
+  if(state->info_png.interlace_method != 0) {
+    /*Adam7 passes cover the whole image before any row is complete, so decode in full*/
+    unsigned char* rgba = 0;
+    unsigned y;
+    state->info_raw.colortype = LCT_RGBA;
+    state->info_raw.bitdepth = 8;
+    state->decoder.color_convert = 1;
+    lodepng_decode(&rgba, &w, &h, state, in, insize);
+    if(!state->error) state->error = bgraSinkInit(&sink, out, factor, w, h, &state->info_raw);
+    if(!state->error) {
+      for(y = 0; y != h; ++y) bgraSinkRow(&sink, &rgba[(size_t)y * w * 4u]);
+    }
+    bgraSinkCleanup(&sink);
+    lodepng_free(rgba);
+    return state->error;
+  }
+
+  {
+    ucvector idat; /*the data from idat chunks*/
+    LodePNGInflateSink inflated;
+
+    ucvector_init(&idat);
+    readChunks(&idat, state, in, insize);
+    if(!state->error) state->error = bgraSinkInit(&sink, out, factor, w, h, &state->info_png.color);
+    if(!state->error) {
+      inflated.emit = bgraSinkEmit;
+      inflated.user = &sink;
+      state->error = zlib_decompress_sink(&inflated, idat.data, idat.size, &state->decoder.zlibsettings);
+    }
+    if(!state->error && (sink.y != h || sink.fill != 0)) {
+      state->error = 91; /*decompressed size does not match prediction*/
+    }
+    bgraSinkCleanup(&sink);
+    ucvector_cleanup(&idat);
+  }
+
+  return state->error;
+}
+
 #ifdef LODEPNG_COMPILE_DISK
 unsigned lodepng_decode_file(unsigned char** out, unsigned* w, unsigned* h, const char* filename,
                              LodePNGColorType colortype, unsigned bitdepth) {
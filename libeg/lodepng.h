@@ -800,6 +800,21 @@ information is placed in the info_png field of the LodePNGState.
 unsigned lodepng_inspect(unsigned* w, unsigned* h,
                          LodePNGState* state,
                          const unsigned char* in, size_t insize);
+
+/*
+RefindPlus: Decodes straight into a caller-provided 8-bit BGRA buffer (the
+EFI/EG_PIXEL byte order) instead of allocating an RGBA image.
+Non-interlaced images are inflated through a 32 KiB sliding window and
+unfiltered one scanline at a time, so no full-size intermediate buffer is
+allocated. Adam7 interlaced images fall back to a full decode.
+out: at least out_w * out_h * 4 bytes, where out_w = (w + factor - 1) / factor
+     and out_h = (h + factor - 1) / factor for the w and h from lodepng_inspect.
+factor: integer box-filter reduction of at most 1024; 1 (or 0) decodes at native size.
+state: as initialised by lodepng_state_init; info_png is filled in.
+Return value: LodePNG error code (0 means no error).
+*/
+unsigned lodepng_decode_bgra(unsigned char* out, unsigned factor, LodePNGState* state,
+                             const unsigned char* in, size_t insize);
 #endif /*LODEPNG_COMPILE_DECODER*/
 
 /*
@@ -116,50 +116,45 @@ VOID *MyMemCpy(void *__restrict __dest, const void *__restrict __src, size_t __n
     return __dest;
 }
 
-typedef struct _lode_color {
-   UINT8 red;
-   UINT8 green;
-   UINT8 blue;
-   UINT8 alpha;
-} lode_color;
-
+// Decode a PNG straight into the EG_IMAGE pixel buffer. LodePNG writes BGRA
+// (EFI's byte order) one scanline at a time, so neither a full-size RGBA
+// buffer nor a second copy of the image is needed. When IconSize is non-zero
+// and the image is at least twice that size, it is box-filtered down by an
+// integer factor while decoding; the result is never smaller than IconSize,
+// so egLoadIcon still does the final fit. IconSize 0 keeps the native size.
 EG_IMAGE * egDecodePNG(IN UINT8 *FileData, IN UINTN FileDataLength, IN UINTN IconSize, IN BOOLEAN WantAlpha) {
    EG_IMAGE *NewImage = NULL;
-   unsigned Error, Width, Height;
-   EG_PIXEL *PixelData;
-   lode_color *LodeData;
-   UINTN i;
-
-   Error = lodepng_decode_memory((unsigned char **) &PixelData, &Width, &Height, (unsigned char*) FileData,
-                                 (size_t) FileDataLength, LCT_RGBA, 8);
+   LodePNGState State;
+   unsigned Error, Width, Height, Factor, Largest;
 
+   lodepng_state_init(&State);
+   Error = lodepng_inspect(&Width, &Height, &State, (unsigned char*) FileData, (size_t) FileDataLength);
    if (Error) {
+      lodepng_state_cleanup(&State);
       return NULL;
    }
 
+   Factor  = 1;
+   Largest = (Width > Height) ? Width : Height;
+   if (IconSize > 0 && Largest >= IconSize * 2) {
+      Factor = Largest / (unsigned) IconSize;
+   }
+
    // allocate image structure and buffer
-   NewImage = egCreateImage(Width, Height, WantAlpha);
+   NewImage = egCreateImage((Width + Factor - 1) / Factor, (Height + Factor - 1) / Factor, WantAlpha);
    if (NewImage == NULL) {
-       return NULL;
-   }
-   if (NewImage->Width != Width || NewImage->Height != Height) {
-       // Should never happen; just being paranoid.
-       MY_FREE_IMAGE(NewImage);
-       return NULL;
+      lodepng_state_cleanup(&State);
+      return NULL;
    }
 
-   LodeData = (lode_color *) PixelData;
+   Error = lodepng_decode_bgra((unsigned char*) NewImage->PixelData, Factor, &State,
+                               (unsigned char*) FileData, (size_t) FileDataLength);
+   lodepng_state_cleanup(&State);
 
-   // Annoyingly, EFI and LodePNG use different ordering of RGB values in
-   // their pixel data representations, so we've got to adjust them.
-   for (i = 0; i < (NewImage->Height * NewImage->Width); i++) {
-      NewImage->PixelData[i].r = LodeData[i].red;
-      NewImage->PixelData[i].g = LodeData[i].green;
-      NewImage->PixelData[i].b = LodeData[i].blue;
-      if (WantAlpha)
-         NewImage->PixelData[i].a = LodeData[i].alpha;
+   if (Error) {
+      MY_FREE_IMAGE(NewImage);
+      return NULL;
    }
-   lodepng_free(PixelData);
 
    return NewImage;
 } // EG_IMAGE * egDecodePNG()
@@ -1670,7 +1670,9 @@ VOID egDrawImage (
         return;
     }
 
+    // Opaque images would only be copied over the background ... Blit them directly
     if ((GlobalConfig.ScreenBackground == NULL) ||
+        (!Image->HasAlpha) ||
         ((Image->Width == egScreenWidth) && (Image->Height == egScreenHeight))
     ) {
         CompImage = Image;
@@ -116,6 +116,133 @@ VOID egMeasureText (
     if (Height != NULL) *Height = BaseFontImage->Height;
 }
 
+//
+// Glyph cache
+//
+
+// Coverage masks, one byte per pixel, for each glyph of BaseFontImage. Glyphs
+// are extracted on first use. Masks are only used when all inked pixels of the
+// font share one colour, which holds for the embedded fonts and the usual
+// font files; other fonts are composed cell by cell from the full image.
+static UINT8    *GlyphMasks     = NULL;
+static BOOLEAN   GlyphReady[FONT_NUM_CHARS];
+static BOOLEAN   GlyphMonoFont  = FALSE;
+static EG_PIXEL  GlyphInkColor  = { 0x00, 0x00, 0x00, 0 };
+
+static
+VOID egFreeGlyphCache (VOID) {
+    MY_FREE_POOL(GlyphMasks);
+    ZeroMem (GlyphReady, sizeof (GlyphReady));
+    GlyphMonoFont = FALSE;
+} // static VOID egFreeGlyphCache()
+
+static
+BOOLEAN egPrepareGlyphCache (VOID) {
+    UINTN      i;
+    BOOLEAN    FoundInk = FALSE;
+    EG_PIXEL  *Pixel;
+
+    if (GlyphMasks != NULL) {
+        return GlyphMonoFont;
+    }
+
+    GlyphMasks = AllocateZeroPool (FONT_NUM_CHARS * FontCellWidth * BaseFontImage->Height);
+    if (GlyphMasks == NULL) {
+        return FALSE;
+    }
+
+    GlyphMonoFont = TRUE;
+    for (i = 0; i < (BaseFontImage->Width * BaseFontImage->Height); i++) {
+        Pixel = &BaseFontImage->PixelData[i];
+        if (Pixel->a == 0) {
+            continue;
+        }
+
+        if (!FoundInk) {
+            GlyphInkColor = *Pixel;
+            FoundInk      = TRUE;
+        }
+        else if (Pixel->r != GlyphInkColor.r ||
+            Pixel->g != GlyphInkColor.g ||
+            Pixel->b != GlyphInkColor.b
+        ) {
+            GlyphMonoFont = FALSE;
+            break;
+        }
+    } // for
+
+    return GlyphMonoFont;
+} // static BOOLEAN egPrepareGlyphCache()
+
+static
+UINT8 * egGetGlyphMask (
+    IN UINTN c
+) {
+    UINTN      x, y;
+    UINT8     *Mask;
+    EG_PIXEL  *FontPtr;
+
+    Mask = GlyphMasks + c * FontCellWidth * BaseFontImage->Height;
+    if (!GlyphReady[c]) {
+        FontPtr = BaseFontImage->PixelData + c * FontCellWidth;
+        for (y = 0; y < BaseFontImage->Height; y++) {
+            for (x = 0; x < FontCellWidth; x++) {
+                Mask[y * FontCellWidth + x] = FontPtr[x].a;
+            }
+            FontPtr += BaseFontImage->Width;
+        }
+        GlyphReady[c] = TRUE;
+    }
+
+    return Mask;
+} // static UINT8 * egGetGlyphMask()
+
+// Blends a whole run of glyphs into the buffer, one scanline at a time.
+// Uses the same rounding as egRawCompose().
+static
+VOID egRenderTextRun (
+    IN     UINTN     *Glyphs,
+    IN     UINTN      GlyphCount,
+    IN OUT EG_PIXEL  *BufferPtr,
+    IN     UINTN      BufferLineOffset,
+    IN     EG_PIXEL  *Ink
+) {
+    UINTN      i, x, y;
+    UINTN      Alpha, RevAlpha, Temp;
+    UINT8     *Mask;
+    EG_PIXEL  *CompPtr;
+
+    for (y = 0; y < BaseFontImage->Height; y++) {
+        CompPtr = BufferPtr + y * BufferLineOffset;
+
+        for (i = 0; i < GlyphCount; i++) {
+            Mask = egGetGlyphMask (Glyphs[i]) + y * FontCellWidth;
+
+            for (x = 0; x < FontCellWidth; x++, CompPtr++) {
+                Alpha = Mask[x];
+                if (Alpha == 0) {
+                    continue;
+                }
+
+                if (Alpha == 255) {
+                    CompPtr->b = Ink->b;
+                    CompPtr->g = Ink->g;
+                    CompPtr->r = Ink->r;
+                    continue;
+                }
+
+                RevAlpha   = 255 - Alpha;
+                Temp       = (UINTN) CompPtr->b * RevAlpha + (UINTN) Ink->b * Alpha + 0x80;
+                CompPtr->b = (Temp + (Temp >> 8)) >> 8;
+                Temp       = (UINTN) CompPtr->g * RevAlpha + (UINTN) Ink->g * Alpha + 0x80;
+                CompPtr->g = (Temp + (Temp >> 8)) >> 8;
+                Temp       = (UINTN) CompPtr->r * RevAlpha + (UINTN) Ink->r * Alpha + 0x80;
+                CompPtr->r = (Temp + (Temp >> 8)) >> 8;
+            } // for x
+        } // for i
+    } // for y
+} // static VOID egRenderTextRun()
+
 VOID egRenderText (
     IN CHAR16       *Text,
     IN OUT EG_IMAGE *CompImage,
@@ -126,8 +253,10 @@ VOID egRenderText (
     EG_IMAGE        *FontImage;
     EG_PIXEL        *BufferPtr;
     EG_PIXEL        *FontPixelData;
+    EG_PIXEL         Ink;
     UINTN            BufferLineOffset, FontLineOffset;
     UINTN            TextLength;
+    UINTN           *Glyphs;
     UINTN            i, c;
 
     // Nothing to do if nothing was passed
@@ -142,6 +271,38 @@ VOID egRenderText (
         TextLength = (CompImage->Width - PosX) / FontCellWidth;
     }
 
+    if (TextLength == 0) {
+        return;
+    }
+
+    BufferPtr         = CompImage->PixelData;
+    BufferLineOffset  = CompImage->Width;
+    BufferPtr        += PosX + PosY * BufferLineOffset;
+
+    // Single colour fonts are blended from the glyph cache in one pass
+    if (egPrepareGlyphCache()) {
+        Glyphs = AllocatePool (TextLength * sizeof (UINTN));
+        if (Glyphs != NULL) {
+            for (i = 0; i < TextLength; i++) {
+                c = Text[i];
+                Glyphs[i] = (c < 32 || c >= 127) ? 95 : c - 32;
+            }
+
+            // The light font is the inverse of the base font
+            Ink = GlyphInkColor;
+            if (BGBrightness < 128) {
+                Ink.r = 255 - Ink.r;
+                Ink.g = 255 - Ink.g;
+                Ink.b = 255 - Ink.b;
+            }
+
+            egRenderTextRun (Glyphs, TextLength, BufferPtr, BufferLineOffset, &Ink);
+            MY_FREE_POOL(Glyphs);
+
+            return;
+        }
+    }
+
     if (BGBrightness < 128) {
         if (LightFontImage == NULL) {
             LightFontImage = egCopyImage(BaseFontImage);
@@ -170,9 +331,6 @@ VOID egRenderText (
     }
 
     // render it
-    BufferPtr         = CompImage->PixelData;
-    BufferLineOffset  = CompImage->Width;
-    BufferPtr        += PosX + PosY * BufferLineOffset;
     FontPixelData     = FontImage->PixelData;
     FontLineOffset    = FontImage->Width;
 
@@ -199,6 +357,9 @@ VOID egLoadFont (
     IN CHAR16 *Filename
 ) {
     MY_FREE_IMAGE(BaseFontImage);
+    MY_FREE_IMAGE(DarkFontImage);
+    MY_FREE_IMAGE(LightFontImage);
+    egFreeGlyphCache();
     BaseFontImage = egLoadImage(SelfDir, Filename, TRUE);
     LEAKABLEONEIMAGE(BaseFontImage, "BaseFontImage");
 